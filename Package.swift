@@ -4,6 +4,10 @@
 
 import PackageDescription
 
+// Building with BONJSON_STATS set (e.g. `BONJSON_STATS=1 swift test`) compiles in the scan
+// and encode counters behind the decoder's and encoder's statisticsHandler.
+let collectsStatistics = Context.environment["BONJSON_STATS"] != nil
+
 let package = Package(
     name: "BONJSON",
     products: [
@@ -13,17 +17,27 @@ let package = Package(
         .executable(
             name: "bonjson-benchmark",
             targets: ["BONJSONBenchmark"]),
+        .executable(
+            name: "bonjson-c-benchmark",
+            targets: ["CKSBonjsonBenchmark"]),
     ],
     targets: [
         .target(
             name: "CKSBonjson",
-            publicHeadersPath: "include"),
+            publicHeadersPath: "include",
+            cSettings: collectsStatistics ? [.define("KSBONJSON_STATS")] : []),
         .target(
             name: "BONJSON",
-            dependencies: ["CKSBonjson"]),
+            dependencies: ["CKSBonjson"],
+            swiftSettings: collectsStatistics ? [.define("BONJSON_STATS")] : []),
         .executableTarget(
             name: "BONJSONBenchmark",
             dependencies: ["BONJSON"]),
+        // Compiles the CKSBonjson sources itself (so it can count the decoder's allocations)
+        // instead of depending on the CKSBonjson target.
+        .executableTarget(
+            name: "CKSBonjsonBenchmark",
+            linkerSettings: [.linkedLibrary("m", .when(platforms: [.linux]))]),
         .executableTarget(
             name: "BONJSONProfiler",
             dependencies: ["BONJSON"]),
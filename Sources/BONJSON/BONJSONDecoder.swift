@@ -2,6 +2,7 @@
 // ABOUTME: Uses C position-map API for single-pass scanning and random access decoding.
 
 import Foundation
+import Dispatch
 import CKSBonjson
 
 /// An object that decodes instances of a data type from BONJSON data.
@@ -165,6 +166,23 @@ public final class BONJSONDecoder {
         case allow
     }
 
+    /// The strategy for how much of the document is mapped before decoding starts.
+    public enum MappingStrategy {
+        /// Map every value in the document up front (default).
+        case eager
+
+        /// Check the document's structure up front, but map each container's
+        /// contents only when decoding first reaches it. Partial decodes of large
+        /// documents then cost roughly what they read. String and duplicate key
+        /// validation only covers the containers that are actually decoded.
+        case lazy
+
+        /// Map like `.eager`, but split a large root array's elements across
+        /// threads to scan them concurrently. Other documents, and root arrays
+        /// too small to be worth splitting, are mapped as `.eager` would.
+        case parallel
+    }
+
     /// The strategy to use for decoding dates. Default is `.secondsSince1970`.
     public var dateDecodingStrategy: DateDecodingStrategy = .secondsSince1970
 
@@ -217,6 +235,30 @@ public final class BONJSONDecoder {
     /// The strategy for Unicode normalization of decoded strings.
     public var unicodeNormalizationStrategy: UnicodeNormalizationStrategy = .none
 
+    /// The strategy for mapping the document. Default is `.eager`.
+    /// `.lazy` falls back to `.eager` when NFC normalization is combined with
+    /// duplicate key rejection, since that check needs every key.
+    public var mappingStrategy: MappingStrategy = .eager
+
+    /// Whether the elements of a root array are decoded on several threads.
+    /// Default is `false`.
+    ///
+    /// Applies when decoding `[T]` whose elements aren't batch decoded primitives,
+    /// and pays off when each element is costly to decode. Custom date and data
+    /// decoding closures may then be called from several threads at once.
+    /// Ignored when the map is built lazily.
+    public var decodesArrayElementsConcurrently: Bool = false
+
+    /// Called with the statistics of each document decoded successfully. Default is `nil`.
+    ///
+    /// The counters are compiled out of normal builds, so this is only called when
+    /// the package was built with the `BONJSON_STATS` environment variable set.
+    public var statisticsHandler: ((Statistics) -> Void)? = nil
+
+    /// Whether the statistics include how long each phase took. Default is `false`,
+    /// since reading the clock adds to what is being measured.
+    public var statisticsIncludeTimings: Bool = false
+
     /// Contextual user info for decoding.
     public var userInfo: [CodingUserInfoKey: Any] = [:]
 
@@ -231,18 +273,295 @@ public final class BONJSONDecoder {
     /// - Returns: A value of the requested type.
     /// - Throws: An error if decoding fails.
     public func decode<T: Decodable>(_ type: T.Type, from data: Data) throws -> T {
-        // Build decode flags from strategies
-        let decodeFlags = makeDecodeFlags()
-
         // Build the position map using C API
         let map = try _PositionMap(
             data: data,
-            flags: decodeFlags,
+            flags: makeDecodeFlags(),
+            unicodeStrategy: unicodeDecodingStrategy,
+            nulStrategy: nulDecodingStrategy,
+            duplicateKeyStrategy: duplicateKeyDecodingStrategy,
+            normalizationStrategy: unicodeNormalizationStrategy,
+            lazy: usesLazyMapping,
+            parallel: mappingStrategy == .parallel,
+            compactRecords: usesCompactRecords,
+            statistics: statisticsMode
+        )
+        return try decode(type, from: map)
+    }
+
+    /// Decodes a value of the given type from BONJSON bytes without copying them.
+    ///
+    /// The position map points straight into `buffer`, so the bytes must stay valid
+    /// and unmodified until this call returns.
+    ///
+    /// - Parameters:
+    ///   - type: The type to decode.
+    ///   - buffer: The BONJSON bytes to decode.
+    /// - Returns: A value of the requested type.
+    /// - Throws: An error if decoding fails.
+    public func decode<T: Decodable>(_ type: T.Type, from buffer: UnsafeRawBufferPointer) throws -> T {
+        let map = try _PositionMap(
+            bytes: buffer,
+            flags: makeDecodeFlags(),
             unicodeStrategy: unicodeDecodingStrategy,
             nulStrategy: nulDecodingStrategy,
             duplicateKeyStrategy: duplicateKeyDecodingStrategy,
-            normalizationStrategy: unicodeNormalizationStrategy
+            normalizationStrategy: unicodeNormalizationStrategy,
+            lazy: usesLazyMapping,
+            parallel: mappingStrategy == .parallel,
+            compactRecords: usesCompactRecords,
+            statistics: statisticsMode
         )
+        return try decode(type, from: map)
+    }
+
+    /// Decodes a value of the given type from BONJSON data, reusing the position map
+    /// storage kept by `session` rather than allocating it afresh.
+    ///
+    /// - Parameters:
+    ///   - type: The type to decode.
+    ///   - data: The BONJSON data to decode.
+    ///   - session: Storage to reuse. Must not be used from another thread at the same time.
+    /// - Returns: A value of the requested type.
+    /// - Throws: An error if decoding fails.
+    public func decode<T: Decodable>(_ type: T.Type, from data: Data, using session: BONJSONSession) throws -> T {
+        let map = try _PositionMap(
+            data: data,
+            flags: makeDecodeFlags(),
+            unicodeStrategy: unicodeDecodingStrategy,
+            nulStrategy: nulDecodingStrategy,
+            duplicateKeyStrategy: duplicateKeyDecodingStrategy,
+            normalizationStrategy: unicodeNormalizationStrategy,
+            lazy: usesLazyMapping,
+            parallel: mappingStrategy == .parallel,
+            compactRecords: usesCompactRecords,
+            session: session,
+            statistics: statisticsMode
+        )
+        return try decode(type, from: map)
+    }
+
+    /// Decodes a value of the given type from BONJSON bytes without copying them,
+    /// reusing the position map storage kept by `session`.
+    ///
+    /// - Parameters:
+    ///   - type: The type to decode.
+    ///   - buffer: The BONJSON bytes to decode. Must stay valid until this call returns.
+    ///   - session: Storage to reuse. Must not be used from another thread at the same time.
+    /// - Returns: A value of the requested type.
+    /// - Throws: An error if decoding fails.
+    public func decode<T: Decodable>(_ type: T.Type, from buffer: UnsafeRawBufferPointer, using session: BONJSONSession) throws -> T {
+        let map = try _PositionMap(
+            bytes: buffer,
+            flags: makeDecodeFlags(),
+            unicodeStrategy: unicodeDecodingStrategy,
+            nulStrategy: nulDecodingStrategy,
+            duplicateKeyStrategy: duplicateKeyDecodingStrategy,
+            normalizationStrategy: unicodeNormalizationStrategy,
+            lazy: usesLazyMapping,
+            parallel: mappingStrategy == .parallel,
+            compactRecords: usesCompactRecords,
+            session: session,
+            statistics: statisticsMode
+        )
+        return try decode(type, from: map)
+    }
+
+    /// Decodes a value of the given type from a BONJSON file.
+    ///
+    /// The file is memory-mapped and decoded in place, so large documents are
+    /// never copied into a second resident buffer.
+    ///
+    /// - Parameters:
+    ///   - type: The type to decode.
+    ///   - url: The location of the BONJSON file.
+    /// - Returns: A value of the requested type.
+    /// - Throws: An error if the file can't be read or decoding fails.
+    public func decode<T: Decodable>(_ type: T.Type, contentsOf url: URL) throws -> T {
+        let data = try Data(contentsOf: url, options: .alwaysMapped)
+        return try data.withUnsafeBytes { buffer in
+            try decode(type, from: buffer)
+        }
+    }
+
+    // MARK: - Map Indexes
+
+    /// Maps a BONJSON file and saves the map as an index file, so that later decodes of
+    /// the same file (in this process or another) can open it instead of scanning the
+    /// whole document again. See `decode(_:contentsOf:index:)`.
+    ///
+    /// The index holds 16 to 20 bytes per value, is written to a temporary file and
+    /// then moved into place, and is only usable with a decoder whose limits, string
+    /// strategies and key decoding strategy match this one's (other settings, such as
+    /// date strategies, can differ). It is tied to the machine's byte order and this
+    /// library's version.
+    ///
+    /// - Parameters:
+    ///   - url: The location of the BONJSON file.
+    ///   - indexURL: Where to write the index.
+    /// - Throws: An error if the file can't be read or mapped, or the index can't be written.
+    public func writeIndex(forContentsOf url: URL, to indexURL: URL) throws {
+        let document = try NSData(contentsOf: url, options: .alwaysMapped)
+        let map = try _PositionMap(
+            bytes: UnsafeRawBufferPointer(start: document.bytes, count: document.length),
+            flags: makeDecodeFlags(),
+            unicodeStrategy: unicodeDecodingStrategy,
+            nulStrategy: nulDecodingStrategy,
+            duplicateKeyStrategy: duplicateKeyDecodingStrategy,
+            normalizationStrategy: unicodeNormalizationStrategy,
+            parallel: mappingStrategy == .parallel,
+            compactRecords: usesCompactRecords
+        )
+        try withExtendedLifetime(document) {
+            if unicodeNormalizationStrategy == .nfc && duplicateKeyDecodingStrategy == .reject {
+                try map.validateNFCDuplicateKeys()
+            }
+
+            let temporaryURL = indexURL.deletingLastPathComponent()
+                .appendingPathComponent(".\(indexURL.lastPathComponent).\(UUID().uuidString)")
+            guard let stream = OutputStream(url: temporaryURL, append: false) else {
+                throw BONJSONDecodingError.invalidURL(indexURL.absoluteString)
+            }
+            stream.open()
+            let written = Result { try map.writeIndex(to: stream) }
+            stream.close()
+            do {
+                try written.get()
+                if FileManager.default.fileExists(atPath: indexURL.path) {
+                    _ = try FileManager.default.replaceItemAt(indexURL, withItemAt: temporaryURL)
+                } else {
+                    try FileManager.default.moveItem(at: temporaryURL, to: indexURL)
+                }
+            } catch {
+                try? FileManager.default.removeItem(at: temporaryURL)
+                throw error
+            }
+        }
+    }
+
+    /// Decodes a value of the given type from a BONJSON file, using an index written by
+    /// `writeIndex(forContentsOf:to:)` instead of scanning the document.
+    ///
+    /// Both files are memory-mapped, and the map points into the index rather than
+    /// copying it, so this takes the same time to start decoding however large the
+    /// document is, and processes decoding the same file share its pages. Only the
+    /// values the decode reads are touched.
+    ///
+    /// The index is checked against the file's length and a hash of sampled blocks of it,
+    /// which catches a replaced or rewritten file but not every edit in place. Otherwise
+    /// the index is trusted: only use indexes you wrote. `statisticsHandler` isn't called.
+    ///
+    /// - Parameters:
+    ///   - type: The type to decode.
+    ///   - url: The location of the BONJSON file.
+    ///   - indexURL: The location of its index.
+    /// - Returns: A value of the requested type.
+    /// - Throws: `BONJSONDecodingError.indexMismatch` if the index was written for another
+    ///   file or with other decoder settings, or an error if decoding fails.
+    public func decode<T: Decodable>(_ type: T.Type, contentsOf url: URL, index indexURL: URL) throws -> T {
+        return try decode(type, from: makeIndexedMap(contentsOf: url, index: indexURL))
+    }
+
+    /// Opens a BONJSON file's map from its index. Used by `decode(_:contentsOf:index:)`
+    /// and `BONJSONDocument`.
+    func makeIndexedMap(contentsOf url: URL, index indexURL: URL) throws -> _PositionMap {
+        return try _PositionMap(
+            document: NSData(contentsOf: url, options: .alwaysMapped),
+            index: NSData(contentsOf: indexURL, options: .alwaysMapped),
+            flags: makeDecodeFlags(),
+            unicodeStrategy: unicodeDecodingStrategy,
+            nulStrategy: nulDecodingStrategy,
+            duplicateKeyStrategy: duplicateKeyDecodingStrategy,
+            normalizationStrategy: unicodeNormalizationStrategy,
+            compactRecords: usesCompactRecords
+        )
+    }
+
+    /// Whether to build the position map lazily (see `mappingStrategy`).
+    private var usesLazyMapping: Bool {
+        guard mappingStrategy == .lazy else { return false }
+        return !(unicodeNormalizationStrategy == .nfc && duplicateKeyDecodingStrategy == .reject)
+    }
+
+    /// What the position map should count for `statisticsHandler`. Always `.off` unless
+    /// built with BONJSON_STATS, since the C counters don't exist otherwise.
+    private var statisticsMode: _PositionMap.StatisticsMode {
+        #if BONJSON_STATS
+        guard statisticsHandler != nil else { return .off }
+        return statisticsIncludeTimings ? .countsAndTimings : .counts
+        #else
+        return .off
+        #endif
+    }
+
+    /// Whether record instances are mapped as compact records, whose keys are resolved
+    /// once per record definition. Custom key conversion can depend on the coding path,
+    /// so it keeps the per-object lookup.
+    private var usesCompactRecords: Bool {
+        if case .custom = keyDecodingStrategy { return false }
+        return true
+    }
+
+    /// Maps the document at the start of `buffer`, which other documents may follow,
+    /// reusing `session`'s map storage. Used by `BONJSONDocumentReader`.
+    func makeSequenceMap(from buffer: UnsafeRawBufferPointer, lazy: Bool, session: BONJSONSession) throws -> _PositionMap {
+        return try _PositionMap(
+            bytes: buffer,
+            flags: makeDecodeFlags(),
+            unicodeStrategy: unicodeDecodingStrategy,
+            nulStrategy: nulDecodingStrategy,
+            duplicateKeyStrategy: duplicateKeyDecodingStrategy,
+            normalizationStrategy: unicodeNormalizationStrategy,
+            lazy: lazy || usesLazyMapping,
+            compactRecords: usesCompactRecords,
+            sequence: true,
+            session: session,
+            statistics: statisticsMode
+        )
+    }
+
+    /// Maps `data` for path queries (see `BONJSONDocument`). The map is lazy, so a
+    /// query only scans the containers it passes through, except when NFC duplicate
+    /// key checking needs every key up front.
+    func makeQueryMap(from data: Data) throws -> _PositionMap {
+        let checksNFCDuplicates = unicodeNormalizationStrategy == .nfc && duplicateKeyDecodingStrategy == .reject
+        let map = try _PositionMap(
+            data: data,
+            flags: makeDecodeFlags(),
+            unicodeStrategy: unicodeDecodingStrategy,
+            nulStrategy: nulDecodingStrategy,
+            duplicateKeyStrategy: duplicateKeyDecodingStrategy,
+            normalizationStrategy: unicodeNormalizationStrategy,
+            lazy: !checksNFCDuplicates,
+            compactRecords: usesCompactRecords
+        )
+        if checksNFCDuplicates {
+            try map.validateNFCDuplicateKeys()
+        }
+        return map
+    }
+
+    /// Checks that `data` is a document this decoder would accept, without decoding it,
+    /// and returns how deeply its containers nest. Used by `BONJSONFragment`.
+    func validate(_ data: Data) throws -> Int {
+        return try data.withUnsafeBytes { buffer in
+            let map = try _PositionMap(
+                bytes: buffer,
+                flags: makeDecodeFlags(),
+                unicodeStrategy: unicodeDecodingStrategy,
+                nulStrategy: nulDecodingStrategy,
+                duplicateKeyStrategy: duplicateKeyDecodingStrategy,
+                normalizationStrategy: unicodeNormalizationStrategy
+            )
+            if unicodeNormalizationStrategy == .nfc && duplicateKeyDecodingStrategy == .reject {
+                try map.validateNFCDuplicateKeys()
+            }
+            return map.nestingDepth
+        }
+    }
+
+    /// Decodes a value from an already-scanned position map.
+    func decode<T: Decodable>(_ type: T.Type, from map: _PositionMap) throws -> T {
 
         // When NFC normalization is active, C-layer duplicate detection is deferred
         // because byte-equal keys may become equal after NFC normalization
@@ -250,7 +569,19 @@ public final class BONJSONDecoder {
             try map.validateNFCDuplicateKeys()
         }
 
-        let rootIndex = map.rootIndex
+        guard let handler = statisticsHandler, let stats = map.statistics else {
+            return try decode(type, from: map, at: map.rootIndex)
+        }
+        let startTime = stats.pointee.measuresTime ? DispatchTime.now().uptimeNanoseconds : 0
+        let value = try decode(type, from: map, at: map.rootIndex)
+        let decodeNanoseconds = stats.pointee.measuresTime ? DispatchTime.now().uptimeNanoseconds - startTime : 0
+        handler(Statistics(stats.pointee, decodeNanoseconds: decodeNanoseconds))
+        return value
+    }
+
+    /// Decodes the value at `rootIndex` in a position map whose keys have already
+    /// been validated.
+    func decode<T: Decodable>(_ type: T.Type, from map: _PositionMap, at rootIndex: size_t) throws -> T {
 
         // Fast path: batch decode for primitive arrays
         if let result = tryBatchDecode(type, from: map, at: rootIndex) {
@@ -269,11 +600,23 @@ public final class BONJSONDecoder {
             duplicateKeyDecodingStrategy: duplicateKeyDecodingStrategy,
             maxBigNumberExponent: maxBigNumberExponent,
             maxBigNumberMagnitude: maxBigNumberMagnitude,
-            outOfRangeBigNumberDecodingStrategy: outOfRangeBigNumberDecodingStrategy
+            outOfRangeBigNumberDecodingStrategy: outOfRangeBigNumberDecodingStrategy,
+            decodesOnOneThread: !decodesArrayElementsConcurrently
         )
+        defer { state.drainDecoderPool() }
+
+        if decodesArrayElementsConcurrently,
+           let arrayType = type as? _ConcurrentlyDecodableArray.Type,
+           let result = try arrayType.decodeConcurrently(state: state, at: rootIndex) {
+            return result as! T
+        }
 
         let decoder = _MapDecoder(state: state, entryIndex: rootIndex, lazyPath: .root)
 
+        if let result = try decoder.decodeFields(type) {
+            return result
+        }
+
         // Handle special types that need custom decoding
         if type == Date.self {
             return try decoder.decodeDate() as! T
@@ -430,6 +773,8 @@ public enum BONJSONDecodingError: Error, CustomStringConvertible {
     case bigNumberExponentOutOfRange(Int32)
     case bigNumberExponentExceeded(Int32)
     case bigNumberMagnitudeExceeded(Int)
+    case invalidPath(String)
+    case indexMismatch
 
     public var description: String {
         switch self {
@@ -452,7 +797,7 @@ public enum BONJSONDecodingError: Error, CustomStringConvertible {
         case .duplicateObjectKey(let key):
             return "Duplicate object key: \(key)"
         case .tooManyKeys:
-            return "Object has more keys than the duplicate detection limit (256)"
+            return "Not enough memory to track an object's keys for duplicate detection"
         case .typeMismatch(let expected, let actual):
             return "Type mismatch: expected \(expected), got \(actual)"
         case .keyNotFound(let key):
@@ -485,6 +830,10 @@ public enum BONJSONDecodingError: Error, CustomStringConvertible {
             return "BigNumber exponent \(exp) exceeds maximum allowed"
         case .bigNumberMagnitudeExceeded(let bytes):
             return "BigNumber magnitude \(bytes) bytes exceeds maximum allowed"
+        case .invalidPath(let expression):
+            return "Invalid path expression: \(expression)"
+        case .indexMismatch:
+            return "Map index was written for another document, or with other decoder settings"
         }
     }
 }
@@ -493,22 +842,61 @@ public enum BONJSONDecodingError: Error, CustomStringConvertible {
 
 /// Wraps the C position map API for Swift use.
 final class _PositionMap {
-    /// The input data as a contiguous array - keeps pointer stable.
-    private let inputBytes: ContiguousArray<UInt8>
+    /// The input bytes. Points either at a private copy (see `ownedInput`)
+    /// or at caller-owned memory that must outlive the map.
+    private let inputBytes: UnsafeBufferPointer<UInt8>
+
+    /// The copy of the input made by `init(data:)`, released (or returned to the
+    /// session) in deinit. May be larger than the input when reused from a session.
+    /// Nil when decoding directly from caller-owned memory.
+    private let ownedInput: UnsafeMutableBufferPointer<UInt8>?
+
+    /// The session whose storage this map borrowed, and returns in deinit.
+    private let session: BONJSONSession?
+
+    /// The mapped document and index of a map opened from an index, which the
+    /// context points into. Empty for a scanned map.
+    private let mappedFiles: [NSData]
 
-    /// The map context.
-    private var context: KSBONJSONMapContext
+    /// The map context. Allocated without being zeroed, since the C begin functions set
+    /// everything a scan reads (the container stack and record definitions are several KB,
+    /// more than a small document costs to decode). Owned by this map, or by its session.
+    private let context: UnsafeMutablePointer<KSBONJSONMapContext>
 
-    /// The entry buffer - using ContiguousArray for better performance.
-    private var entries: ContiguousArray<KSBONJSONMapEntry>
+    /// The entry buffer, allocated and grown by the C scanner.
+    /// Owned by this map and released in deinit. Reallocated when a lazy map
+    /// expands a container, so always re-read it after `expandContainer(at:)`.
+    private var entries: UnsafeMutablePointer<KSBONJSONMapEntry>
+
+    /// Whether containers are scanned on first access rather than up front.
+    let isLazy: Bool
+
+    /// Whether record instances are mapped as compact records (values only).
+    let compactRecords: Bool
+
+    /// Length of the mapped document in bytes. Only differs from the input
+    /// length for a document read from a sequence (which others may follow).
+    let documentLength: Int
 
     /// Precomputed next sibling index for each entry (index after subtree).
     /// Using ContiguousArray for cache-friendly access.
+    /// Empty for lazy maps and small documents, where the sibling is read from the
+    /// entry's subtree size instead.
     private var nextSibling: ContiguousArray<Int>
 
-    /// Cache for already-decoded strings, keyed by (offset, length).
-    /// This avoids creating duplicate String objects for repeated keys.
-    private var stringCache: [UInt64: String] = [:]
+    /// One String per interned key id, created the first time a key with that id is
+    /// read, so a key repeated across many objects is only decoded once.
+    /// Filled up front by prepareForConcurrentReads().
+    private var keyStrings: ContiguousArray<String?>
+
+    /// Whether the scan interned the object keys (see ksbonjson_map_setInternKeys).
+    /// Off for small documents.
+    let internsKeys: Bool
+
+    /// Documents shorter than this (in bytes) skip the sibling table and key interning.
+    /// With only a handful of values, building them costs more than they save, and
+    /// the per-call setup dominates small (RPC-sized) messages.
+    static let smallDocumentSize = 256
 
     /// Actual entry count after scanning.
     @usableFromInline var entryCount: Int
@@ -516,6 +904,17 @@ final class _PositionMap {
     /// Root entry index.
     @usableFromInline private(set) var rootIndex: size_t
 
+    /// What the scan counts (see `BONJSONDecoder.statisticsHandler`).
+    enum StatisticsMode {
+        case off
+        case counts
+        case countsAndTimings
+    }
+
+    /// The counters the C scanner fills in, owned by this map and released in deinit.
+    /// Nil unless statistics were requested. Lazy expansions keep adding to them.
+    private(set) var statistics: UnsafeMutablePointer<KSBONJSONMapStats>?
+
     /// Security strategies for string handling.
     let unicodeStrategy: BONJSONDecoder.UnicodeDecodingStrategy
     let nulStrategy: BONJSONDecoder.NULDecodingStrategy
@@ -535,13 +934,99 @@ final class _PositionMap {
     }
 
     /// Full initializer with security configuration.
-    init(
+    /// Copies the data so the map owns a stable input buffer.
+    convenience init(
         data: Data,
         flags: KSBONJSONDecodeFlags,
         unicodeStrategy: BONJSONDecoder.UnicodeDecodingStrategy,
         nulStrategy: BONJSONDecoder.NULDecodingStrategy,
         duplicateKeyStrategy: BONJSONDecoder.DuplicateKeyDecodingStrategy,
-        normalizationStrategy: BONJSONDecoder.UnicodeNormalizationStrategy = .none
+        normalizationStrategy: BONJSONDecoder.UnicodeNormalizationStrategy = .none,
+        lazy: Bool = false,
+        parallel: Bool = false,
+        compactRecords: Bool = false,
+        session: BONJSONSession? = nil,
+        statistics: StatisticsMode = .off
+    ) throws {
+        var storage = session?.takeMapStorage()
+        let copy: UnsafeMutableBufferPointer<UInt8>
+        if let input = storage?.input, input.count >= data.count {
+            copy = input
+        } else {
+            storage?.input?.deallocate()
+            copy = UnsafeMutableBufferPointer<UInt8>.allocate(capacity: data.count)
+        }
+        storage?.input = nil
+        _ = copy.initialize(from: data)
+        try self.init(
+            bytes: UnsafeRawBufferPointer(rebasing: UnsafeRawBufferPointer(copy)[..<data.count]),
+            ownedInput: copy,
+            flags: flags,
+            unicodeStrategy: unicodeStrategy,
+            nulStrategy: nulStrategy,
+            duplicateKeyStrategy: duplicateKeyStrategy,
+            normalizationStrategy: normalizationStrategy,
+            lazy: lazy,
+            parallel: parallel,
+            compactRecords: compactRecords,
+            sequence: false,
+            storage: storage,
+            session: session,
+            statistics: statistics
+        )
+    }
+
+    /// Zero-copy initializer: maps caller-owned memory in place.
+    /// The bytes must stay valid and unmodified for the lifetime of the map.
+    /// With `sequence`, only the document at the start of the bytes is mapped
+    /// and others may follow it (see `documentLength`).
+    convenience init(
+        bytes: UnsafeRawBufferPointer,
+        flags: KSBONJSONDecodeFlags,
+        unicodeStrategy: BONJSONDecoder.UnicodeDecodingStrategy,
+        nulStrategy: BONJSONDecoder.NULDecodingStrategy,
+        duplicateKeyStrategy: BONJSONDecoder.DuplicateKeyDecodingStrategy,
+        normalizationStrategy: BONJSONDecoder.UnicodeNormalizationStrategy = .none,
+        lazy: Bool = false,
+        parallel: Bool = false,
+        compactRecords: Bool = false,
+        sequence: Bool = false,
+        session: BONJSONSession? = nil,
+        statistics: StatisticsMode = .off
+    ) throws {
+        try self.init(
+            bytes: bytes,
+            ownedInput: nil,
+            flags: flags,
+            unicodeStrategy: unicodeStrategy,
+            nulStrategy: nulStrategy,
+            duplicateKeyStrategy: duplicateKeyStrategy,
+            normalizationStrategy: normalizationStrategy,
+            lazy: lazy,
+            parallel: parallel,
+            compactRecords: compactRecords,
+            sequence: sequence,
+            storage: session?.takeMapStorage(),
+            session: session,
+            statistics: statistics
+        )
+    }
+
+    private init(
+        bytes: UnsafeRawBufferPointer,
+        ownedInput: UnsafeMutableBufferPointer<UInt8>?,
+        flags: KSBONJSONDecodeFlags,
+        unicodeStrategy: BONJSONDecoder.UnicodeDecodingStrategy,
+        nulStrategy: BONJSONDecoder.NULDecodingStrategy,
+        duplicateKeyStrategy: BONJSONDecoder.DuplicateKeyDecodingStrategy,
+        normalizationStrategy: BONJSONDecoder.UnicodeNormalizationStrategy,
+        lazy: Bool,
+        parallel: Bool,
+        compactRecords: Bool,
+        sequence: Bool,
+        storage: _PositionMapStorage?,
+        session: BONJSONSession?,
+        statistics mode: StatisticsMode
     ) throws {
         // Store strategies for later use in string creation
         self.unicodeStrategy = unicodeStrategy
@@ -549,89 +1034,332 @@ final class _PositionMap {
         self.duplicateKeyStrategy = duplicateKeyStrategy
         self.normalizationStrategy = normalizationStrategy
 
-        // Copy to contiguous array to ensure stable pointer
-        self.inputBytes = ContiguousArray(data)
-
-        // Estimate entry count — records may expand to more entries than data length,
-        // so retry with a larger buffer if the map fills up.
-        var currentCapacity = Int(ksbonjson_map_estimateEntries(inputBytes.count))
-        self.entries = ContiguousArray<KSBONJSONMapEntry>(repeating: KSBONJSONMapEntry(), count: currentCapacity)
-        self.nextSibling = []   // Will be computed after scanning
-        self.entryCount = 0
-        self.context = KSBONJSONMapContext()
-        self.rootIndex = 0  // Will be set after scanning
-
-        // Initialize and scan using stable pointers, retrying if map is full
-        var scanSucceeded = false
-        while !scanSucceeded {
-            try inputBytes.withUnsafeBufferPointer { inputPtr in
-                try entries.withUnsafeMutableBufferPointer { entriesPtr in
-                    ksbonjson_map_beginWithFlags(
-                        &context,
-                        inputPtr.baseAddress,
-                        inputPtr.count,
-                        entriesPtr.baseAddress,
-                        entriesPtr.count,
-                        flags
-                    )
+        // The bytes may belong to the caller, so assume (rather than rebind) their type
+        let inputBytes = UnsafeBufferPointer(start: bytes.baseAddress?.assumingMemoryBound(to: UInt8.self),
+                                             count: bytes.count)
+
+        // Scan once into an entry buffer that the C scanner grows in chunks as needed,
+        // so allocation is proportional to the actual value count (records included).
+        // A session's context already has a grown buffer, which the scan starts from.
+        var storage = storage
+        let context: UnsafeMutablePointer<KSBONJSONMapContext>
+        if let reused = storage?.context {
+            context = reused
+            ksbonjson_map_resetGrowable(context, inputBytes.baseAddress, inputBytes.count, flags)
+        } else {
+            context = .allocate(capacity: 1)
+            ksbonjson_map_beginGrowable(context, inputBytes.baseAddress, inputBytes.count, flags)
+        }
+        ksbonjson_map_setLazy(context, lazy)
+        ksbonjson_map_setCompactRecords(context, compactRecords)
+        ksbonjson_map_setInternKeys(context, inputBytes.count >= _PositionMap.smallDocumentSize)
+        var statistics: UnsafeMutablePointer<KSBONJSONMapStats>?
+        if mode != .off {
+            statistics = .allocate(capacity: 1)
+            statistics!.initialize(to: KSBONJSONMapStats())
+            statistics!.pointee.measuresTime = mode == .countsAndTimings
+            ksbonjson_map_setStats(context, statistics)
+        }
+        var documentLength = inputBytes.count
+        let status: ksbonjson_decodeStatus
+        if sequence {
+            status = ksbonjson_map_scanDocument(context, &documentLength)
+        } else {
+            status = parallel && !lazy ? _PositionMap.scanInParallel(context) : ksbonjson_map_scan(context)
+        }
+        guard status == KSBONJSON_DECODE_OK else {
+            ksbonjson_map_setStats(context, nil)
+            statistics?.deallocate()
+            if let session = session {
+                session.recycle(mapStorage: _PositionMapStorage(
+                    context: context,
+                    nextSibling: storage?.nextSibling ?? [],
+                    keyStrings: storage?.keyStrings ?? [],
+                    input: ownedInput
+                ))
+            } else {
+                ksbonjson_map_freeEntries(context)
+                context.deallocate()
+                ownedInput?.deallocate()
+            }
+            throw _PositionMap.scanError(for: status)
+        }
+
+        self.inputBytes = inputBytes
+        self.ownedInput = ownedInput
+        self.session = session
+        self.mappedFiles = []
+        self.entries = context.pointee.entries!
+        self.isLazy = lazy
+        self.compactRecords = compactRecords
+        self.documentLength = documentLength
+        self.context = context
+        self.statistics = statistics
+        self.rootIndex = ksbonjson_map_root(context)
+        self.entryCount = Int(ksbonjson_map_count(context))
+        self.internsKeys = context.pointee.internKeys
+
+        // Move (rather than copy) the reused arrays so that they stay uniquely
+        // referenced and can be refilled in place
+        self.nextSibling = storage?.nextSibling ?? []
+        self.keyStrings = storage?.keyStrings ?? []
+        storage = nil
 
-                    let status = ksbonjson_map_scan(&context)
-                    guard status == KSBONJSON_DECODE_OK else {
-                        if status == KSBONJSON_DECODE_MAP_FULL {
-                            return // will retry with larger buffer
-                        }
-                        // Map C status codes to Swift errors
-                        switch status {
-                        case KSBONJSON_DECODE_NUL_CHARACTER:
-                            throw BONJSONDecodingError.nulCharacterInString
-                        case KSBONJSON_DECODE_INVALID_UTF8:
-                            throw BONJSONDecodingError.invalidUTF8Sequence
-                        case KSBONJSON_DECODE_DUPLICATE_OBJECT_NAME:
-                            throw BONJSONDecodingError.duplicateObjectKey("")
-                        case KSBONJSON_DECODE_TOO_MANY_KEYS:
-                            throw BONJSONDecodingError.tooManyKeys
-                        case KSBONJSON_DECODE_MAX_DEPTH_EXCEEDED:
-                            throw BONJSONDecodingError.maxDepthExceeded
-                        case KSBONJSON_DECODE_MAX_STRING_LENGTH_EXCEEDED:
-                            throw BONJSONDecodingError.maxStringLengthExceeded
-                        case KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED:
-                            throw BONJSONDecodingError.maxContainerSizeExceeded
-                        case KSBONJSON_DECODE_MAX_DOCUMENT_SIZE_EXCEEDED:
-                            throw BONJSONDecodingError.maxDocumentSizeExceeded
-                        default:
-                            let message = ksbonjson_describeDecodeStatus(status).map { String(cString: $0) } ?? "Unknown error"
-                            throw BONJSONDecodingError.scanFailed(message)
-                        }
-                    }
-                    scanSucceeded = true
-                }
+        // Precompute next sibling indices for O(1) child navigation
+        computeNextSiblingIndices()
+    }
+
+    /// Opens the map saved in an index (see `BONJSONDecoder.writeIndex(forContentsOf:to:)`)
+    /// in place of scanning the document. The sibling table isn't built: siblings are
+    /// read from the entries' subtree sizes, so opening doesn't touch every entry.
+    init(
+        document: NSData,
+        index: NSData,
+        flags: KSBONJSONDecodeFlags,
+        unicodeStrategy: BONJSONDecoder.UnicodeDecodingStrategy,
+        nulStrategy: BONJSONDecoder.NULDecodingStrategy,
+        duplicateKeyStrategy: BONJSONDecoder.DuplicateKeyDecodingStrategy,
+        normalizationStrategy: BONJSONDecoder.UnicodeNormalizationStrategy,
+        compactRecords: Bool
+    ) throws {
+        self.unicodeStrategy = unicodeStrategy
+        self.nulStrategy = nulStrategy
+        self.duplicateKeyStrategy = duplicateKeyStrategy
+        self.normalizationStrategy = normalizationStrategy
+
+        let inputBytes = UnsafeBufferPointer(start: document.bytes.assumingMemoryBound(to: UInt8.self),
+                                             count: document.length)
+        let context = UnsafeMutablePointer<KSBONJSONMapContext>.allocate(capacity: 1)
+        let status = ksbonjson_map_openIndex(context, inputBytes.baseAddress, inputBytes.count,
+                                             index.bytes, index.length, flags)
+        // Record instances must be mapped the way this decoder reads them
+        guard status == KSBONJSON_DECODE_OK && context.pointee.compactRecords == compactRecords else {
+            if status == KSBONJSON_DECODE_OK {
+                ksbonjson_map_closeIndex(context)
             }
-            if !scanSucceeded {
-                // Double the entry buffer and retry
-                currentCapacity *= 2
-                self.entries = ContiguousArray<KSBONJSONMapEntry>(repeating: KSBONJSONMapEntry(), count: currentCapacity)
+            context.deallocate()
+            throw status == KSBONJSON_DECODE_OK ? BONJSONDecodingError.indexMismatch : _PositionMap.scanError(for: status)
+        }
+
+        self.inputBytes = inputBytes
+        self.ownedInput = nil
+        self.session = nil
+        self.mappedFiles = [document, index]
+        self.entries = context.pointee.entries!
+        self.isLazy = false
+        self.compactRecords = compactRecords
+        self.documentLength = inputBytes.count
+        self.context = context
+        self.statistics = nil
+        self.rootIndex = ksbonjson_map_root(context)
+        self.entryCount = Int(ksbonjson_map_count(context))
+        self.internsKeys = context.pointee.internKeys
+        self.nextSibling = []
+        self.keyStrings = []
+    }
+
+    deinit {
+        ksbonjson_map_setStats(context, nil)
+        statistics?.deallocate()
+        if !mappedFiles.isEmpty {
+            // The files are unmapped once this map releases them
+            ksbonjson_map_closeIndex(context)
+            context.deallocate()
+        } else if let session = session {
+            session.recycle(mapStorage: _PositionMapStorage(
+                context: context,
+                nextSibling: nextSibling,
+                keyStrings: keyStrings,
+                input: ownedInput
+            ))
+        } else {
+            ksbonjson_map_freeEntries(context)
+            context.deallocate()
+            ownedInput?.deallocate()
+        }
+    }
+
+    /// Scan a large root array's elements on several threads (see `MappingStrategy.parallel`).
+    /// Falls back to a serial scan for documents the C partition doesn't split.
+    private static func scanInParallel(_ context: UnsafeMutablePointer<KSBONJSONMapContext>) -> ksbonjson_decodeStatus {
+        let maxSegments = ProcessInfo.processInfo.activeProcessorCount
+        var partition = [KSBONJSONMapSegment](repeating: KSBONJSONMapSegment(), count: maxSegments)
+        var segmentCount = 0
+        let status = ksbonjson_map_partition(context, &partition, maxSegments, &segmentCount)
+        guard status == KSBONJSON_DECODE_OK else { return status }
+        guard segmentCount > 0 else { return ksbonjson_map_scan(context) }
+
+        let segments = partition
+        let segmentContexts = UnsafeMutableBufferPointer<KSBONJSONMapContext>.allocate(capacity: segmentCount)
+        segmentContexts.initialize(repeating: KSBONJSONMapContext())
+        let statuses = UnsafeMutableBufferPointer<ksbonjson_decodeStatus>.allocate(capacity: segmentCount)
+        statuses.initialize(repeating: KSBONJSON_DECODE_OK)
+        defer {
+            for i in 0..<segmentCount {
+                ksbonjson_map_freeEntries(&segmentContexts[i])
             }
+            segmentContexts.deallocate()
+            statuses.deallocate()
+        }
+
+        // Segments only read the partitioned context
+        let parent = UnsafePointer(context)
+        DispatchQueue.concurrentPerform(iterations: segmentCount) { i in
+            statuses[i] = ksbonjson_map_scanSegment(segmentContexts.baseAddress! + i, parent, segments[i])
+        }
+        if let failure = statuses.first(where: { $0 != KSBONJSON_DECODE_OK }) {
+            return failure
+        }
+        return ksbonjson_map_joinSegments(context, segmentContexts.baseAddress, segmentCount)
+    }
+
+    /// Map a C scan status to the corresponding Swift error.
+    static func scanError(for status: ksbonjson_decodeStatus) -> BONJSONDecodingError {
+        switch status {
+        case KSBONJSON_DECODE_NUL_CHARACTER:
+            return .nulCharacterInString
+        case KSBONJSON_DECODE_INVALID_UTF8:
+            return .invalidUTF8Sequence
+        case KSBONJSON_DECODE_DUPLICATE_OBJECT_NAME:
+            return .duplicateObjectKey("")
+        case KSBONJSON_DECODE_TOO_MANY_KEYS:
+            return .tooManyKeys
+        case KSBONJSON_DECODE_MAX_DEPTH_EXCEEDED:
+            return .maxDepthExceeded
+        case KSBONJSON_DECODE_MAX_STRING_LENGTH_EXCEEDED:
+            return .maxStringLengthExceeded
+        case KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED:
+            return .maxContainerSizeExceeded
+        case KSBONJSON_DECODE_MAX_DOCUMENT_SIZE_EXCEEDED:
+            return .maxDocumentSizeExceeded
+        case KSBONJSON_DECODE_INDEX_MISMATCH:
+            return .indexMismatch
+        default:
+            let message = ksbonjson_describeDecodeStatus(status).map { String(cString: $0) } ?? "Unknown error"
+            return .scanFailed(message)
         }
-
-        self.rootIndex = ksbonjson_map_root(&context)
-        self.entryCount = Int(ksbonjson_map_count(&context))
-
-        // Precompute next sibling indices for O(1) child navigation
-        self.nextSibling = computeNextSiblingIndices()
     }
 
     /// Build next sibling indices from precomputed subtree sizes in map entries.
     /// nextSibling[i] = i + subtreeSize[i]
-    private func computeNextSiblingIndices() -> ContiguousArray<Int> {
-        let result = ContiguousArray<Int>(unsafeUninitializedCapacity: entryCount) { buffer, count in
-            for i in 0..<entryCount {
-                buffer[i] = i + Int(entries[i].subtreeSize)
+    /// Left empty for lazy maps and small documents. Refills the existing storage,
+    /// so a reused (session) array keeps its capacity.
+    private func computeNextSiblingIndices() {
+        nextSibling.removeAll(keepingCapacity: true)
+        guard !isLazy && documentLength >= _PositionMap.smallDocumentSize else { return }
+        nextSibling.reserveCapacity(entryCount)
+        let entries = self.entries
+        for i in 0..<entryCount {
+            nextSibling.append(i + Int(entries[i].subtreeSize))
+        }
+    }
+
+    /// How deeply the containers of a document this library encoded nest. Only the
+    /// structure is checked: the encoder's own strategies may allow NULs, duplicate keys
+    /// or non-finite floats that a default decoder would reject.
+    static func nestingDepth(ofEncoded data: Data) throws -> Int {
+        var flags = ksbonjson_defaultDecodeFlags()
+        flags.rejectNUL = false
+        flags.rejectInvalidUTF8 = false
+        flags.rejectDuplicateKeys = false
+        flags.rejectNaNInfinity = false
+        return try data.withUnsafeBytes { buffer in
+            try _PositionMap(
+                bytes: buffer,
+                flags: flags,
+                unicodeStrategy: .replace,
+                nulStrategy: .allow,
+                duplicateKeyStrategy: .keepLast
+            ).nestingDepth
+        }
+    }
+
+    /// How deeply the document's containers nest: 0 for a scalar, 1 for a container of
+    /// scalars, and so on. Only meaningful for an eager map.
+    var nestingDepth: Int {
+        var depth = 0
+        var containerEnds: [Int] = []
+        for i in 0..<entryCount {
+            while let end = containerEnds.last, i >= end {
+                containerEnds.removeLast()
+            }
+            switch entries[i].type {
+            case KSBONJSON_TYPE_ARRAY, KSBONJSON_TYPE_OBJECT, KSBONJSON_TYPE_TYPED_ARRAY, KSBONJSON_TYPE_RECORD:
+                containerEnds.append(i + Int(entries[i].subtreeSize))
+                depth = max(depth, containerEnds.count)
+            default:
+                break
             }
-            count = entryCount
         }
+        return depth
+    }
+
+    /// Scan the children of a container that a lazy map hasn't expanded yet, or give
+    /// a typed array span an entry per element so it can be decoded element-wise.
+    /// Does nothing for non-containers and already expanded containers.
+    @inline(__always)
+    func expandContainer(at index: size_t) throws {
+        guard index >= 0 && index < entryCount else { return }
+        let entry = entries[Int(index)]
+        let isSpan = entry.type == KSBONJSON_TYPE_TYPED_ARRAY
+        // UInt32.max is KSBONJSON_MAP_UNEXPANDED
+        let isStub = isLazy &&
+                     (entry.type == KSBONJSON_TYPE_ARRAY || entry.type == KSBONJSON_TYPE_OBJECT ||
+                      entry.type == KSBONJSON_TYPE_RECORD) &&
+                     entry.data.container.count == UInt32.max
+        guard isSpan || isStub else { return }
+
+        let status = ksbonjson_map_expand(context, index)
+        guard status == KSBONJSON_DECODE_OK else {
+            throw _PositionMap.scanError(for: status)
+        }
+        entries = context.pointee.entries!
+        entryCount = Int(ksbonjson_map_count(context))
+    }
+
+    /// Run a C function (such as a path query) on the map's context. The function may
+    /// expand containers or typed array spans, so the entry buffer is re-read afterwards.
+    func withContext<R>(_ body: (UnsafeMutablePointer<KSBONJSONMapContext>) -> R) -> R {
+        let result = body(context)
+        entries = context.pointee.entries!
+        entryCount = Int(ksbonjson_map_count(context))
         return result
     }
 
+    /// Write the map as an index of its document (see `BONJSONDecoder.writeIndex(forContentsOf:to:)`).
+    func writeIndex(to stream: OutputStream) throws {
+        let writer = _MapIndexWriter(stream)
+        let status = withExtendedLifetime(writer) {
+            ksbonjson_map_writeIndex(context, _MapIndexWriter.callback, Unmanaged.passUnretained(writer).toOpaque())
+        }
+        if let error = writer.error {
+            throw error
+        }
+        guard status == KSBONJSON_DECODE_OK else {
+            throw _PositionMap.scanError(for: status)
+        }
+    }
+
+    /// Make the map safe to decode from several threads at once: typed array spans
+    /// are expanded up front (expansion mutates the map), as are the interned key strings.
+    /// Returns false for lazy maps, whose containers are only expanded on first access.
+    func prepareForConcurrentReads() throws -> Bool {
+        guard !isLazy else { return false }
+        let scannedCount = entryCount
+        for index in 0..<scannedCount where entries[index].type == KSBONJSON_TYPE_TYPED_ARRAY {
+            try expandContainer(at: size_t(index))
+        }
+        let keyCount = internsKeys ? Int(context.pointee.internedKeyCount) : 0
+        if keyStrings.count < keyCount {
+            keyStrings.append(contentsOf: repeatElement(nil, count: keyCount - keyStrings.count))
+        }
+        for id in 0..<keyCount where keyStrings[id] == nil {
+            let key = context.pointee.internedKeys![id]
+            keyStrings[id] = createString(offset: Int(key.offset), length: Int(key.length))
+        }
+        return true
+    }
+
     /// Get entry at index - inlined for performance.
     @inline(__always)
     func getEntry(at index: size_t) -> KSBONJSONMapEntry? {
@@ -648,9 +1376,18 @@ final class _PositionMap {
         return entries[index]
     }
 
+    /// Decode a BigNumber entry's payload from the stored input bytes.
+    /// Map entries only record where the payload lives, keeping them at 16 bytes.
+    @inline(__always)
+    func getBigNumber(_ entry: KSBONJSONMapEntry) -> KSBONJSONBigNumberValue {
+        return withUnsafePointer(to: entry) { entryPtr in
+            ksbonjson_map_decodeBigNumber(inputBytes.baseAddress, entryPtr)
+        }
+    }
+
     /// Get string data - reads from stored input bytes using entry offset/length.
-    /// Uses caching to avoid creating duplicate String objects for repeated keys.
-    /// Handles unicode strategy for replace/delete modes.
+    /// Handles unicode strategy for replace/delete modes. Use getKeyString(at:) for
+    /// object keys, which shares one String between keys with the same bytes.
     @inline(__always)
     func getString(at index: size_t) -> String? {
         guard index >= 0 && index < entryCount else {
@@ -669,19 +1406,55 @@ final class _PositionMap {
             return nil
         }
 
-        // Pack offset and length into a single UInt64 key for cache lookup
-        let cacheKey = UInt64(offset) << 32 | UInt64(length)
+        return createString(offset: offset, length: length)
+    }
 
-        // Check cache first
-        if let cached = stringCache[cacheKey] {
-            return cached
+    /// Get the string of an object key entry. With interned keys, every key with the
+    /// same bytes returns the same String, created the first time one of them is read.
+    @inline(__always)
+    func getKeyString(at index: size_t) -> String? {
+        guard let id = keyId(at: index) else {
+            return getString(at: index)
         }
+        if id < keyStrings.count, let string = keyStrings[id] {
+            return string
+        }
+        guard let string = getString(at: index) else {
+            return nil
+        }
+        if id >= keyStrings.count {
+            // A lazy map interns keys as containers are expanded, so ids keep arriving
+            let keyCount = Int(context.pointee.internedKeyCount)
+            keyStrings.append(contentsOf: repeatElement(nil, count: keyCount - keyStrings.count))
+        }
+        keyStrings[id] = string
+        return string
+    }
 
-        let string = createString(offset: offset, length: length)
+    /// The interned id of the object key entry at index, or nil if keys aren't interned.
+    /// Keys with the same id have the same bytes.
+    @inline(__always)
+    func keyId(at index: size_t) -> Int? {
+        guard internsKeys && index >= 0 && index < entryCount else {
+            return nil
+        }
+        // Re-read the pointer: expansion may have grown the table
+        // UInt32.max is KSBONJSON_MAP_NO_KEY_ID
+        let id = context.pointee.keyIds![Int(index)]
+        return id == UInt32.max ? nil : Int(id)
+    }
 
-        // Cache for future lookups
-        stringCache[cacheKey] = string
-        return string
+    /// The interned id of a key, or nil if no object key in the document has its bytes
+    /// (so no object has it). Only meaningful when internsKeys is set.
+    @inline(__always)
+    func keyId(for key: String) -> Int? {
+        var key = key
+        let id = key.withUTF8 { utf8 in
+            utf8.withMemoryRebound(to: CChar.self) { chars in
+                ksbonjson_map_findKeyId(context, chars.baseAddress, chars.count)
+            }
+        }
+        return id == UInt32.max ? nil : Int(id)
     }
 
     /// Create a string from contiguous bytes at the given offset/length.
@@ -690,11 +1463,8 @@ final class _PositionMap {
         switch unicodeStrategy {
         case .reject, .replace:
             // C layer already validated for .reject; .replace uses Swift's behavior
-            result = inputBytes.withUnsafeBufferPointer { ptr in
-                let start = ptr.baseAddress! + offset
-                let buffer = UnsafeBufferPointer(start: start, count: length)
-                return String(decoding: buffer, as: UTF8.self)
-            }
+            let buffer = UnsafeBufferPointer(start: inputBytes.baseAddress! + offset, count: length)
+            result = String(decoding: buffer, as: UTF8.self)
 
         case .delete:
             // Filter out invalid UTF-8 bytes before creating string
@@ -783,8 +1553,22 @@ final class _PositionMap {
     /// Check for duplicate keys in objects after NFC normalization.
     /// Only needed when NFC normalization is active and duplicate rejection is desired.
     func validateNFCDuplicateKeys() throws {
+        var checkedDefinitions = Set<UInt32>()
         for i in 0..<entryCount {
             let entry = entries[i]
+
+            // Compact records share their definition's keys, so check each definition once
+            if entry.type == KSBONJSON_TYPE_RECORD {
+                guard checkedDefinitions.insert(entry.data.record.definition).inserted else { continue }
+                var seenKeys = Set<String>()
+                for keyIndex in recordKeyIndices(definition: Int(entry.data.record.definition)) {
+                    if let key = getKeyString(at: size_t(keyIndex)), !seenKeys.insert(key).inserted {
+                        throw BONJSONDecodingError.duplicateObjectKey(key)
+                    }
+                }
+                continue
+            }
+
             guard entry.type == KSBONJSON_TYPE_OBJECT else { continue }
 
             let pairCount = Int(entry.data.container.count) / 2
@@ -799,7 +1583,7 @@ final class _PositionMap {
                 let valueIndex = nextSiblingIndex(keyIndex)
                 currentIndex = nextSiblingIndex(valueIndex)
 
-                if let key = getString(at: size_t(keyIndex)) {
+                if let key = getKeyString(at: size_t(keyIndex)) {
                     // getString already applies NFC normalization
                     if seenKeys.contains(key) {
                         throw BONJSONDecodingError.duplicateObjectKey(key)
@@ -810,6 +1594,20 @@ final class _PositionMap {
         }
     }
 
+    /// Entry indices of a record definition's key strings, in field order.
+    /// Compact record values are stored in the same order.
+    func recordKeyIndices(definition: Int) -> Range<Int> {
+        let def = withUnsafeBytes(of: &context.pointee.recordDefs) { raw in
+            raw.bindMemory(to: KSBONJSONRecordDef.self)[definition]
+        }
+        return Int(def.firstKeyIndex)..<Int(def.firstKeyIndex) + Int(def.keyCount)
+    }
+
+    /// Number of record definitions in the document's prelude.
+    var recordDefinitionCount: Int {
+        return Int(context.pointee.recordDefCount)
+    }
+
     /// Get entry count.
     @inline(__always)
     var count: size_t {
@@ -819,10 +1617,34 @@ final class _PositionMap {
     /// Get next sibling index (exposed for key cache building).
     @inline(__always)
     func nextSiblingIndex(_ index: Int) -> Int {
-        guard index >= 0 && index < nextSibling.count else {
+        if index >= 0 && index < nextSibling.count {
+            return nextSibling[index]
+        }
+        guard index >= 0 && index < entryCount else {
             return index + 1
         }
-        return nextSibling[index]
+        return index + Int(entries[index].subtreeSize)
+    }
+
+    /// Whether the C scan built a key index for the object at the given index.
+    @inline(__always)
+    func hasKeyIndex(_ objectIndex: size_t) -> Bool {
+        return ksbonjson_map_hasKeyIndex(context, objectIndex)
+    }
+
+    /// Look up a key's value index through the object's C key index.
+    /// Returns nil if the key isn't present.
+    @inline(__always)
+    func findIndexedKey(_ key: String, inObject objectIndex: size_t) -> size_t? {
+        var key = key
+        let valueIndex = key.withUTF8 { utf8 in
+            utf8.withMemoryRebound(to: CChar.self) { chars in
+                ksbonjson_map_findKey(context, objectIndex, chars.baseAddress, chars.count)
+            }
+        }
+        // Not found is SIZE_MAX, which arrives here as a negative Int
+        guard valueIndex >= 0 && valueIndex < entryCount else { return nil }
+        return valueIndex
     }
 
     /// Compare a key string directly against bytes in input buffer.
@@ -830,44 +1652,70 @@ final class _PositionMap {
     @inline(__always)
     func compareKeyBytes(offset: Int, length: Int, with key: String) -> Bool {
         guard length == key.utf8.count else { return false }
-        return inputBytes.withUnsafeBufferPointer { ptr in
-            key.withCString { cString in
-                memcmp(ptr.baseAddress! + offset, cString, length) == 0
-            }
+        return key.withCString { cString in
+            memcmp(inputBytes.baseAddress! + offset, cString, length) == 0
         }
     }
 
+    /// Whether the string entry at keyIndex holds exactly these UTF-8 bytes.
+    @inline(__always)
+    func keyEquals(at keyIndex: Int, _ bytes: UnsafePointer<CChar>, length: Int) -> Bool {
+        let entry = entries[keyIndex]
+        guard entry.type == KSBONJSON_TYPE_STRING && Int(entry.data.string.length) == length else {
+            return false
+        }
+        return memcmp(inputBytes.baseAddress! + Int(entry.data.string.offset), bytes, length) == 0
+    }
+
+    /// Look up a key's value index in an expanded object or record, by index or by
+    /// linear search. Returns nil if the key isn't present.
+    @inline(__always)
+    func findKey(_ bytes: UnsafePointer<CChar>, length: Int, inObject objectIndex: size_t) -> size_t? {
+        let valueIndex = ksbonjson_map_findKey(context, objectIndex, bytes, length)
+        // Not found is SIZE_MAX, which arrives here as a negative Int
+        guard valueIndex >= 0 && valueIndex < entryCount else { return nil }
+        return valueIndex
+    }
+
     // MARK: - Batch Decode Methods
 
-    /// Batch decode an array of Int64 values.
-    /// Returns nil if index is not an array.
+    /// Number of elements a batch decode of the array at `arrayIndex` produces.
+    /// Typed array spans are converted straight from the input, so only arrays
+    /// a lazy map hasn't expanded yet get expanded here.
+    /// Returns nil if the index is not an array.
     @inline(__always)
-    func decodeInt64Array(at arrayIndex: size_t) -> [Int64]? {
+    private func batchElementCount(at arrayIndex: size_t) -> Int? {
         guard arrayIndex >= 0 && arrayIndex < entryCount else {
             return nil
         }
+        if entries[Int(arrayIndex)].type == KSBONJSON_TYPE_TYPED_ARRAY {
+            return Int(entries[Int(arrayIndex)].data.typedArray.count)
+        }
 
+        guard (try? expandContainer(at: arrayIndex)) != nil else {
+            return nil
+        }
         let entry = entries[Int(arrayIndex)]
         guard entry.type == KSBONJSON_TYPE_ARRAY else {
             return nil
         }
+        return Int(entry.data.container.count)
+    }
 
-        let count = Int(entry.data.container.count)
+    /// Batch decode an array of Int64 values.
+    /// Returns nil if index is not an array.
+    @inline(__always)
+    func decodeInt64Array(at arrayIndex: size_t) -> [Int64]? {
+        guard let count = batchElementCount(at: arrayIndex) else {
+            return nil
+        }
         guard count > 0 else {
             return []
         }
 
         var result = [Int64](repeating: 0, count: count)
         result.withUnsafeMutableBufferPointer { buffer in
-            entries.withUnsafeBufferPointer { entriesPtr in
-                inputBytes.withUnsafeBufferPointer { inputPtr in
-                    // Update context pointers for batch decode
-                    var localContext = context
-                    localContext.entries = UnsafeMutablePointer(mutating: entriesPtr.baseAddress)
-                    localContext.input = inputPtr.baseAddress
-                    _ = ksbonjson_map_decodeInt64Array(&localContext, arrayIndex, buffer.baseAddress!, count)
-                }
-            }
+            _ = ksbonjson_map_decodeInt64Array(context, arrayIndex, buffer.baseAddress!, count)
         }
         return result
     }
@@ -875,30 +1723,16 @@ final class _PositionMap {
     /// Batch decode an array of UInt64 values.
     @inline(__always)
     func decodeUInt64Array(at arrayIndex: size_t) -> [UInt64]? {
-        guard arrayIndex >= 0 && arrayIndex < entryCount else {
+        guard let count = batchElementCount(at: arrayIndex) else {
             return nil
         }
-
-        let entry = entries[Int(arrayIndex)]
-        guard entry.type == KSBONJSON_TYPE_ARRAY else {
-            return nil
-        }
-
-        let count = Int(entry.data.container.count)
         guard count > 0 else {
             return []
         }
 
         var result = [UInt64](repeating: 0, count: count)
         result.withUnsafeMutableBufferPointer { buffer in
-            entries.withUnsafeBufferPointer { entriesPtr in
-                inputBytes.withUnsafeBufferPointer { inputPtr in
-                    var localContext = context
-                    localContext.entries = UnsafeMutablePointer(mutating: entriesPtr.baseAddress)
-                    localContext.input = inputPtr.baseAddress
-                    _ = ksbonjson_map_decodeUInt64Array(&localContext, arrayIndex, buffer.baseAddress!, count)
-                }
-            }
+            _ = ksbonjson_map_decodeUInt64Array(context, arrayIndex, buffer.baseAddress!, count)
         }
         return result
     }
@@ -906,30 +1740,16 @@ final class _PositionMap {
     /// Batch decode an array of Double values.
     @inline(__always)
     func decodeDoubleArray(at arrayIndex: size_t) -> [Double]? {
-        guard arrayIndex >= 0 && arrayIndex < entryCount else {
-            return nil
-        }
-
-        let entry = entries[Int(arrayIndex)]
-        guard entry.type == KSBONJSON_TYPE_ARRAY else {
+        guard let count = batchElementCount(at: arrayIndex) else {
             return nil
         }
-
-        let count = Int(entry.data.container.count)
         guard count > 0 else {
             return []
         }
 
         var result = [Double](repeating: 0, count: count)
         result.withUnsafeMutableBufferPointer { buffer in
-            entries.withUnsafeBufferPointer { entriesPtr in
-                inputBytes.withUnsafeBufferPointer { inputPtr in
-                    var localContext = context
-                    localContext.entries = UnsafeMutablePointer(mutating: entriesPtr.baseAddress)
-                    localContext.input = inputPtr.baseAddress
-                    _ = ksbonjson_map_decodeDoubleArray(&localContext, arrayIndex, buffer.baseAddress!, count)
-                }
-            }
+            _ = ksbonjson_map_decodeDoubleArray(context, arrayIndex, buffer.baseAddress!, count)
         }
         return result
     }
@@ -937,30 +1757,16 @@ final class _PositionMap {
     /// Batch decode an array of Bool values.
     @inline(__always)
     func decodeBoolArray(at arrayIndex: size_t) -> [Bool]? {
-        guard arrayIndex >= 0 && arrayIndex < entryCount else {
+        guard let count = batchElementCount(at: arrayIndex) else {
             return nil
         }
-
-        let entry = entries[Int(arrayIndex)]
-        guard entry.type == KSBONJSON_TYPE_ARRAY else {
-            return nil
-        }
-
-        let count = Int(entry.data.container.count)
         guard count > 0 else {
             return []
         }
 
         var result = [Bool](repeating: false, count: count)
         result.withUnsafeMutableBufferPointer { buffer in
-            entries.withUnsafeBufferPointer { entriesPtr in
-                inputBytes.withUnsafeBufferPointer { inputPtr in
-                    var localContext = context
-                    localContext.entries = UnsafeMutablePointer(mutating: entriesPtr.baseAddress)
-                    localContext.input = inputPtr.baseAddress
-                    _ = ksbonjson_map_decodeBoolArray(&localContext, arrayIndex, buffer.baseAddress!, count)
-                }
-            }
+            _ = ksbonjson_map_decodeBoolArray(context, arrayIndex, buffer.baseAddress!, count)
         }
         return result
     }
@@ -969,16 +1775,9 @@ final class _PositionMap {
     /// Uses C batch function to get string offsets, then creates strings in batch.
     @inline(__always)
     func decodeStringArray(at arrayIndex: size_t) -> [String]? {
-        guard arrayIndex >= 0 && arrayIndex < entryCount else {
+        guard let count = batchElementCount(at: arrayIndex) else {
             return nil
         }
-
-        let entry = entries[Int(arrayIndex)]
-        guard entry.type == KSBONJSON_TYPE_ARRAY else {
-            return nil
-        }
-
-        let count = Int(entry.data.container.count)
         guard count > 0 else {
             return []
         }
@@ -986,14 +1785,7 @@ final class _PositionMap {
         // Get string offsets in batch from C
         var stringRefs = [KSBONJSONStringRef](repeating: KSBONJSONStringRef(), count: count)
         let decoded = stringRefs.withUnsafeMutableBufferPointer { buffer in
-            entries.withUnsafeBufferPointer { entriesPtr in
-                inputBytes.withUnsafeBufferPointer { inputPtr in
-                    var localContext = context
-                    localContext.entries = UnsafeMutablePointer(mutating: entriesPtr.baseAddress)
-                    localContext.input = inputPtr.baseAddress
-                    return ksbonjson_map_decodeStringArray(&localContext, arrayIndex, buffer.baseAddress!, count)
-                }
-            }
+            return ksbonjson_map_decodeStringArray(context, arrayIndex, buffer.baseAddress!, count)
         }
 
         guard decoded == count else {
@@ -1001,17 +1793,37 @@ final class _PositionMap {
         }
 
         // Create strings from offsets - all in one pass through inputBytes
-        return inputBytes.withUnsafeBufferPointer { ptr in
-            stringRefs.map { ref in
-                let offset = Int(ref.offset)
-                let length = Int(ref.length)
-                if length == 0 {
-                    return ""
-                }
-                let start = ptr.baseAddress! + offset
-                let buffer = UnsafeBufferPointer(start: start, count: length)
-                return String(decoding: buffer, as: UTF8.self)
+        return stringRefs.map { ref in
+            let offset = Int(ref.offset)
+            let length = Int(ref.length)
+            if length == 0 {
+                return ""
             }
+            let start = inputBytes.baseAddress! + offset
+            let buffer = UnsafeBufferPointer(start: start, count: length)
+            return String(decoding: buffer, as: UTF8.self)
+        }
+    }
+}
+
+/// Hands the parts of a map index to an output stream. A stream error stops the
+/// write and is kept to be rethrown in place of the C status.
+private final class _MapIndexWriter {
+    let stream: OutputStream
+    private(set) var error: Error?
+
+    init(_ stream: OutputStream) {
+        self.stream = stream
+    }
+
+    static let callback: KSBONJSONMapIndexWriteFunc = { data, length, userData in
+        let writer = Unmanaged<_MapIndexWriter>.fromOpaque(userData!).takeUnretainedValue()
+        do {
+            try writer.stream.writeAll(UnsafeRawBufferPointer(start: data, count: length))
+            return true
+        } catch {
+            writer.error = error
+            return false
         }
     }
 }
@@ -1034,6 +1846,29 @@ final class _MapDecoderState {
     let maxBigNumberMagnitude: Int?
     let outOfRangeBigNumberDecodingStrategy: BONJSONDecoder.OutOfRangeBigNumberDecodingStrategy
 
+    /// Whether keyed containers can look keys up through the C map's key index.
+    /// The index compares raw key bytes and keeps the first duplicate, so it only
+    /// matches the Swift lookup for validated, unnormalized keys without keepLast.
+    let usesMapKeyIndex: Bool
+
+    /// Whether `BONJSONFieldDecodable` types are read through a `BONJSONFieldReader`.
+    /// Readers match raw key bytes and stop at the first match, so converted keys
+    /// and duplicate keys go through the keyed container instead.
+    let decodesFieldsDirectly: Bool
+
+    /// Field lookup for each record definition, indexed by definition.
+    /// Empty unless the map holds compact records.
+    let recordFieldTables: [_RecordFieldTable]
+
+    /// Decoders taken back once their value is decoded, to be reused for the next one.
+    /// nil when elements may be decoded on several threads at once.
+    private let decoderPool: _MapDecoderPool?
+
+    /// The interned id of each key string looked up so far, or -1 for a key no object has,
+    /// so that a key is only hashed into the map's intern table once per decode.
+    /// nil when keys aren't interned, or when elements may be decoded on several threads at once.
+    private var keyIds: [String: Int]?
+
     init(
         map: _PositionMap,
         userInfo: [CodingUserInfoKey: Any],
@@ -1046,9 +1881,12 @@ final class _MapDecoderState {
         duplicateKeyDecodingStrategy: BONJSONDecoder.DuplicateKeyDecodingStrategy = .reject,
         maxBigNumberExponent: Int? = nil,
         maxBigNumberMagnitude: Int? = nil,
-        outOfRangeBigNumberDecodingStrategy: BONJSONDecoder.OutOfRangeBigNumberDecodingStrategy = .throw
+        outOfRangeBigNumberDecodingStrategy: BONJSONDecoder.OutOfRangeBigNumberDecodingStrategy = .throw,
+        decodesOnOneThread: Bool = true
     ) {
         self.map = map
+        self.decoderPool = decodesOnOneThread ? _MapDecoderPool() : nil
+        self.keyIds = decodesOnOneThread && map.internsKeys ? [:] : nil
         self.userInfo = userInfo
         self.dateDecodingStrategy = dateDecodingStrategy
         self.dataDecodingStrategy = dataDecodingStrategy
@@ -1060,6 +1898,71 @@ final class _MapDecoderState {
         self.maxBigNumberExponent = maxBigNumberExponent
         self.maxBigNumberMagnitude = maxBigNumberMagnitude
         self.outOfRangeBigNumberDecodingStrategy = outOfRangeBigNumberDecodingStrategy
+        self.usesMapKeyIndex = unicodeDecodingStrategy == .reject &&
+            map.normalizationStrategy == .none &&
+            duplicateKeyDecodingStrategy != .keepLast
+        if case .useDefaultKeys = keyDecodingStrategy {
+            self.decodesFieldsDirectly = duplicateKeyDecodingStrategy == .reject
+        } else {
+            self.decodesFieldsDirectly = false
+        }
+
+        // Resolved up front (there are at most 256 definitions) so that the
+        // tables are read-only once decoding starts, even on several threads
+        if map.compactRecords {
+            self.recordFieldTables = (0..<map.recordDefinitionCount).map { definition in
+                _RecordFieldTable(
+                    map: map,
+                    keyIndices: map.recordKeyIndices(definition: definition),
+                    keyDecodingStrategy: keyDecodingStrategy,
+                    duplicateKeyDecodingStrategy: duplicateKeyDecodingStrategy
+                )
+            }
+        } else {
+            self.recordFieldTables = []
+        }
+    }
+
+    /// A decoder for the value at entryIndex, whose coding path is parentPath plus key.
+    /// Reuses a pooled decoder when there is one.
+    @inline(__always)
+    func makeDecoder(entryIndex: size_t, parentPath: _LazyCodingPath, key: CodingKey) -> _MapDecoder {
+        if let decoder = decoderPool?.take() {
+            decoder.reuse(entryIndex: entryIndex, parentPath: parentPath, key: key)
+            return decoder
+        }
+        return _MapDecoder(state: self, entryIndex: entryIndex, lazyPath: parentPath.appending(key))
+    }
+
+    /// Hand back a decoder from makeDecoder() once its value is decoded.
+    /// It is only pooled if nothing else (such as a container kept by `init(from:)`)
+    /// still references it or its path.
+    @inline(__always)
+    func recycle(_ decoder: inout _MapDecoder) {
+        decoderPool?.put(&decoder)
+    }
+
+    /// The interned id of a key, or nil if no object key in the document has its bytes.
+    /// Only meaningful when the map interns keys.
+    @inline(__always)
+    func keyId(for key: String) -> Int? {
+        guard keyIds != nil else {
+            return map.keyId(for: key)
+        }
+        if let id = keyIds![key] {
+            return id < 0 ? nil : id
+        }
+        let id = map.keyId(for: key)
+        // Expanding a lazy map's containers interns more keys, so a miss may not stay one
+        if id != nil || !map.isLazy {
+            keyIds![key] = id ?? -1
+        }
+        return id
+    }
+
+    /// Release the pooled decoders, which reference this state.
+    func drainDecoderPool() {
+        decoderPool?.drain()
     }
 
     /// Validate and return a float value according to the non-conforming float strategy.
@@ -1359,8 +2262,9 @@ final class _MapDecoderState {
 /// The full [CodingKey] array is only built when actually needed (e.g., for error messages).
 /// This saves ~100-150 ns per nesting level by avoiding array allocation and copying.
 final class _LazyCodingPath {
-    let parent: _LazyCodingPath?
-    let key: CodingKey?
+    /// Only changed for the path node of a pooled decoder (never for root).
+    fileprivate(set) var parent: _LazyCodingPath?
+    fileprivate(set) var key: CodingKey?
 
     /// The root (empty) path - shared singleton
     static let root = _LazyCodingPath(parent: nil, key: nil)
@@ -1406,8 +2310,12 @@ final class _LazyCodingPath {
 /// Internal decoder that implements the Decoder protocol using the position map.
 final class _MapDecoder: Decoder {
     let state: _MapDecoderState
-    let entryIndex: size_t
-    let lazyPath: _LazyCodingPath
+    private(set) var entryIndex: size_t
+    fileprivate(set) var lazyPath: _LazyCodingPath
+
+    /// Key cache lent to this decoder's keyed containers. Kept (emptied) while the
+    /// decoder is pooled, so the next wide object reuses its storage.
+    fileprivate var keyCacheHolder: _KeyCacheHolder?
 
     /// Computed property - only builds array when accessed (rare, mostly for errors)
     var codingPath: [CodingKey] { lazyPath.toArray() }
@@ -1420,25 +2328,46 @@ final class _MapDecoder: Decoder {
         self.lazyPath = lazyPath
     }
 
+    /// Point a pooled decoder at another value. Its path node is its own, so the
+    /// node is updated in place rather than replaced.
+    @inline(__always)
+    fileprivate func reuse(entryIndex: size_t, parentPath: _LazyCodingPath, key: CodingKey) {
+        self.entryIndex = entryIndex
+        lazyPath.parent = parentPath
+        lazyPath.key = key
+    }
+
+    /// The key cache for a keyed container of this decoder's object.
+    @inline(__always)
+    fileprivate func makeKeyCacheHolder() -> _KeyCacheHolder {
+        if let holder = keyCacheHolder {
+            return holder
+        }
+        let holder = _KeyCacheHolder()
+        keyCacheHolder = holder
+        return holder
+    }
+
     func container<Key: CodingKey>(keyedBy type: Key.Type) throws -> KeyedDecodingContainer<Key> {
+        try state.map.expandContainer(at: entryIndex)
         guard let entry = state.map.getEntry(at: entryIndex) else {
             throw BONJSONDecodingError.unexpectedEndOfData
         }
 
-        guard entry.type == KSBONJSON_TYPE_OBJECT else {
+        guard entry.type == KSBONJSON_TYPE_OBJECT || entry.type == KSBONJSON_TYPE_RECORD else {
             throw BONJSONDecodingError.typeMismatch(expected: "object", actual: describeType(entry.type))
         }
 
         let container = _MapKeyedDecodingContainer<Key>(
-            state: state,
+            decoder: self,
             objectIndex: entryIndex,
-            entry: entry,
-            lazyPath: lazyPath
+            entry: entry
         )
         return KeyedDecodingContainer(container)
     }
 
     func unkeyedContainer() throws -> UnkeyedDecodingContainer {
+        try state.map.expandContainer(at: entryIndex)
         guard let entry = state.map.getEntry(at: entryIndex) else {
             throw BONJSONDecodingError.unexpectedEndOfData
         }
@@ -1496,7 +2425,7 @@ final class _MapDecoder: Decoder {
         case KSBONJSON_TYPE_UINT:
             return Double(entry.data.uintValue)
         case KSBONJSON_TYPE_BIGNUMBER:
-            let bn = entry.data.bigNumber
+            let bn = state.map.getBigNumber(entry)
             return try state.decodeBigNumber((bn.significand, bn.exponent, bn.sign))
         case KSBONJSON_TYPE_STRING:
             // Try to decode string as non-conforming float
@@ -1571,8 +2500,8 @@ final class _MapDecoder: Decoder {
         case KSBONJSON_TYPE_FLOAT: return "float"
         case KSBONJSON_TYPE_BIGNUMBER: return "big number"
         case KSBONJSON_TYPE_STRING: return "string"
-        case KSBONJSON_TYPE_ARRAY: return "array"
-        case KSBONJSON_TYPE_OBJECT: return "object"
+        case KSBONJSON_TYPE_ARRAY, KSBONJSON_TYPE_TYPED_ARRAY: return "array"
+        case KSBONJSON_TYPE_OBJECT, KSBONJSON_TYPE_RECORD: return "object"
         default: return "unknown"
         }
     }
@@ -1589,7 +2518,116 @@ private let kSmallObjectThreshold = 12
 /// Key cache holder - only allocated for large objects that need dictionary lookup.
 /// Using a class allows mutation from within the struct container.
 private final class _KeyCacheHolder {
-    var cache: [String: size_t]?
+    var cache: [String: size_t] = [:]
+
+    /// Used instead of cache when the map interned its keys.
+    var idCache: [Int: size_t] = [:]
+
+    /// Whether the cache holds the current object's keys.
+    var isFilled = false
+
+    /// Empty the caches for another object, keeping their storage.
+    func reset() {
+        guard isFilled else { return }
+        cache.removeAll(keepingCapacity: true)
+        idCache.removeAll(keepingCapacity: true)
+        isFilled = false
+    }
+}
+
+/// Decoders of one decode, taken back for reuse once their value has been decoded.
+/// The map is walked depth-first, so there's about one live decoder per nesting level,
+/// and the pool saves the decoder, its path node and its key cache for every value after
+/// the first at each level. Not thread-safe.
+private final class _MapDecoderPool {
+    /// More than the deepest nesting seen in practice; beyond it decoders are just freed.
+    private static let capacity = 32
+
+    private var decoders: [_MapDecoder] = []
+
+    init() {
+        decoders.reserveCapacity(_MapDecoderPool.capacity)
+    }
+
+    @inline(__always)
+    func take() -> _MapDecoder? {
+        return decoders.popLast()
+    }
+
+    @inline(__always)
+    func put(_ decoder: inout _MapDecoder) {
+        // A decoder (or path node, or key cache) still referenced elsewhere is left alone
+        guard decoders.count < _MapDecoderPool.capacity,
+              isKnownUniquelyReferenced(&decoder),
+              isKnownUniquelyReferenced(&decoder.lazyPath) else {
+            return
+        }
+        if decoder.keyCacheHolder != nil {
+            if isKnownUniquelyReferenced(&decoder.keyCacheHolder!) {
+                decoder.keyCacheHolder!.reset()
+            } else {
+                decoder.keyCacheHolder = nil
+            }
+        }
+        // Drop the links to the rest of the path so they aren't kept alive
+        decoder.lazyPath.parent = nil
+        decoder.lazyPath.key = nil
+        decoders.append(decoder)
+    }
+
+    func drain() {
+        decoders.removeAll()
+    }
+}
+
+/// The keys of one record definition, resolved to value positions.
+/// Built once per definition and shared by every compact record that uses it,
+/// so lookups in record instances never touch the key entries.
+final class _RecordFieldTable {
+    /// Value position of each key, after key decoding conversion.
+    let positions: [String: Int]
+
+    /// The converted keys in field order, with duplicates resolved (for allKeys).
+    let keys: [String]
+
+    /// Number of values in each record (one per definition key, duplicates included).
+    let valueCount: Int
+
+    init(
+        map: _PositionMap,
+        keyIndices: Range<Int>,
+        keyDecodingStrategy: BONJSONDecoder.KeyDecodingStrategy,
+        duplicateKeyDecodingStrategy: BONJSONDecoder.DuplicateKeyDecodingStrategy
+    ) {
+        let keepLast = duplicateKeyDecodingStrategy == .keepLast
+        var positions: [String: Int] = [:]
+        positions.reserveCapacity(keyIndices.count)
+        var keys: [String] = []
+        keys.reserveCapacity(keyIndices.count)
+
+        for (position, keyIndex) in keyIndices.enumerated() {
+            guard let original = map.getKeyString(at: size_t(keyIndex)) else { continue }
+            let key: String
+            switch keyDecodingStrategy {
+            case .convertFromSnakeCase:
+                key = original.convertFromSnakeCase()
+            default:
+                // Custom conversion depends on the coding path, so compact
+                // records are only used with the other strategies
+                key = original
+            }
+
+            if positions[key] != nil {
+                guard keepLast else { continue }
+                keys.removeAll { $0 == key }
+            }
+            positions[key] = position
+            keys.append(key)
+        }
+        self.positions = positions
+        self.keys = keys
+        self.valueCount = keyIndices.count
+    }
 }
 
 struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtocol {
@@ -1606,28 +2644,65 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
     private let firstChildIndex: Int
     private let useLinearSearch: Bool
 
+    /// Whether keys are looked up through the C map's key index (wide objects only).
+    private let useKeyIndex: Bool
+
     /// Key cache holder - only allocated for large objects.
     /// nil for small objects that use linear search.
     private let keyCacheHolder: _KeyCacheHolder?
 
+    /// The definition's field table when this is a compact record, whose children are
+    /// values only. Keys then resolve to value positions without reading key entries.
+    private let recordFields: _RecordFieldTable?
+
+    /// Whether a compact record's value at position N is simply firstChildIndex + N
+    /// (no value spans more than one entry).
+    private let recordValuesAreContiguous: Bool
+
     /// All keys in this object - built on demand (not cached, since rarely used).
     var allKeys: [Key] {
+        if let fields = recordFields {
+            return fields.keys.compactMap { Key(stringValue: $0) }
+        }
         return buildAllKeys()
     }
 
-    init(state: _MapDecoderState, objectIndex: size_t, entry: KSBONJSONMapEntry, lazyPath: _LazyCodingPath) {
+    init(decoder: _MapDecoder, objectIndex: size_t, entry: KSBONJSONMapEntry) {
+        let state = decoder.state
         self.state = state
         self.objectIndex = objectIndex
         self.entry = entry
-        self.lazyPath = lazyPath
+        self.lazyPath = decoder.lazyPath
+
+        if entry.type == KSBONJSON_TYPE_RECORD {
+            let fields = state.recordFieldTables[Int(entry.data.record.definition)]
+            let valueCount = fields.valueCount
+            self.pairCount = valueCount
+            self.firstChildIndex = Int(entry.data.record.firstChild)
+            self.useLinearSearch = false
+            self.useKeyIndex = false
+            self.keyCacheHolder = nil
+            self.recordFields = fields
+            // Lazy maps give every child a single entry
+            self.recordValuesAreContiguous = state.map.isLazy || Int(entry.subtreeSize) == valueCount + 1
+            return
+        }
+        self.recordFields = nil
+        self.recordValuesAreContiguous = false
 
         let count = Int(entry.data.container.count) / 2
         self.pairCount = count
         self.firstChildIndex = Int(entry.data.container.firstChild)
-        self.useLinearSearch = count <= kSmallObjectThreshold
+        let isSmall = count <= kSmallObjectThreshold
+        self.useLinearSearch = isSmall
+
+        // Objects indexed during the scan need no Swift dictionary
+        let isIndexed = !isSmall && state.usesMapKeyIndex && state.map.hasKeyIndex(objectIndex)
+        self.useKeyIndex = isIndexed
 
-        // Only allocate cache holder for large objects - saves ~100ns per small object
-        self.keyCacheHolder = count > kSmallObjectThreshold ? _KeyCacheHolder() : nil
+        // Only allocate cache holder for large objects - saves ~100ns per small object.
+        // A pooled decoder lends the one it kept from its last object.
+        self.keyCacheHolder = !isSmall && !isIndexed ? decoder.makeKeyCacheHolder() : nil
     }
 
     /// Build allKeys array - only called when allKeys is accessed.
@@ -1647,7 +2722,7 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
             let valueIndex = state.map.nextSiblingIndex(keyIndex)
             currentIndex = state.map.nextSiblingIndex(valueIndex)
 
-            if let keyString = state.map.getString(at: size_t(keyIndex)) {
+            if let keyString = state.map.getKeyString(at: size_t(keyIndex)) {
                 let convertedKey = convertKey(keyString)
 
                 // Handle duplicate filtering
@@ -1682,10 +2757,31 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
     /// For keepLast: always update to keep the last occurrence.
     @inline(__always)
     private func ensureKeyCache() {
-        guard let holder = keyCacheHolder, holder.cache == nil else { return }
+        guard let holder = keyCacheHolder, !holder.isFilled else { return }
+        holder.isFilled = true
 
         let keepLast = state.duplicateKeyDecodingStrategy == .keepLast
-        var cache: [String: size_t] = [:]
+        if state.map.internsKeys {
+            // Key ids need no Strings, and hash as integers
+            var idCache = holder.idCache
+            holder.idCache = [:]
+            idCache.reserveCapacity(pairCount)
+            var currentIndex = firstChildIndex
+            for _ in 0..<pairCount {
+                let keyIndex = currentIndex
+                let valueIndex = state.map.nextSiblingIndex(keyIndex)
+                currentIndex = state.map.nextSiblingIndex(valueIndex)
+
+                if let id = state.map.keyId(at: size_t(keyIndex)), keepLast || idCache[id] == nil {
+                    idCache[id] = size_t(valueIndex)
+                }
+            }
+            holder.idCache = idCache
+            return
+        }
+
+        var cache = holder.cache
+        holder.cache = [:]
         cache.reserveCapacity(pairCount)
 
         var currentIndex = firstChildIndex
@@ -1694,7 +2790,7 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
             let valueIndex = state.map.nextSiblingIndex(keyIndex)
             currentIndex = state.map.nextSiblingIndex(valueIndex)
 
-            if let keyString = state.map.getString(at: size_t(keyIndex)) {
+            if let keyString = state.map.getKeyString(at: size_t(keyIndex)) {
                 if keepLast || cache[keyString] == nil {
                     // keepLast: always update; keepFirst: only set if not exists
                     cache[keyString] = size_t(valueIndex)
@@ -1704,10 +2800,27 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
         holder.cache = cache
     }
 
+    /// Look up a key in the key cache (for larger objects).
+    @inline(__always)
+    private func cachedValueIndex(forOriginalKey key: String) -> size_t? {
+        ensureKeyCache()
+        if state.map.internsKeys {
+            guard let id = state.keyId(for: key) else { return nil }
+            return keyCacheHolder!.idCache[id]
+        }
+        return keyCacheHolder!.cache[key]
+    }
+
     /// Linear search for key - used for small objects to avoid dictionary overhead.
     /// For keepLast strategy, searches the entire object and returns the last match.
     @inline(__always)
     private func linearFindValue(forOriginalKey key: String) -> size_t? {
+        if state.map.internsKeys {
+            // A key no object has has no id; otherwise a match is an integer compare
+            guard let id = state.keyId(for: key) else { return nil }
+            return linearFindValue(forKeyId: id)
+        }
+
         let keepLast = state.duplicateKeyDecodingStrategy == .keepLast
         var foundIndex: size_t? = nil
 
@@ -1735,6 +2848,29 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
         return foundIndex
     }
 
+    /// Linear search by interned key id.
+    @inline(__always)
+    private func linearFindValue(forKeyId id: Int) -> size_t? {
+        let keepLast = state.duplicateKeyDecodingStrategy == .keepLast
+        var foundIndex: size_t? = nil
+
+        var currentIndex = firstChildIndex
+        for _ in 0..<pairCount {
+            let keyIndex = currentIndex
+            let valueIndex = state.map.nextSiblingIndex(keyIndex)
+            currentIndex = state.map.nextSiblingIndex(valueIndex)
+
+            if state.map.keyId(at: size_t(keyIndex)) == id {
+                if keepLast {
+                    foundIndex = size_t(valueIndex)
+                } else {
+                    return size_t(valueIndex)
+                }
+            }
+        }
+        return foundIndex
+    }
+
     private func convertKey(_ key: String) -> String {
         switch state.keyDecodingStrategy {
         case .useDefaultKeys:
@@ -1762,7 +2898,7 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
                 let valueIndex = state.map.nextSiblingIndex(keyIndex)
                 currentIndex = state.map.nextSiblingIndex(valueIndex)
 
-                if let keyString = state.map.getString(at: size_t(keyIndex)) {
+                if let keyString = state.map.getKeyString(at: size_t(keyIndex)) {
                     let convertedKey = convertKey(keyString)
                     if convertedKey == key.stringValue {
                         return keyString
@@ -1773,18 +2909,47 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
         }
     }
 
+    /// Value index of a compact record's field.
+    @inline(__always)
+    private func recordValueIndex(at position: Int) -> size_t {
+        if recordValuesAreContiguous {
+            return size_t(firstChildIndex + position)
+        }
+        var index = firstChildIndex
+        for _ in 0..<position {
+            index = state.map.nextSiblingIndex(index)
+        }
+        return size_t(index)
+    }
+
     @inline(__always)
     func contains(_ key: Key) -> Bool {
+        if let fields = recordFields {
+            return fields.positions[key.stringValue] != nil
+        }
         let originalKey = findOriginalKey(key)
         if useLinearSearch {
             return linearFindValue(forOriginalKey: originalKey) != nil
         }
-        ensureKeyCache()
-        return keyCacheHolder!.cache![originalKey] != nil
+        if useKeyIndex {
+            return state.map.findIndexedKey(originalKey, inObject: objectIndex) != nil
+        }
+        return cachedValueIndex(forOriginalKey: originalKey) != nil
     }
 
     @inline(__always)
     private func valueIndex(forKey key: Key) throws -> size_t {
+        // Compact records: the key was resolved to a position once for the definition
+        if let fields = recordFields {
+            guard let position = fields.positions[key.stringValue] else {
+                throw DecodingError.keyNotFound(key, DecodingError.Context(
+                    codingPath: codingPath,
+                    debugDescription: "Key '\(key.stringValue)' not found"
+                ))
+            }
+            return recordValueIndex(at: position)
+        }
+
         let originalKey = findOriginalKey(key)
 
         // For small objects, use linear search
@@ -1798,9 +2963,19 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
             ))
         }
 
+        // For wide objects, use the key index built during the scan
+        if useKeyIndex {
+            guard let valueIdx = state.map.findIndexedKey(originalKey, inObject: objectIndex) else {
+                throw DecodingError.keyNotFound(key, DecodingError.Context(
+                    codingPath: codingPath,
+                    debugDescription: "Key '\(key.stringValue)' not found"
+                ))
+            }
+            return valueIdx
+        }
+
         // For larger objects, use dictionary
-        ensureKeyCache()
-        guard let valueIdx = keyCacheHolder!.cache![originalKey] else {
+        guard let valueIdx = cachedValueIndex(forOriginalKey: originalKey) else {
             throw DecodingError.keyNotFound(key, DecodingError.Context(
                 codingPath: codingPath,
                 debugDescription: "Key '\(key.stringValue)' not found"
@@ -1822,7 +2997,7 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
     /// Only create full decoder when needed for nested types.
     private func decoder(forKey key: Key) throws -> _MapDecoder {
         let idx = try valueIndex(forKey: key)
-        return _MapDecoder(state: state, entryIndex: idx, lazyPath: lazyPath.appending(key))
+        return state.makeDecoder(entryIndex: idx, parentPath: lazyPath, key: key)
     }
 
     func decodeNil(forKey key: Key) throws -> Bool {
@@ -1850,7 +3025,7 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
             }
         }
         if entry.type == KSBONJSON_TYPE_BIGNUMBER {
-            let bn = entry.data.bigNumber
+            let bn = state.map.getBigNumber(entry)
             if state.outOfRangeBigNumberDecodingStrategy == .stringify,
                state.validateBigNumberLimits((bn.significand, bn.exponent, bn.sign)) != nil {
                 return state.stringifyBigNumber((bn.significand, bn.exponent, bn.sign))
@@ -1874,7 +3049,7 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
         case KSBONJSON_TYPE_INT: return Double(entry.data.intValue)
         case KSBONJSON_TYPE_UINT: return Double(entry.data.uintValue)
         case KSBONJSON_TYPE_BIGNUMBER:
-            let bn = entry.data.bigNumber
+            let bn = state.map.getBigNumber(entry)
             return try state.decodeBigNumber((bn.significand, bn.exponent, bn.sign))
         case KSBONJSON_TYPE_STRING:
             // Try to decode string as non-conforming float
@@ -1943,14 +3118,15 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
         case KSBONJSON_TYPE_FLOAT: return "float"
         case KSBONJSON_TYPE_BIGNUMBER: return "big number"
         case KSBONJSON_TYPE_STRING: return "string"
-        case KSBONJSON_TYPE_ARRAY: return "array"
-        case KSBONJSON_TYPE_OBJECT: return "object"
+        case KSBONJSON_TYPE_ARRAY, KSBONJSON_TYPE_TYPED_ARRAY: return "array"
+        case KSBONJSON_TYPE_OBJECT, KSBONJSON_TYPE_RECORD: return "object"
         default: return "unknown"
         }
     }
 
     func decode<T: Decodable>(_ type: T.Type, forKey key: Key) throws -> T {
-        let dec = try decoder(forKey: key)
+        var dec = try decoder(forKey: key)
+        defer { state.recycle(&dec) }
 
         // Handle special types
         if type == Date.self {
@@ -1969,11 +3145,14 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
         if type == Decimal.self {
             let entry = try entryForKey(key)
             if entry.type == KSBONJSON_TYPE_BIGNUMBER {
-                let bn = entry.data.bigNumber
+                let bn = state.map.getBigNumber(entry)
                 return try state.decodeBigNumberAsDecimal((bn.significand, bn.exponent, bn.sign)) as! T
             }
             // Fall through to let Decimal's Decodable init handle other numeric types
         }
+        if let result = try dec.decodeFields(type) {
+            return result
+        }
 
         return try T(from: dec)
     }
@@ -2001,6 +3180,16 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
 
     /// Look up value index by raw string key (for superDecoder which uses "super" as key).
     private func valueIndexForString(_ keyString: String) throws -> size_t {
+        if let fields = recordFields {
+            guard let position = fields.positions[keyString] else {
+                throw DecodingError.keyNotFound(_StringKey(stringValue: keyString), DecodingError.Context(
+                    codingPath: codingPath,
+                    debugDescription: "Key '\(keyString)' not found"
+                ))
+            }
+            return recordValueIndex(at: position)
+        }
+
         // For small objects, use linear search
         if useLinearSearch {
             if let valueIdx = linearFindValue(forOriginalKey: keyString) {
@@ -2012,9 +3201,19 @@ struct _MapKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtoco
             ))
         }
 
+        // For wide objects, use the key index built during the scan
+        if useKeyIndex {
+            guard let valueIdx = state.map.findIndexedKey(keyString, inObject: objectIndex) else {
+                throw DecodingError.keyNotFound(_StringKey(stringValue: keyString), DecodingError.Context(
+                    codingPath: codingPath,
+                    debugDescription: "Key '\(keyString)' not found"
+                ))
+            }
+            return valueIdx
+        }
+
         // For larger objects, use dictionary
-        ensureKeyCache()
-        guard let valueIdx = keyCacheHolder!.cache![keyString] else {
+        guard let valueIdx = cachedValueIndex(forOriginalKey: keyString) else {
             throw DecodingError.keyNotFound(_StringKey(stringValue: keyString), DecodingError.Context(
                 codingPath: codingPath,
                 debugDescription: "Key '\(keyString)' not found"
@@ -2057,6 +3256,20 @@ struct _MapUnkeyedDecodingContainer: UnkeyedDecodingContainer {
         self.currentEntryIndex = Int(entry.data.container.firstChild)
     }
 
+    /// Iterate only the given elements, the first of which is at `firstEntryIndex`.
+    /// Used to decode an array in chunks on several threads; `count` then
+    /// reports the range's upper bound.
+    init(state: _MapDecoderState, arrayIndex: size_t, entry: KSBONJSONMapEntry, lazyPath: _LazyCodingPath,
+         elements: Range<Int>, firstEntryIndex: Int) {
+        self.state = state
+        self.arrayIndex = arrayIndex
+        self.entry = entry
+        self.lazyPath = lazyPath
+        self.elementCount = elements.upperBound
+        self.currentIndex = elements.lowerBound
+        self.currentEntryIndex = firstEntryIndex
+    }
+
     /// Get next entry - O(1) sequential access using tracked entry index.
     @inline(__always)
     private mutating func nextEntry() throws -> (index: Int, entry: KSBONJSONMapEntry) {
@@ -2087,10 +3300,10 @@ struct _MapUnkeyedDecodingContainer: UnkeyedDecodingContainer {
         }
 
         let entryIdx = currentEntryIndex
-        let decoder = _MapDecoder(
-            state: state,
+        let decoder = state.makeDecoder(
             entryIndex: size_t(entryIdx),
-            lazyPath: lazyPath.appending(_BONJSONIndexKey(index: currentIndex))
+            parentPath: lazyPath,
+            key: _BONJSONIndexKey(index: currentIndex)
         )
 
         // Advance to next element using nextSibling
@@ -2130,7 +3343,7 @@ struct _MapUnkeyedDecodingContainer: UnkeyedDecodingContainer {
             }
         }
         if entry.type == KSBONJSON_TYPE_BIGNUMBER {
-            let bn = entry.data.bigNumber
+            let bn = state.map.getBigNumber(entry)
             if state.outOfRangeBigNumberDecodingStrategy == .stringify,
                state.validateBigNumberLimits((bn.significand, bn.exponent, bn.sign)) != nil {
                 return state.stringifyBigNumber((bn.significand, bn.exponent, bn.sign))
@@ -2153,7 +3366,7 @@ struct _MapUnkeyedDecodingContainer: UnkeyedDecodingContainer {
         case KSBONJSON_TYPE_INT: return Double(entry.data.intValue)
         case KSBONJSON_TYPE_UINT: return Double(entry.data.uintValue)
         case KSBONJSON_TYPE_BIGNUMBER:
-            let bn = entry.data.bigNumber
+            let bn = state.map.getBigNumber(entry)
             return try state.decodeBigNumber((bn.significand, bn.exponent, bn.sign))
         case KSBONJSON_TYPE_STRING:
             // Try to decode string as non-conforming float
@@ -2222,8 +3435,8 @@ struct _MapUnkeyedDecodingContainer: UnkeyedDecodingContainer {
         case KSBONJSON_TYPE_FLOAT: return "float"
         case KSBONJSON_TYPE_BIGNUMBER: return "big number"
         case KSBONJSON_TYPE_STRING: return "string"
-        case KSBONJSON_TYPE_ARRAY: return "array"
-        case KSBONJSON_TYPE_OBJECT: return "object"
+        case KSBONJSON_TYPE_ARRAY, KSBONJSON_TYPE_TYPED_ARRAY: return "array"
+        case KSBONJSON_TYPE_OBJECT, KSBONJSON_TYPE_RECORD: return "object"
         default: return "unknown"
         }
     }
@@ -2240,13 +3453,14 @@ struct _MapUnkeyedDecodingContainer: UnkeyedDecodingContainer {
             let entryType = state.map.getEntryUnchecked(at: currentEntryIndex).type
             if entryType == KSBONJSON_TYPE_BIGNUMBER {
                 let (_, entry) = try nextEntry()
-                let bn = entry.data.bigNumber
+                let bn = state.map.getBigNumber(entry)
                 return try state.decodeBigNumberAsDecimal((bn.significand, bn.exponent, bn.sign)) as! T
             }
             // Fall through to let Decimal's Decodable init handle other numeric types
         }
 
-        let decoder = try nextDecoder()
+        var decoder = try nextDecoder()
+        defer { state.recycle(&decoder) }
 
         if type == Date.self {
             return try decoder.decodeDate() as! T
@@ -2261,6 +3475,9 @@ struct _MapUnkeyedDecodingContainer: UnkeyedDecodingContainer {
             }
             return url as! T
         }
+        if let result = try decoder.decodeFields(type) {
+            return result
+        }
 
         return try T(from: decoder)
     }
@@ -2280,6 +3497,70 @@ struct _MapUnkeyedDecodingContainer: UnkeyedDecodingContainer {
     }
 }
 
+// MARK: - Concurrent Array Decoding
+
+/// Arrays whose elements can be decoded on several threads
+/// (see `BONJSONDecoder.decodesArrayElementsConcurrently`).
+protocol _ConcurrentlyDecodableArray {
+    /// Returns nil if the value at `index` isn't suited to concurrent decoding.
+    static func decodeConcurrently(state: _MapDecoderState, at index: size_t) throws -> Self?
+}
+
+extension Array: _ConcurrentlyDecodableArray where Element: Decodable {
+    static func decodeConcurrently(state: _MapDecoderState, at index: size_t) throws -> [Element]? {
+        let map = state.map
+        guard try map.prepareForConcurrentReads(),
+              let entry = map.getEntry(at: index),
+              entry.type == KSBONJSON_TYPE_ARRAY else {
+            return nil
+        }
+        let count = Int(entry.data.container.count)
+
+        // A few chunks per thread evens out elements of uneven cost
+        let chunkCount = Swift.min(count, ProcessInfo.processInfo.activeProcessorCount * 4)
+        guard chunkCount > 1 else { return nil }
+
+        // Find where each chunk starts in the map
+        var chunkStarts = [Int](repeating: 0, count: chunkCount)
+        var entryIndex = Int(entry.data.container.firstChild)
+        var nextChunk = 0
+        for element in 0..<count {
+            if nextChunk < chunkCount && element == count * nextChunk / chunkCount {
+                chunkStarts[nextChunk] = entryIndex
+                nextChunk += 1
+            }
+            entryIndex = map.nextSiblingIndex(entryIndex)
+        }
+
+        var results = [Element?](repeating: nil, count: count)
+        var errors = [Error?](repeating: nil, count: chunkCount)
+        results.withUnsafeMutableBufferPointer { results in
+            errors.withUnsafeMutableBufferPointer { errors in
+                DispatchQueue.concurrentPerform(iterations: chunkCount) { chunk in
+                    let elements = (count * chunk / chunkCount)..<(count * (chunk + 1) / chunkCount)
+                    var container = _MapUnkeyedDecodingContainer(
+                        state: state, arrayIndex: index, entry: entry, lazyPath: .root,
+                        elements: elements, firstEntryIndex: chunkStarts[chunk]
+                    )
+                    do {
+                        for element in elements {
+                            results[element] = try container.decode(Element.self)
+                        }
+                    } catch {
+                        errors[chunk] = error
+                    }
+                }
+            }
+        }
+
+        // Report the error of the earliest failing element, as a serial decode would
+        if let error = errors.lazy.compactMap({ $0 }).first {
+            throw error
+        }
+        return results.map { $0! }
+    }
+}
+
 // MARK: - Single Value Decoding Container
 
 struct _MapSingleValueDecodingContainer: SingleValueDecodingContainer {
@@ -2327,7 +3608,7 @@ struct _MapSingleValueDecodingContainer: SingleValueDecodingContainer {
             }
         }
         if entry.type == KSBONJSON_TYPE_BIGNUMBER {
-            let bn = entry.data.bigNumber
+            let bn = state.map.getBigNumber(entry)
             if state.outOfRangeBigNumberDecodingStrategy == .stringify,
                state.validateBigNumberLimits((bn.significand, bn.exponent, bn.sign)) != nil {
                 return state.stringifyBigNumber((bn.significand, bn.exponent, bn.sign))
@@ -2352,7 +3633,7 @@ struct _MapSingleValueDecodingContainer: SingleValueDecodingContainer {
         case KSBONJSON_TYPE_INT: return Double(entry.data.intValue)
         case KSBONJSON_TYPE_UINT: return Double(entry.data.uintValue)
         case KSBONJSON_TYPE_BIGNUMBER:
-            let bn = entry.data.bigNumber
+            let bn = state.map.getBigNumber(entry)
             return try state.decodeBigNumber((bn.significand, bn.exponent, bn.sign))
         case KSBONJSON_TYPE_STRING:
             // Try to decode string as non-conforming float
@@ -2425,8 +3706,8 @@ struct _MapSingleValueDecodingContainer: SingleValueDecodingContainer {
         case KSBONJSON_TYPE_FLOAT: return "float"
         case KSBONJSON_TYPE_BIGNUMBER: return "big number"
         case KSBONJSON_TYPE_STRING: return "string"
-        case KSBONJSON_TYPE_ARRAY: return "array"
-        case KSBONJSON_TYPE_OBJECT: return "object"
+        case KSBONJSON_TYPE_ARRAY, KSBONJSON_TYPE_TYPED_ARRAY: return "array"
+        case KSBONJSON_TYPE_OBJECT, KSBONJSON_TYPE_RECORD: return "object"
         default: return "unknown"
         }
     }
@@ -2451,13 +3732,16 @@ struct _MapSingleValueDecodingContainer: SingleValueDecodingContainer {
         if type == Decimal.self {
             let entry = state.map.getEntry(at: entryIndex)
             if let entry = entry, entry.type == KSBONJSON_TYPE_BIGNUMBER {
-                let bn = entry.data.bigNumber
+                let bn = state.map.getBigNumber(entry)
                 return try state.decodeBigNumberAsDecimal((bn.significand, bn.exponent, bn.sign)) as! T
             }
             // Fall through to let Decimal's Decodable init handle other numeric types
         }
 
         let decoder = _MapDecoder(state: state, entryIndex: entryIndex, lazyPath: lazyPath)
+        if let result = try decoder.decodeFields(type) {
+            return result
+        }
         return try T(from: decoder)
     }
 }
@@ -0,0 +1,150 @@
+// ABOUTME: Reading and writing sequences of concatenated BONJSON documents.
+// ABOUTME: One position map context and encode buffer are reused for every document.
+
+import Foundation
+import CKSBonjson
+
+/// Reads a sequence of concatenated BONJSON documents, such as an append-only event log,
+/// one document at a time.
+///
+/// Each document is mapped by itself (the bytes after it are the next document, not
+/// trailing garbage), and the position map storage is reused from one document to the
+/// next, so reading a long sequence costs no per-document setup:
+///
+///     let reader = BONJSONDocumentReader(data: log)
+///     while let event = try reader.next(Event.self) {
+///         handle(event)
+///     }
+///
+/// The decoder's limits apply to each document separately; `maxDocumentSize` bounds a
+/// single document rather than the whole sequence. A reader is not thread-safe.
+public final class BONJSONDocumentReader {
+
+    /// The decoder used for each document.
+    public let decoder: BONJSONDecoder
+
+    /// The documents.
+    public let data: Data
+
+    /// Offset (from `data.startIndex`) of the next document.
+    public private(set) var offset: Int = 0
+
+    /// Whether every document has been read.
+    public var isAtEnd: Bool {
+        return offset >= data.count
+    }
+
+    private let session = BONJSONSession()
+
+    /// Creates a reader over a buffer of concatenated documents.
+    public init(data: Data, decoder: BONJSONDecoder = BONJSONDecoder()) {
+        self.data = data
+        self.decoder = decoder
+    }
+
+    /// Creates a reader over a file of concatenated documents.
+    /// The file is memory-mapped rather than read into memory.
+    public convenience init(contentsOf url: URL, decoder: BONJSONDecoder = BONJSONDecoder()) throws {
+        self.init(data: try Data(contentsOf: url, options: .alwaysMapped), decoder: decoder)
+    }
+
+    /// Decodes the next document, or returns nil at the end of the sequence.
+    ///
+    /// If the document is malformed or doesn't decode as `type`, the error is thrown and
+    /// the reader stays at that document (use `skip()` to step over it).
+    public func next<T: Decodable>(_ type: T.Type) throws -> T? {
+        return try withNextMap(lazy: false) { map in
+            try decoder.decode(type, from: map)
+        }
+    }
+
+    /// Steps over the next document without decoding it, returning its byte range
+    /// in `data`, or nil at the end of the sequence.
+    ///
+    /// The document is mapped lazily, so only its structure (bounds, nesting and
+    /// delimiters) is checked.
+    @discardableResult
+    public func skip() throws -> Range<Data.Index>? {
+        let start = offset
+        let skipped: Void? = try withNextMap(lazy: true) { _ in }
+        guard skipped != nil else { return nil }
+        return (data.startIndex + start)..<(data.startIndex + offset)
+    }
+
+    /// Decodes every remaining document.
+    public func decodeAll<T: Decodable>(_ type: T.Type) throws -> [T] {
+        var values: [T] = []
+        while let value = try next(type) {
+            values.append(value)
+        }
+        return values
+    }
+
+    /// Byte ranges of every remaining document, found by skipping over them.
+    public func remainingRanges() throws -> [Range<Data.Index>] {
+        var ranges: [Range<Data.Index>] = []
+        while let range = try skip() {
+            ranges.append(range)
+        }
+        return ranges
+    }
+
+    /// Map the next document and run `body` on it, advancing past the document only if both succeed.
+    private func withNextMap<R>(lazy: Bool, _ body: (_PositionMap) throws -> R) throws -> R? {
+        guard !isAtEnd else { return nil }
+        return try data.withUnsafeBytes { (buffer: UnsafeRawBufferPointer) -> R in
+            let remaining = UnsafeRawBufferPointer(rebasing: buffer[offset...])
+            let map = try decoder.makeSequenceMap(from: remaining, lazy: lazy, session: session)
+            let result = try body(map)
+            offset += map.documentLength
+            return result
+        }
+    }
+}
+
+/// Writes a sequence of concatenated BONJSON documents to a sink, reusing one encode
+/// buffer for every document. `BONJSONDocumentReader` reads the sequence back.
+///
+///     let writer = BONJSONDocumentWriter(stream: logStream)
+///     for event in events {
+///         try writer.write(event)
+///     }
+///
+/// Each document is encoded in full before any of it reaches the sink, so a document
+/// that fails to encode leaves no partial output. A writer is not thread-safe.
+public final class BONJSONDocumentWriter {
+
+    /// The encoder used for each document.
+    public let encoder: BONJSONEncoder
+
+    /// Number of documents written so far.
+    public private(set) var documentCount: Int = 0
+
+    /// Total bytes handed to the sink so far.
+    public private(set) var bytesWritten: Int = 0
+
+    private let sink: (UnsafeRawBufferPointer) throws -> Void
+    private let session = BONJSONSession()
+
+    /// Creates a writer that hands each encoded document to `sink`.
+    /// The bytes passed to the sink are only valid for the duration of the call.
+    public init(encoder: BONJSONEncoder = BONJSONEncoder(), sink: @escaping (UnsafeRawBufferPointer) throws -> Void) {
+        self.encoder = encoder
+        self.sink = sink
+    }
+
+    /// Creates a writer that writes each encoded document to an opened output stream.
+    public convenience init(encoder: BONJSONEncoder = BONJSONEncoder(), stream: OutputStream) {
+        self.init(encoder: encoder) { try stream.writeAll($0) }
+    }
+
+    /// Encodes `value` as the next document of the sequence.
+    /// - Throws: An error if encoding fails or the sink throws.
+    public func write<T: Encodable>(_ value: T) throws {
+        try encoder.encode(value, using: session) { bytes in
+            try sink(bytes)
+            bytesWritten += bytes.count
+        }
+        documentCount += 1
+    }
+}
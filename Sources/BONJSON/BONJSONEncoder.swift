@@ -2,6 +2,7 @@
 // ABOUTME: Uses the buffer-based C API for high-performance direct buffer encoding.
 
 import Foundation
+import Dispatch
 import CKSBonjson
 
 /// An object that encodes instances of a data type as BONJSON data.
@@ -75,6 +76,20 @@ public final class BONJSONEncoder {
         case custom((_ codingPath: [CodingKey]) -> CodingKey)
     }
 
+    /// Which arrays the encoder writes as records: one shared key list (a record
+    /// definition) up front, then just the values of each element.
+    public enum RecordEncodingStrategy {
+        /// Only a root array of at least two keyed objects with the same keys (default).
+        case rootArrays
+
+        /// Any array of at least two keyed objects with the same keys, anywhere in the
+        /// tree, up to 256 distinct key lists per document. Definitions found below the
+        /// root are inserted in front of the root value once it has been encoded, so
+        /// `encode(_:to:)` (which can't rewrite output it has already flushed) only
+        /// applies this to the root array.
+        case allArrays
+    }
+
     // MARK: - Security Strategies
 
     /// The strategy to use for handling NUL (U+0000) characters in strings during encoding.
@@ -105,6 +120,31 @@ public final class BONJSONEncoder {
     /// The strategy to use for encoding keys. Default is `.useDefaultKeys`.
     public var keyEncodingStrategy: KeyEncodingStrategy = .useDefaultKeys
 
+    /// The strategy for which arrays are encoded as records. Default is `.rootArrays`.
+    public var recordEncodingStrategy: RecordEncodingStrategy = .rootArrays
+
+    /// Whether the elements of a large root array are encoded on several threads.
+    /// Default is `false`.
+    ///
+    /// Applies when encoding `[T]` whose elements aren't batch encoded primitives, and pays
+    /// off when each element is costly to encode. The elements' `encode(to:)` and custom
+    /// key, date and data encoding closures may then be called from several threads at once.
+    ///
+    /// A root array of objects with the same keys still becomes record instances of one
+    /// definition, but an element that doesn't match it is written as a plain object (as
+    /// when streaming) rather than the whole array going back to plain objects. Arrays
+    /// below the root aren't written as records. When streaming, only a few chunks of
+    /// encoded elements are held at a time.
+    public var encodesArrayElementsConcurrently: Bool = false
+
+    /// Whether batch encoded `[Int]`, `[Int64]` and `[Double]` arrays are written with the
+    /// narrowest typed array element that holds every value exactly. Default is `false`.
+    ///
+    /// Integers then take 1, 2 or 4 bytes each when they all fit (unsigned if none is
+    /// negative), and doubles take 4 bytes when they all convert to `Float` and back
+    /// unchanged. Decoding gives back the same values. Costs an extra pass over each array.
+    public var narrowsNumericArrays: Bool = false
+
     // MARK: - Security Strategy Properties
 
     /// The strategy for handling NUL characters in strings. Default is `.reject` (most secure).
@@ -127,6 +167,15 @@ public final class BONJSONEncoder {
     /// Contextual user info for encoding.
     public var userInfo: [CodingUserInfoKey: Any] = [:]
 
+    /// Called with the statistics of each document encoded successfully. Default is `nil`.
+    ///
+    /// The counters are compiled out of normal builds, so this is only called when
+    /// the package was built with the `BONJSON_STATS` environment variable set.
+    public var statisticsHandler: ((Statistics) -> Void)? = nil
+
+    /// Whether the statistics include how long encoding took. Default is `false`.
+    public var statisticsIncludeTimings: Bool = false
+
     /// Creates a new BONJSON encoder.
     public init() {}
 
@@ -136,7 +185,101 @@ public final class BONJSONEncoder {
     /// - Returns: A new `Data` value containing the encoded BONJSON data.
     /// - Throws: An error if encoding fails.
     public func encode<T: Encodable>(_ value: T) throws -> Data {
-        let state = _BufferEncoderState(
+        let state = makeEncoderState()
+        try encode(value, into: state)
+        return state.buffer.withUnsafeBytes { Data($0.prefix(state.bytesWritten)) }
+    }
+
+    /// Encodes the given value, reusing the encode buffer kept by `session` rather
+    /// than growing a new one from scratch.
+    ///
+    /// - Parameters:
+    ///   - value: The value to encode.
+    ///   - session: Storage to reuse. Must not be used from another thread at the same time.
+    /// - Returns: A new `Data` value containing the encoded BONJSON data.
+    /// - Throws: An error if encoding fails.
+    public func encode<T: Encodable>(_ value: T, using session: BONJSONSession) throws -> Data {
+        let state = makeEncoderState(reusing: session.takeEncodeBuffer())
+        defer { session.recycle(encodeBuffer: state.takeBuffer()) }
+        try encode(value, into: state)
+        return state.buffer.withUnsafeBytes { Data($0.prefix(state.bytesWritten)) }
+    }
+
+    // MARK: - Streaming Output
+
+    /// Size of the buffer used by the streaming `encode(_:to:)` methods. Default is 64 KB.
+    ///
+    /// Output is handed to the sink in chunks of at most this size. A single value
+    /// larger than this (a long string or batch-encoded array) temporarily grows the buffer.
+    public var streamingChunkSize: Int = 65536
+
+    /// Encodes the given value, handing the BONJSON output to `sink` in chunks as the
+    /// encoding buffer fills, rather than accumulating the whole document in memory.
+    ///
+    /// Each chunk is only valid for the duration of the call. If the sink throws,
+    /// encoding stops and the error is rethrown; output already delivered is not retracted.
+    ///
+    /// - Parameters:
+    ///   - value: The value to encode.
+    ///   - sink: Receives each chunk of encoded bytes, in order.
+    /// - Throws: An error if encoding fails or the sink throws.
+    public func encode<T: Encodable>(_ value: T, to sink: (UnsafeRawBufferPointer) throws -> Void) throws {
+        try withoutActuallyEscaping(sink) { sink in
+            let state = makeEncoderState()
+            state.streamOutput(chunkSize: max(streamingChunkSize, 256), to: sink)
+            try encode(value, into: state)
+        }
+    }
+
+    /// Encodes the given value, writing the BONJSON output to an open `OutputStream`
+    /// in chunks as it is produced.
+    ///
+    /// - Parameters:
+    ///   - value: The value to encode.
+    ///   - stream: An opened output stream.
+    /// - Throws: An error if encoding fails or the stream cannot accept the data.
+    public func encode<T: Encodable>(_ value: T, to stream: OutputStream) throws {
+        try encode(value) { try stream.writeAll($0) }
+    }
+
+    // MARK: - Document Sequences
+
+    /// Encodes the given value as one more document at the end of `data`, building
+    /// a sequence of concatenated documents that `BONJSONDocumentReader` reads back.
+    ///
+    /// `data` is only modified if encoding succeeds.
+    ///
+    /// - Parameters:
+    ///   - value: The value to encode.
+    ///   - data: The sequence to append to.
+    ///   - session: Storage to reuse between documents, if any.
+    /// - Throws: An error if encoding fails.
+    public func encode<T: Encodable>(_ value: T, appendingTo data: inout Data, using session: BONJSONSession? = nil) throws {
+        try encode(value, using: session) { data.append(contentsOf: $0) }
+    }
+
+    /// Encodes a value for a `BONJSONFragment`. Records are never used: a spliced value
+    /// can't carry the record definitions its instances would refer to.
+    func encodeFragment<T: Encodable>(_ value: T) throws -> Data {
+        let state = makeEncoderState(records: false)
+        try encode(value, into: state, records: false)
+        return state.buffer.withUnsafeBytes { Data($0.prefix(state.bytesWritten)) }
+    }
+
+    /// Encodes a whole document into a (reused) buffer and hands it to `body` in one piece.
+    func encode<T: Encodable>(_ value: T, using session: BONJSONSession?, body: (UnsafeRawBufferPointer) throws -> Void) throws {
+        let state = makeEncoderState(reusing: session?.takeEncodeBuffer())
+        defer {
+            if let session = session {
+                session.recycle(encodeBuffer: state.takeBuffer())
+            }
+        }
+        try encode(value, into: state)
+        try state.buffer.withUnsafeBytes { try body(UnsafeRawBufferPointer(rebasing: $0.prefix(state.bytesWritten))) }
+    }
+
+    private func makeEncoderState(reusing buffer: ContiguousArray<UInt8>? = nil, records: Bool = true) -> _BufferEncoderState {
+        return _BufferEncoderState(
             userInfo: userInfo,
             dateEncodingStrategy: dateEncodingStrategy,
             dataEncodingStrategy: dataEncodingStrategy,
@@ -146,9 +289,35 @@ public final class BONJSONEncoder {
             maxDepth: maxDepth,
             maxStringLength: maxStringLength,
             maxContainerSize: maxContainerSize,
-            maxDocumentSize: maxDocumentSize
+            maxDocumentSize: maxDocumentSize,
+            recordsNestedArrays: records && recordEncodingStrategy == .allArrays,
+            narrowsNumericArrays: narrowsNumericArrays,
+            reusing: buffer,
+            collectsStatistics: collectsStatistics
         )
+    }
+
+    /// Whether encoder states count what they write for `statisticsHandler`. Always
+    /// false unless built with BONJSON_STATS, since the C counters don't exist otherwise.
+    private var collectsStatistics: Bool {
+        #if BONJSON_STATS
+        return statisticsHandler != nil
+        #else
+        return false
+        #endif
+    }
+
+    private func encode<T: Encodable>(_ value: T, into state: _BufferEncoderState, records: Bool = true) throws {
+        guard let handler = statisticsHandler, let stats = state.statistics else {
+            return try encodeValue(value, into: state, records: records)
+        }
+        let startTime = statisticsIncludeTimings ? DispatchTime.now().uptimeNanoseconds : 0
+        try encodeValue(value, into: state, records: records)
+        let encodeNanoseconds = statisticsIncludeTimings ? DispatchTime.now().uptimeNanoseconds - startTime : 0
+        handler(Statistics(stats.pointee, encodeNanoseconds: encodeNanoseconds))
+    }
 
+    private func encodeValue<T: Encodable>(_ value: T, into state: _BufferEncoderState, records: Bool) throws {
         // Fast path for primitive arrays
         if let intArray = value as? [Int] {
             try state.encodeBatchInt64Array(intArray)
@@ -178,33 +347,14 @@ public final class BONJSONEncoder {
             try state.encodeBatchBoolArray(boolArray)
         } else if let stringArray = value as? [String] {
             try state.encodeBatchStringArray(stringArray)
-        } else if let candidate = value as? _RecordCandidateArray, candidate._recordCandidateCount >= 2,
-                  let keys = try candidate._probeFirstElementKeys(using: keyEncodingStrategy),
-                  !keys.isEmpty {
-            // Try record encoding for arrays of keyed objects
-            let savedPosition = state.context.position
-            let savedDepth = state.currentDepth
-            do {
-                try state.encodeRecordDefinition(keys: keys)
-                state.recordSchema = keys
-                // Write array begin
-                state.ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_CONTAINER_BEGIN))
-                let beginResult = ksbonjson_encodeToBuffer_beginArray(&state.context)
-                try throwIfEncodingFailed(beginResult)
-                try candidate._encodeRecordElements(to: state, codingPath: [])
-                // Write array end
-                state.ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_CONTAINER_END))
-                let endResult = ksbonjson_encodeToBuffer_endContainer(&state.context)
-                try throwIfEncodingFailed(endResult)
-                state.recordSchema = nil
-            } catch is _RecordEncodingFallback {
-                // Schema mismatch — reset buffer and fall through to regular Codable
-                state.recordSchema = nil
-                state.context.position = savedPosition
-                state.context.containerDepth = Int32(savedDepth)
-                let encoder = _BufferEncoder(state: state, codingPath: [])
-                try encoder.encodeValue(value)
-            }
+        } else if encodesArrayElementsConcurrently,
+                  let array = value as? _ConcurrentlyEncodableArray,
+                  try state.encodeConcurrently(array, records: records, makeChunkState: { makeEncoderState(records: false) }) {
+            // Elements encoded on several threads
+        } else if records,
+                  let candidate = value as? _RecordCandidateArray,
+                  try state.tryEncodeRecordArray(candidate, codingPath: []) {
+            // Encoded as record instances
         } else {
             // Default path through Codable
             let encoder = _BufferEncoder(state: state, codingPath: [])
@@ -213,8 +363,23 @@ public final class BONJSONEncoder {
 
         // Close all remaining containers and finalize
         try state.finalize()
+    }
+}
 
-        return state.buffer.withUnsafeBytes { Data($0.prefix(state.bytesWritten)) }
+extension OutputStream {
+    /// Write all of `bytes`, retrying partial writes.
+    func writeAll(_ bytes: UnsafeRawBufferPointer) throws {
+        var offset = 0
+        while offset < bytes.count {
+            let written = write(
+                bytes.baseAddress!.assumingMemoryBound(to: UInt8.self) + offset,
+                maxLength: bytes.count - offset
+            )
+            guard written > 0 else {
+                throw streamError ?? BONJSONEncodingError.encodingFailed("Output stream did not accept data")
+            }
+            offset += written
+        }
     }
 }
 
@@ -305,6 +470,30 @@ final class _BufferEncoderState {
     /// Record mode state: when set, keyed containers use record instance encoding.
     var recordSchema: [String]?
 
+    /// The definition that record instances of the array being encoded refer to.
+    var recordDefinitionIndex: UInt64 = 0
+
+    /// Whether arrays of keyed objects below the root are also tried as records
+    /// (see `BONJSONEncoder.RecordEncodingStrategy.allArrays`).
+    private(set) var recordsNestedArrays: Bool
+
+    /// Whether integer and double arrays are written with their narrowest element type
+    /// (see `BONJSONEncoder.narrowsNumericArrays`).
+    let narrowsNumericArrays: Bool
+
+    /// Every record definition used so far, in index order.
+    private var recordDefinitions: [[String]] = []
+    private var recordDefinitionIndices: [[String]: Int] = [:]
+
+    /// How many of `recordDefinitions` have been written at the start of the buffer,
+    /// and how many bytes they take. The rest are inserted after them by finalize().
+    private var writtenRecordDefinitionCount = 0
+    private var recordHeaderLength = 0
+
+    /// The counters the C encoder fills in, owned by this state and released in deinit.
+    /// Nil unless statistics were requested.
+    private(set) var statistics: UnsafeMutablePointer<KSBONJSONEncodeStats>?
+
     /// Initial buffer size.
     private static let initialCapacity = 256
 
@@ -318,8 +507,14 @@ final class _BufferEncoderState {
         maxDepth: Int = 0,
         maxStringLength: Int = 0,
         maxContainerSize: Int = 0,
-        maxDocumentSize: Int = 0
+        maxDocumentSize: Int = 0,
+        recordsNestedArrays: Bool = false,
+        narrowsNumericArrays: Bool = false,
+        reusing reusedBuffer: ContiguousArray<UInt8>? = nil,
+        collectsStatistics: Bool = false
     ) {
+        self.recordsNestedArrays = recordsNestedArrays
+        self.narrowsNumericArrays = narrowsNumericArrays
         self.userInfo = userInfo
         self.dateEncodingStrategy = dateEncodingStrategy
         self.dataEncodingStrategy = dataEncodingStrategy
@@ -327,7 +522,8 @@ final class _BufferEncoderState {
         self.keyEncodingStrategy = keyEncodingStrategy
         self.nulEncodingStrategy = nulEncodingStrategy
 
-        self.buffer = ContiguousArray<UInt8>(repeating: 0, count: Self.initialCapacity)
+        // A reused buffer keeps whatever size earlier documents grew it to
+        self.buffer = reusedBuffer ?? ContiguousArray<UInt8>(repeating: 0, count: Self.initialCapacity)
         self.context = KSBONJSONBufferEncodeContext()
 
         // Build encode flags from strategy
@@ -361,6 +557,25 @@ final class _BufferEncoderState {
                 flags
             )
         }
+
+        if collectsStatistics {
+            statistics = .allocate(capacity: 1)
+            statistics!.initialize(to: KSBONJSONEncodeStats())
+            ksbonjson_encodeToBuffer_setStats(&context, statistics)
+        }
+    }
+
+    deinit {
+        statistics?.deallocate()
+    }
+
+    /// Hand the buffer over (e.g. to a session) once encoding has finished with it.
+    /// Moves rather than copies, leaving the state with an empty buffer.
+    func takeBuffer() -> ContiguousArray<UInt8> {
+        var taken = ContiguousArray<UInt8>()
+        swap(&taken, &buffer)
+        ksbonjson_encodeToBuffer_setBuffer(&context, nil, 0)
+        return taken
     }
 
     /// Current container depth.
@@ -373,7 +588,111 @@ final class _BufferEncoderState {
     func ensureCapacity(_ additionalBytes: Int) {
         let required = bytesWritten + additionalBytes
         guard required > buffer.count else { return }
-        growBuffer(to: required)
+        makeRoom(for: additionalBytes)
+    }
+
+    /// Flush to the sink if streaming, growing only if that doesn't free enough space.
+    private func makeRoom(for additionalBytes: Int) {
+        if sink != nil {
+            flushBuffer()
+            guard bytesWritten + additionalBytes > buffer.count else { return }
+        }
+        growBuffer(to: bytesWritten + additionalBytes)
+    }
+
+    // MARK: - Streaming Output
+
+    /// Where flushed output goes. Nil when encoding into a single growing buffer.
+    private var sink: ((UnsafeRawBufferPointer) throws -> Void)?
+
+    /// The first error thrown by the sink. Once set, further output is discarded.
+    private(set) var sinkError: Error?
+
+    /// Start of a region that may still be rewound, and so must not be flushed yet.
+    /// Positions are relative to the buffer start and move down as bytes are flushed.
+    var pinnedPosition: Int?
+
+    /// True when output is being flushed to a sink rather than kept in the buffer.
+    var isStreaming: Bool {
+        return sink != nil
+    }
+
+    /// Switch to streaming mode: keep a fixed-size buffer and flush it to `sink` whenever it fills.
+    func streamOutput(chunkSize: Int, to sink: @escaping (UnsafeRawBufferPointer) throws -> Void) {
+        self.sink = sink
+        // Definitions found after output has been flushed couldn't be put in front of it
+        recordsNestedArrays = false
+        if buffer.count < chunkSize {
+            growBuffer(to: chunkSize)
+        }
+        ksbonjson_encodeToBuffer_setFlushCallback(&context, { data, length, userData in
+            let state = Unmanaged<_BufferEncoderState>.fromOpaque(userData!).takeUnretainedValue()
+            state.deliverToSink(UnsafeRawBufferPointer(start: data, count: length))
+            return KSBONJSON_ENCODE_OK
+        }, Unmanaged.passUnretained(self).toOpaque())
+    }
+
+    /// Hand flushed bytes to the sink. Errors are recorded rather than propagated so that
+    /// the C layer still compacts the buffer; encoding stops at the next throwing call site.
+    private func deliverToSink(_ bytes: UnsafeRawBufferPointer) {
+        guard sinkError == nil, let sink = sink else { return }
+        do {
+            try sink(bytes)
+        } catch {
+            sinkError = error
+        }
+    }
+
+    /// Flush everything before the pinned position (or everything, if nothing is pinned).
+    func flushBuffer() {
+        let length = pinnedPosition ?? bytesWritten
+        guard length > 0 else { return }
+        let result = ksbonjson_encodeToBuffer_flush(&context, length)
+        if result > 0, let pinned = pinnedPosition {
+            pinnedPosition = pinned - result
+        }
+    }
+
+    /// Throw the sink's error, if it has failed.
+    @inline(__always)
+    func throwIfSinkFailed() throws {
+        if let error = sinkError {
+            throw error
+        }
+    }
+
+    /// Everything needed to undo the writes made after a point in the encoding:
+    /// the buffer position plus the state of the container that was open there.
+    struct RollbackPoint {
+        var position: Int
+        let depth: Int
+        let container: KSBONJSONContainerState
+        let elementCount: Int
+    }
+
+    /// Capture the current position and innermost container state.
+    func rollbackPoint() -> RollbackPoint {
+        let depth = currentDepth
+        let container = withUnsafeBytes(of: &context.containers) { containers in
+            containers.bindMemory(to: KSBONJSONContainerState.self)[depth]
+        }
+        let elementCount = withUnsafeBytes(of: &context.containerElementCounts) { counts in
+            counts.bindMemory(to: Int.self)[depth]
+        }
+        return RollbackPoint(position: bytesWritten, depth: depth, container: container, elementCount: elementCount)
+    }
+
+    /// Discard everything written since the rollback point was captured.
+    /// The point's position must still be in the buffer (not flushed).
+    func rollBack(to point: RollbackPoint) {
+        context.position = size_t(point.position)
+        context.containerDepth = Int32(point.depth)
+        withUnsafeMutableBytes(of: &context.containers) { containers in
+            containers.bindMemory(to: KSBONJSONContainerState.self)[point.depth] = point.container
+        }
+        withUnsafeMutableBytes(of: &context.containerElementCounts) { counts in
+            counts.bindMemory(to: Int.self)[point.depth] = point.elementCount
+        }
     }
 
     /// Grow buffer to at least the required size (slow path, not inlined).
@@ -386,6 +705,7 @@ final class _BufferEncoderState {
 
         buffer.reserveCapacity(newCapacity)
         buffer.append(contentsOf: repeatElement(0, count: newCapacity - buffer.count))
+        statistics?.pointee.bufferGrowths += 1
 
         // Update the C context with new buffer pointer
         buffer.withUnsafeMutableBufferPointer { bufferPtr in
@@ -415,6 +735,24 @@ final class _BufferEncoderState {
 
         let endResult = ksbonjson_encodeToBuffer_end(&context)
         try throwIfEncodingFailed(endResult)
+
+        try insertPendingRecordDefinitions()
+
+        if isStreaming {
+            pinnedPosition = nil
+            flushBuffer()
+            try throwIfSinkFailed()
+        }
+    }
+
+    /// Copy a pre-encoded value into the output. Its nesting counts towards `maxDepth`.
+    func encodeFragment(_ fragment: BONJSONFragment) throws {
+        ensureCapacity(fragment.bytes.count)
+        let result = fragment.bytes.withUnsafeBytes { bytes in
+            ksbonjson_encodeToBuffer_fragment(
+                &context, bytes.baseAddress?.assumingMemoryBound(to: UInt8.self), bytes.count, fragment.depth)
+        }
+        try throwIfEncodingFailed(result)
     }
 
     /// Batch encode an array of Int values.
@@ -423,7 +761,9 @@ final class _BufferEncoderState {
         let result = values.withUnsafeBufferPointer { ptr in
             // Convert Int to Int64 pointer - safe on 64-bit platforms
             ptr.baseAddress!.withMemoryRebound(to: Int64.self, capacity: values.count) { int64Ptr in
-                ksbonjson_encodeToBuffer_int64Array(&context, int64Ptr, values.count)
+                narrowsNumericArrays
+                    ? ksbonjson_encodeToBuffer_narrowInt64Array(&context, int64Ptr, values.count)
+                    : ksbonjson_encodeToBuffer_int64Array(&context, int64Ptr, values.count)
             }
         }
         try throwIfEncodingFailed(result)
@@ -433,7 +773,9 @@ final class _BufferEncoderState {
     func encodeBatchInt64Array(_ values: [Int64]) throws {
         ensureCapacity(Int(ksbonjson_maxEncodedSize_int64Array(values.count)))
         let result = values.withUnsafeBufferPointer { ptr in
-            ksbonjson_encodeToBuffer_int64Array(&context, ptr.baseAddress, values.count)
+            narrowsNumericArrays
+                ? ksbonjson_encodeToBuffer_narrowInt64Array(&context, ptr.baseAddress, values.count)
+                : ksbonjson_encodeToBuffer_int64Array(&context, ptr.baseAddress, values.count)
         }
         try throwIfEncodingFailed(result)
     }
@@ -442,7 +784,9 @@ final class _BufferEncoderState {
     func encodeBatchDoubleArray(_ values: [Double]) throws {
         ensureCapacity(Int(ksbonjson_maxEncodedSize_doubleArray(values.count)))
         let result = values.withUnsafeBufferPointer { ptr in
-            ksbonjson_encodeToBuffer_doubleArray(&context, ptr.baseAddress, values.count)
+            narrowsNumericArrays
+                ? ksbonjson_encodeToBuffer_narrowDoubleArray(&context, ptr.baseAddress, values.count)
+                : ksbonjson_encodeToBuffer_doubleArray(&context, ptr.baseAddress, values.count)
         }
         try throwIfEncodingFailed(result)
     }
@@ -595,7 +939,7 @@ final class _BufferEncoderState {
     /// Write a record definition directly to the buffer.
     /// Record definitions are written outside container tracking, so we write raw bytes
     /// to avoid corrupting the C encoder's container state.
-    func encodeRecordDefinition(keys: [String]) throws {
+    private func encodeRecordDefinition(keys: [String]) throws {
         // Estimate capacity: 1 (def marker) + keys + 1 (end marker)
         var totalKeyBytes = 0
         for key in keys {
@@ -643,6 +987,219 @@ final class _BufferEncoderState {
         }
     }
 
+    /// Try to encode an array as record instances of a single definition, taken from
+    /// the first element's keys. Returns false, leaving the encoder as it was, if the
+    /// array isn't made of at least two keyed objects, the definition limit is reached,
+    /// or an element doesn't match; the caller then encodes the array normally.
+    fileprivate func tryEncodeRecordArray(_ candidate: _RecordCandidateArray, codingPath: [CodingKey]) throws -> Bool {
+        guard candidate._recordCandidateCount >= 2,
+              let keys = try candidate._probeFirstElementKeys(using: keyEncodingStrategy),
+              !keys.isEmpty else {
+            return false
+        }
+
+        let savedDefinitionCount = recordDefinitions.count
+        let savedHeader = (writtenRecordDefinitionCount, recordHeaderLength)
+        let arrayStart = rollbackPoint()
+        guard let definitionIndex = indexOfRecordDefinition(keys: keys) else {
+            return false
+        }
+
+        do {
+            // Nothing but definitions written yet (a root array): write new ones in place
+            if bytesWritten == recordHeaderLength {
+                try writePendingRecordDefinitions()
+            }
+
+            let savedSchema = recordSchema
+            let savedDefinitionIndex = recordDefinitionIndex
+            recordSchema = keys
+            recordDefinitionIndex = UInt64(definitionIndex)
+            defer {
+                recordSchema = savedSchema
+                recordDefinitionIndex = savedDefinitionIndex
+            }
+
+            ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_CONTAINER_BEGIN))
+            let beginResult = ksbonjson_encodeToBuffer_beginArray(&context)
+            try throwIfEncodingFailed(beginResult)
+            try candidate._encodeRecordElements(to: self, codingPath: codingPath)
+            ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_CONTAINER_END))
+            let endResult = ksbonjson_encodeToBuffer_endContainer(&context)
+            try throwIfEncodingFailed(endResult)
+            return true
+        } catch is _RecordEncodingFallback {
+            // Schema mismatch: drop the array and any definitions added while encoding it
+            rollBack(to: arrayStart)
+            for discarded in recordDefinitions[savedDefinitionCount...] {
+                recordDefinitionIndices[discarded] = nil
+            }
+            recordDefinitions.removeSubrange(savedDefinitionCount...)
+            (writtenRecordDefinitionCount, recordHeaderLength) = savedHeader
+            return false
+        }
+    }
+
+    /// Find or add the definition for a key list. Nil once the document has
+    /// KSBONJSON_MAX_RECORD_DEFS definitions and this is a new one.
+    private func indexOfRecordDefinition(keys: [String]) -> Int? {
+        if let index = recordDefinitionIndices[keys] {
+            return index
+        }
+        guard recordDefinitions.count < Int(KSBONJSON_MAX_RECORD_DEFS) else {
+            return nil
+        }
+        recordDefinitionIndices[keys] = recordDefinitions.count
+        recordDefinitions.append(keys)
+        return recordDefinitions.count - 1
+    }
+
+    /// Write the not-yet-written definitions at the current position.
+    private func writePendingRecordDefinitions() throws {
+        let start = bytesWritten
+        for keys in recordDefinitions[writtenRecordDefinitionCount...] {
+            try encodeRecordDefinition(keys: keys)
+        }
+        writtenRecordDefinitionCount = recordDefinitions.count
+        recordHeaderLength += bytesWritten - start
+    }
+
+    /// Insert the definitions found after the root value was started between the
+    /// already written definitions and the root value, since all definitions must
+    /// precede it. Moves the encoded value up by the size of the new definitions.
+    private func insertPendingRecordDefinitions() throws {
+        guard writtenRecordDefinitionCount < recordDefinitions.count else { return }
+
+        var insertedLength = 0
+        for keys in recordDefinitions[writtenRecordDefinitionCount...] {
+            insertedLength += 2
+            for key in keys {
+                insertedLength += Int(ksbonjson_maxEncodedSize_string(key.utf8.count))
+            }
+        }
+        let limit = Int(context.flags.maxDocumentSize)
+        if limit >= 0 && bytesWritten + insertedLength > limit {
+            throw BONJSONEncodingError.maxDocumentSizeExceeded
+        }
+
+        ensureCapacity(insertedLength)
+        let end = bytesWritten
+        buffer.withUnsafeMutableBufferPointer { bufferPtr in
+            let base = bufferPtr.baseAddress! + recordHeaderLength
+            _ = memmove(base + insertedLength, base, end - recordHeaderLength)
+        }
+        context.position = size_t(recordHeaderLength)
+        try writePendingRecordDefinitions()
+        context.position = size_t(end + insertedLength)
+    }
+
+    /// Fewest elements worth handing to a thread of their own.
+    private static let minimumConcurrentChunkSize = 128
+
+    /// Encode a root array's elements on several threads, then write them out in order
+    /// (see `BONJSONEncoder.encodesArrayElementsConcurrently`). Each chunk of elements is
+    /// encoded into an array of its own, in a state made by `makeChunkState`, and copied
+    /// (or handed to the sink) without that array's opening byte. Chunks written as
+    /// records refer to the definition written here before any of them start.
+    /// Returns false, having written nothing, for arrays too short to split.
+    fileprivate func encodeConcurrently(
+        _ array: _ConcurrentlyEncodableArray,
+        records: Bool,
+        makeChunkState: () -> _BufferEncoderState
+    ) throws -> Bool {
+        let count = array._recordCandidateCount
+        let processorCount = ProcessInfo.processInfo.activeProcessorCount
+        // A few chunks per thread evens out elements of uneven cost
+        let chunkCount = Swift.min(count / Self.minimumConcurrentChunkSize, processorCount * 4)
+        guard chunkCount > 1 && currentDepth == 0 else { return false }
+
+        var schema: _RecordSchema?
+        if records && bytesWritten == recordHeaderLength,
+           let keys = try array._probeFirstElementKeys(using: keyEncodingStrategy), !keys.isEmpty,
+           let definitionIndex = indexOfRecordDefinition(keys: keys) {
+            try writePendingRecordDefinitions()
+            schema = _RecordSchema(keys: keys, definitionIndex: UInt64(definitionIndex))
+        }
+
+        ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_CONTAINER_BEGIN))
+        try throwIfEncodingFailed(ksbonjson_encodeToBuffer_beginArray(&context))
+        let arrayDepth = currentDepth
+
+        // Streaming only keeps one chunk per thread in memory at a time
+        let batchSize = isStreaming ? processorCount : chunkCount
+        var batchStart = 0
+        while batchStart < chunkCount {
+            let chunks = batchStart..<Swift.min(batchStart + batchSize, chunkCount)
+            let chunkStates = chunks.map { _ in makeChunkState() }
+            var errors = [Error?](repeating: nil, count: chunks.count)
+            errors.withUnsafeMutableBufferPointer { errors in
+                DispatchQueue.concurrentPerform(iterations: chunks.count) { i in
+                    let chunk = chunks.lowerBound + i
+                    let elements = (count * chunk / chunkCount)..<(count * (chunk + 1) / chunkCount)
+                    do {
+                        try array._encodeElements(elements, to: chunkStates[i], schema: schema)
+                    } catch {
+                        errors[i] = error
+                    }
+                }
+            }
+
+            // Report the error of the earliest failing element, as a serial encode would
+            if let error = errors.lazy.compactMap({ $0 }).first {
+                throw error
+            }
+            for chunkState in chunkStates {
+                try appendElements(of: chunkState)
+            }
+            batchStart = chunks.upperBound
+        }
+
+        // The elements were copied in as bytes, so count them into the array here
+        withUnsafeMutableBytes(of: &context.containerElementCounts) { counts in
+            counts.bindMemory(to: Int.self)[arrayDepth] += count
+        }
+        return true
+    }
+
+    /// Write the elements a chunk state encoded (everything after its array's opening
+    /// byte) to the output, and add up what it counted.
+    private func appendElements(of chunkState: _BufferEncoderState) throws {
+        let length = chunkState.bytesWritten - 1
+        let limit = Int(context.flags.maxDocumentSize)
+        if limit >= 0 && Int(context.flushedBytes) + bytesWritten + length > limit {
+            throw BONJSONEncodingError.maxDocumentSizeExceeded
+        }
+        if let stats = statistics, let chunkStats = chunkState.statistics {
+            // Less the array the chunk's elements were wrapped in
+            stats.pointee.add(chunkStats.pointee)
+            stats.pointee.arrayCount -= 1
+        }
+        guard length > 0 else { return }
+
+        try chunkState.buffer.withUnsafeBytes { chunkBytes in
+            let elements = UnsafeRawBufferPointer(rebasing: chunkBytes[1..<(1 + length)])
+            if isStreaming {
+                // Hand the chunk to the sink straight from the chunk state's buffer,
+                // in pieces no larger than this buffer
+                flushBuffer()
+                var offset = 0
+                while offset < length {
+                    let piece = Swift.min(length - offset, buffer.count)
+                    deliverToSink(UnsafeRawBufferPointer(rebasing: elements[offset..<(offset + piece)]))
+                    offset += piece
+                }
+                context.flushedBytes += size_t(length)
+                try throwIfSinkFailed()
+                return
+            }
+            ensureCapacity(length)
+            buffer.withUnsafeMutableBytes { bufferBytes in
+                bufferBytes.baseAddress!.advanced(by: bytesWritten).copyMemory(from: elements.baseAddress!, byteCount: length)
+            }
+            context.position += size_t(length)
+        }
+    }
+
     /// Try batch encoding a value as a primitive array. Returns true if handled.
     func tryBatchEncode<T: Encodable>(_ value: T) throws -> Bool {
         if let v = value as? [Int]    { try encodeBatchInt64Array(v); return true }
@@ -660,6 +1217,102 @@ final class _BufferEncoderState {
         if let v = value as? [Bool]   { try encodeBatchBoolArray(v); return true }
         return false
     }
+
+    /// Try encoding a `[String: String]`, `[String: Int]` or `[String: Bool]` as one object
+    /// in a single C call. Returns true if handled.
+    ///
+    /// The object is written in the dictionary's iteration order, so the output is the
+    /// same as encoding the dictionary through a keyed container. Converted keys need
+    /// the coding path of every entry, so only `.useDefaultKeys` takes this path.
+    func tryEncodeDictionary<T: Encodable>(_ value: T) throws -> Bool {
+        guard case .useDefaultKeys = keyEncodingStrategy else { return false }
+        if let v = value as? [String: Int] {
+            let values = ContiguousArray(v.values.lazy.map { Int64($0) })
+            try values.withUnsafeBytes { bytes in
+                try encodeObjectRow(keys: v.keys, type: KSBONJSON_COLUMN_INT64, values: bytes, stride: MemoryLayout<Int64>.stride)
+            }
+            return true
+        }
+        if let v = value as? [String: String] {
+            let arena = _UTF8Arena(v.values)
+            try arena.withColumnStrings { strings in
+                try strings.withUnsafeBytes { bytes in
+                    try encodeObjectRow(keys: v.keys, type: KSBONJSON_COLUMN_STRING, values: bytes,
+                                        stride: MemoryLayout<KSBONJSONColumnString>.stride)
+                }
+            }
+            return true
+        }
+        if let v = value as? [String: Bool] {
+            let values = ContiguousArray(v.values)
+            try values.withUnsafeBytes { bytes in
+                try encodeObjectRow(keys: v.keys, type: KSBONJSON_COLUMN_BOOL, values: bytes, stride: MemoryLayout<Bool>.stride)
+            }
+            return true
+        }
+        return false
+    }
+
+    /// Encode one object whose i-th key's value is at `values + i * stride`.
+    private func encodeObjectRow<Keys: Sequence>(
+        keys: Keys,
+        type: KSBONJSONColumnType,
+        values: UnsafeRawBufferPointer,
+        stride: Int
+    ) throws where Keys.Element == String {
+        let result = _UTF8Arena(keys).withColumnStrings { keyStrings -> Int in
+            var columns = ContiguousArray<KSBONJSONColumn>()
+            columns.reserveCapacity(keyStrings.count)
+            for (i, key) in keyStrings.enumerated() {
+                columns.append(KSBONJSONColumn(
+                    key: key.bytes,
+                    keyLength: key.length,
+                    type: type,
+                    values: values.baseAddress! + i * stride,
+                    stride: 0
+                ))
+            }
+            return columns.withUnsafeBufferPointer { columnsPtr in
+                ensureCapacity(Int(ksbonjson_maxEncodedSize_columns(columnsPtr.baseAddress, columnsPtr.count, 1, false)))
+                return ksbonjson_encodeToBuffer_objectRows(&context, columnsPtr.baseAddress, columnsPtr.count, 1)
+            }
+        }
+        try throwIfEncodingFailed(result)
+    }
+}
+
+/// The UTF-8 of a sequence of strings, concatenated so that C can be handed
+/// pointers into one buffer instead of one allocation per string.
+private struct _UTF8Arena {
+    private var bytes = ContiguousArray<UInt8>()
+    private var lengths = ContiguousArray<Int>()
+
+    init<S: Sequence>(_ strings: S) where S.Element == String {
+        for string in strings {
+            let start = bytes.count
+            bytes.append(contentsOf: string.utf8)
+            lengths.append(bytes.count - start)
+        }
+    }
+
+    /// Run `body` with a column string for each string, valid only during the call.
+    func withColumnStrings<R>(_ body: (ContiguousArray<KSBONJSONColumnString>) throws -> R) rethrows -> R {
+        return try bytes.withUnsafeBufferPointer { buffer in
+            // Empty strings still need a valid pointer
+            let base = UnsafeRawPointer(buffer.baseAddress) ?? UnsafeRawPointer(bitPattern: 1)!
+            var strings = ContiguousArray<KSBONJSONColumnString>()
+            strings.reserveCapacity(lengths.count)
+            var offset = 0
+            for length in lengths {
+                strings.append(KSBONJSONColumnString(
+                    bytes: (base + offset).assumingMemoryBound(to: CChar.self),
+                    length: length
+                ))
+                offset += length
+            }
+            return try body(strings)
+        }
+    }
 }
 
 // MARK: - Buffer-Based Encoder
@@ -729,6 +1382,28 @@ final class _BufferEncoder: Encoder {
             return
         }
 
+        if let fragment = value as? BONJSONFragment {
+            try state.encodeFragment(fragment)
+            return
+        }
+
+        // Flat dictionaries as one object (a record element must go through its schema)
+        if state.recordSchema == nil, try state.tryEncodeDictionary(value) {
+            return
+        }
+
+        if state.recordSchema == nil, let fieldValue = value as? BONJSONFieldEncodable,
+           try state.tryEncodeFields(fieldValue, codingPath: codingPath) {
+            return
+        }
+
+        // Arrays of keyed objects below the root (BONJSONEncoder.encode tries the root one)
+        if state.recordsNestedArrays && state.recordSchema == nil && state.currentDepth > 0,
+           let candidate = value as? _RecordCandidateArray,
+           try state.tryEncodeRecordArray(candidate, codingPath: codingPath) {
+            return
+        }
+
         // Default encoding
         try value.encode(to: self)
     }
@@ -1334,6 +2009,8 @@ struct _BufferUnkeyedEncodingContainer: UnkeyedEncodingContainer {
     }
 
     mutating func encode<T: Encodable>(_ value: T) throws {
+        // Stop early on large streamed arrays once the sink has failed
+        try state.throwIfSinkFailed()
         try prepareToEncode()
         if try state.tryBatchEncode(value) { return }
         let encoder = _BufferEncoder(state: state, codingPath: codingPath + [_BONJSONIndexKey(index: count - 1)])
@@ -1507,17 +2184,21 @@ extension Array: _RecordCandidateArray where Element: Encodable {
     fileprivate func _probeFirstElementKeys(using keyEncodingStrategy: BONJSONEncoder.KeyEncodingStrategy) throws -> [String]? {
         guard let first = self.first else { return nil }
         // Skip types that encodeValue intercepts before encode(to:)
-        if first is Date || first is Data || first is URL || first is Decimal { return nil }
+        if first is Date || first is Data || first is URL || first is Decimal || first is BONJSONFragment { return nil }
         let probe = _KeyCaptureEncoder(keyEncodingStrategy: keyEncodingStrategy)
         try first.encode(to: probe)
         return probe.capturedKeys
     }
 
     fileprivate func _encodeRecordElements(to state: _BufferEncoderState, codingPath: [CodingKey]) throws {
+        if state.isStreaming {
+            try _encodeRecordElementsRewindingMismatches(indices, to: state, codingPath: codingPath)
+            return
+        }
         for (i, element) in self.enumerated() {
-            // Begin record instance (def index 0)
+            // Begin record instance
             state.ensureCapacity(11) // type byte + ULEB128
-            let result = ksbonjson_encodeToBuffer_beginRecordInstance(&state.context, 0)
+            let result = ksbonjson_encodeToBuffer_beginRecordInstance(&state.context, state.recordDefinitionIndex)
             try throwIfEncodingFailed(result)
 
             let recordInstanceDepth = state.currentDepth
@@ -1536,6 +2217,83 @@ extension Array: _RecordCandidateArray where Element: Encodable {
             try throwIfEncodingFailed(endResult)
         }
     }
+
+    /// Streaming variant: earlier elements may already have been flushed, so a schema
+    /// mismatch can't restart the whole array. Instead, only the mismatching element is
+    /// rewound and re-encoded as a regular object (arrays may mix both forms).
+    /// Also used for the chunks of a concurrent encode, which can't restart the others.
+    private func _encodeRecordElementsRewindingMismatches(
+        _ elements: Range<Int>,
+        to state: _BufferEncoderState,
+        codingPath: [CodingKey]
+    ) throws {
+        let arrayDepth = state.currentDepth
+        defer { state.pinnedPosition = nil }
+        for i in elements {
+            let element = self[i]
+            try state.throwIfSinkFailed()
+            var elementStart = state.rollbackPoint()
+            state.pinnedPosition = elementStart.position
+            let encoder = _BufferEncoder(
+                state: state,
+                codingPath: codingPath + [_BONJSONIndexKey(index: i)]
+            )
+            do {
+                state.ensureCapacity(11) // type byte + ULEB128
+                let result = ksbonjson_encodeToBuffer_beginRecordInstance(&state.context, state.recordDefinitionIndex)
+                try throwIfEncodingFailed(result)
+                try encoder.encodeValue(element)
+                try state.closeContainersToDepth(arrayDepth)
+            } catch is _RecordEncodingFallback {
+                // Flushing moves the pinned bytes down the buffer
+                elementStart.position = state.pinnedPosition!
+                state.rollBack(to: elementStart)
+                let schema = state.recordSchema
+                state.recordSchema = nil
+                defer { state.recordSchema = schema }
+                try encoder.encodeValue(element)
+                try state.closeContainersToDepth(arrayDepth)
+            }
+        }
+    }
+}
+
+/// The record definition a concurrent encode's chunks write their elements against.
+private struct _RecordSchema {
+    let keys: [String]
+    let definitionIndex: UInt64
+}
+
+/// Arrays whose elements can be encoded on several threads
+/// (see `BONJSONEncoder.encodesArrayElementsConcurrently`).
+private protocol _ConcurrentlyEncodableArray: _RecordCandidateArray {
+    /// Encode the elements in range into a new array in state, as record instances
+    /// of schema if there is one, leaving the array open.
+    func _encodeElements(_ elements: Range<Int>, to state: _BufferEncoderState, schema: _RecordSchema?) throws
+}
+
+extension Array: _ConcurrentlyEncodableArray where Element: Encodable {
+    fileprivate func _encodeElements(_ elements: Range<Int>, to state: _BufferEncoderState, schema: _RecordSchema?) throws {
+        state.ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_CONTAINER_BEGIN))
+        try throwIfEncodingFailed(ksbonjson_encodeToBuffer_beginArray(&state.context))
+        let arrayDepth = state.currentDepth
+
+        if let schema = schema {
+            state.recordSchema = schema.keys
+            state.recordDefinitionIndex = schema.definitionIndex
+            defer { state.recordSchema = nil }
+            try _encodeRecordElementsRewindingMismatches(elements, to: state, codingPath: [])
+            return
+        }
+        for i in elements {
+            // As an unkeyed container would, but with the element's index in the whole array
+            try state.closeContainersToDepth(arrayDepth)
+            if try state.tryBatchEncode(self[i]) { continue }
+            let encoder = _BufferEncoder(state: state, codingPath: [_BONJSONIndexKey(index: i)])
+            try encoder.encodeValue(self[i])
+        }
+        try state.closeContainersToDepth(arrayDepth)
+    }
 }
 
 /// Lightweight encoder that captures key names without encoding values.
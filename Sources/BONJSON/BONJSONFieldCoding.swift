@@ -0,0 +1,420 @@
+// ABOUTME: Field-level BONJSON conformances that encode and decode a type's fields directly,
+// ABOUTME: bypassing keyed Codable containers for hot model types.
+
+import Foundation
+import CKSBonjson
+
+/// A type that BONJSONEncoder encodes by writing its fields straight to the output,
+/// instead of going through a keyed encoding container:
+///
+///     struct Person: Codable, BONJSONFieldCodable {
+///         var name: String
+///         var age: Int
+///         var email: String?
+///
+///         static let bonjsonFields = BONJSONFieldTable(["name", "age", "email"])
+///
+///         func encodeFields(to writer: inout BONJSONFieldWriter) throws {
+///             try writer.encode(name, at: 0)
+///             try writer.encode(age, at: 1)
+///             try writer.encodeIfPresent(email, at: 2)
+///         }
+///
+///         init(fields reader: inout BONJSONFieldReader) throws {
+///             name = try reader.decode(String.self, at: 0)
+///             age = try reader.decode(Int.self, at: 1)
+///             email = try reader.decodeIfPresent(String.self, at: 2)
+///         }
+///     }
+///
+/// The output must be what the type's `Encodable` conformance would produce, because
+/// other encoders, converted keys and record arrays still use that conformance. Writing
+/// the fields in `CodingKeys` order, with `encodeIfPresent` for optionals, matches a
+/// synthesized conformance.
+public protocol BONJSONFieldEncodable: Encodable {
+    /// The type's keys, in the order its fields are written.
+    static var bonjsonFields: BONJSONFieldTable { get }
+
+    /// Write each field, referring to keys by their position in `bonjsonFields`.
+    func encodeFields(to writer: inout BONJSONFieldWriter) throws
+}
+
+/// A type that BONJSONDecoder decodes by reading its fields straight from the position
+/// map, instead of going through a keyed decoding container. See `BONJSONFieldEncodable`.
+///
+/// Fields are found fastest when they're read in the order they were encoded; fields that
+/// arrive in another order fall back to a key lookup.
+public protocol BONJSONFieldDecodable: Decodable {
+    /// The type's keys, in the order its fields are read.
+    static var bonjsonFields: BONJSONFieldTable { get }
+
+    /// Read each field, referring to keys by their position in `bonjsonFields`.
+    init(fields reader: inout BONJSONFieldReader) throws
+}
+
+public typealias BONJSONFieldCodable = BONJSONFieldEncodable & BONJSONFieldDecodable
+
+// MARK: - Field Table
+
+/// A type's keys with their UTF-8 bytes laid out once, so that writing or matching a key
+/// needs no String conversion. Create one per type and keep it in a `static let`.
+public final class BONJSONFieldTable {
+
+    /// The keys, in field order.
+    public let keys: [String]
+
+    /// Every key's UTF-8 bytes, back to back.
+    private let bytes: UnsafeMutablePointer<CChar>
+    private let offsets: [Int]
+    private let lengths: [Int]
+
+    public init(_ keys: [String]) {
+        self.keys = keys
+        var utf8 = ContiguousArray<UInt8>()
+        var offsets: [Int] = []
+        var lengths: [Int] = []
+        for key in keys {
+            offsets.append(utf8.count)
+            utf8.append(contentsOf: key.utf8)
+            lengths.append(utf8.count - offsets[offsets.count - 1])
+        }
+        // At least one byte, so that even an empty key has a valid pointer
+        self.bytes = UnsafeMutablePointer<CChar>.allocate(capacity: max(utf8.count, 1))
+        utf8.withUnsafeBytes { source in
+            UnsafeMutableRawBufferPointer(start: bytes, count: source.count).copyMemory(from: source)
+        }
+        self.offsets = offsets
+        self.lengths = lengths
+    }
+
+    deinit {
+        bytes.deallocate()
+    }
+
+    /// Number of fields.
+    public var count: Int {
+        return keys.count
+    }
+
+    @inline(__always)
+    func keyBytes(at field: Int) -> UnsafePointer<CChar> {
+        return UnsafePointer(bytes + offsets[field])
+    }
+
+    @inline(__always)
+    func keyLength(at field: Int) -> Int {
+        return lengths[field]
+    }
+
+    func codingKey(at field: Int) -> CodingKey {
+        return _StringKey(stringValue: keys[field])
+    }
+}
+
+// MARK: - Writer
+
+/// Writes a `BONJSONFieldEncodable` value's fields as the members of one object.
+/// Primitive fields go straight to the C encoder; other fields are encoded as usual.
+public struct BONJSONFieldWriter {
+    let state: _BufferEncoderState
+    let fields: BONJSONFieldTable
+    let codingPath: [CodingKey]
+
+    /// Depth of the object being written.
+    let objectDepth: Int
+
+    @inline(__always)
+    private func encodeKey(_ field: Int) throws {
+        let length = fields.keyLength(at: field)
+        state.ensureCapacity(Int(ksbonjson_maxEncodedSize_string(length)))
+        let result = ksbonjson_encodeToBuffer_string(&state.context, fields.keyBytes(at: field), length)
+        try throwIfEncodingFailed(result)
+    }
+
+    public mutating func encodeNil(at field: Int) throws {
+        try encodeKey(field)
+        state.ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_NULL))
+        try throwIfEncodingFailed(ksbonjson_encodeToBuffer_null(&state.context))
+    }
+
+    public mutating func encode(_ value: Bool, at field: Int) throws {
+        try encodeKey(field)
+        state.ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_BOOL))
+        try throwIfEncodingFailed(ksbonjson_encodeToBuffer_bool(&state.context, value))
+    }
+
+    public mutating func encode(_ value: String, at field: Int) throws {
+        try encodeKey(field)
+        var value = value
+        let utf8Count = value.utf8.count
+        state.ensureCapacity(Int(ksbonjson_maxEncodedSize_string(utf8Count)))
+        let result = value.withUTF8 { utf8 in
+            utf8.withMemoryRebound(to: CChar.self) { chars in
+                // An empty string still needs a valid pointer
+                ksbonjson_encodeToBuffer_string(&state.context, chars.baseAddress ?? fields.keyBytes(at: field), utf8Count)
+            }
+        }
+        try throwIfEncodingFailed(result)
+    }
+
+    public mutating func encode(_ value: Int, at field: Int) throws {
+        try encode(Int64(value), at: field)
+    }
+
+    public mutating func encode(_ value: Int64, at field: Int) throws {
+        try encodeKey(field)
+        state.ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_INT))
+        try throwIfEncodingFailed(ksbonjson_encodeToBuffer_int(&state.context, value))
+    }
+
+    public mutating func encode(_ value: UInt, at field: Int) throws {
+        try encode(UInt64(value), at: field)
+    }
+
+    public mutating func encode(_ value: UInt64, at field: Int) throws {
+        try encodeKey(field)
+        state.ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_INT))
+        try throwIfEncodingFailed(ksbonjson_encodeToBuffer_uint(&state.context, value))
+    }
+
+    public mutating func encode(_ value: Double, at field: Int) throws {
+        try encodeKey(field)
+        if value.isFinite {
+            state.ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_FLOAT))
+            try throwIfEncodingFailed(ksbonjson_encodeToBuffer_float(&state.context, value))
+            return
+        }
+        // The non-conforming float strategy decides
+        let encoder = _BufferEncoder(state: state, codingPath: codingPath + [fields.codingKey(at: field)])
+        try encoder.encodeFloat(value)
+    }
+
+    public mutating func encode(_ value: Float, at field: Int) throws {
+        try encode(Double(value), at: field)
+    }
+
+    /// Encodes any other value (nested objects, arrays, dates, ...) as a keyed container would.
+    public mutating func encode<T: Encodable>(_ value: T, at field: Int) throws {
+        try encodeKey(field)
+        if try !state.tryBatchEncode(value) {
+            let encoder = _BufferEncoder(state: state, codingPath: codingPath + [fields.codingKey(at: field)])
+            try encoder.encodeValue(value)
+        }
+        // Nested containers close lazily; close them before the next key
+        try state.closeContainersToDepth(objectDepth)
+    }
+
+    /// Encodes the value, or nothing at all if it's nil (as `encodeIfPresent` does).
+    public mutating func encodeIfPresent<T: Encodable>(_ value: T?, at field: Int) throws {
+        guard let value = value else { return }
+        try encode(value, at: field)
+    }
+}
+
+extension _BufferEncoderState {
+    /// Try encoding a value through its field conformance. Returns true if handled.
+    /// Converted keys need the coding path of every field, so only `.useDefaultKeys` takes this path.
+    func tryEncodeFields(_ value: BONJSONFieldEncodable, codingPath: [CodingKey]) throws -> Bool {
+        guard case .useDefaultKeys = keyEncodingStrategy else { return false }
+
+        ensureCapacity(Int(KSBONJSON_MAX_ENCODED_SIZE_CONTAINER_BEGIN))
+        try throwIfEncodingFailed(ksbonjson_encodeToBuffer_beginObject(&context))
+
+        var writer = BONJSONFieldWriter(
+            state: self,
+            fields: type(of: value).bonjsonFields,
+            codingPath: codingPath,
+            objectDepth: currentDepth
+        )
+        try value.encodeFields(to: &writer)
+        try closeContainersToDepth(writer.objectDepth - 1)
+        return true
+    }
+}
+
+// MARK: - Reader
+
+/// Reads a `BONJSONFieldDecodable` value's fields from one object in the position map.
+///
+/// The reader keeps a cursor on the object's next member: a field read in encoded order
+/// is matched against that member's key bytes and found without a search. Any other
+/// field is looked up by key (through the object's key index when it has one).
+public struct BONJSONFieldReader {
+    let state: _MapDecoderState
+    let fields: BONJSONFieldTable
+    let objectIndex: size_t
+    let lazyPath: _LazyCodingPath
+
+    /// Map index of the next member's key (objects) or value (compact records).
+    private var cursor: Int
+
+    /// Map index of the next member's key in a compact record's definition,
+    /// or -1 for an object.
+    private var recordKeyCursor: Int
+
+    /// Members after the cursor.
+    private var remaining: Int
+
+    /// The coding path of the object being read.
+    public var codingPath: [CodingKey] {
+        return lazyPath.toArray()
+    }
+
+    init(state: _MapDecoderState, objectIndex: size_t, lazyPath: _LazyCodingPath, fields: BONJSONFieldTable) throws {
+        self.state = state
+        self.fields = fields
+        self.objectIndex = objectIndex
+        self.lazyPath = lazyPath
+
+        try state.map.expandContainer(at: objectIndex)
+        guard let entry = state.map.getEntry(at: objectIndex) else {
+            throw BONJSONDecodingError.unexpectedEndOfData
+        }
+        switch entry.type {
+        case KSBONJSON_TYPE_OBJECT:
+            self.cursor = Int(entry.data.container.firstChild)
+            self.recordKeyCursor = -1
+            self.remaining = Int(entry.data.container.count) / 2
+        case KSBONJSON_TYPE_RECORD:
+            let keyIndices = state.map.recordKeyIndices(definition: Int(entry.data.record.definition))
+            self.cursor = Int(entry.data.record.firstChild)
+            self.recordKeyCursor = keyIndices.lowerBound
+            self.remaining = keyIndices.count
+        default:
+            throw BONJSONDecodingError.typeMismatch(expected: "object", actual: describeType(entry.type))
+        }
+    }
+
+    /// Map index of a field's value, or nil if the object doesn't have it.
+    @inline(__always)
+    private mutating func valueIndex(at field: Int) -> size_t? {
+        let key = fields.keyBytes(at: field)
+        let length = fields.keyLength(at: field)
+        if remaining > 0 {
+            let isRecord = recordKeyCursor >= 0
+            if state.map.keyEquals(at: isRecord ? recordKeyCursor : cursor, key, length: length) {
+                let valueIndex = isRecord ? cursor : state.map.nextSiblingIndex(cursor)
+                cursor = state.map.nextSiblingIndex(valueIndex)
+                if isRecord {
+                    recordKeyCursor += 1
+                }
+                remaining -= 1
+                return size_t(valueIndex)
+            }
+        }
+        return state.map.findKey(key, length: length, inObject: objectIndex)
+    }
+
+    @inline(__always)
+    private mutating func requireValueIndex(at field: Int) throws -> size_t {
+        guard let index = valueIndex(at: field) else {
+            let key = fields.codingKey(at: field)
+            throw DecodingError.keyNotFound(key, DecodingError.Context(
+                codingPath: codingPath,
+                debugDescription: "Key '\(key.stringValue)' not found"
+            ))
+        }
+        return index
+    }
+
+    /// A container for a primitive value. Primitive errors carry no coding path,
+    /// so the object's path is used rather than extending it.
+    @inline(__always)
+    private mutating func valueContainer(at field: Int) throws -> _MapSingleValueDecodingContainer {
+        return _MapSingleValueDecodingContainer(state: state, entryIndex: try requireValueIndex(at: field), lazyPath: lazyPath)
+    }
+
+    /// Whether the object has the field.
+    public func contains(_ field: Int) -> Bool {
+        return state.map.findKey(fields.keyBytes(at: field), length: fields.keyLength(at: field), inObject: objectIndex) != nil
+    }
+
+    /// Whether the field's value is null.
+    public mutating func decodeNil(at field: Int) throws -> Bool {
+        return try valueContainer(at: field).decodeNil()
+    }
+
+    public mutating func decode(_ type: Bool.Type, at field: Int) throws -> Bool {
+        return try valueContainer(at: field).decode(type)
+    }
+
+    public mutating func decode(_ type: String.Type, at field: Int) throws -> String {
+        return try valueContainer(at: field).decode(type)
+    }
+
+    public mutating func decode(_ type: Int.Type, at field: Int) throws -> Int {
+        return try valueContainer(at: field).decode(type)
+    }
+
+    public mutating func decode(_ type: Int64.Type, at field: Int) throws -> Int64 {
+        return try valueContainer(at: field).decode(type)
+    }
+
+    public mutating func decode(_ type: UInt.Type, at field: Int) throws -> UInt {
+        return try valueContainer(at: field).decode(type)
+    }
+
+    public mutating func decode(_ type: UInt64.Type, at field: Int) throws -> UInt64 {
+        return try valueContainer(at: field).decode(type)
+    }
+
+    public mutating func decode(_ type: Double.Type, at field: Int) throws -> Double {
+        return try valueContainer(at: field).decode(type)
+    }
+
+    public mutating func decode(_ type: Float.Type, at field: Int) throws -> Float {
+        return try valueContainer(at: field).decode(type)
+    }
+
+    /// Decodes any other value (nested objects, arrays, dates, ...) as a keyed container would.
+    public mutating func decode<T: Decodable>(_ type: T.Type, at field: Int) throws -> T {
+        let index = try requireValueIndex(at: field)
+        let path = lazyPath.appending(fields.codingKey(at: field))
+        return try _MapSingleValueDecodingContainer(state: state, entryIndex: index, lazyPath: path).decode(type)
+    }
+
+    /// Decodes the field, or returns nil if it's missing or null (as `decodeIfPresent` does).
+    public mutating func decodeIfPresent<T: Decodable>(_ type: T.Type, at field: Int) throws -> T? {
+        guard let index = valueIndex(at: field) else { return nil }
+        let entry = state.map.getEntry(at: index)
+        if entry?.type == KSBONJSON_TYPE_NULL {
+            return nil
+        }
+        let path = lazyPath.appending(fields.codingKey(at: field))
+        return try _MapSingleValueDecodingContainer(state: state, entryIndex: index, lazyPath: path).decode(type)
+    }
+
+    private func describeType(_ type: KSBONJSONValueType) -> String {
+        switch type {
+        case KSBONJSON_TYPE_NULL: return "null"
+        case KSBONJSON_TYPE_TRUE: return "true"
+        case KSBONJSON_TYPE_FALSE: return "false"
+        case KSBONJSON_TYPE_INT: return "integer"
+        case KSBONJSON_TYPE_UINT: return "unsigned integer"
+        case KSBONJSON_TYPE_FLOAT: return "float"
+        case KSBONJSON_TYPE_BIGNUMBER: return "big number"
+        case KSBONJSON_TYPE_STRING: return "string"
+        case KSBONJSON_TYPE_ARRAY, KSBONJSON_TYPE_TYPED_ARRAY: return "array"
+        case KSBONJSON_TYPE_OBJECT, KSBONJSON_TYPE_RECORD: return "object"
+        default: return "unknown"
+        }
+    }
+}
+
+extension _MapDecoder {
+    /// Decode the value through its field conformance, or return nil if the type
+    /// doesn't have one (or the decoder's strategies rule the reader out).
+    @inline(__always)
+    func decodeFields<T>(_ type: T.Type) throws -> T? {
+        guard state.decodesFieldsDirectly, let fieldType = type as? BONJSONFieldDecodable.Type else {
+            return nil
+        }
+        var reader = try BONJSONFieldReader(
+            state: state,
+            objectIndex: entryIndex,
+            lazyPath: lazyPath,
+            fields: fieldType.bonjsonFields
+        )
+        return try fieldType.init(fields: &reader) as? T
+    }
+}
@@ -0,0 +1,67 @@
+// ABOUTME: Pre-encoded BONJSON values that BONJSONEncoder splices into its output as-is.
+// ABOUTME: Lets cached sub-documents be reused without re-encoding them through Codable.
+
+import Foundation
+import CKSBonjson
+
+/// A BONJSON value that is already encoded. `BONJSONEncoder` copies its bytes straight
+/// into the output wherever the fragment is encoded, instead of encoding a value:
+///
+///     let profile = try BONJSONFragment(encoding: user.profile)   // once, then cached
+///
+///     struct Response: Encodable {
+///         var requestID: Int
+///         var profile: BONJSONFragment
+///     }
+///     let data = try encoder.encode(Response(requestID: 7, profile: profile))
+///
+/// The output decodes exactly as if the original value had been encoded in place, and
+/// the fragment's nesting counts towards the encoder's `maxDepth` where it is spliced.
+/// A fragment holds one complete value without records, since record instances refer
+/// to definitions at the start of the document they were encoded in.
+///
+/// Only `BONJSONEncoder` can encode a fragment; other encoders throw.
+public struct BONJSONFragment: Encodable, Equatable {
+
+    /// The encoded value.
+    public let bytes: Data
+
+    /// How deeply the value's containers nest, which counts towards the depth limit of
+    /// the encoder it is spliced into.
+    let depth: Int
+
+    /// Wraps the encoding of a single BONJSON value, such as one produced by
+    /// `BONJSONEncoder.encode(_:)` for a value that wasn't written as records.
+    ///
+    /// - Parameters:
+    ///   - bytes: The encoded value.
+    ///   - decoder: The decoder whose limits and strategies the bytes are checked with.
+    /// - Throws: An error if the bytes aren't one complete value, or contain records.
+    public init(bytes: Data, decoder: BONJSONDecoder = BONJSONDecoder()) throws {
+        // TYPE_RECORD_DEF (0xB9)
+        if bytes.first == 0xB9 {
+            throw BONJSONDecodingError.scanFailed("A fragment can't contain record definitions")
+        }
+        self.depth = try decoder.validate(bytes)
+        self.bytes = bytes
+    }
+
+    /// Encodes `value` into a fragment. Arrays of objects are never written as records.
+    ///
+    /// - Parameters:
+    ///   - value: The value to encode.
+    ///   - encoder: The encoder whose strategies and limits to use.
+    /// - Throws: An error if encoding fails.
+    public init<T: Encodable>(encoding value: T, with encoder: BONJSONEncoder = BONJSONEncoder()) throws {
+        self.bytes = try encoder.encodeFragment(value)
+        self.depth = try _PositionMap.nestingDepth(ofEncoded: bytes)
+    }
+
+    public func encode(to encoder: Encoder) throws {
+        // BONJSONEncoder intercepts fragments before reaching here
+        throw EncodingError.invalidValue(self, EncodingError.Context(
+            codingPath: encoder.codingPath,
+            debugDescription: "BONJSONFragment can only be encoded by BONJSONEncoder"
+        ))
+    }
+}
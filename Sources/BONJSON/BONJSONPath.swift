@@ -0,0 +1,280 @@
+// ABOUTME: Path queries that read selected values from a BONJSON document without Codable.
+// ABOUTME: Paths compile to the C path API and run over a lazily scanned position map.
+
+import Foundation
+import CKSBonjson
+
+/// A compiled path expression that selects values in a BONJSON document:
+///
+///     $.user.id          member "id" of member "user"
+///     $.items[0]         first element of the "items" array
+///     $.items[*].price   member "price" of every element of "items"
+///     $["key.with.dots"] a member whose name needs quoting ('...' works too)
+///     $.config.*         every member value of an object
+///
+/// The leading `$` is optional, and quoted names have no escapes. Names containing
+/// whitespace, quotes, brackets or `*` must be quoted. Compile a path once and use it
+/// with any number of documents.
+public struct BONJSONPath: CustomStringConvertible {
+
+    /// The expression the path was compiled from.
+    public let expression: String
+
+    public var description: String {
+        return expression
+    }
+
+    /// The expression's bytes, which the compiled steps refer to by offset.
+    private let bytes: ContiguousArray<CChar>
+
+    private let compiled: KSBONJSONPath
+
+    /// Compiles a path expression.
+    /// - Throws: `BONJSONDecodingError.invalidPath` if the expression is malformed.
+    public init(_ expression: String) throws {
+        let bytes = ContiguousArray(expression.utf8.map { CChar(bitPattern: $0) })
+        var compiled = KSBONJSONPath()
+        let isValid = bytes.withUnsafeBufferPointer { chars in
+            ksbonjson_path_compile(&compiled, chars.baseAddress, chars.count)
+        }
+        guard isValid else {
+            throw BONJSONDecodingError.invalidPath(expression)
+        }
+        self.expression = expression
+        self.bytes = bytes
+        self.compiled = compiled
+    }
+
+    /// Run `body` with the compiled path, its expression pointer set to this path's bytes.
+    func withCompiledPath<R>(_ body: (UnsafePointer<KSBONJSONPath>) -> R) -> R {
+        var path = compiled
+        return bytes.withUnsafeBufferPointer { chars in
+            path.expression = chars.baseAddress
+            return withUnsafePointer(to: &path) { body($0) }
+        }
+    }
+}
+
+/// A BONJSON document that reads values by path, without decoding the rest of it.
+///
+/// The document is mapped lazily: a query scans only the containers its path passes
+/// through, and later queries reuse what earlier ones scanned. For a handful of fields
+/// from a large document this avoids building the Codable containers, coding paths and
+/// key caches that a full decode would:
+///
+///     let document = try BONJSONDocument(data: data)
+///     let userID = try document.int64(at: BONJSONPath("$.user.id"))
+///     let prices = try document.doubles(at: BONJSONPath("$.items[*].price"))
+///
+/// The decoder's limits and string strategies apply. A document is not thread-safe,
+/// because queries expand the map.
+public final class BONJSONDocument {
+
+    /// The decoder whose settings the document was mapped with.
+    public let decoder: BONJSONDecoder
+
+    private let map: _PositionMap
+
+    /// Maps a document. Structural errors anywhere in the document are reported here;
+    /// errors inside a container's contents are reported by the first query that scans it.
+    public init(data: Data, decoder: BONJSONDecoder = BONJSONDecoder()) throws {
+        self.decoder = decoder
+        self.map = try decoder.makeQueryMap(from: data)
+    }
+
+    /// Opens a BONJSON file from an index written by `BONJSONDecoder.writeIndex(forContentsOf:to:)`,
+    /// without scanning it. Both files stay memory-mapped for the life of the document.
+    ///
+    /// Throws `BONJSONDecodingError.indexMismatch` if the index was written for another
+    /// file or with other decoder settings (see `BONJSONDecoder.decode(_:contentsOf:index:)`).
+    public init(contentsOf url: URL, index indexURL: URL, decoder: BONJSONDecoder = BONJSONDecoder()) throws {
+        self.decoder = decoder
+        self.map = try decoder.makeIndexedMap(contentsOf: url, index: indexURL)
+        if decoder.unicodeNormalizationStrategy == .nfc && decoder.duplicateKeyDecodingStrategy == .reject {
+            try map.validateNFCDuplicateKeys()
+        }
+    }
+
+    // MARK: - Matching
+
+    /// Whether the path selects anything.
+    public func contains(_ path: BONJSONPath) throws -> Bool {
+        return try firstIndex(of: path) != nil
+    }
+
+    /// Number of values the path selects.
+    public func count(of path: BONJSONPath) throws -> Int {
+        return try evaluate(path, ksbonjson_path_findAll, into: nil, maxCount: 0)
+    }
+
+    // MARK: - Single Values
+
+    /// The first selected value as an integer, or nil if nothing is selected or the
+    /// value isn't an integer that fits in Int64.
+    public func int64(at path: BONJSONPath) throws -> Int64? {
+        guard let entry = try firstEntry(of: path) else { return nil }
+        switch entry.type {
+        case KSBONJSON_TYPE_INT:
+            return entry.data.intValue
+        case KSBONJSON_TYPE_UINT:
+            return Int64(exactly: entry.data.uintValue)
+        default:
+            return nil
+        }
+    }
+
+    /// The first selected value as an unsigned integer, or nil if nothing is selected
+    /// or the value isn't a non-negative integer.
+    public func uint64(at path: BONJSONPath) throws -> UInt64? {
+        guard let entry = try firstEntry(of: path) else { return nil }
+        switch entry.type {
+        case KSBONJSON_TYPE_UINT:
+            return entry.data.uintValue
+        case KSBONJSON_TYPE_INT:
+            return UInt64(exactly: entry.data.intValue)
+        default:
+            return nil
+        }
+    }
+
+    /// The first selected value as a double, or nil if nothing is selected or the
+    /// value isn't a number.
+    public func double(at path: BONJSONPath) throws -> Double? {
+        guard let index = try firstIndex(of: path), let entry = map.getEntry(at: index) else { return nil }
+        switch entry.type {
+        case KSBONJSON_TYPE_FLOAT:
+            return entry.data.floatValue
+        case KSBONJSON_TYPE_INT:
+            return Double(entry.data.intValue)
+        case KSBONJSON_TYPE_UINT:
+            return Double(entry.data.uintValue)
+        case KSBONJSON_TYPE_BIGNUMBER:
+            return try decoder.decode(Double.self, from: map, at: index)
+        default:
+            return nil
+        }
+    }
+
+    /// The first selected value as a boolean, or nil if nothing is selected or the
+    /// value isn't a boolean.
+    public func bool(at path: BONJSONPath) throws -> Bool? {
+        guard let entry = try firstEntry(of: path) else { return nil }
+        switch entry.type {
+        case KSBONJSON_TYPE_TRUE:
+            return true
+        case KSBONJSON_TYPE_FALSE:
+            return false
+        default:
+            return nil
+        }
+    }
+
+    /// The first selected value as a string, or nil if nothing is selected or the
+    /// value isn't a string.
+    public func string(at path: BONJSONPath) throws -> String? {
+        guard let index = try firstIndex(of: path) else { return nil }
+        return map.getString(at: index)
+    }
+
+    /// Decodes the first selected value, or returns nil if nothing is selected.
+    public func decode<T: Decodable>(_ type: T.Type, at path: BONJSONPath) throws -> T? {
+        guard let index = try firstIndex(of: path) else { return nil }
+        return try decoder.decode(type, from: map, at: index)
+    }
+
+    // MARK: - All Values
+
+    /// Every selected value converted to Int64, as batch array decoding converts
+    /// elements: floats truncate, booleans become 0 or 1, and other values become 0.
+    public func int64s(at path: BONJSONPath) throws -> [Int64] {
+        return try evaluateAll(path, ksbonjson_path_decodeInt64s, zero: 0)
+    }
+
+    /// Every selected value converted to UInt64, as batch array decoding converts elements.
+    public func uint64s(at path: BONJSONPath) throws -> [UInt64] {
+        return try evaluateAll(path, ksbonjson_path_decodeUInt64s, zero: 0)
+    }
+
+    /// Every selected value converted to Double, as batch array decoding converts elements.
+    public func doubles(at path: BONJSONPath) throws -> [Double] {
+        return try evaluateAll(path, ksbonjson_path_decodeDoubles, zero: 0)
+    }
+
+    /// Every selected value converted to Bool, as batch array decoding converts elements:
+    /// numbers are true when non-zero, and other values are false.
+    public func bools(at path: BONJSONPath) throws -> [Bool] {
+        return try evaluateAll(path, ksbonjson_path_decodeBools, zero: false)
+    }
+
+    /// Every selected value as a string. Values that aren't strings become empty strings.
+    public func strings(at path: BONJSONPath) throws -> [String] {
+        return try indices(of: path).map { map.getString(at: $0) ?? "" }
+    }
+
+    /// Decodes every selected value.
+    public func decodeAll<T: Decodable>(_ type: T.Type, at path: BONJSONPath) throws -> [T] {
+        return try indices(of: path).map { try decoder.decode(type, from: map, at: $0) }
+    }
+
+    // MARK: - Evaluation
+
+    private typealias PathFunction<Element> = (
+        UnsafeMutablePointer<KSBONJSONMapContext>?, UnsafePointer<KSBONJSONPath>?, Int,
+        UnsafeMutablePointer<Element>?, Int, UnsafeMutablePointer<ksbonjson_decodeStatus>?) -> Int
+
+    /// Run a C path function, storing up to maxCount results. Returns the match count.
+    /// - Throws: An error if a container on the path turns out to be malformed when scanned.
+    private func evaluate<Element>(
+        _ path: BONJSONPath,
+        _ function: PathFunction<Element>,
+        into buffer: UnsafeMutablePointer<Element>?,
+        maxCount: Int
+    ) throws -> Int {
+        let rootIndex = map.rootIndex
+        var status = KSBONJSON_DECODE_OK
+        let count = map.withContext { context in
+            path.withCompiledPath { compiled in
+                function(context, compiled, rootIndex, buffer, maxCount, &status)
+            }
+        }
+        guard status == KSBONJSON_DECODE_OK else {
+            throw _PositionMap.scanError(for: status)
+        }
+        return count
+    }
+
+    private func evaluateAll<Element>(_ path: BONJSONPath, _ function: PathFunction<Element>, zero: Element) throws -> [Element] {
+        let count = try evaluate(path, function, into: nil, maxCount: 0)
+        guard count > 0 else { return [] }
+        var result = [Element](repeating: zero, count: count)
+        _ = try result.withUnsafeMutableBufferPointer { buffer in
+            try evaluate(path, function, into: buffer.baseAddress, maxCount: count)
+        }
+        return result
+    }
+
+    private func indices(of path: BONJSONPath) throws -> [Int] {
+        return try evaluateAll(path, ksbonjson_path_findAll, zero: 0)
+    }
+
+    private func firstIndex(of path: BONJSONPath) throws -> size_t? {
+        let rootIndex = map.rootIndex
+        var status = KSBONJSON_DECODE_OK
+        let index = map.withContext { context in
+            path.withCompiledPath { compiled in
+                ksbonjson_path_find(context, compiled, rootIndex, &status)
+            }
+        }
+        guard status == KSBONJSON_DECODE_OK else {
+            throw _PositionMap.scanError(for: status)
+        }
+        // Not found is SIZE_MAX, which arrives here as a negative Int
+        guard index >= 0 && index < map.count else { return nil }
+        return index
+    }
+
+    private func firstEntry(of path: BONJSONPath) throws -> KSBONJSONMapEntry? {
+        guard let index = try firstIndex(of: path) else { return nil }
+        return map.getEntry(at: index)
+    }
+}
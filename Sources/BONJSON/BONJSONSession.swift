@@ -0,0 +1,117 @@
+// ABOUTME: Reusable storage for repeated BONJSON encodes and decodes.
+// ABOUTME: Keeps the encode buffer and position map allocations alive between calls.
+
+import Foundation
+import CKSBonjson
+
+/// Storage that `BONJSONEncoder` and `BONJSONDecoder` reuse across calls instead
+/// of allocating it afresh each time.
+///
+/// Each encode normally starts from a small buffer and regrows it, and each decode
+/// allocates a new position map (entry buffer, sibling index, string cache and input
+/// copy). A session keeps those allocations after a call finishes and resets them for
+/// the next one, which pays off for many small documents:
+///
+///     let session = BONJSONSession()
+///     for request in requests {
+///         let message = try decoder.decode(Request.self, from: request, using: session)
+///         let reply = try encoder.encode(handle(message), using: session)
+///     }
+///
+/// A session is not thread-safe. Use one per thread (or check sessions out of a pool).
+/// If a session is already in use by an unfinished call (for example a nested decode
+/// inside `init(from:)`), the inner call simply allocates its own storage.
+public final class BONJSONSession {
+
+    /// Allocations larger than this (in bytes) are released after the call rather than
+    /// kept, so that one unusually large document doesn't pin its memory indefinitely.
+    /// Default is 1 MB.
+    public var maxRetainedBytes: Int
+
+    /// Creates an empty session. Storage is allocated by the first call that uses it.
+    public init(maxRetainedBytes: Int = 1 << 20) {
+        self.maxRetainedBytes = maxRetainedBytes
+    }
+
+    deinit {
+        if var storage = mapStorage {
+            storage.release()
+        }
+    }
+
+    // MARK: - Encoder Storage
+
+    private var encodeBuffer: ContiguousArray<UInt8>?
+
+    /// Take the retained encode buffer, if any.
+    func takeEncodeBuffer() -> ContiguousArray<UInt8>? {
+        defer { encodeBuffer = nil }
+        return encodeBuffer
+    }
+
+    /// Keep an encode buffer for the next call.
+    func recycle(encodeBuffer buffer: ContiguousArray<UInt8>) {
+        guard buffer.count <= maxRetainedBytes else { return }
+        encodeBuffer = buffer
+    }
+
+    // MARK: - Decoder Storage
+
+    private var mapStorage: _PositionMapStorage?
+
+    /// Take the retained position map storage, if any.
+    func takeMapStorage() -> _PositionMapStorage? {
+        defer { mapStorage = nil }
+        return mapStorage
+    }
+
+    /// Keep position map storage for the next call, or release it if it's too large
+    /// or the session already holds some.
+    func recycle(mapStorage storage: _PositionMapStorage) {
+        var storage = storage
+        guard mapStorage == nil, storage.retainedBytes <= maxRetainedBytes else {
+            storage.release()
+            return
+        }
+        storage.keyStrings.removeAll(keepingCapacity: true)
+        mapStorage = storage
+    }
+}
+
+/// The allocations behind a `_PositionMap` that a session carries between decodes.
+struct _PositionMapStorage {
+    /// A growable map context whose entry buffer, key index and key interning tables are kept.
+    var context: UnsafeMutablePointer<KSBONJSONMapContext>
+
+    /// Sibling index storage (contents are rebuilt per map).
+    var nextSibling: ContiguousArray<Int>
+
+    /// Interned key string storage (emptied, keeping capacity, between maps).
+    var keyStrings: ContiguousArray<String?>
+
+    /// Buffer for the copy that `decode(_:from: Data)` makes of its input.
+    var input: UnsafeMutableBufferPointer<UInt8>?
+
+    /// Approximate size of the retained allocations.
+    var retainedBytes: Int {
+        return MemoryLayout<KSBONJSONMapContext>.stride +
+               Int(context.pointee.entriesCapacity) * MemoryLayout<KSBONJSONMapEntry>.stride +
+               Int(context.pointee.keyIndexSlotsCapacity) * MemoryLayout<UInt32>.stride +
+               Int(context.pointee.keyIndexRefsCapacity) * MemoryLayout<KSBONJSONKeyIndexRef>.stride +
+               Int(context.pointee.keyIdsCapacity) * MemoryLayout<UInt32>.stride +
+               Int(context.pointee.internedKeyCapacity) * MemoryLayout<KSBONJSONInternedKey>.stride +
+               Int(context.pointee.internSlotsCapacity) * MemoryLayout<UInt32>.stride +
+               Int(context.pointee.keySetCapacity) * MemoryLayout<UInt32>.stride +
+               keyStrings.capacity * MemoryLayout<String?>.stride +
+               nextSibling.capacity * MemoryLayout<Int>.stride +
+               (input?.count ?? 0)
+    }
+
+    /// Free the C and input allocations.
+    mutating func release() {
+        ksbonjson_map_freeEntries(context)
+        context.deallocate()
+        input?.deallocate()
+        input = nil
+    }
+}
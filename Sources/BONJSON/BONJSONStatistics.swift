@@ -0,0 +1,199 @@
+// ABOUTME: Counters and phase timings reported by the statistics handlers of BONJSONEncoder and BONJSONDecoder.
+// ABOUTME: They wrap the C scan and encode stats, which only exist in builds made with BONJSON_STATS set.
+
+import Foundation
+import CKSBonjson
+
+extension BONJSONDecoder {
+    /// What decoding one document did, for finding out why it is slow.
+    ///
+    /// Reported to `statisticsHandler`. The timings are zero unless
+    /// `statisticsIncludeTimings` is set.
+    public struct Statistics {
+        /// Values mapped, by type. Keys and the values inside records are included.
+        public var nullCount = 0
+        public var booleanCount = 0
+        public var integerCount = 0
+        public var floatCount = 0
+        public var bigNumberCount = 0
+        public var stringCount = 0
+        public var arrayCount = 0
+        public var objectCount = 0
+
+        /// Typed arrays kept as a single span of input bytes (until expanded).
+        public var typedArrayCount = 0
+
+        /// Record instances mapped as compact records (values only).
+        public var compactRecordCount = 0
+
+        /// Strings with the length in the type code, and their total length in bytes.
+        public var shortStringCount = 0
+        public var shortStringBytes = 0
+
+        /// Strings terminated by 0xFF, and their total length in bytes.
+        public var longStringCount = 0
+        public var longStringBytes = 0
+
+        /// Strings accepted by the fast (SIMD or all-ASCII) UTF-8 check.
+        public var fastValidationCount = 0
+        public var fastValidationBytes = 0
+
+        /// Strings that needed the byte-by-byte UTF-8 validator.
+        public var slowValidationCount = 0
+        public var slowValidationBytes = 0
+
+        /// Key comparisons made while checking for duplicate keys.
+        public var duplicateKeyComparisons = 0
+
+        /// Deepest container nesting reached.
+        public var maxDepth = 0
+
+        /// Record instances whose values were scanned.
+        public var recordInstanceCount = 0
+
+        /// Containers scanned on first access (lazy mapping only).
+        public var expansionCount = 0
+
+        /// Times the position map's entry buffer had to grow.
+        public var entryBufferGrowths = 0
+
+        /// Time spent scanning the document up front, and expanding lazily mapped containers.
+        /// A scan split across threads (`MappingStrategy.parallel`) isn't timed.
+        public var scanNanoseconds: UInt64 = 0
+        public var expandNanoseconds: UInt64 = 0
+
+        /// Time spent building the decoded value once the document was mapped
+        /// (including any lazy expansion).
+        public var decodeNanoseconds: UInt64 = 0
+
+        init(_ stats: KSBONJSONMapStats, decodeNanoseconds: UInt64) {
+            withUnsafeBytes(of: stats.valueCounts) { raw in
+                let counts = raw.bindMemory(to: Int.self)
+                nullCount = counts[Int(KSBONJSON_TYPE_NULL.rawValue)]
+                booleanCount = counts[Int(KSBONJSON_TYPE_FALSE.rawValue)] + counts[Int(KSBONJSON_TYPE_TRUE.rawValue)]
+                integerCount = counts[Int(KSBONJSON_TYPE_INT.rawValue)] + counts[Int(KSBONJSON_TYPE_UINT.rawValue)]
+                floatCount = counts[Int(KSBONJSON_TYPE_FLOAT.rawValue)]
+                bigNumberCount = counts[Int(KSBONJSON_TYPE_BIGNUMBER.rawValue)]
+                stringCount = counts[Int(KSBONJSON_TYPE_STRING.rawValue)]
+                arrayCount = counts[Int(KSBONJSON_TYPE_ARRAY.rawValue)]
+                objectCount = counts[Int(KSBONJSON_TYPE_OBJECT.rawValue)]
+                typedArrayCount = counts[Int(KSBONJSON_TYPE_TYPED_ARRAY.rawValue)]
+                compactRecordCount = counts[Int(KSBONJSON_TYPE_RECORD.rawValue)]
+            }
+            shortStringCount = stats.shortStringCount
+            shortStringBytes = stats.shortStringBytes
+            longStringCount = stats.longStringCount
+            longStringBytes = stats.longStringBytes
+            fastValidationCount = stats.fastValidationCount
+            fastValidationBytes = stats.fastValidationBytes
+            slowValidationCount = stats.slowValidationCount
+            slowValidationBytes = stats.slowValidationBytes
+            duplicateKeyComparisons = stats.duplicateKeyComparisons
+            maxDepth = stats.maxDepth
+            recordInstanceCount = stats.recordInstanceCount
+            expansionCount = stats.expansionCount
+            entryBufferGrowths = stats.entryBufferGrowths
+            scanNanoseconds = stats.scanNanoseconds
+            expandNanoseconds = stats.expandNanoseconds
+            self.decodeNanoseconds = decodeNanoseconds
+        }
+    }
+}
+
+extension BONJSONEncoder {
+    /// What encoding one document did, for finding out why it is slow.
+    ///
+    /// Reported to `statisticsHandler`. Values are counted as they were written
+    /// (a whole-number float written as an integer counts as an integer), including
+    /// any written while trying a record layout that was then abandoned.
+    public struct Statistics {
+        /// Values written one at a time, by type.
+        public var nullCount = 0
+        public var booleanCount = 0
+        public var integerCount = 0
+        public var floatCount = 0
+        public var bigNumberCount = 0
+
+        /// Strings (keys included) with the length in the type code, and their total length in bytes.
+        public var shortStringCount = 0
+        public var shortStringBytes = 0
+
+        /// Strings terminated by 0xFF, and their total length in bytes.
+        public var longStringCount = 0
+        public var longStringBytes = 0
+
+        /// Containers opened.
+        public var arrayCount = 0
+        public var objectCount = 0
+        public var recordInstanceCount = 0
+
+        /// Arrays and record columns written in one batch call, and the values they held.
+        public var batchCount = 0
+        public var batchValueCount = 0
+
+        /// Pre-encoded `BONJSONFragment`s spliced in, and their total length in bytes.
+        public var fragmentCount = 0
+        public var fragmentBytes = 0
+
+        /// Deepest container nesting reached.
+        public var maxDepth = 0
+
+        /// Chunks handed to the sink while streaming.
+        public var flushCount = 0
+
+        /// Times the encode buffer had to grow.
+        public var bufferGrowths = 0
+
+        /// Time spent encoding the document, zero unless `statisticsIncludeTimings` is set.
+        public var encodeNanoseconds: UInt64 = 0
+
+        init(_ stats: KSBONJSONEncodeStats, encodeNanoseconds: UInt64) {
+            nullCount = stats.nullCount
+            booleanCount = stats.boolCount
+            integerCount = stats.intCount
+            floatCount = stats.floatCount
+            bigNumberCount = stats.bigNumberCount
+            shortStringCount = stats.shortStringCount
+            shortStringBytes = stats.shortStringBytes
+            longStringCount = stats.longStringCount
+            longStringBytes = stats.longStringBytes
+            arrayCount = stats.arrayCount
+            objectCount = stats.objectCount
+            recordInstanceCount = stats.recordInstanceCount
+            batchCount = stats.batchCount
+            batchValueCount = stats.batchValueCount
+            fragmentCount = stats.fragmentCount
+            fragmentBytes = stats.fragmentBytes
+            maxDepth = stats.maxDepth
+            flushCount = stats.flushCount
+            bufferGrowths = stats.bufferGrowths
+            self.encodeNanoseconds = encodeNanoseconds
+        }
+    }
+}
+
+extension KSBONJSONEncodeStats {
+    /// Add the counts of an encoder that wrote part of the same document
+    /// (a chunk of a concurrently encoded array).
+    mutating func add(_ other: KSBONJSONEncodeStats) {
+        nullCount += other.nullCount
+        boolCount += other.boolCount
+        intCount += other.intCount
+        floatCount += other.floatCount
+        bigNumberCount += other.bigNumberCount
+        shortStringCount += other.shortStringCount
+        shortStringBytes += other.shortStringBytes
+        longStringCount += other.longStringCount
+        longStringBytes += other.longStringBytes
+        arrayCount += other.arrayCount
+        objectCount += other.objectCount
+        recordInstanceCount += other.recordInstanceCount
+        batchCount += other.batchCount
+        batchValueCount += other.batchValueCount
+        fragmentCount += other.fragmentCount
+        fragmentBytes += other.fragmentBytes
+        maxDepth = Swift.max(maxDepth, other.maxDepth)
+        flushCount += other.flushCount
+        bufferGrowths += other.bufferGrowths
+    }
+}
@@ -0,0 +1,225 @@
+// ABOUTME: Streaming conversion between JSON text and BONJSON, without building Swift values in between.
+// ABOUTME: Wraps the C transcoder, which takes input in chunks and hands output to a sink in chunks.
+
+import Foundation
+import CKSBonjson
+
+/// Converts JSON documents to BONJSON and back without decoding them into values.
+///
+/// Both directions stream: input is read a chunk at a time and output is handed over as
+/// it is produced, so memory use stays flat however large the document is:
+///
+///     let transcoder = BONJSONTranscoder()
+///     let bonjson = try transcoder.bonjson(fromJSON: jsonData)
+///     let json = try transcoder.json(fromBONJSON: bonjson)
+///
+/// JSON numbers written as integers stay integers (as big numbers if they don't fit in
+/// 64 bits); all others become floats. Arrays of numbers become typed arrays and a root
+/// array of objects with the same keys becomes record instances, unless turned off. The
+/// JSON written is compact, with floats in their shortest round-trip form.
+///
+/// Malformed input and exceeded limits throw `BONJSONDecodingError`. A transcoder can
+/// be reused, but is not thread-safe.
+public final class BONJSONTranscoder {
+
+    /// Whether non-empty arrays of numbers are written as typed arrays.
+    public var usesTypedArrays: Bool = true
+
+    /// Whether a root array whose elements are objects with the same keys (in the same
+    /// order) is written as record instances of one definition.
+    public var usesRecords: Bool = true
+
+    /// Whether JSON strings containing NUL characters are rejected.
+    public var rejectsNUL: Bool = true
+
+    /// Whether JSON strings containing invalid UTF-8 (or unpaired surrogate escapes)
+    /// are rejected. BONJSON to JSON always rejects invalid UTF-8.
+    public var rejectsInvalidUTF8: Bool = true
+
+    /// Whether anything but whitespace after the JSON document is rejected.
+    public var rejectsTrailingBytes: Bool = true
+
+    /// Limits applied to JSON input, as `BONJSONDecoder` applies them to BONJSON input.
+    public var maxDepth: Int = 512
+    public var maxStringLength: Int = 10_000_000
+    public var maxContainerSize: Int = 1_000_000
+    public var maxDocumentSize: Int = 2_000_000_000
+
+    /// How much is read from an input stream at a time.
+    public var readChunkSize: Int = 65_536
+
+    public init() {}
+
+    // MARK: - JSON to BONJSON
+
+    /// Converts a JSON document to BONJSON.
+    public func bonjson(fromJSON json: Data) throws -> Data {
+        var output = Data()
+        try convertJSON(json) { output.append(contentsOf: $0) }
+        return output
+    }
+
+    /// Converts a JSON document, handing the BONJSON to `sink` in chunks as it is produced.
+    ///
+    /// Each chunk is only valid for the duration of the call. If the sink throws,
+    /// conversion stops and the error is rethrown.
+    public func convertJSON(_ json: Data, to sink: (UnsafeRawBufferPointer) throws -> Void) throws {
+        try transcodeJSON(to: sink) { feed in
+            try json.withUnsafeBytes { _ = try feed($0) }
+        }
+    }
+
+    /// Converts a JSON document read from an open input stream, writing the BONJSON to an
+    /// open output stream.
+    public func convertJSON(from input: InputStream, to output: OutputStream) throws {
+        try transcodeJSON(to: { try output.writeAll($0) }) { feed in
+            try readChunks(from: input, feed)
+        }
+    }
+
+    // MARK: - BONJSON to JSON
+
+    /// Converts a BONJSON document to JSON.
+    public func json(fromBONJSON bonjson: Data) throws -> Data {
+        var output = Data()
+        try convertBONJSON(bonjson) { output.append(contentsOf: $0) }
+        return output
+    }
+
+    /// Converts a BONJSON document, handing the JSON to `sink` in chunks as it is produced.
+    ///
+    /// Each chunk is only valid for the duration of the call. If the sink throws,
+    /// conversion stops and the error is rethrown.
+    public func convertBONJSON(_ bonjson: Data, to sink: (UnsafeRawBufferPointer) throws -> Void) throws {
+        try transcodeBONJSON(to: sink) { feed in
+            try bonjson.withUnsafeBytes { _ = try feed($0) }
+        }
+    }
+
+    /// Converts a BONJSON document read from an open input stream, writing the JSON to an
+    /// open output stream.
+    public func convertBONJSON(from input: InputStream, to output: OutputStream) throws {
+        try transcodeBONJSON(to: { try output.writeAll($0) }) { feed in
+            try readChunks(from: input, feed)
+        }
+    }
+
+    // MARK: - Implementation
+
+    /// Feeds a chunk of input to the converter, returning false once it has failed.
+    private typealias Feed = (UnsafeRawBufferPointer) throws -> Bool
+
+    private func transcodeJSON(to sink: (UnsafeRawBufferPointer) throws -> Void,
+                               input: (Feed) throws -> Void) throws {
+        try withoutActuallyEscaping(sink) { sink in
+            let output = _TranscoderOutput(sink)
+            let context = UnsafeMutablePointer<KSBONJSONFromJSONContext>.allocate(capacity: 1)
+            defer { context.deallocate() }
+
+            let status: ksbonjson_decodeStatus = try withExtendedLifetime(output) {
+                ksbonjson_fromJSON_begin(context, makeDecodeFlags(), _TranscoderOutput.callback,
+                                         Unmanaged.passUnretained(output).toOpaque())
+                ksbonjson_fromJSON_setUseTypedArrays(context, usesTypedArrays)
+                ksbonjson_fromJSON_setUseRecords(context, usesRecords)
+                do {
+                    try input { chunk in
+                        guard chunk.count > 0 else { return true }
+                        let bytes = chunk.baseAddress!.assumingMemoryBound(to: UInt8.self)
+                        return ksbonjson_fromJSON_feed(context, bytes, chunk.count) == KSBONJSON_DECODE_OK
+                    }
+                } catch {
+                    // The context's buffers are only released by end
+                    _ = ksbonjson_fromJSON_end(context)
+                    throw error
+                }
+                return ksbonjson_fromJSON_end(context)
+            }
+            try output.throwIfFailed()
+            guard status == KSBONJSON_DECODE_OK else {
+                throw _PositionMap.scanError(for: status)
+            }
+        }
+    }
+
+    private func transcodeBONJSON(to sink: (UnsafeRawBufferPointer) throws -> Void,
+                                  input: (Feed) throws -> Void) throws {
+        try withoutActuallyEscaping(sink) { sink in
+            let output = _TranscoderOutput(sink)
+            // The decoder keeps pointers into the context, so it mustn't move
+            let context = UnsafeMutablePointer<KSBONJSONToJSONContext>.allocate(capacity: 1)
+            defer { context.deallocate() }
+
+            let status: ksbonjson_decodeStatus = try withExtendedLifetime(output) {
+                ksbonjson_toJSON_begin(context, _TranscoderOutput.callback, Unmanaged.passUnretained(output).toOpaque())
+                do {
+                    try input { chunk in
+                        guard chunk.count > 0 else { return true }
+                        let bytes = chunk.baseAddress!.assumingMemoryBound(to: UInt8.self)
+                        return ksbonjson_toJSON_feed(context, bytes, chunk.count) == KSBONJSON_DECODE_OK
+                    }
+                } catch {
+                    _ = ksbonjson_toJSON_end(context)
+                    throw error
+                }
+                return ksbonjson_toJSON_end(context)
+            }
+            try output.throwIfFailed()
+            guard status == KSBONJSON_DECODE_OK else {
+                throw _PositionMap.scanError(for: status)
+            }
+        }
+    }
+
+    private func readChunks(from stream: InputStream, _ feed: Feed) throws {
+        var buffer = [UInt8](repeating: 0, count: max(readChunkSize, 1))
+        while true {
+            let count = buffer.withUnsafeMutableBufferPointer { stream.read($0.baseAddress!, maxLength: $0.count) }
+            guard count >= 0 else {
+                throw stream.streamError ?? BONJSONDecodingError.scanFailed("Input stream could not be read")
+            }
+            guard count > 0 else { return }
+            let proceed = try buffer.withUnsafeBytes { try feed(UnsafeRawBufferPointer(rebasing: $0[0..<count])) }
+            guard proceed else { return }
+        }
+    }
+
+    private func makeDecodeFlags() -> KSBONJSONDecodeFlags {
+        var flags = ksbonjson_defaultDecodeFlags()
+        flags.rejectNUL = rejectsNUL
+        flags.rejectInvalidUTF8 = rejectsInvalidUTF8
+        flags.rejectTrailingBytes = rejectsTrailingBytes
+        flags.maxDepth = maxDepth
+        flags.maxStringLength = maxStringLength
+        flags.maxContainerSize = maxContainerSize
+        flags.maxDocumentSize = maxDocumentSize
+        return flags
+    }
+}
+
+/// Hands the C transcoder's output to a Swift sink. A sink error stops the conversion
+/// and is kept to be rethrown in place of the C status.
+private final class _TranscoderOutput {
+    let sink: (UnsafeRawBufferPointer) throws -> Void
+    private(set) var error: Error?
+
+    init(_ sink: @escaping (UnsafeRawBufferPointer) throws -> Void) {
+        self.sink = sink
+    }
+
+    static let callback: KSBONJSONAddEncodedDataFunc = { data, length, userData in
+        let output = Unmanaged<_TranscoderOutput>.fromOpaque(userData!).takeUnretainedValue()
+        do {
+            try output.sink(UnsafeRawBufferPointer(start: data, count: length))
+            return KSBONJSON_ENCODE_OK
+        } catch {
+            output.error = error
+            return KSBONJSON_ENCODE_COULD_NOT_ADD_DATA
+        }
+    }
+
+    func throwIfFailed() throws {
+        if let error = error {
+            throw error
+        }
+    }
+}
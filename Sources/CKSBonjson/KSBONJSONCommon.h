@@ -285,7 +285,7 @@ static const uint8_t ksbonjson_nativeSizeIndex[] = {
 // Zigzag encode: 0→0, -1→1, 1→2, -2→3, 2→4, ...
 static inline uint64_t ksbonjson_zigzagEncode(int64_t v)
 {
-    return (uint64_t)((v << 1) ^ (v >> 63));
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
 }
 
 // Zigzag decode: 0→0, 1→-1, 2→1, 3→-2, 4→2, ...
@@ -364,6 +364,53 @@ static inline size_t ksbonjson_readULEB128(const uint8_t *buf, size_t available,
 }
 
 
+
+// ============================================================================
+// Statistics
+// ============================================================================
+
+// Counters for the optional stats struct that a context points to (ctx->stats).
+// Unless the library is built with KSBONJSON_STATS defined, they compile out entirely.
+
+#ifdef KSBONJSON_STATS
+
+#include <time.h>
+
+// Monotonic clock for the phase timers
+static inline uint64_t ksbonjson_statsNanoseconds(void)
+{
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+#define STATS_ADD(CTX, FIELD, AMOUNT) \
+    do { if ((CTX)->stats != NULL) (CTX)->stats->FIELD += (AMOUNT); } while (0)
+
+#define STATS_MAX(CTX, FIELD, VALUE) \
+    do { if ((CTX)->stats != NULL && (CTX)->stats->FIELD < (size_t)(VALUE)) (CTX)->stats->FIELD = (size_t)(VALUE); } while (0)
+
+// Times a phase into FIELD when the stats ask for timings
+#define STATS_TIMER_START(CTX, NAME) \
+    const uint64_t NAME = ((CTX)->stats != NULL && (CTX)->stats->measuresTime) ? ksbonjson_statsNanoseconds() : 0
+
+#define STATS_TIMER_STOP(CTX, NAME, FIELD) \
+    do { if (NAME != 0 && (CTX)->stats != NULL) (CTX)->stats->FIELD += ksbonjson_statsNanoseconds() - NAME; } while (0)
+
+#else
+
+#define STATS_ADD(CTX, FIELD, AMOUNT) do {} while (0)
+#define STATS_MAX(CTX, FIELD, VALUE) do {} while (0)
+#define STATS_TIMER_START(CTX, NAME) do {} while (0)
+#define STATS_TIMER_STOP(CTX, NAME, FIELD) do {} while (0)
+
+#endif
+
+
 #ifdef __cplusplus
 }
 #endif
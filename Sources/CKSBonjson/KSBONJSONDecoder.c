@@ -31,6 +31,7 @@
 #include "KSBONJSONCommon.h"
 #include <string.h> // For memcpy() and strnlen()
 #include <math.h>   // For pow()
+#include <stdlib.h> // For realloc() and free()
 #include "KSBONJSONSimd.h"
 #ifdef _MSC_VER
 #include <intrin.h>
@@ -43,45 +44,9 @@
 // UTF-8 Validation
 // ============================================================================
 
-/**
- * Validate a UTF-8 string, checking for the requested issues:
- * - If rejectInvalidUTF8: Well-formed sequences, no overlong, no surrogates, no >U+10FFFF
- * - If rejectNUL: No NUL characters
- *
- * @param data The UTF-8 data to validate
- * @param length Length of data in bytes
- * @param rejectNUL If true, NUL characters cause validation failure
- * @param rejectInvalidUTF8 If true, invalid UTF-8 sequences cause validation failure
- * @return KSBONJSON_DECODE_OK if valid, error code otherwise
- */
-static ksbonjson_decodeStatus validateString(const uint8_t* data, size_t length, bool rejectNUL, bool rejectInvalidUTF8)
+// Byte-by-byte UTF-8 validation, which finds the first error
+static ksbonjson_decodeStatus validateUTF8Scalar(const uint8_t* data, size_t length, bool rejectNUL)
 {
-    // Fast path: if only checking NUL, use SIMD scan for 0x00
-    if (rejectNUL && !rejectInvalidUTF8)
-    {
-        unlikely_if(ksbonjson_simd_containsByte(data, length, 0x00))
-        {
-            return KSBONJSON_DECODE_NUL_CHARACTER;
-        }
-        return KSBONJSON_DECODE_OK;
-    }
-
-    // Full UTF-8 validation (with optional NUL check)
-
-    // SIMD fast path: if entire string is ASCII, only need NUL check
-    if (ksbonjson_simd_isAllAscii(data, length))
-    {
-        if (rejectNUL)
-        {
-            unlikely_if(ksbonjson_simd_containsByte(data, length, 0x00))
-            {
-                return KSBONJSON_DECODE_NUL_CHARACTER;
-            }
-        }
-        return KSBONJSON_DECODE_OK;
-    }
-
-    // Slow path: byte-by-byte UTF-8 validation for strings with non-ASCII
     const uint8_t* end = data + length;
 
     while (data < end)
@@ -194,6 +159,59 @@ static ksbonjson_decodeStatus validateString(const uint8_t* data, size_t length,
     return KSBONJSON_DECODE_OK;
 }
 
+/**
+ * Validate a UTF-8 string, checking for the issues the map's flags ask for:
+ * - If rejectInvalidUTF8: Well-formed sequences, no overlong, no surrogates, no >U+10FFFF
+ * - If rejectNUL: No NUL characters
+ *
+ * @param ctx The map whose flags (and stats) apply
+ * @param data The UTF-8 data to validate
+ * @param length Length of data in bytes
+ * @return KSBONJSON_DECODE_OK if valid, error code otherwise
+ */
+static ksbonjson_decodeStatus validateString(KSBONJSONMapContext* ctx, const uint8_t* data, size_t length)
+{
+    const bool rejectNUL = ctx->flags.rejectNUL;
+    const bool rejectInvalidUTF8 = ctx->flags.rejectInvalidUTF8;
+
+    // Fast path: if only checking NUL, use SIMD scan for 0x00
+    if (rejectNUL && !rejectInvalidUTF8)
+    {
+        STATS_ADD(ctx, fastValidationCount, 1);
+        STATS_ADD(ctx, fastValidationBytes, length);
+        unlikely_if(ksbonjson_simd_containsByte(data, length, 0x00))
+        {
+            return KSBONJSON_DECODE_NUL_CHARACTER;
+        }
+        return KSBONJSON_DECODE_OK;
+    }
+
+    // Full UTF-8 validation (with optional NUL check)
+
+    // SIMD fast path: validates UTF-8 and checks for NUL in a single pass
+    if (ksbonjson_simd_isValidUTF8(data, length, rejectNUL))
+    {
+        STATS_ADD(ctx, fastValidationCount, 1);
+        STATS_ADD(ctx, fastValidationBytes, length);
+        return KSBONJSON_DECODE_OK;
+    }
+
+    // Slow path: byte-by-byte UTF-8 validation. This only runs for invalid strings
+    // (to report which error comes first) or where no SIMD validator is available.
+    STATS_ADD(ctx, slowValidationCount, 1);
+    STATS_ADD(ctx, slowValidationBytes, length);
+    return validateUTF8Scalar(data, length, rejectNUL);
+}
+
+ksbonjson_decodeStatus ksbonjson_validateUTF8(const uint8_t* data, size_t length, bool rejectNUL)
+{
+    if (ksbonjson_simd_isValidUTF8(data, length, rejectNUL))
+    {
+        return KSBONJSON_DECODE_OK;
+    }
+    return validateUTF8Scalar(data, length, rejectNUL);
+}
+
 
 // ============================================================================
 // Types
@@ -212,13 +230,22 @@ union number_bits
 // Integer byte counts indexed by type code lower 2 bits: 0->1, 1->2, 2->4, 3->8
 static const size_t intByteCounts[] = { 1, 2, 4, 8 };
 
+// Element size lookup for typed arrays, indexed by (TYPE_TYPED_UINT8 - typeCode)
+static const size_t typedArrayElementSizes[] = {
+    1, 2, 4, 8, 1, 2, 4, 8, 4, 8
+    // uint8, uint16, uint32, uint64, sint8, sint16, sint32, sint64, float32, float64
+};
+
+// Whether element is signed, indexed by (TYPE_TYPED_UINT8 - typeCode)
+// 0=unsigned, 1=signed, 2=float
+static const int typedArrayElementKinds[] = {
+    0, 0, 0, 0, 1, 1, 1, 1, 2, 2
+    // uint8, uint16, uint32, uint64, sint8, sint16, sint32, sint64, float32, float64
+};
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpadded"
-typedef struct
-{
-    uint8_t isObject: 1;
-    uint8_t isExpectingName: 1;
-} ContainerState;
+typedef KSBONJSONDecodeContainerState ContainerState;
 
 typedef struct
 {
@@ -227,7 +254,10 @@ typedef struct
     const KSBONJSONDecodeCallbacks* const callbacks;
     void* const userData;
     int containerDepth;
-    ContainerState containers[KSBONJSON_MAX_CONTAINER_DEPTH];
+    // Indexed by depth (0 is the top level). Owned by the caller so that an
+    // incremental decode can keep it between chunks.
+    ContainerState* const containers;
+    KSBONJSONDecodeRecordDefs* const recordDefs;
 } DecodeContext;
 #pragma GCC diagnostic pop
 
@@ -411,18 +441,25 @@ static ksbonjson_decodeStatus decodeAndReportBigNumber(DecodeContext* const ctx)
     return ctx->callbacks->onBigNumber(ksbonjson_newBigNumber(sign, significand, (int32_t)exponent), ctx->userData);
 }
 
-static ksbonjson_decodeStatus decodeAndReportShortString(DecodeContext* const ctx, const uint8_t typeCode)
+static ksbonjson_decodeStatus readShortString(DecodeContext* const ctx,
+                                              const uint8_t typeCode,
+                                              const uint8_t** const outBegin,
+                                              size_t* const outLength)
 {
-    // Short string length is in the lower nibble (0xD0-0xDF -> length 0-15)
+    // Short string length is in the type code (0x65-0xA7 -> length 0-66)
     const size_t length = (size_t)(typeCode - TYPE_STRING0);
     SHOULD_HAVE_ROOM_FOR_BYTES(length);
     const uint8_t* const begin = ctx->bufferCurrent;
     ctx->bufferCurrent += length;
     SHOULD_NOT_CONTAIN_NUL_CHARS(begin, length);
-    return ctx->callbacks->onString((const char*)begin, length, ctx->userData);
+    *outBegin = begin;
+    *outLength = length;
+    return KSBONJSON_DECODE_OK;
 }
 
-static ksbonjson_decodeStatus decodeAndReportLongString(DecodeContext* const ctx)
+static ksbonjson_decodeStatus readLongString(DecodeContext* const ctx,
+                                             const uint8_t** const outBegin,
+                                             size_t* const outLength)
 {
     // Long string: data bytes until 0xFF terminator
     // 0xFF cannot appear in valid UTF-8, so it's a safe terminator
@@ -441,12 +478,162 @@ static ksbonjson_decodeStatus decodeAndReportLongString(DecodeContext* const ctx
     ctx->bufferCurrent = pos + 1; // skip terminator
 
     SHOULD_NOT_CONTAIN_NUL_CHARS(start, length);
-    return ctx->callbacks->onString((const char*)start, length, ctx->userData);
+    *outBegin = start;
+    *outLength = length;
+    return KSBONJSON_DECODE_OK;
+}
+
+// Read the string whose type code was just consumed, without reporting it
+static ksbonjson_decodeStatus readString(DecodeContext* const ctx,
+                                         const uint8_t typeCode,
+                                         const uint8_t** const outBegin,
+                                         size_t* const outLength)
+{
+    // Short string: 0x65-0xA7 (range-based detection)
+    if (typeCode >= TYPE_STRING0 && typeCode <= TYPE_SHORT_STRING_MAX)
+    {
+        return readShortString(ctx, typeCode, outBegin, outLength);
+    }
+    // Long string: 0xFF
+    if (typeCode == TYPE_STRING_LONG)
+    {
+        return readLongString(ctx, outBegin, outLength);
+    }
+    return KSBONJSON_DECODE_EXPECTED_OBJECT_NAME;
+}
+
+static ksbonjson_decodeStatus decodeAndReportShortString(DecodeContext* const ctx, const uint8_t typeCode)
+{
+    const uint8_t* begin;
+    size_t length;
+    PROPAGATE_ERROR(ctx, readShortString(ctx, typeCode, &begin, &length));
+    return ctx->callbacks->onString((const char*)begin, length, ctx->userData);
+}
+
+static ksbonjson_decodeStatus decodeAndReportLongString(DecodeContext* const ctx)
+{
+    const uint8_t* begin;
+    size_t length;
+    PROPAGATE_ERROR(ctx, readLongString(ctx, &begin, &length));
+    return ctx->callbacks->onString((const char*)begin, length, ctx->userData);
+}
+
+static bool addRecordKey(KSBONJSONDecodeRecordDefs* const defs, const uint8_t* const key, const size_t length)
+{
+    if (defs->keyCount == defs->keyCapacity)
+    {
+        const size_t newCapacity = defs->keyCapacity == 0 ? 16 : defs->keyCapacity * 2;
+        size_t* const newEnds = realloc(defs->keyEnds, newCapacity * sizeof(*newEnds));
+        unlikely_if(newEnds == NULL)
+        {
+            return false;
+        }
+        defs->keyEnds = newEnds;
+        defs->keyCapacity = newCapacity;
+    }
+    const size_t required = defs->keyBytesLength + length;
+    // Allocated even for empty keys so that every key has a valid address
+    if (required > defs->keyBytesCapacity || defs->keyBytes == NULL)
+    {
+        size_t newCapacity = defs->keyBytesCapacity == 0 ? 256 : defs->keyBytesCapacity * 2;
+        if (newCapacity < required)
+        {
+            newCapacity = required;
+        }
+        uint8_t* const newBytes = realloc(defs->keyBytes, newCapacity);
+        unlikely_if(newBytes == NULL)
+        {
+            return false;
+        }
+        defs->keyBytes = newBytes;
+        defs->keyBytesCapacity = newCapacity;
+    }
+    memcpy(defs->keyBytes + defs->keyBytesLength, key, length);
+    defs->keyBytesLength = required;
+    defs->keyEnds[defs->keyCount++] = required;
+    return true;
+}
+
+static void freeRecordDefs(KSBONJSONDecodeRecordDefs* const defs)
+{
+    free(defs->keyBytes);
+    free(defs->keyEnds);
+    defs->keyBytes = NULL;
+    defs->keyEnds = NULL;
+    defs->keyBytesLength = defs->keyBytesCapacity = 0;
+    defs->keyCount = defs->keyCapacity = 0;
+    defs->defCount = 0;
+}
+
+// Read the record definition whose type code was just consumed.
+// Returns KSBONJSON_DECODE_INCOMPLETE having stored nothing if the buffer ends first.
+static ksbonjson_decodeStatus decodeRecordDef(DecodeContext* const ctx)
+{
+    KSBONJSONDecodeRecordDefs* const defs = ctx->recordDefs;
+    unlikely_if(defs->defCount >= KSBONJSON_MAX_RECORD_DEFS)
+    {
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+
+    const size_t firstKey = defs->keyCount;
+    const size_t firstKeyByte = defs->keyBytesLength;
+    ksbonjson_decodeStatus status = KSBONJSON_DECODE_OK;
+    for (;;)
+    {
+        unlikely_if(ctx->bufferCurrent >= ctx->bufferEnd)
+        {
+            status = KSBONJSON_DECODE_INCOMPLETE;
+            break;
+        }
+        const uint8_t typeCode = *ctx->bufferCurrent++;
+        if (typeCode == TYPE_END)
+        {
+            break;
+        }
+        const uint8_t* key;
+        size_t length;
+        status = readString(ctx, typeCode, &key, &length);
+        unlikely_if(status != KSBONJSON_DECODE_OK)
+        {
+            break;
+        }
+        unlikely_if(defs->keyCount - firstKey >= UINT32_MAX || !addRecordKey(defs, key, length))
+        {
+            status = KSBONJSON_DECODE_OUT_OF_MEMORY;
+            break;
+        }
+    }
+
+    unlikely_if(status != KSBONJSON_DECODE_OK)
+    {
+        defs->keyCount = firstKey;
+        defs->keyBytesLength = firstKeyByte;
+        return status;
+    }
+    defs->defs[defs->defCount].firstKey = (uint32_t)firstKey;
+    defs->defs[defs->defCount].keyCount = (uint32_t)(defs->keyCount - firstKey);
+    defs->defCount++;
+    return KSBONJSON_DECODE_OK;
+}
+
+// Report the key of the record field whose value comes next
+static ksbonjson_decodeStatus reportRecordKey(DecodeContext* const ctx, ContainerState* const container)
+{
+    const KSBONJSONDecodeRecordDefs* const defs = ctx->recordDefs;
+    unlikely_if(container->recordField >= defs->defs[container->recordDef].keyCount)
+    {
+        // More values than the definition has keys
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+    const size_t key = defs->defs[container->recordDef].firstKey + container->recordField;
+    const size_t begin = key == 0 ? 0 : defs->keyEnds[key - 1];
+    container->isExpectingName = false;
+    return ctx->callbacks->onString((const char*)defs->keyBytes + begin, defs->keyEnds[key] - begin, ctx->userData);
 }
 
 static ksbonjson_decodeStatus beginArray(DecodeContext* const ctx)
 {
-    unlikely_if(ctx->containerDepth > KSBONJSON_MAX_CONTAINER_DEPTH)
+    unlikely_if(ctx->containerDepth >= KSBONJSON_MAX_CONTAINER_DEPTH)
     {
         return KSBONJSON_DECODE_CONTAINER_DEPTH_EXCEEDED;
     }
@@ -462,16 +649,48 @@ static ksbonjson_decodeStatus beginArray(DecodeContext* const ctx)
 
 static ksbonjson_decodeStatus beginObject(DecodeContext* const ctx)
 {
-    unlikely_if(ctx->containerDepth > KSBONJSON_MAX_CONTAINER_DEPTH)
+    unlikely_if(ctx->containerDepth >= KSBONJSON_MAX_CONTAINER_DEPTH)
+    {
+        return KSBONJSON_DECODE_CONTAINER_DEPTH_EXCEEDED;
+    }
+
+    ctx->containerDepth++;
+    ctx->containers[ctx->containerDepth] = (ContainerState)
+                                            {
+                                                .isObject = true,
+                                                .isExpectingName = true,
+                                            };
+
+    return ctx->callbacks->onBeginObject(ctx->userData);
+}
+
+static ksbonjson_decodeStatus beginRecordInstance(DecodeContext* const ctx)
+{
+    uint64_t defIndex;
+    const size_t bytesRead = ksbonjson_readULEB128(ctx->bufferCurrent,
+                                                   (size_t)(ctx->bufferEnd - ctx->bufferCurrent),
+                                                   &defIndex);
+    unlikely_if(bytesRead == 0)
+    {
+        return KSBONJSON_DECODE_INCOMPLETE;
+    }
+    unlikely_if(defIndex >= ctx->recordDefs->defCount)
+    {
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+    unlikely_if(ctx->containerDepth >= KSBONJSON_MAX_CONTAINER_DEPTH)
     {
         return KSBONJSON_DECODE_CONTAINER_DEPTH_EXCEEDED;
     }
 
+    ctx->bufferCurrent += bytesRead;
     ctx->containerDepth++;
     ctx->containers[ctx->containerDepth] = (ContainerState)
                                             {
                                                 .isObject = true,
                                                 .isExpectingName = true,
+                                                .isRecord = true,
+                                                .recordDef = (uint16_t)defIndex,
                                             };
 
     return ctx->callbacks->onBeginObject(ctx->userData);
@@ -488,6 +707,17 @@ static ksbonjson_decodeStatus endContainer(DecodeContext* const ctx)
     {
         return KSBONJSON_DECODE_EXPECTED_OBJECT_VALUE;
     }
+    if (container->isRecord)
+    {
+        // The fields an instance leaves out are null
+        const uint32_t keyCount = ctx->recordDefs->defs[container->recordDef].keyCount;
+        while (container->recordField < keyCount)
+        {
+            PROPAGATE_ERROR(ctx, reportRecordKey(ctx, container));
+            PROPAGATE_ERROR(ctx, ctx->callbacks->onNull(ctx->userData));
+            container->recordField++;
+        }
+    }
 
     ctx->containerDepth--;
     return ctx->callbacks->onEndContainer(ctx->userData);
@@ -495,25 +725,57 @@ static ksbonjson_decodeStatus endContainer(DecodeContext* const ctx)
 
 static ksbonjson_decodeStatus decodeObjectName(DecodeContext* const ctx, const uint8_t typeCode)
 {
-    // Short string: 0x65-0xA7 (range-based detection)
-    if (typeCode >= TYPE_STRING0 && typeCode <= TYPE_SHORT_STRING_MAX)
-    {
-        return decodeAndReportShortString(ctx, typeCode);
-    }
-    // Long string: 0xFF
-    if (typeCode == TYPE_STRING_LONG)
+    const uint8_t* begin;
+    size_t length;
+    PROPAGATE_ERROR(ctx, readString(ctx, typeCode, &begin, &length));
+    return ctx->callbacks->onString((const char*)begin, length, ctx->userData);
+}
+
+// Report the typed array element at bufferCurrent, whose bytes must all be present
+static ksbonjson_decodeStatus decodeAndReportTypedArrayElement(DecodeContext* const ctx,
+                                                               const size_t elementSize,
+                                                               const int elementKind)
+{
+    union number_bits bits = {.u64 = 0};
+    memcpy(bits.b, ctx->bufferCurrent, elementSize);
+    ctx->bufferCurrent += elementSize;
+    bits.u64 = fromLittleEndian(bits.u64);
+
+    switch (elementKind)
     {
-        return decodeAndReportLongString(ctx);
+        case 0: // unsigned
+        {
+            uint64_t mask = elementSize < 8 ? ((uint64_t)1 << (elementSize * 8)) - 1 : UINT64_MAX;
+            return ctx->callbacks->onUnsignedInteger(bits.u64 & mask, ctx->userData);
+        }
+        case 1: // signed
+        {
+            // Re-read with sign extension
+            const uint8_t* elemStart = ctx->bufferCurrent - elementSize;
+            int8_t signFill = (int8_t)elemStart[elementSize - 1] >> 7;
+            union number_bits sbits = {.u64 = (uint64_t)(int64_t)signFill};
+            memcpy(sbits.b, elemStart, elementSize);
+            sbits.u64 = fromLittleEndian(sbits.u64);
+            return ctx->callbacks->onSignedInteger(sbits.i64, ctx->userData);
+        }
+        default: // float
+        {
+            double value;
+            if (elementSize == 4)
+                value = (double)bits.f32;
+            else
+                value = bits.f64;
+            return reportFloat(ctx, value);
+        }
     }
-    return KSBONJSON_DECODE_EXPECTED_OBJECT_NAME;
 }
 
 // Decode a typed array and report as regular array with individual elements
 static ksbonjson_decodeStatus decodeAndReportTypedArray(DecodeContext* const ctx, const uint8_t typeCode)
 {
     size_t tableIndex = (size_t)(TYPE_TYPED_UINT8 - typeCode);
-    size_t elementSize = (size_t[]){1, 2, 4, 8, 1, 2, 4, 8, 4, 8}[tableIndex];
-    int elementKind = (int[]){0, 0, 0, 0, 1, 1, 1, 1, 2, 2}[tableIndex];
+    size_t elementSize = typedArrayElementSizes[tableIndex];
+    int elementKind = typedArrayElementKinds[tableIndex];
 
     // Read ULEB128 element count
     size_t available = (size_t)(ctx->bufferEnd - ctx->bufferCurrent);
@@ -535,41 +797,7 @@ static ksbonjson_decodeStatus decodeAndReportTypedArray(DecodeContext* const ctx
     // Report individual elements
     for (uint32_t i = 0; i < count; i++)
     {
-        union number_bits bits = {.u64 = 0};
-        memcpy(bits.b, ctx->bufferCurrent, elementSize);
-        ctx->bufferCurrent += elementSize;
-        bits.u64 = fromLittleEndian(bits.u64);
-
-        switch (elementKind)
-        {
-            case 0: // unsigned
-            {
-                uint64_t mask = elementSize < 8 ? ((uint64_t)1 << (elementSize * 8)) - 1 : UINT64_MAX;
-                PROPAGATE_ERROR(ctx, ctx->callbacks->onUnsignedInteger(bits.u64 & mask, ctx->userData));
-                break;
-            }
-            case 1: // signed
-            {
-                // Re-read with sign extension
-                const uint8_t* elemStart = ctx->bufferCurrent - elementSize;
-                int8_t signFill = (int8_t)elemStart[elementSize - 1] >> 7;
-                union number_bits sbits = {.u64 = (uint64_t)(int64_t)signFill};
-                memcpy(sbits.b, elemStart, elementSize);
-                sbits.u64 = fromLittleEndian(sbits.u64);
-                PROPAGATE_ERROR(ctx, ctx->callbacks->onSignedInteger(sbits.i64, ctx->userData));
-                break;
-            }
-            case 2: // float
-            {
-                double value;
-                if (elementSize == 4)
-                    value = (double)bits.f32;
-                else
-                    value = bits.f64;
-                PROPAGATE_ERROR(ctx, reportFloat(ctx, value));
-                break;
-            }
-        }
+        PROPAGATE_ERROR(ctx, decodeAndReportTypedArrayElement(ctx, elementSize, elementKind));
     }
 
     // Report end container
@@ -629,6 +857,8 @@ static ksbonjson_decodeStatus decodeValue(DecodeContext* const ctx, const uint8_
             return beginArray(ctx);
         case TYPE_OBJECT:
             return beginObject(ctx);
+        case TYPE_RECORD_INSTANCE:
+            return beginRecordInstance(ctx);
         case TYPE_END:
             return endContainer(ctx);
         default:
@@ -636,54 +866,85 @@ static ksbonjson_decodeStatus decodeValue(DecodeContext* const ctx, const uint8_
     }
 }
 
-static ksbonjson_decodeStatus decodeDocument(DecodeContext* const ctx)
+// A name or value just completed in the current container
+static void finishContainerElement(DecodeContext* const ctx)
 {
-    static ksbonjson_decodeStatus (*decodeFuncs[2])(DecodeContext*, const uint8_t) =
-    {
-        decodeValue, decodeObjectName,
-    };
-
-    while(ctx->bufferCurrent < ctx->bufferEnd)
+    if (ctx->containerDepth > 0)
     {
-        const uint8_t typeCode = *ctx->bufferCurrent++;
-
-        // Handle container end marker
-        if (typeCode == TYPE_END)
-        {
-            PROPAGATE_ERROR(ctx, endContainer(ctx));
-
-            // Update parent container state after ending child container
-            if (ctx->containerDepth > 0)
-            {
-                ContainerState* const parentContainer = &ctx->containers[ctx->containerDepth];
-                if (parentContainer->isObject)
-                {
-                    parentContainer->isExpectingName = !parentContainer->isExpectingName;
-                }
-            }
-            continue;
-        }
-
         ContainerState* const container = &ctx->containers[ctx->containerDepth];
-
-        if (container->isObject && container->isExpectingName)
+        if (container->isRecord)
         {
-            PROPAGATE_ERROR(ctx, decodeObjectName(ctx, typeCode));
+            container->isExpectingName = true;
+            container->recordField++;
         }
-        else
+        else if (container->isObject)
         {
-            PROPAGATE_ERROR(ctx, decodeValue(ctx, typeCode));
+            container->isExpectingName = !container->isExpectingName;
         }
+    }
+}
 
-        // Update container state
-        if (ctx->containerDepth > 0)
-        {
-            ContainerState* const updatedContainer = &ctx->containers[ctx->containerDepth];
-            if (updatedContainer->isObject)
-            {
-                updatedContainer->isExpectingName = !updatedContainer->isExpectingName;
-            }
+// Decode the object name, value, end marker or record definition at bufferCurrent.
+// Returns KSBONJSON_DECODE_INCOMPLETE without reporting anything or changing
+// the container state if the buffer ends before the token does. The exception is
+// a record field's key, which is reported once, before its value is decoded.
+static ksbonjson_decodeStatus decodeToken(DecodeContext* const ctx)
+{
+    const uint8_t typeCode = *ctx->bufferCurrent++;
+
+    // Handle container end marker
+    if (typeCode == TYPE_END)
+    {
+        PROPAGATE_ERROR(ctx, endContainer(ctx));
+
+        // Update parent container state after ending child container
+        finishContainerElement(ctx);
+        return KSBONJSON_DECODE_OK;
+    }
+
+    const int depth = ctx->containerDepth;
+    ContainerState* const container = &ctx->containers[depth];
+
+    if (typeCode == TYPE_RECORD_DEF && depth == 0)
+    {
+        return decodeRecordDef(ctx);
+    }
+
+    if (container->isRecord)
+    {
+        if (container->isExpectingName)
+        {
+            PROPAGATE_ERROR(ctx, reportRecordKey(ctx, container));
         }
+        PROPAGATE_ERROR(ctx, decodeValue(ctx, typeCode));
+    }
+    else if (container->isObject && container->isExpectingName)
+    {
+        PROPAGATE_ERROR(ctx, decodeObjectName(ctx, typeCode));
+    }
+    else
+    {
+        PROPAGATE_ERROR(ctx, decodeValue(ctx, typeCode));
+    }
+
+    // A container value only counts as complete in its parent once it ends
+    if (ctx->containerDepth == depth)
+    {
+        finishContainerElement(ctx);
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus decodeDocument(DecodeContext* const ctx)
+{
+    static ksbonjson_decodeStatus (*decodeFuncs[2])(DecodeContext*, const uint8_t) =
+    {
+        decodeValue, decodeObjectName,
+    };
+
+    while(ctx->bufferCurrent < ctx->bufferEnd)
+    {
+        PROPAGATE_ERROR(ctx, decodeToken(ctx));
     }
 
     unlikely_if(ctx->containerDepth > 0)
@@ -704,19 +965,276 @@ ksbonjson_decodeStatus ksbonjson_decode(const uint8_t* const document,
                                         void* const userData,
                                         size_t* const decodedOffset)
 {
+    ContainerState containers[KSBONJSON_MAX_CONTAINER_DEPTH + 1] = {{0}};
+    KSBONJSONDecodeRecordDefs recordDefs;
+    memset(&recordDefs, 0, sizeof(recordDefs));
     DecodeContext ctx =
         {
             .bufferCurrent = document,
             .bufferEnd = document + documentLength,
             .callbacks = callbacks,
             .userData = userData,
+            .containers = containers,
+            .recordDefs = &recordDefs,
         };
 
     const ksbonjson_decodeStatus result = decodeDocument(&ctx);
     *decodedOffset = (size_t)(ctx.bufferCurrent - document);
+    freeRecordDefs(&recordDefs);
     return result;
 }
 
+// Report as many whole elements of the typed array in progress as the buffer
+// holds, then close the array once its last element has been reported.
+static ksbonjson_decodeStatus decodeIncrementalTypedArrayElements(KSBONJSONIncrementalDecodeContext* const ictx,
+                                                                  DecodeContext* const ctx)
+{
+    const size_t tableIndex = (size_t)(TYPE_TYPED_UINT8 - ictx->typedArrayType);
+    const size_t elementSize = typedArrayElementSizes[tableIndex];
+    const int elementKind = typedArrayElementKinds[tableIndex];
+
+    uint64_t available = (uint64_t)(ctx->bufferEnd - ctx->bufferCurrent) / elementSize;
+    if (available > ictx->typedArrayRemaining)
+    {
+        available = ictx->typedArrayRemaining;
+    }
+    for (uint64_t i = 0; i < available; i++)
+    {
+        PROPAGATE_ERROR(ctx, decodeAndReportTypedArrayElement(ctx, elementSize, elementKind));
+        ictx->typedArrayRemaining--;
+    }
+
+    if (ictx->typedArrayRemaining == 0)
+    {
+        ictx->typedArrayType = 0;
+        PROPAGATE_ERROR(ctx, ctx->callbacks->onEndContainer(ctx->userData));
+        finishContainerElement(ctx);
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+// Decode as many whole tokens as possible from the start of the buffer.
+// *outConsumed excludes a token cut off by the end of the buffer.
+static ksbonjson_decodeStatus decodeIncrementalBuffer(KSBONJSONIncrementalDecodeContext* const ictx,
+                                                      const uint8_t* const buffer,
+                                                      const size_t length,
+                                                      size_t* const outConsumed)
+{
+    DecodeContext ctx =
+        {
+            .bufferCurrent = buffer,
+            .bufferEnd = buffer + length,
+            .callbacks = ictx->callbacks,
+            .userData = ictx->userData,
+            .containerDepth = ictx->containerDepth,
+            .containers = ictx->containers,
+            .recordDefs = &ictx->recordDefs,
+        };
+
+    ksbonjson_decodeStatus status = KSBONJSON_DECODE_OK;
+    while (ctx.bufferCurrent < ctx.bufferEnd)
+    {
+        if (ictx->typedArrayType != 0)
+        {
+            const uint8_t* const elementsStart = ctx.bufferCurrent;
+            status = decodeIncrementalTypedArrayElements(ictx, &ctx);
+            unlikely_if(status != KSBONJSON_DECODE_OK || (ictx->typedArrayType != 0 && ctx.bufferCurrent == elementsStart))
+            {
+                // Failed, or only part of the next element is here
+                break;
+            }
+            continue;
+        }
+
+        const uint8_t* const tokenStart = ctx.bufferCurrent;
+        const uint8_t typeCode = *tokenStart;
+        ContainerState* const container = &ctx.containers[ctx.containerDepth];
+        if (container->isRecord && container->isExpectingName && typeCode != TYPE_END)
+        {
+            // Report the field's key now so that a typed array value can stream
+            status = reportRecordKey(&ctx, container);
+            unlikely_if(status != KSBONJSON_DECODE_OK)
+            {
+                break;
+            }
+        }
+        if (!(container->isObject && container->isExpectingName) &&
+            typeCode >= TYPE_TYPED_FLOAT64 && typeCode <= TYPE_TYPED_UINT8)
+        {
+            // Typed arrays can be large, so report them as their elements arrive
+            uint64_t count;
+            const size_t bytesRead = ksbonjson_readULEB128(tokenStart + 1, length - (size_t)(tokenStart + 1 - buffer), &count);
+            if (bytesRead == 0)
+            {
+                status = KSBONJSON_DECODE_INCOMPLETE;
+            }
+            else
+            {
+                ctx.bufferCurrent += 1 + bytesRead;
+                status = ctx.callbacks->onBeginArray(ctx.userData);
+                ictx->typedArrayType = typeCode;
+                ictx->typedArrayRemaining = count;
+            }
+        }
+        else
+        {
+            status = decodeToken(&ctx);
+        }
+
+        if (status == KSBONJSON_DECODE_INCOMPLETE)
+        {
+            // Nothing was reported for the cut-off token, so it can be retried once complete
+            ctx.bufferCurrent = tokenStart;
+            status = KSBONJSON_DECODE_OK;
+            break;
+        }
+        unlikely_if(status != KSBONJSON_DECODE_OK)
+        {
+            break;
+        }
+    }
+
+    // An empty typed array at the very end of the buffer still needs closing
+    if (status == KSBONJSON_DECODE_OK && ictx->typedArrayType != 0 && ictx->typedArrayRemaining == 0)
+    {
+        status = decodeIncrementalTypedArrayElements(ictx, &ctx);
+    }
+
+    ictx->containerDepth = ctx.containerDepth;
+    *outConsumed = (size_t)(ctx.bufferCurrent - buffer);
+    return status;
+}
+
+static bool appendIncrementalPending(KSBONJSONIncrementalDecodeContext* const ictx,
+                                     const uint8_t* const bytes,
+                                     const size_t length)
+{
+    if (length == 0)
+    {
+        return true;
+    }
+    const size_t required = ictx->pendingLength + length;
+    if (required > ictx->pendingCapacity)
+    {
+        size_t newCapacity = ictx->pendingCapacity == 0 ? 64 : ictx->pendingCapacity * 2;
+        if (newCapacity < required)
+        {
+            newCapacity = required;
+        }
+        uint8_t* const newPending = realloc(ictx->pending, newCapacity);
+        unlikely_if(newPending == NULL)
+        {
+            return false;
+        }
+        ictx->pending = newPending;
+        ictx->pendingCapacity = newCapacity;
+    }
+    memcpy(ictx->pending + ictx->pendingLength, bytes, length);
+    ictx->pendingLength = required;
+    return true;
+}
+
+void ksbonjson_decodeIncremental_begin(KSBONJSONIncrementalDecodeContext* const ctx,
+                                       const KSBONJSONDecodeCallbacks* const callbacks,
+                                       void* const userData)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->callbacks = callbacks;
+    ctx->userData = userData;
+    ctx->status = KSBONJSON_DECODE_OK;
+}
+
+ksbonjson_decodeStatus ksbonjson_decodeIncremental_feed(KSBONJSONIncrementalDecodeContext* const ctx,
+                                                        const uint8_t* chunk,
+                                                        size_t chunkLength)
+{
+    unlikely_if(ctx->status != KSBONJSON_DECODE_OK)
+    {
+        return ctx->status;
+    }
+
+    // First finish the token cut off by an earlier chunk. Its buffer is topped up
+    // in steps that grow with it, so a long token is copied and rescanned in
+    // amortized linear time.
+    while (ctx->pendingLength > 0 && chunkLength > 0)
+    {
+        size_t step = ctx->pendingLength < 64 ? 64 : ctx->pendingLength;
+        if (step > chunkLength)
+        {
+            step = chunkLength;
+        }
+        unlikely_if(!appendIncrementalPending(ctx, chunk, step))
+        {
+            return ctx->status = KSBONJSON_DECODE_OUT_OF_MEMORY;
+        }
+        chunk += step;
+        chunkLength -= step;
+
+        size_t consumed;
+        ctx->status = decodeIncrementalBuffer(ctx, ctx->pending, ctx->pendingLength, &consumed);
+        unlikely_if(ctx->status != KSBONJSON_DECODE_OK)
+        {
+            return ctx->status;
+        }
+        if (consumed > 0)
+        {
+            // The buffered token completed. Whatever was copied past the tokens
+            // decoded with it came from this chunk, so decode it from there instead.
+            const size_t unused = ctx->pendingLength - consumed;
+            chunk -= unused;
+            chunkLength += unused;
+            ctx->pendingLength = 0;
+            ctx->decodedOffset += consumed;
+        }
+    }
+    if (ctx->pendingLength > 0)
+    {
+        return KSBONJSON_DECODE_OK;
+    }
+
+    size_t consumed;
+    ctx->status = decodeIncrementalBuffer(ctx, chunk, chunkLength, &consumed);
+    unlikely_if(ctx->status != KSBONJSON_DECODE_OK)
+    {
+        return ctx->status;
+    }
+    ctx->decodedOffset += consumed;
+
+    unlikely_if(!appendIncrementalPending(ctx, chunk + consumed, chunkLength - consumed))
+    {
+        return ctx->status = KSBONJSON_DECODE_OUT_OF_MEMORY;
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+ksbonjson_decodeStatus ksbonjson_decodeIncremental_end(KSBONJSONIncrementalDecodeContext* const ctx)
+{
+    ksbonjson_decodeStatus status = ctx->status;
+    if (status == KSBONJSON_DECODE_OK)
+    {
+        if (ctx->pendingLength > 0 || ctx->typedArrayType != 0)
+        {
+            status = KSBONJSON_DECODE_INCOMPLETE;
+        }
+        else if (ctx->containerDepth > 0)
+        {
+            status = KSBONJSON_DECODE_UNCLOSED_CONTAINERS;
+        }
+        else
+        {
+            status = ctx->callbacks->onEndData(ctx->userData);
+        }
+    }
+
+    free(ctx->pending);
+    ctx->pending = NULL;
+    ctx->pendingLength = 0;
+    ctx->pendingCapacity = 0;
+    freeRecordDefs(&ctx->recordDefs);
+    ctx->status = status;
+    return status;
+}
+
 const char* ksbonjson_describeDecodeStatus(const ksbonjson_decodeStatus status)
 {
     switch(status)
@@ -750,7 +1268,7 @@ const char* ksbonjson_describeDecodeStatus(const ksbonjson_decodeStatus status)
         case KSBONJSON_DECODE_INVALID_UTF8:
             return "A string contained invalid UTF-8 (malformed sequence, surrogate, or overlong encoding)";
         case KSBONJSON_DECODE_TOO_MANY_KEYS:
-            return "Object has more keys than the duplicate detection limit (256)";
+            return "Not enough memory to track an object's keys for duplicate detection";
         case KSBONJSON_DECODE_TRAILING_BYTES:
             return "Document has trailing bytes after the root value";
         case KSBONJSON_DECODE_MAX_DEPTH_EXCEEDED:
@@ -761,6 +1279,10 @@ const char* ksbonjson_describeDecodeStatus(const ksbonjson_decodeStatus status)
             return "Maximum container size exceeded";
         case KSBONJSON_DECODE_MAX_DOCUMENT_SIZE_EXCEEDED:
             return "Maximum document size exceeded";
+        case KSBONJSON_DECODE_OUT_OF_MEMORY:
+            return "Not enough memory to buffer a value split across chunks";
+        case KSBONJSON_DECODE_INDEX_MISMATCH:
+            return "The map index was written for another document, or with other settings";
         default:
             return "(unknown status - was it a user-defined status code?)";
     }
@@ -771,15 +1293,34 @@ const char* ksbonjson_describeDecodeStatus(const ksbonjson_decodeStatus status)
 // Position Map API Implementation
 // ============================================================================
 
+// Entries are sized to pack four per 64-byte cache line. Anything with more than
+// 8 bytes of payload (big numbers) is referenced out of line instead of widening the union.
+_Static_assert(sizeof(KSBONJSONMapEntry) == 16, "KSBONJSONMapEntry must stay 16 bytes");
+
 // Helper macros for position map scanning
 #define MAP_SHOULD_HAVE_ROOM_FOR_BYTES(BYTE_COUNT) \
     unlikely_if(ctx->position + (BYTE_COUNT) > ctx->inputLength) \
         return KSBONJSON_DECODE_INCOMPLETE
 
-#define MAP_SHOULD_HAVE_ENTRY_SPACE() \
-    unlikely_if(ctx->entriesCount >= ctx->entriesCapacity) \
+#define MAP_SHOULD_HAVE_ENTRY_SPACE_FOR(ENTRY_COUNT) \
+    unlikely_if(ctx->entriesCount + (ENTRY_COUNT) > ctx->entriesCapacity && \
+                !mapGrowEntries(ctx, ctx->entriesCount + (ENTRY_COUNT))) \
         return KSBONJSON_DECODE_MAP_FULL
 
+#define MAP_SHOULD_HAVE_ENTRY_SPACE() MAP_SHOULD_HAVE_ENTRY_SPACE_FOR(1)
+
+// Ask the context's grow function (if any) for more entry space.
+// Entries are always addressed by index, so the buffer may move.
+static bool mapGrowEntries(KSBONJSONMapContext* ctx, size_t requiredCapacity)
+{
+    if (ctx->growEntries == NULL)
+    {
+        return false;
+    }
+    STATS_ADD(ctx, entryBufferGrowths, 1);
+    return ctx->growEntries(ctx, requiredCapacity) && ctx->entriesCapacity >= requiredCapacity;
+}
+
 // Helper to add an entry and return its index (subtreeSize defaults to 1)
 static inline size_t mapAddEntry(KSBONJSONMapContext* ctx, KSBONJSONMapEntry entry)
 {
@@ -790,6 +1331,25 @@ static inline size_t mapAddEntry(KSBONJSONMapContext* ctx, KSBONJSONMapEntry ent
     return index;
 }
 
+#ifdef KSBONJSON_STATS
+// Tally the types of the entries from firstIndex on. Counting once the entries exist
+// covers every way of making them (including in-place container and record slots).
+static void mapCountEntries(KSBONJSONMapContext* ctx, size_t firstIndex)
+{
+    if (ctx->stats == NULL)
+    {
+        return;
+    }
+    for (size_t i = firstIndex; i < ctx->entriesCount; i++)
+    {
+        ctx->stats->valueCounts[ctx->entries[i].type]++;
+    }
+}
+#   define STATS_COUNT_ENTRIES(CTX, FIRST_INDEX) mapCountEntries(CTX, FIRST_INDEX)
+#else
+#   define STATS_COUNT_ENTRIES(CTX, FIRST_INDEX) do {} while (0)
+#endif
+
 // Decode unsigned int for position map
 static uint64_t mapDecodeUnsignedInt(KSBONJSONMapContext* ctx, size_t byteCount)
 {
@@ -828,10 +1388,8 @@ static double mapDecodeFloat64(KSBONJSONMapContext* ctx)
     return bits.f64;
 }
 
-// Forward declarations for recursive scanning
-static ksbonjson_decodeStatus mapScanValue(KSBONJSONMapContext* ctx, size_t* outIndex);
-static ksbonjson_decodeStatus mapScanTypedArray(KSBONJSONMapContext* ctx, uint8_t typeCode, size_t* outIndex);
-static ksbonjson_decodeStatus mapScanRecordInstance(KSBONJSONMapContext* ctx, size_t* outIndex);
+// Lazy containers are scanned by skipping, defined with the lazy scanning below
+static ksbonjson_decodeStatus mapScanLazyContainer(KSBONJSONMapContext* ctx, uint8_t typeCode, size_t* outIndex);
 
 // Scan a short string (length encoded in type code)
 static ksbonjson_decodeStatus mapScanShortString(KSBONJSONMapContext* ctx, uint8_t typeCode, size_t* outIndex)
@@ -842,9 +1400,7 @@ static ksbonjson_decodeStatus mapScanShortString(KSBONJSONMapContext* ctx, uint8
     size_t length = (size_t)(typeCode - TYPE_STRING0);
     size_t offset = ctx->position;
 
-    // Check max string length (SIZE_MAX means use spec default)
-    size_t maxStrLen = ctx->flags.maxStringLength < SIZE_MAX ? ctx->flags.maxStringLength : KSBONJSON_DEFAULT_MAX_STRING_LENGTH;
-    unlikely_if(length > maxStrLen)
+    unlikely_if(length > ctx->maxStringLength)
     {
         return KSBONJSON_DECODE_MAX_STRING_LENGTH_EXCEEDED;
     }
@@ -854,9 +1410,7 @@ static ksbonjson_decodeStatus mapScanShortString(KSBONJSONMapContext* ctx, uint8
     // Validate string if required
     if (ctx->flags.rejectInvalidUTF8 || ctx->flags.rejectNUL)
     {
-        ksbonjson_decodeStatus status = validateString(ctx->input + offset, length,
-                                                        ctx->flags.rejectNUL,
-                                                        ctx->flags.rejectInvalidUTF8);
+        ksbonjson_decodeStatus status = validateString(ctx, ctx->input + offset, length);
         unlikely_if(status != KSBONJSON_DECODE_OK)
         {
             return status;
@@ -864,6 +1418,8 @@ static ksbonjson_decodeStatus mapScanShortString(KSBONJSONMapContext* ctx, uint8
     }
 
     ctx->position += length;
+    STATS_ADD(ctx, shortStringCount, 1);
+    STATS_ADD(ctx, shortStringBytes, length);
 
     KSBONJSONMapEntry entry = {
         .type = KSBONJSON_TYPE_STRING,
@@ -895,9 +1451,7 @@ static ksbonjson_decodeStatus mapScanLongString(KSBONJSONMapContext* ctx, size_t
     size_t length = ctx->position - startOffset;
     ctx->position++; // skip terminator
 
-    // Check max string length (SIZE_MAX means use spec default)
-    size_t maxStrLen = ctx->flags.maxStringLength < SIZE_MAX ? ctx->flags.maxStringLength : KSBONJSON_DEFAULT_MAX_STRING_LENGTH;
-    unlikely_if(length > maxStrLen)
+    unlikely_if(length > ctx->maxStringLength)
     {
         return KSBONJSON_DECODE_MAX_STRING_LENGTH_EXCEEDED;
     }
@@ -905,15 +1459,16 @@ static ksbonjson_decodeStatus mapScanLongString(KSBONJSONMapContext* ctx, size_t
     // Validate string
     if (ctx->flags.rejectInvalidUTF8 || ctx->flags.rejectNUL)
     {
-        ksbonjson_decodeStatus status = validateString(ctx->input + startOffset, length,
-                                                        ctx->flags.rejectNUL,
-                                                        ctx->flags.rejectInvalidUTF8);
+        ksbonjson_decodeStatus status = validateString(ctx, ctx->input + startOffset, length);
         unlikely_if(status != KSBONJSON_DECODE_OK)
         {
             return status;
         }
     }
 
+    STATS_ADD(ctx, longStringCount, 1);
+    STATS_ADD(ctx, longStringBytes, length);
+
     KSBONJSONMapEntry entry = {
         .type = KSBONJSON_TYPE_STRING,
         .data.string = {
@@ -998,6 +1553,7 @@ static ksbonjson_decodeStatus mapScanBigNumber(KSBONJSONMapContext* ctx, size_t*
 {
     MAP_SHOULD_HAVE_ENTRY_SPACE();
 
+    const size_t payloadOffset = ctx->position;
     size_t available = ctx->inputLength - ctx->position;
 
     int64_t exponent;
@@ -1018,12 +1574,8 @@ static ksbonjson_decodeStatus mapScanBigNumber(KSBONJSONMapContext* ctx, size_t*
     ctx->position += bytesRead;
     available -= bytesRead;
 
-    int32_t sign = 0;
-    uint8_t significand[16] = {0};
-
     if (signedLength != 0)
     {
-        sign = signedLength < 0 ? -1 : 0;
         size_t byteCount = (size_t)(signedLength < 0 ? -signedLength : signedLength);
 
         unlikely_if(byteCount > available)
@@ -1042,105 +1594,58 @@ static ksbonjson_decodeStatus mapScanBigNumber(KSBONJSONMapContext* ctx, size_t*
             return KSBONJSON_DECODE_INVALID_DATA;
         }
 
-        // Copy LE magnitude bytes directly to the array
-        memcpy(significand, ctx->input + ctx->position, byteCount);
         ctx->position += byteCount;
     }
 
+    // The payload is validated here but decoded on demand (ksbonjson_map_decodeBigNumber),
+    // which keeps every map entry at 16 bytes.
     KSBONJSONMapEntry entry = {
         .type = KSBONJSON_TYPE_BIGNUMBER,
         .data.bigNumber = {
-            .significand = {significand[0], significand[1], significand[2], significand[3],
-                           significand[4], significand[5], significand[6], significand[7],
-                           significand[8], significand[9], significand[10], significand[11],
-                           significand[12], significand[13], significand[14], significand[15]},
-            .exponent = (int32_t)exponent,
-            .sign = sign
+            .offset = (uint32_t)payloadOffset,
+            .length = (uint32_t)(ctx->position - payloadOffset)
         }
     };
     *outIndex = mapAddEntry(ctx, entry);
     return KSBONJSON_DECODE_OK;
 }
 
-// Scan an array container (delimiter-terminated)
-static ksbonjson_decodeStatus mapScanArray(KSBONJSONMapContext* ctx, size_t* outIndex)
+// Containers in a lazy map occupy a single slot among their siblings,
+// because their children are appended wherever the entries end when expanded.
+static inline uint32_t mapContainerSubtreeSize(KSBONJSONMapContext* ctx, size_t containerIndex)
 {
-    MAP_SHOULD_HAVE_ENTRY_SPACE();
-
-    // Check max depth (SIZE_MAX means use compile-time default)
-    size_t maxDepth = ctx->flags.maxDepth < SIZE_MAX ? ctx->flags.maxDepth : KSBONJSON_MAX_CONTAINER_DEPTH;
-    unlikely_if((size_t)ctx->containerDepth >= maxDepth)
-    {
-        return KSBONJSON_DECODE_MAX_DEPTH_EXCEEDED;
-    }
-
-    // Reserve slot for array entry (we'll update it after scanning children)
-    size_t arrayIndex = ctx->entriesCount;
-    ctx->entries[arrayIndex] = (KSBONJSONMapEntry){
-        .type = KSBONJSON_TYPE_ARRAY,
-        .data.container = { .firstChild = 0, .count = 0 }
-    };
-    ctx->entriesCount++;
-
-    // Push container onto stack
-    ctx->containerStack[ctx->containerDepth] = arrayIndex;
-    ctx->containerDepth++;
-
-    // The first child will be the next entry
-    size_t firstChild = ctx->entriesCount;
-    uint32_t totalCount = 0;
-    size_t maxContSize = ctx->flags.maxContainerSize < SIZE_MAX ? ctx->flags.maxContainerSize : KSBONJSON_DEFAULT_MAX_CONTAINER_SIZE;
-
-    // Read values until TYPE_END encountered
-    while (true)
-    {
-        MAP_SHOULD_HAVE_ROOM_FOR_BYTES(1);
-        if (ctx->input[ctx->position] == TYPE_END)
-        {
-            ctx->position++; // consume end marker
-            break;
-        }
-
-        size_t childIndex;
-        ksbonjson_decodeStatus status = mapScanValue(ctx, &childIndex);
-        unlikely_if(status != KSBONJSON_DECODE_OK) return status;
-        totalCount++;
-
-        unlikely_if(totalCount > maxContSize)
-        {
-            return KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED;
-        }
-    }
-
-    // Update the array entry with child info and subtree size
-    ctx->entries[arrayIndex].data.container.firstChild = (uint32_t)firstChild;
-    ctx->entries[arrayIndex].data.container.count = totalCount;
-    ctx->entries[arrayIndex].subtreeSize = (uint32_t)(ctx->entriesCount - arrayIndex);
-
-    // Pop container
-    ctx->containerDepth--;
-
-    *outIndex = arrayIndex;
-    return KSBONJSON_DECODE_OK;
+    return ctx->isLazy ? 1 : (uint32_t)(ctx->entriesCount - containerIndex);
 }
 
-// Scan an object name (must be a string)
+static ksbonjson_decodeStatus mapInternKey(KSBONJSONMapContext* ctx, size_t keyIndex);
+
+// Scan an object name (must be a string), interning it if keys are being interned
 static ksbonjson_decodeStatus mapScanObjectName(KSBONJSONMapContext* ctx, size_t* outIndex)
 {
     MAP_SHOULD_HAVE_ROOM_FOR_BYTES(1);
     uint8_t typeCode = ctx->input[ctx->position++];
+    ksbonjson_decodeStatus status;
 
     // Short string: 0x65-0xA7 (range-based detection)
     if (typeCode >= TYPE_STRING0 && typeCode <= TYPE_SHORT_STRING_MAX)
     {
-        return mapScanShortString(ctx, typeCode, outIndex);
+        status = mapScanShortString(ctx, typeCode, outIndex);
     }
     // Long string: 0xFF
-    if (typeCode == TYPE_STRING_LONG)
+    else if (typeCode == TYPE_STRING_LONG)
     {
-        return mapScanLongString(ctx, outIndex);
+        status = mapScanLongString(ctx, outIndex);
     }
-    return KSBONJSON_DECODE_EXPECTED_OBJECT_NAME;
+    else
+    {
+        return KSBONJSON_DECODE_EXPECTED_OBJECT_NAME;
+    }
+
+    if (ctx->internKeys && status == KSBONJSON_DECODE_OK)
+    {
+        status = mapInternKey(ctx, *outIndex);
+    }
+    return status;
 }
 
 /**
@@ -1163,128 +1668,410 @@ static inline bool stringsEqual(
     ) == 0;
 }
 
-// Maximum number of keys we can track for duplicate detection per object.
-// Objects with more keys than this will cause an error if duplicate detection is enabled.
-#define MAX_TRACKED_KEYS 256
-
-// Scan an object container (delimiter-terminated)
-static ksbonjson_decodeStatus mapScanObject(KSBONJSONMapContext* ctx, size_t* outIndex)
+// Hash a key for key sets and indexes (FNV-1a: keys are short, so a bytewise hash is enough)
+static inline uint32_t mapHashKey(const uint8_t* key, size_t length)
 {
-    MAP_SHOULD_HAVE_ENTRY_SPACE();
-
-    // Check max depth (SIZE_MAX means use compile-time default)
-    size_t maxDepth = ctx->flags.maxDepth < SIZE_MAX ? ctx->flags.maxDepth : KSBONJSON_MAX_CONTAINER_DEPTH;
-    unlikely_if((size_t)ctx->containerDepth >= maxDepth)
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
     {
-        return KSBONJSON_DECODE_MAX_DEPTH_EXCEEDED;
+        hash = (hash ^ key[i]) * 16777619u;
     }
+    return hash;
+}
 
-    // Reserve slot for object entry
-    size_t objectIndex = ctx->entriesCount;
-    ctx->entries[objectIndex] = (KSBONJSONMapEntry){
-        .type = KSBONJSON_TYPE_OBJECT,
-        .data.container = { .firstChild = 0, .count = 0 }
-    };
-    ctx->entriesCount++;
-
-    // Push container onto stack
-    ctx->containerStack[ctx->containerDepth] = objectIndex;
-    ctx->containerDepth++;
+static inline void mapKeySetBegin(KSBONJSONMapContext* ctx, KSBONJSONMapKeySet* set)
+{
+    set->base = ctx->keySetTop;
+    set->size = 0;
+    set->count = 0;
+}
 
-    // The first child will be the next entry
-    size_t firstChild = ctx->entriesCount;
-    uint32_t entryCount = 0; // counts individual entries (keys + values)
-    bool checkDuplicates = ctx->flags.rejectDuplicateKeys;
-    size_t maxContSize = ctx->flags.maxContainerSize < SIZE_MAX ? ctx->flags.maxContainerSize : KSBONJSON_DEFAULT_MAX_CONTAINER_SIZE;
+static inline void mapKeySetEnd(KSBONJSONMapContext* ctx, KSBONJSONMapKeySet* set)
+{
+    ctx->keySetTop = set->base;
+}
 
-    // Track key indices for duplicate detection
-    size_t keyIndices[MAX_TRACKED_KEYS];
-    size_t keyCount = 0;
+// Double the set's table, rehashing its keys
+static bool mapKeySetGrow(KSBONJSONMapContext* ctx, KSBONJSONMapKeySet* set)
+{
+    size_t newSize = set->size == 0 ? 16 : set->size * 2;
 
-    // Read key-value pairs until TYPE_END encountered
-    while (true)
+    // The new table is built just above the old one, then moved down over it
+    size_t requiredCapacity = set->base + set->size + newSize;
+    if (requiredCapacity > ctx->keySetCapacity)
     {
-        MAP_SHOULD_HAVE_ROOM_FOR_BYTES(1);
-        if (ctx->input[ctx->position] == TYPE_END)
+        size_t newCapacity = ctx->keySetCapacity * 2;
+        if (newCapacity < requiredCapacity)
         {
-            ctx->position++; // consume end marker
-            break;
+            newCapacity = requiredCapacity;
         }
-
-        // Scan key (must be string)
-        size_t keyIndex;
-        ksbonjson_decodeStatus status = mapScanObjectName(ctx, &keyIndex);
-        unlikely_if(status != KSBONJSON_DECODE_OK) return status;
-
-        // Check for duplicate keys if required
-        if (checkDuplicates)
+        uint32_t* newSlots = realloc(ctx->keySetSlots, newCapacity * sizeof(*newSlots));
+        unlikely_if(newSlots == NULL)
         {
-            // Error if object has more keys than we can track
-            unlikely_if(keyCount >= MAX_TRACKED_KEYS)
-            {
-                return KSBONJSON_DECODE_TOO_MANY_KEYS;
-            }
+            return false;
+        }
+        ctx->keySetSlots = newSlots;
+        ctx->keySetCapacity = newCapacity;
+    }
 
-            const KSBONJSONMapEntry* newKey = &ctx->entries[keyIndex];
-            // Check against all previous keys in this object
-            for (size_t j = 0; j < keyCount; j++)
+    const uint32_t* oldTable = ctx->keySetSlots + set->base;
+    uint32_t* newTable = ctx->keySetSlots + set->base + set->size;
+    memset(newTable, 0, newSize * sizeof(*newTable));
+    size_t mask = newSize - 1;
+    for (size_t i = 0; i < set->size; i++)
+    {
+        if (oldTable[i] != 0)
+        {
+            const KSBONJSONMapEntry* key = &ctx->entries[oldTable[i] - 1];
+            size_t slot = mapHashKey(ctx->input + key->data.string.offset, key->data.string.length) & mask;
+            while (newTable[slot] != 0)
             {
-                const KSBONJSONMapEntry* existingKey = &ctx->entries[keyIndices[j]];
-                unlikely_if(stringsEqual(ctx, newKey, existingKey))
-                {
-                    return KSBONJSON_DECODE_DUPLICATE_OBJECT_NAME;
-                }
+                slot = (slot + 1) & mask;
             }
-            keyIndices[keyCount++] = keyIndex;
+            newTable[slot] = oldTable[i];
         }
+    }
+    memmove(ctx->keySetSlots + set->base, newTable, newSize * sizeof(*newTable));
 
-        // Scan value
-        size_t valueIndex;
-        status = mapScanValue(ctx, &valueIndex);
-        unlikely_if(status != KSBONJSON_DECODE_OK) return status;
-
-        entryCount += 2; // key + value
+    set->size = newSize;
+    ctx->keySetTop = set->base + newSize;
+    return true;
+}
 
-        // Check max container size (entryCount/2 = number of key-value pairs)
-        unlikely_if((entryCount / 2) > maxContSize)
+// Add a key to the set, failing if an equal key is already present
+static ksbonjson_decodeStatus mapKeySetInsert(KSBONJSONMapContext* ctx, KSBONJSONMapKeySet* set, size_t keyIndex)
+{
+    // Keep the load factor at or below 1/2
+    unlikely_if((set->count + 1) * 2 > set->size)
+    {
+        unlikely_if(!mapKeySetGrow(ctx, set))
         {
-            return KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED;
+            return KSBONJSON_DECODE_TOO_MANY_KEYS;
         }
     }
 
-    // Update the object entry with child info and subtree size
-    ctx->entries[objectIndex].data.container.firstChild = (uint32_t)firstChild;
-    ctx->entries[objectIndex].data.container.count = entryCount;
-    ctx->entries[objectIndex].subtreeSize = (uint32_t)(ctx->entriesCount - objectIndex);
-
-    // Pop container
-    ctx->containerDepth--;
-
-    *outIndex = objectIndex;
+    uint32_t* table = ctx->keySetSlots + set->base;
+    const KSBONJSONMapEntry* key = &ctx->entries[keyIndex];
+    size_t mask = set->size - 1;
+    size_t slot = mapHashKey(ctx->input + key->data.string.offset, key->data.string.length) & mask;
+    while (table[slot] != 0)
+    {
+        STATS_ADD(ctx, duplicateKeyComparisons, 1);
+        unlikely_if(stringsEqual(ctx, &ctx->entries[table[slot] - 1], key))
+        {
+            return KSBONJSON_DECODE_DUPLICATE_OBJECT_NAME;
+        }
+        slot = (slot + 1) & mask;
+    }
+    table[slot] = (uint32_t)keyIndex + 1;
+    set->count++;
     return KSBONJSON_DECODE_OK;
 }
 
-// Element size lookup for typed arrays, indexed by (TYPE_TYPED_UINT8 - typeCode)
-static const size_t typedArrayElementSizes[] = {
-    1, 2, 4, 8, 1, 2, 4, 8, 4, 8
-    // uint8, uint16, uint32, uint64, sint8, sint16, sint32, sint64, float32, float64
-};
+static void mapKeySetFree(KSBONJSONMapContext* ctx)
+{
+    free(ctx->keySetSlots);
+    ctx->keySetSlots = NULL;
+    ctx->keySetCapacity = 0;
+    ctx->keySetTop = 0;
+}
 
-// Whether element is signed, indexed by (TYPE_TYPED_UINT8 - typeCode)
-// 0=unsigned, 1=signed, 2=float
-static const int typedArrayElementKinds[] = {
-    0, 0, 0, 0, 1, 1, 1, 1, 2, 2
-    // uint8, uint16, uint32, uint64, sint8, sint16, sint32, sint64, float32, float64
-};
+// Duplicate key sets are only needed while scanning. A growable map keeps the slots
+// for its next scan (see ksbonjson_map_resetGrowable()) and frees them with its entries;
+// a map with a caller's fixed entry buffer has nothing else to free, so it frees them here.
+static void mapKeySetRelease(KSBONJSONMapContext* ctx)
+{
+    if (ctx->growEntries == NULL)
+    {
+        mapKeySetFree(ctx);
+    }
+    else
+    {
+        ctx->keySetTop = 0;
+    }
+}
 
-// Scan a typed array (0xF5-0xFE): expands to regular ARRAY + element entries
-static ksbonjson_decodeStatus mapScanTypedArray(KSBONJSONMapContext* ctx, uint8_t typeCode, size_t* outIndex)
+static bool mapReserveKeyIndex(KSBONJSONMapContext* ctx, size_t slotCount)
 {
-    MAP_SHOULD_HAVE_ENTRY_SPACE();
+    size_t requiredSlots = ctx->keyIndexSlotsCount + slotCount;
+    unlikely_if(requiredSlots > UINT32_MAX)
+    {
+        return false;
+    }
+    if (requiredSlots > ctx->keyIndexSlotsCapacity)
+    {
+        size_t newCapacity = ctx->keyIndexSlotsCapacity * 2;
+        if (newCapacity < requiredSlots)
+        {
+            newCapacity = requiredSlots;
+        }
+        uint32_t* newSlots = realloc(ctx->keyIndexSlots, newCapacity * sizeof(*newSlots));
+        unlikely_if(newSlots == NULL)
+        {
+            return false;
+        }
+        ctx->keyIndexSlots = newSlots;
+        ctx->keyIndexSlotsCapacity = newCapacity;
+    }
+    if (ctx->keyIndexRefsCount == ctx->keyIndexRefsCapacity)
+    {
+        size_t newCapacity = ctx->keyIndexRefsCapacity == 0 ? 16 : ctx->keyIndexRefsCapacity * 2;
+        KSBONJSONKeyIndexRef* newRefs = realloc(ctx->keyIndexRefs, newCapacity * sizeof(*newRefs));
+        unlikely_if(newRefs == NULL)
+        {
+            return false;
+        }
+        ctx->keyIndexRefs = newRefs;
+        ctx->keyIndexRefsCapacity = newCapacity;
+    }
+    return true;
+}
 
-    size_t tableIndex = (size_t)(TYPE_TYPED_UINT8 - typeCode);
-    size_t elementSize = typedArrayElementSizes[tableIndex];
-    int elementKind = typedArrayElementKinds[tableIndex];
+// Build the key index for a scanned object with enough pairs to warrant one.
+// If the object's keys were collected in a duplicate-check set, its table is
+// copied instead of rehashing (both use the same sizing and slot format).
+// The index is an optimization only, so allocation failure just skips it.
+static void mapIndexObjectKeys(KSBONJSONMapContext* ctx, size_t objectIndex, size_t firstChild, size_t pairCount, const KSBONJSONMapKeySet* keySet)
+{
+    if (ctx->keyIndexMinPairs == 0 || pairCount < ctx->keyIndexMinPairs)
+    {
+        return;
+    }
+
+    // Keep the load factor at or below 1/2
+    size_t slotCount = 16;
+    while (slotCount < pairCount * 2)
+    {
+        slotCount *= 2;
+    }
+    unlikely_if(!mapReserveKeyIndex(ctx, slotCount))
+    {
+        return;
+    }
+
+    uint32_t* table = ctx->keyIndexSlots + ctx->keyIndexSlotsCount;
+    size_t mask = slotCount - 1;
+
+    if (keySet != NULL && keySet->size == slotCount)
+    {
+        memcpy(table, ctx->keySetSlots + keySet->base, slotCount * sizeof(*table));
+        pairCount = 0; // Nothing left to hash
+    }
+    else
+    {
+        memset(table, 0, slotCount * sizeof(*table));
+    }
+
+    size_t keyIndex = firstChild;
+    for (size_t i = 0; i < pairCount; i++)
+    {
+        const KSBONJSONMapEntry* keyEntry = &ctx->entries[keyIndex];
+        const uint8_t* key = ctx->input + keyEntry->data.string.offset;
+        size_t slot = mapHashKey(key, keyEntry->data.string.length) & mask;
+        while (table[slot] != 0)
+        {
+            // Keep the first occurrence of a duplicate, matching the linear search
+            if (stringsEqual(ctx, &ctx->entries[table[slot] - 1], keyEntry))
+            {
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        if (table[slot] == 0)
+        {
+            table[slot] = (uint32_t)keyIndex + 1;
+        }
+
+        size_t valueIndex = keyIndex + 1;
+        keyIndex = valueIndex + ctx->entries[valueIndex].subtreeSize;
+    }
+
+    // Objects finish in post-order (and lazy maps expand in any order),
+    // so insert the ref at its sorted position from the end.
+    size_t position = ctx->keyIndexRefsCount;
+    while (position > 0 && ctx->keyIndexRefs[position - 1].objectIndex > objectIndex)
+    {
+        ctx->keyIndexRefs[position] = ctx->keyIndexRefs[position - 1];
+        position--;
+    }
+    ctx->keyIndexRefs[position] = (KSBONJSONKeyIndexRef){
+        .objectIndex = (uint32_t)objectIndex,
+        .firstSlot = (uint32_t)ctx->keyIndexSlotsCount,
+        .slotMask = (uint32_t)mask,
+    };
+    ctx->keyIndexRefsCount++;
+    ctx->keyIndexSlotsCount += slotCount;
+}
+
+static const KSBONJSONKeyIndexRef* mapFindKeyIndex(KSBONJSONMapContext* ctx, size_t objectIndex)
+{
+    size_t low = 0;
+    size_t high = ctx->keyIndexRefsCount;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        size_t midIndex = ctx->keyIndexRefs[mid].objectIndex;
+        if (midIndex == objectIndex)
+        {
+            return &ctx->keyIndexRefs[mid];
+        }
+        if (midIndex < objectIndex)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+// Find the id of the key with these bytes, interning them as a new key if there is none.
+// The hash must be mapHashKey() of the bytes.
+static bool mapInternKeyBytes(KSBONJSONMapContext* ctx, uint32_t offset, uint32_t length, uint32_t hash, uint32_t* outId)
+{
+    // Keep the load factor at or below 1/2
+    unlikely_if((ctx->internedKeyCount + 1) * 2 > ctx->internSlotsCapacity)
+    {
+        size_t newCapacity = ctx->internSlotsCapacity == 0 ? 64 : ctx->internSlotsCapacity * 2;
+        uint32_t* newSlots = calloc(newCapacity, sizeof(*newSlots));
+        unlikely_if(newSlots == NULL)
+        {
+            return false;
+        }
+        size_t mask = newCapacity - 1;
+        for (size_t id = 0; id < ctx->internedKeyCount; id++)
+        {
+            size_t slot = ctx->internedKeys[id].hash & mask;
+            while (newSlots[slot] != 0)
+            {
+                slot = (slot + 1) & mask;
+            }
+            newSlots[slot] = (uint32_t)id + 1;
+        }
+        free(ctx->internSlots);
+        ctx->internSlots = newSlots;
+        ctx->internSlotsCapacity = newCapacity;
+    }
+
+    const uint8_t* bytes = ctx->input + offset;
+    size_t mask = ctx->internSlotsCapacity - 1;
+    size_t slot = hash & mask;
+    while (ctx->internSlots[slot] != 0)
+    {
+        uint32_t id = ctx->internSlots[slot] - 1;
+        const KSBONJSONInternedKey* key = &ctx->internedKeys[id];
+        if (key->hash == hash && key->length == length && memcmp(ctx->input + key->offset, bytes, length) == 0)
+        {
+            *outId = id;
+            return true;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (ctx->internedKeyCount == ctx->internedKeyCapacity)
+    {
+        size_t newCapacity = ctx->internedKeyCapacity == 0 ? 32 : ctx->internedKeyCapacity * 2;
+        KSBONJSONInternedKey* newKeys = realloc(ctx->internedKeys, newCapacity * sizeof(*newKeys));
+        unlikely_if(newKeys == NULL)
+        {
+            return false;
+        }
+        ctx->internedKeys = newKeys;
+        ctx->internedKeyCapacity = newCapacity;
+    }
+    uint32_t id = (uint32_t)ctx->internedKeyCount++;
+    ctx->internedKeys[id] = (KSBONJSONInternedKey){ .offset = offset, .length = length, .hash = hash };
+    ctx->internSlots[slot] = id + 1;
+    *outId = id;
+    return true;
+}
+
+// Make room in the key id table for the entry at index (the table is sparse, so
+// only key entries are ever written)
+static bool mapReserveKeyId(KSBONJSONMapContext* ctx, size_t index)
+{
+    likely_if(index < ctx->keyIdsCapacity)
+    {
+        return true;
+    }
+    size_t newCapacity = ctx->keyIdsCapacity * 2;
+    if (newCapacity < ctx->entriesCapacity)
+    {
+        newCapacity = ctx->entriesCapacity;
+    }
+    if (newCapacity <= index)
+    {
+        newCapacity = index + 1;
+    }
+    uint32_t* newIds = realloc(ctx->keyIds, newCapacity * sizeof(*newIds));
+    unlikely_if(newIds == NULL)
+    {
+        return false;
+    }
+    ctx->keyIds = newIds;
+    ctx->keyIdsCapacity = newCapacity;
+    return true;
+}
+
+// Give the key entry at keyIndex its key id
+static ksbonjson_decodeStatus mapInternKey(KSBONJSONMapContext* ctx, size_t keyIndex)
+{
+    const KSBONJSONMapEntry* key = &ctx->entries[keyIndex];
+    uint32_t offset = key->data.string.offset;
+    uint32_t length = key->data.string.length;
+    uint32_t id;
+    unlikely_if(!mapReserveKeyId(ctx, keyIndex) ||
+                !mapInternKeyBytes(ctx, offset, length, mapHashKey(ctx->input + offset, length), &id))
+    {
+        return KSBONJSON_DECODE_MAP_FULL;
+    }
+    ctx->keyIds[keyIndex] = id;
+    return KSBONJSON_DECODE_OK;
+}
+
+// Give dst (with no interned keys of its own) a copy of src's interned keys
+static bool mapCopyInternedKeys(KSBONJSONMapContext* dst, const KSBONJSONMapContext* src)
+{
+    if (src->internedKeyCount == 0)
+    {
+        return true;
+    }
+    dst->internedKeys = malloc(src->internedKeyCapacity * sizeof(*dst->internedKeys));
+    dst->internSlots = malloc(src->internSlotsCapacity * sizeof(*dst->internSlots));
+    unlikely_if(dst->internedKeys == NULL || dst->internSlots == NULL)
+    {
+        return false;
+    }
+    memcpy(dst->internedKeys, src->internedKeys, src->internedKeyCount * sizeof(*dst->internedKeys));
+    memcpy(dst->internSlots, src->internSlots, src->internSlotsCapacity * sizeof(*dst->internSlots));
+    dst->internedKeyCount = src->internedKeyCount;
+    dst->internedKeyCapacity = src->internedKeyCapacity;
+    dst->internSlotsCapacity = src->internSlotsCapacity;
+    return true;
+}
+
+static void mapFreeInternedKeys(KSBONJSONMapContext* ctx)
+{
+    free(ctx->keyIds);
+    ctx->keyIds = NULL;
+    ctx->keyIdsCapacity = 0;
+    free(ctx->internedKeys);
+    ctx->internedKeys = NULL;
+    ctx->internedKeyCount = 0;
+    ctx->internedKeyCapacity = 0;
+    free(ctx->internSlots);
+    ctx->internSlots = NULL;
+    ctx->internSlotsCapacity = 0;
+}
+
+// Read and validate the element count of a typed array, and check that its element
+// data is present. ctx->position must be at the count that follows the type code,
+// and is left at the start of the element data.
+static ksbonjson_decodeStatus mapReadTypedArrayCount(KSBONJSONMapContext* ctx, uint8_t typeCode, uint32_t* outCount)
+{
+    size_t elementSize = typedArrayElementSizes[TYPE_TYPED_UINT8 - typeCode];
 
     // Read ULEB128 element count
     size_t available = ctx->inputLength - ctx->position;
@@ -1297,8 +2084,7 @@ static ksbonjson_decodeStatus mapScanTypedArray(KSBONJSONMapContext* ctx, uint8_
     ctx->position += bytesRead;
 
     // Check container size limit
-    size_t maxContSize = ctx->flags.maxContainerSize < SIZE_MAX ? ctx->flags.maxContainerSize : KSBONJSON_DEFAULT_MAX_CONTAINER_SIZE;
-    unlikely_if(count64 > maxContSize)
+    unlikely_if(count64 > ctx->maxContainerSize)
     {
         return KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED;
     }
@@ -1308,19 +2094,25 @@ static ksbonjson_decodeStatus mapScanTypedArray(KSBONJSONMapContext* ctx, uint8_
     size_t dataBytes = (size_t)count * elementSize;
     MAP_SHOULD_HAVE_ROOM_FOR_BYTES(dataBytes);
 
-    // Check that we have enough entry space (1 for array + count for elements)
-    unlikely_if(ctx->entriesCount + 1 + count > ctx->entriesCapacity)
-    {
-        return KSBONJSON_DECODE_MAP_FULL;
-    }
+    *outCount = count;
+    return KSBONJSON_DECODE_OK;
+}
 
-    // Reserve slot for array entry
-    size_t arrayIndex = ctx->entriesCount;
-    ctx->entries[arrayIndex] = (KSBONJSONMapEntry){
-        .type = KSBONJSON_TYPE_ARRAY,
-        .data.container = { .firstChild = 0, .count = 0 }
-    };
-    ctx->entriesCount++;
+// Scan the elements of a typed array whose entry is already reserved at arrayIndex,
+// creating an entry per element. ctx->position must be at the element count that
+// follows the type code.
+static ksbonjson_decodeStatus mapScanTypedArrayElements(KSBONJSONMapContext* ctx, uint8_t typeCode, size_t arrayIndex)
+{
+    size_t tableIndex = (size_t)(TYPE_TYPED_UINT8 - typeCode);
+    size_t elementSize = typedArrayElementSizes[tableIndex];
+    int elementKind = typedArrayElementKinds[tableIndex];
+
+    uint32_t count;
+    ksbonjson_decodeStatus status = mapReadTypedArrayCount(ctx, typeCode, &count);
+    unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+
+    // Check that we have enough entry space for the elements
+    MAP_SHOULD_HAVE_ENTRY_SPACE_FOR((size_t)count);
 
     size_t firstChild = ctx->entriesCount;
 
@@ -1377,7 +2169,30 @@ static ksbonjson_decodeStatus mapScanTypedArray(KSBONJSONMapContext* ctx, uint8_
     // Update array entry
     ctx->entries[arrayIndex].data.container.firstChild = (uint32_t)firstChild;
     ctx->entries[arrayIndex].data.container.count = count;
-    ctx->entries[arrayIndex].subtreeSize = (uint32_t)(ctx->entriesCount - arrayIndex);
+    ctx->entries[arrayIndex].subtreeSize = mapContainerSubtreeSize(ctx, arrayIndex);
+
+    return KSBONJSON_DECODE_OK;
+}
+
+// Scan a typed array (0xF5-0xFE) into a single span entry that points at its
+// element data. Elements only get entries of their own if the span is expanded.
+static ksbonjson_decodeStatus mapScanTypedArraySpan(KSBONJSONMapContext* ctx, uint8_t typeCode, size_t* outIndex)
+{
+    MAP_SHOULD_HAVE_ENTRY_SPACE();
+
+    size_t typeCodeOffset = ctx->position - 1;
+    uint32_t count;
+    ksbonjson_decodeStatus status = mapReadTypedArrayCount(ctx, typeCode, &count);
+    unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+    ctx->position += (size_t)count * typedArrayElementSizes[TYPE_TYPED_UINT8 - typeCode];
+
+    size_t arrayIndex = ctx->entriesCount;
+    ctx->entries[arrayIndex] = (KSBONJSONMapEntry){
+        .type = KSBONJSON_TYPE_TYPED_ARRAY,
+        .subtreeSize = 1,
+        .data.typedArray = { .offset = (uint32_t)typeCodeOffset, .count = count }
+    };
+    ctx->entriesCount++;
 
     *outIndex = arrayIndex;
     return KSBONJSON_DECODE_OK;
@@ -1394,10 +2209,10 @@ static ksbonjson_decodeStatus mapScanRecordDef(KSBONJSONMapContext* ctx)
     size_t firstKeyIndex = ctx->entriesCount;
     uint32_t keyCount = 0;
     bool checkDuplicates = ctx->flags.rejectDuplicateKeys;
-    size_t maxContSize = ctx->flags.maxContainerSize < SIZE_MAX ? ctx->flags.maxContainerSize : KSBONJSON_DEFAULT_MAX_CONTAINER_SIZE;
 
-    // Track key indices for duplicate detection within this definition
-    size_t keyIndices[MAX_TRACKED_KEYS];
+    // Track keys for duplicate detection within this definition
+    KSBONJSONMapKeySet keySet;
+    mapKeySetBegin(ctx, &keySet);
 
     // Read key strings until TYPE_END
     while (true)
@@ -1415,29 +2230,19 @@ static ksbonjson_decodeStatus mapScanRecordDef(KSBONJSONMapContext* ctx)
 
         if (checkDuplicates)
         {
-            unlikely_if(keyCount >= MAX_TRACKED_KEYS)
-            {
-                return KSBONJSON_DECODE_TOO_MANY_KEYS;
-            }
-            const KSBONJSONMapEntry* newKey = &ctx->entries[keyIndex];
-            for (size_t j = 0; j < keyCount; j++)
-            {
-                const KSBONJSONMapEntry* existingKey = &ctx->entries[keyIndices[j]];
-                unlikely_if(stringsEqual(ctx, newKey, existingKey))
-                {
-                    return KSBONJSON_DECODE_DUPLICATE_OBJECT_NAME;
-                }
-            }
-            keyIndices[keyCount] = keyIndex;
+            status = mapKeySetInsert(ctx, &keySet, keyIndex);
+            unlikely_if(status != KSBONJSON_DECODE_OK) return status;
         }
 
         keyCount++;
-        unlikely_if(keyCount > maxContSize)
+        unlikely_if(keyCount > ctx->maxContainerSize)
         {
             return KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED;
         }
     }
 
+    mapKeySetEnd(ctx, &keySet);
+
     // Store definition
     ctx->recordDefs[ctx->recordDefCount].firstKeyIndex = firstKeyIndex;
     ctx->recordDefs[ctx->recordDefCount].keyCount = keyCount;
@@ -1446,202 +2251,685 @@ static ksbonjson_decodeStatus mapScanRecordDef(KSBONJSONMapContext* ctx)
     return KSBONJSON_DECODE_OK;
 }
 
-// Scan a record instance (0xBA): expands to regular OBJECT entry
-static ksbonjson_decodeStatus mapScanRecordInstance(KSBONJSONMapContext* ctx, size_t* outIndex)
+// ============================================================================
+// Map Scanner
+// ============================================================================
+
+// The scanner is a single loop over an explicit stack of open containers
+// (ctx->containerStack), so nesting costs a frame in the context rather than a call.
+// Every type code is looked up in mapScanOps to find its handler, which is reached
+// by computed goto where the compiler supports it, and through a switch otherwise.
+
+#ifndef KSBONJSON_MAP_COMPUTED_GOTO
+#   if defined(__GNUC__)
+#       define KSBONJSON_MAP_COMPUTED_GOTO 1
+#   else
+#       define KSBONJSON_MAP_COMPUTED_GOTO 0
+#   endif
+#endif
+
+enum
 {
-    MAP_SHOULD_HAVE_ENTRY_SPACE();
+    MAP_OP_INVALID,
+    MAP_OP_SMALLINT,
+    MAP_OP_SHORT_STRING,
+    MAP_OP_UINT,
+    MAP_OP_SINT,
+    MAP_OP_FLOAT32,
+    MAP_OP_FLOAT64,
+    MAP_OP_BIG_NUMBER,
+    MAP_OP_NULL,
+    MAP_OP_FALSE,
+    MAP_OP_TRUE,
+    MAP_OP_ARRAY,
+    MAP_OP_OBJECT,
+    MAP_OP_RECORD_INSTANCE,
+    MAP_OP_TYPED_ARRAY,
+    MAP_OP_LONG_STRING,
+    MAP_OP_COUNT
+};
 
-    // Read ULEB128 definition index
-    size_t available = ctx->inputLength - ctx->position;
-    uint64_t defIndex64;
-    size_t bytesRead = ksbonjson_readULEB128(ctx->input + ctx->position, available, &defIndex64);
-    unlikely_if(bytesRead == 0)
-    {
-        return KSBONJSON_DECODE_INCOMPLETE;
-    }
-    ctx->position += bytesRead;
+#define o_ MAP_OP_INVALID
+#define i_ MAP_OP_SMALLINT
+#define s_ MAP_OP_SHORT_STRING
+#define ta MAP_OP_TYPED_ARRAY
 
-    // Validate definition index
-    unlikely_if(defIndex64 >= ctx->recordDefCount)
-    {
-        return KSBONJSON_DECODE_INVALID_DATA;
-    }
-    size_t defIndex = (size_t)defIndex64;
-    KSBONJSONRecordDef* def = &ctx->recordDefs[defIndex];
+// Scan handler for each type code. END and record definitions are invalid as values.
+static const uint8_t mapScanOps[256] =
+{
+    /* 0x00 */ i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_,
+    /* 0x10 */ i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_,
+    /* 0x20 */ i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_,
+    /* 0x30 */ i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_,
+    /* 0x40 */ i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_,
+    /* 0x50 */ i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_, i_,
+    /* 0x60 */ i_, i_, i_, i_, i_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_,
+    /* 0x70 */ s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_,
+    /* 0x80 */ s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_,
+    /* 0x90 */ s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_, s_,
+    /* 0xA0 */ s_, s_, s_, s_, s_, s_, s_, s_,
+               MAP_OP_UINT, MAP_OP_UINT, MAP_OP_UINT, MAP_OP_UINT,
+               MAP_OP_SINT, MAP_OP_SINT, MAP_OP_SINT, MAP_OP_SINT,
+    /* 0xB0 */ MAP_OP_FLOAT32, MAP_OP_FLOAT64, MAP_OP_BIG_NUMBER, MAP_OP_NULL,
+               MAP_OP_FALSE, MAP_OP_TRUE, o_, MAP_OP_ARRAY,
+               MAP_OP_OBJECT, o_, MAP_OP_RECORD_INSTANCE, o_, o_, o_, o_, o_,
+    /* 0xC0 */ o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_,
+    /* 0xD0 */ o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_,
+    /* 0xE0 */ o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_, o_,
+    /* 0xF0 */ o_, o_, o_, o_, o_, ta, ta, ta, ta, ta, ta, ta, ta, ta, ta, MAP_OP_LONG_STRING,
+};
 
-    // Check max depth
-    size_t maxDepth = ctx->flags.maxDepth < SIZE_MAX ? ctx->flags.maxDepth : KSBONJSON_MAX_CONTAINER_DEPTH;
-    unlikely_if((size_t)ctx->containerDepth >= maxDepth)
-    {
-        return KSBONJSON_DECODE_MAX_DEPTH_EXCEEDED;
-    }
+#undef o_
+#undef i_
+#undef s_
+#undef ta
 
-    // Reserve slot for object entry
-    size_t objectIndex = ctx->entriesCount;
-    ctx->entries[objectIndex] = (KSBONJSONMapEntry){
-        .type = KSBONJSON_TYPE_OBJECT,
-        .data.container = { .firstChild = 0, .count = 0 }
-    };
-    ctx->entriesCount++;
+// What the children of an open container are
+enum
+{
+    MAP_FRAME_ARRAY,
+    MAP_FRAME_OBJECT,
+    MAP_FRAME_RECORD,
+};
 
-    size_t firstChild = ctx->entriesCount;
-    uint32_t valueCount = 0;
+// Open the container whose entry is at entryIndex, pushing it onto the container stack.
+// For record instances, ctx->position must be at the definition index that follows the type code.
+static inline ksbonjson_decodeStatus mapPushContainer(KSBONJSONMapContext* ctx, uint8_t kind, size_t entryIndex)
+{
+    KSBONJSONMapFrame frame = {
+        .entryIndex = (uint32_t)entryIndex,
+        .firstChild = (uint32_t)ctx->entriesCount,
+        .count = 0,
+        .recordDef = 0,
+        .kind = kind,
+    };
 
-    // Read values until TYPE_END, interleaving with keys from definition
-    while (true)
+    if (kind == MAP_FRAME_RECORD)
     {
-        MAP_SHOULD_HAVE_ROOM_FOR_BYTES(1);
-        if (ctx->input[ctx->position] == TYPE_END)
+        STATS_ADD(ctx, recordInstanceCount, 1);
+
+        // Read ULEB128 definition index
+        uint64_t defIndex64;
+        size_t bytesRead = ksbonjson_readULEB128(ctx->input + ctx->position, ctx->inputLength - ctx->position, &defIndex64);
+        unlikely_if(bytesRead == 0)
         {
-            ctx->position++; // consume end marker
-            break;
+            return KSBONJSON_DECODE_INCOMPLETE;
         }
+        ctx->position += bytesRead;
 
-        // Cannot have more values than keys
-        unlikely_if(valueCount >= def->keyCount)
+        unlikely_if(defIndex64 >= ctx->recordDefCount)
         {
             return KSBONJSON_DECODE_INVALID_DATA;
         }
+        frame.recordDef = (uint32_t)defIndex64;
+    }
+
+    unlikely_if((size_t)ctx->containerDepth >= ctx->maxDepth)
+    {
+        return KSBONJSON_DECODE_MAX_DEPTH_EXCEEDED;
+    }
+
+    mapKeySetBegin(ctx, &frame.keySet);
+    ctx->containerStack[ctx->containerDepth] = frame;
+    ctx->containerDepth++;
+    STATS_MAX(ctx, maxDepth, ctx->containerDepth);
+    return KSBONJSON_DECODE_OK;
+}
 
-        // Check entry space for key + value
-        unlikely_if(ctx->entriesCount + 2 > ctx->entriesCapacity)
+// Append a copy of a record definition's key, as the key of an instance's value
+static inline ksbonjson_decodeStatus mapAddRecordKey(KSBONJSONMapContext* ctx, const KSBONJSONRecordDef* def, size_t keyNumber)
+{
+    size_t defKeyIndex = def->firstKeyIndex + keyNumber;
+    KSBONJSONMapEntry keyEntry = ctx->entries[defKeyIndex];
+    keyEntry.subtreeSize = 1;
+    if (ctx->internKeys)
+    {
+        unlikely_if(!mapReserveKeyId(ctx, ctx->entriesCount))
         {
             return KSBONJSON_DECODE_MAP_FULL;
         }
-
-        // Re-add key from definition (copy the STRING entry)
-        size_t defKeyIndex = def->firstKeyIndex + valueCount;
-        KSBONJSONMapEntry keyEntry = ctx->entries[defKeyIndex];
-        keyEntry.subtreeSize = 1;
-        ctx->entries[ctx->entriesCount] = keyEntry;
-        ctx->entriesCount++;
-
-        // Scan value
-        size_t valueIndex;
-        ksbonjson_decodeStatus status = mapScanValue(ctx, &valueIndex);
-        unlikely_if(status != KSBONJSON_DECODE_OK) return status;
-
-        valueCount++;
+        ctx->keyIds[ctx->entriesCount] = ctx->keyIds[defKeyIndex];
     }
+    ctx->entries[ctx->entriesCount] = keyEntry;
+    ctx->entriesCount++;
+    return KSBONJSON_DECODE_OK;
+}
 
-    // Pad remaining keys with NULL values
-    for (uint32_t i = valueCount; i < def->keyCount; i++)
+// Finish the container on top of the stack once its end marker has been consumed,
+// and pop it. Its entry is only updated here, once all its children have been scanned.
+static ksbonjson_decodeStatus mapPopContainer(KSBONJSONMapContext* ctx)
+{
+    KSBONJSONMapFrame* frame = &ctx->containerStack[ctx->containerDepth - 1];
+    size_t index = frame->entryIndex;
+
+    switch (frame->kind)
     {
-        unlikely_if(ctx->entriesCount + 2 > ctx->entriesCapacity)
+        case MAP_FRAME_ARRAY:
+            break;
+        case MAP_FRAME_OBJECT:
         {
-            return KSBONJSON_DECODE_MAP_FULL;
+            const KSBONJSONMapKeySet* keySet = ctx->flags.rejectDuplicateKeys ? &frame->keySet : NULL;
+            mapIndexObjectKeys(ctx, index, frame->firstChild, frame->count / 2, keySet);
+            mapKeySetEnd(ctx, &frame->keySet);
+            break;
         }
+        case MAP_FRAME_RECORD:
+        {
+            const KSBONJSONRecordDef* def = &ctx->recordDefs[frame->recordDef];
+            bool isCompact = ctx->compactRecords;
 
-        // Re-add key from definition
-        size_t defKeyIndex = def->firstKeyIndex + i;
-        KSBONJSONMapEntry keyEntry = ctx->entries[defKeyIndex];
-        keyEntry.subtreeSize = 1;
-        ctx->entries[ctx->entriesCount] = keyEntry;
-        ctx->entriesCount++;
-
-        // Add NULL value
-        KSBONJSONMapEntry nullEntry = { .type = KSBONJSON_TYPE_NULL, .subtreeSize = 1 };
-        ctx->entries[ctx->entriesCount] = nullEntry;
-        ctx->entriesCount++;
-    }
+            // Pad remaining keys with NULL values
+            for (uint32_t i = frame->count; i < def->keyCount; i++)
+            {
+                MAP_SHOULD_HAVE_ENTRY_SPACE_FOR(isCompact ? 1 : 2);
+                if (!isCompact)
+                {
+                    ksbonjson_decodeStatus status = mapAddRecordKey(ctx, def, i);
+                    unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+                }
+                KSBONJSONMapEntry nullEntry = { .type = KSBONJSON_TYPE_NULL, .subtreeSize = 1 };
+                ctx->entries[ctx->entriesCount] = nullEntry;
+                ctx->entriesCount++;
+            }
 
-    // entryCount = keys + values = 2 * def->keyCount
-    uint32_t entryCount = 2 * def->keyCount;
+            if (isCompact)
+            {
+                // The keys stay in the definition, shared by every instance
+                ctx->entries[index].type = KSBONJSON_TYPE_RECORD;
+                ctx->entries[index].data.record.firstChild = frame->firstChild;
+                ctx->entries[index].data.record.definition = frame->recordDef;
+                ctx->entries[index].subtreeSize = mapContainerSubtreeSize(ctx, index);
+                ctx->containerDepth--;
+                return KSBONJSON_DECODE_OK;
+            }
 
-    // Update the object entry
-    ctx->entries[objectIndex].data.container.firstChild = (uint32_t)firstChild;
-    ctx->entries[objectIndex].data.container.count = entryCount;
-    ctx->entries[objectIndex].subtreeSize = (uint32_t)(ctx->entriesCount - objectIndex);
+            // Keys and values
+            frame->count = 2 * def->keyCount;
+            mapIndexObjectKeys(ctx, index, frame->firstChild, def->keyCount, NULL);
+            break;
+        }
+    }
 
-    *outIndex = objectIndex;
+    ctx->entries[index].data.container.firstChild = frame->firstChild;
+    ctx->entries[index].data.container.count = frame->count;
+    ctx->entries[index].subtreeSize = mapContainerSubtreeSize(ctx, index);
+    ctx->containerDepth--;
     return KSBONJSON_DECODE_OK;
 }
 
-// Main value scanner
-static ksbonjson_decodeStatus mapScanValue(KSBONJSONMapContext* ctx, size_t* outIndex)
+// Reserve the entry of a container, to be filled in when it closes
+static inline size_t mapReserveContainerEntry(KSBONJSONMapContext* ctx, KSBONJSONValueType type)
 {
-    MAP_SHOULD_HAVE_ROOM_FOR_BYTES(1);
-    uint8_t typeCode = ctx->input[ctx->position++];
+    size_t index = ctx->entriesCount;
+    ctx->entries[index] = (KSBONJSONMapEntry){
+        .type = type,
+        .data.container = { .firstChild = 0, .count = 0 }
+    };
+    ctx->entriesCount++;
+    return index;
+}
 
-    // Small integers: 0x00-0x64 (most common case)
-    if (typeCode <= TYPE_SMALLINT_MAX)
+#if KSBONJSON_MAP_COMPUTED_GOTO
+#   pragma GCC diagnostic push
+#   pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+// Scan until the container stack is back down to baseDepth: one whole value if
+// no container above baseDepth is open, or else the rest of the open containers.
+static ksbonjson_decodeStatus mapScanValues(KSBONJSONMapContext* ctx, int baseDepth)
+{
+#if KSBONJSON_MAP_COMPUTED_GOTO
+    static const void* const opLabels[MAP_OP_COUNT] = {
+        [MAP_OP_INVALID] = &&opInvalid,
+        [MAP_OP_SMALLINT] = &&opSmallInt,
+        [MAP_OP_SHORT_STRING] = &&opShortString,
+        [MAP_OP_UINT] = &&opUnsignedInt,
+        [MAP_OP_SINT] = &&opSignedInt,
+        [MAP_OP_FLOAT32] = &&opFloat32,
+        [MAP_OP_FLOAT64] = &&opFloat64,
+        [MAP_OP_BIG_NUMBER] = &&opBigNumber,
+        [MAP_OP_NULL] = &&opNull,
+        [MAP_OP_FALSE] = &&opFalse,
+        [MAP_OP_TRUE] = &&opTrue,
+        [MAP_OP_ARRAY] = &&opArray,
+        [MAP_OP_OBJECT] = &&opObject,
+        [MAP_OP_RECORD_INSTANCE] = &&opRecordInstance,
+        [MAP_OP_TYPED_ARRAY] = &&opTypedArray,
+        [MAP_OP_LONG_STRING] = &&opLongString,
+    };
+#endif
+
+    ksbonjson_decodeStatus status;
+    size_t index;
+    uint8_t typeCode;
+    KSBONJSONMapFrame* frame;
+    KSBONJSONValueType scalarType;
+
+    if (ctx->containerDepth > baseDepth)
     {
-        MAP_SHOULD_HAVE_ENTRY_SPACE();
-        KSBONJSONMapEntry entry = {
-            .type = KSBONJSON_TYPE_INT,
-            .data.intValue = (int64_t)typeCode
-        };
-        *outIndex = mapAddEntry(ctx, entry);
-        return KSBONJSON_DECODE_OK;
+        goto nextChild;
     }
 
-    // Short strings: 0x65-0xA7 (range-based detection)
-    if (typeCode >= TYPE_STRING0 && typeCode <= TYPE_SHORT_STRING_MAX)
+nextValue:
+    MAP_SHOULD_HAVE_ROOM_FOR_BYTES(1);
+    typeCode = ctx->input[ctx->position++];
+#if KSBONJSON_MAP_COMPUTED_GOTO
+    goto *opLabels[mapScanOps[typeCode]];
+#else
+    switch (mapScanOps[typeCode])
     {
-        return mapScanShortString(ctx, typeCode, outIndex);
+        case MAP_OP_SMALLINT: goto opSmallInt;
+        case MAP_OP_SHORT_STRING: goto opShortString;
+        case MAP_OP_UINT: goto opUnsignedInt;
+        case MAP_OP_SINT: goto opSignedInt;
+        case MAP_OP_FLOAT32: goto opFloat32;
+        case MAP_OP_FLOAT64: goto opFloat64;
+        case MAP_OP_BIG_NUMBER: goto opBigNumber;
+        case MAP_OP_NULL: goto opNull;
+        case MAP_OP_FALSE: goto opFalse;
+        case MAP_OP_TRUE: goto opTrue;
+        case MAP_OP_ARRAY: goto opArray;
+        case MAP_OP_OBJECT: goto opObject;
+        case MAP_OP_RECORD_INSTANCE: goto opRecordInstance;
+        case MAP_OP_TYPED_ARRAY: goto opTypedArray;
+        case MAP_OP_LONG_STRING: goto opLongString;
+        default: goto opInvalid;
     }
+#endif
 
-    // Unsigned integers: 0xA8-0xAB (mask-based detection)
-    if ((typeCode & TYPE_MASK_UINT) == TYPE_UINT_BASE)
+opSmallInt:
+    MAP_SHOULD_HAVE_ENTRY_SPACE();
+    mapAddEntry(ctx, (KSBONJSONMapEntry){ .type = KSBONJSON_TYPE_INT, .data.intValue = (int64_t)typeCode });
+    goto valueDone;
+
+opShortString:
+    status = mapScanShortString(ctx, typeCode, &index);
+    goto scalarDone;
+
+opLongString:
+    status = mapScanLongString(ctx, &index);
+    goto scalarDone;
+
+opUnsignedInt:
+    status = mapScanUnsignedInt(ctx, typeCode, &index);
+    goto scalarDone;
+
+opSignedInt:
+    status = mapScanSignedInt(ctx, typeCode, &index);
+    goto scalarDone;
+
+opFloat32:
+    status = mapScanFloat32(ctx, &index);
+    goto scalarDone;
+
+opFloat64:
+    status = mapScanFloat64(ctx, &index);
+    goto scalarDone;
+
+opBigNumber:
+    status = mapScanBigNumber(ctx, &index);
+    goto scalarDone;
+
+opTypedArray:
+    status = mapScanTypedArraySpan(ctx, typeCode, &index);
+    goto scalarDone;
+
+opNull:
+    scalarType = KSBONJSON_TYPE_NULL;
+    goto addConstant;
+
+opFalse:
+    scalarType = KSBONJSON_TYPE_FALSE;
+    goto addConstant;
+
+opTrue:
+    scalarType = KSBONJSON_TYPE_TRUE;
+addConstant:
+    MAP_SHOULD_HAVE_ENTRY_SPACE();
+    mapAddEntry(ctx, (KSBONJSONMapEntry){ .type = scalarType });
+    goto valueDone;
+
+opArray:
+    unlikely_if(ctx->isLazy) goto lazyContainer;
+    MAP_SHOULD_HAVE_ENTRY_SPACE();
+    status = mapPushContainer(ctx, MAP_FRAME_ARRAY, mapReserveContainerEntry(ctx, KSBONJSON_TYPE_ARRAY));
+    unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+    goto nextChild;
+
+opObject:
+    unlikely_if(ctx->isLazy) goto lazyContainer;
+    MAP_SHOULD_HAVE_ENTRY_SPACE();
+    status = mapPushContainer(ctx, MAP_FRAME_OBJECT, mapReserveContainerEntry(ctx, KSBONJSON_TYPE_OBJECT));
+    unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+    goto nextChild;
+
+opRecordInstance:
+    // Mapped as a regular object, or as a RECORD entry if compact
+    unlikely_if(ctx->isLazy) goto lazyContainer;
+    MAP_SHOULD_HAVE_ENTRY_SPACE();
+    status = mapPushContainer(ctx, MAP_FRAME_RECORD, mapReserveContainerEntry(ctx, KSBONJSON_TYPE_OBJECT));
+    unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+    goto nextChild;
+
+lazyContainer:
+    status = mapScanLazyContainer(ctx, typeCode, &index);
+    goto scalarDone;
+
+opInvalid:
+    return KSBONJSON_DECODE_INVALID_DATA;
+
+scalarDone:
+    unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+    // Fall through
+
+valueDone:
+    if (ctx->containerDepth == baseDepth)
     {
-        return mapScanUnsignedInt(ctx, typeCode, outIndex);
+        return KSBONJSON_DECODE_OK;
     }
-
-    // Signed integers: 0xAC-0xAF (mask-based detection)
-    if ((typeCode & TYPE_MASK_SINT) == TYPE_SINT_BASE)
+    frame = &ctx->containerStack[ctx->containerDepth - 1];
+    switch (frame->kind)
     {
-        return mapScanSignedInt(ctx, typeCode, outIndex);
+        case MAP_FRAME_ARRAY:
+            frame->count++;
+            unlikely_if(frame->count > ctx->maxContainerSize)
+            {
+                return KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED;
+            }
+            break;
+        case MAP_FRAME_OBJECT:
+            frame->count += 2; // key + value
+            unlikely_if(frame->count / 2 > ctx->maxContainerSize)
+            {
+                return KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED;
+            }
+            break;
+        default:
+            frame->count++;
+            break;
     }
+    // Fall through
 
-    // Typed arrays: 0xF5-0xFE
-    if (typeCode >= TYPE_TYPED_FLOAT64 && typeCode <= TYPE_TYPED_UINT8)
+nextChild:
+    MAP_SHOULD_HAVE_ROOM_FOR_BYTES(1);
+    if (ctx->input[ctx->position] == TYPE_END)
     {
-        return mapScanTypedArray(ctx, typeCode, outIndex);
+        ctx->position++; // consume end marker
+        status = mapPopContainer(ctx);
+        unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+        goto valueDone;
     }
 
-    // Remaining types (individual checks)
-    switch (typeCode)
+    frame = &ctx->containerStack[ctx->containerDepth - 1];
+    if (frame->kind == MAP_FRAME_OBJECT)
     {
-        case TYPE_STRING_LONG:
-            return mapScanLongString(ctx, outIndex);
-        case TYPE_BIG_NUMBER:
-            return mapScanBigNumber(ctx, outIndex);
-        case TYPE_FLOAT32:
-            return mapScanFloat32(ctx, outIndex);
-        case TYPE_FLOAT64:
-            return mapScanFloat64(ctx, outIndex);
-        case TYPE_NULL:
+        // Scan key (must be string)
+        status = mapScanObjectName(ctx, &index);
+        unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+
+        if (ctx->flags.rejectDuplicateKeys)
         {
-            MAP_SHOULD_HAVE_ENTRY_SPACE();
-            KSBONJSONMapEntry entry = { .type = KSBONJSON_TYPE_NULL };
-            *outIndex = mapAddEntry(ctx, entry);
-            return KSBONJSON_DECODE_OK;
+            status = mapKeySetInsert(ctx, &frame->keySet, index);
+            unlikely_if(status != KSBONJSON_DECODE_OK) return status;
         }
-        case TYPE_FALSE:
+    }
+    else if (frame->kind == MAP_FRAME_RECORD)
+    {
+        const KSBONJSONRecordDef* def = &ctx->recordDefs[frame->recordDef];
+
+        // Cannot have more values than keys
+        unlikely_if(frame->count >= def->keyCount)
         {
-            MAP_SHOULD_HAVE_ENTRY_SPACE();
-            KSBONJSONMapEntry entry = { .type = KSBONJSON_TYPE_FALSE };
-            *outIndex = mapAddEntry(ctx, entry);
-            return KSBONJSON_DECODE_OK;
+            return KSBONJSON_DECODE_INVALID_DATA;
         }
-        case TYPE_TRUE:
+
+        // Keys are interleaved with the values from the definition unless the record is compact
+        if (!ctx->compactRecords)
         {
             MAP_SHOULD_HAVE_ENTRY_SPACE();
-            KSBONJSONMapEntry entry = { .type = KSBONJSON_TYPE_TRUE };
-            *outIndex = mapAddEntry(ctx, entry);
+            status = mapAddRecordKey(ctx, def, frame->count);
+            unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+        }
+    }
+    goto nextValue;
+}
+
+#if KSBONJSON_MAP_COMPUTED_GOTO
+#   pragma GCC diagnostic pop
+#endif
+
+// Scan one whole value, whose entry index is returned in outIndex
+static inline ksbonjson_decodeStatus mapScanValue(KSBONJSONMapContext* ctx, size_t* outIndex)
+{
+    // Every value's entry (or a container's reserved entry) comes first
+    *outIndex = ctx->entriesCount;
+    return mapScanValues(ctx, ctx->containerDepth);
+}
+
+// Scan the children of a container whose entry is already at index, until its end marker.
+// ctx->position must be just past the container's type code.
+static ksbonjson_decodeStatus mapScanContainerChildren(KSBONJSONMapContext* ctx, uint8_t typeCode, size_t index)
+{
+    uint8_t kind = typeCode == TYPE_ARRAY ? MAP_FRAME_ARRAY
+                 : typeCode == TYPE_OBJECT ? MAP_FRAME_OBJECT
+                 : MAP_FRAME_RECORD;
+    ksbonjson_decodeStatus status = mapPushContainer(ctx, kind, index);
+    unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+    return mapScanValues(ctx, ctx->containerDepth - 1);
+}
+
+
+// ============================================================================
+// Lazy Map Scanning
+// ============================================================================
+
+// Skip over the container whose type code was just consumed, checking bounds,
+// nesting depth and delimiters but creating no entries. Everything else is
+// validated when the container is expanded.
+static ksbonjson_decodeStatus mapSkipContainer(KSBONJSONMapContext* ctx, uint8_t typeCode)
+{
+    size_t parentDepth = (size_t)ctx->containerDepth;
+    size_t openCount = 0;
+
+    // Iterative so that skipping cost doesn't depend on the call stack
+    for (;;)
+    {
+        if (typeCode <= TYPE_SMALLINT_MAX)
+        {
+            // No payload
+        }
+        else if (typeCode >= TYPE_STRING0 && typeCode <= TYPE_SHORT_STRING_MAX)
+        {
+            size_t length = (size_t)(typeCode - TYPE_STRING0);
+            MAP_SHOULD_HAVE_ROOM_FOR_BYTES(length);
+            ctx->position += length;
+        }
+        else if ((typeCode & TYPE_MASK_UINT) == TYPE_UINT_BASE || (typeCode & TYPE_MASK_SINT) == TYPE_SINT_BASE)
+        {
+            size_t byteCount = intByteCounts[typeCode & 0x03];
+            MAP_SHOULD_HAVE_ROOM_FOR_BYTES(byteCount);
+            ctx->position += byteCount;
+        }
+        else if (typeCode >= TYPE_TYPED_FLOAT64 && typeCode <= TYPE_TYPED_UINT8)
+        {
+            uint64_t count64;
+            size_t bytesRead = ksbonjson_readULEB128(ctx->input + ctx->position, ctx->inputLength - ctx->position, &count64);
+            unlikely_if(bytesRead == 0)
+            {
+                return KSBONJSON_DECODE_INCOMPLETE;
+            }
+            ctx->position += bytesRead;
+            unlikely_if(count64 > ctx->maxContainerSize)
+            {
+                return KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED;
+            }
+            size_t dataBytes = (size_t)count64 * typedArrayElementSizes[TYPE_TYPED_UINT8 - typeCode];
+            MAP_SHOULD_HAVE_ROOM_FOR_BYTES(dataBytes);
+            ctx->position += dataBytes;
+        }
+        else
+        {
+            switch (typeCode)
+            {
+                case TYPE_STRING_LONG:
+                {
+                    size_t remaining = ctx->inputLength - ctx->position;
+                    size_t offset = ksbonjson_simd_findByte(ctx->input + ctx->position, remaining, TYPE_STRING_LONG);
+                    unlikely_if(offset >= remaining)
+                    {
+                        return KSBONJSON_DECODE_INCOMPLETE;
+                    }
+                    ctx->position += offset + 1;
+                    break;
+                }
+                case TYPE_BIG_NUMBER:
+                {
+                    int64_t exponent;
+                    size_t bytesRead = ksbonjson_readZigzagLEB128(ctx->input + ctx->position, ctx->inputLength - ctx->position, &exponent);
+                    unlikely_if(bytesRead == 0)
+                    {
+                        return KSBONJSON_DECODE_INCOMPLETE;
+                    }
+                    ctx->position += bytesRead;
+                    int64_t signedLength;
+                    bytesRead = ksbonjson_readZigzagLEB128(ctx->input + ctx->position, ctx->inputLength - ctx->position, &signedLength);
+                    unlikely_if(bytesRead == 0)
+                    {
+                        return KSBONJSON_DECODE_INCOMPLETE;
+                    }
+                    ctx->position += bytesRead;
+                    size_t byteCount = (size_t)(signedLength < 0 ? -signedLength : signedLength);
+                    MAP_SHOULD_HAVE_ROOM_FOR_BYTES(byteCount);
+                    ctx->position += byteCount;
+                    break;
+                }
+                case TYPE_FLOAT32:
+                    MAP_SHOULD_HAVE_ROOM_FOR_BYTES(4);
+                    ctx->position += 4;
+                    break;
+                case TYPE_FLOAT64:
+                    MAP_SHOULD_HAVE_ROOM_FOR_BYTES(8);
+                    ctx->position += 8;
+                    break;
+                case TYPE_NULL:
+                case TYPE_FALSE:
+                case TYPE_TRUE:
+                    break;
+                case TYPE_RECORD_INSTANCE:
+                {
+                    uint64_t defIndex64;
+                    size_t bytesRead = ksbonjson_readULEB128(ctx->input + ctx->position, ctx->inputLength - ctx->position, &defIndex64);
+                    unlikely_if(bytesRead == 0)
+                    {
+                        return KSBONJSON_DECODE_INCOMPLETE;
+                    }
+                    ctx->position += bytesRead;
+                    unlikely_if(defIndex64 >= ctx->recordDefCount)
+                    {
+                        return KSBONJSON_DECODE_INVALID_DATA;
+                    }
+                }
+                // Fall through
+                case TYPE_ARRAY:
+                case TYPE_OBJECT:
+                    unlikely_if(parentDepth + openCount >= ctx->maxDepth)
+                    {
+                        return KSBONJSON_DECODE_MAX_DEPTH_EXCEEDED;
+                    }
+                    openCount++;
+                    break;
+                case TYPE_END:
+                    // openCount is never 0 here: the loop exits as soon as the outer container closes
+                    openCount--;
+                    break;
+                default:
+                    return KSBONJSON_DECODE_INVALID_DATA;
+            }
+        }
+
+        if (openCount == 0)
+        {
             return KSBONJSON_DECODE_OK;
         }
-        case TYPE_ARRAY:
-            return mapScanArray(ctx, outIndex);
+
+        MAP_SHOULD_HAVE_ROOM_FOR_BYTES(1);
+        typeCode = ctx->input[ctx->position++];
+    }
+}
+
+static inline KSBONJSONValueType mapLazyContainerType(const KSBONJSONMapContext* ctx, uint8_t typeCode)
+{
+    switch (typeCode)
+    {
         case TYPE_OBJECT:
-            return mapScanObject(ctx, outIndex);
+            return KSBONJSON_TYPE_OBJECT;
         case TYPE_RECORD_INSTANCE:
-            return mapScanRecordInstance(ctx, outIndex);
+            return ctx->compactRecords ? KSBONJSON_TYPE_RECORD : KSBONJSON_TYPE_OBJECT;
         default:
-            return KSBONJSON_DECODE_INVALID_DATA;
+            return KSBONJSON_TYPE_ARRAY;
     }
 }
 
+// Record a container as a single unexpanded entry and skip over its contents
+static ksbonjson_decodeStatus mapScanLazyContainer(KSBONJSONMapContext* ctx, uint8_t typeCode, size_t* outIndex)
+{
+    MAP_SHOULD_HAVE_ENTRY_SPACE();
+
+    size_t typeCodeOffset = ctx->position - 1;
+    ksbonjson_decodeStatus status = mapSkipContainer(ctx, typeCode);
+    unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+
+    KSBONJSONMapEntry entry = {
+        .type = mapLazyContainerType(ctx, typeCode),
+        .data.container = { .firstChild = (uint32_t)typeCodeOffset, .count = KSBONJSON_MAP_UNEXPANDED }
+    };
+    *outIndex = mapAddEntry(ctx, entry);
+    return KSBONJSON_DECODE_OK;
+}
+
+// Scan the children of the unexpanded container or typed array span at index,
+// leaving ctx->position just past it. Nesting depth is counted from this container,
+// since the skip that created it already checked the absolute depth of everything inside.
+static ksbonjson_decodeStatus mapExpandContainer(KSBONJSONMapContext* ctx, size_t index)
+{
+    const KSBONJSONMapEntry* entry = &ctx->entries[index];
+    size_t typeCodeOffset = entry->type == KSBONJSON_TYPE_TYPED_ARRAY
+        ? entry->data.typedArray.offset
+        : entry->data.container.firstChild;
+    uint8_t typeCode = ctx->input[typeCodeOffset];
+    ctx->position = typeCodeOffset + 1;
+    ctx->containerDepth = 0;
+
+    if (typeCode >= TYPE_TYPED_FLOAT64 && typeCode <= TYPE_TYPED_UINT8)
+    {
+        return mapScanTypedArrayElements(ctx, typeCode, index);
+    }
+    return mapScanContainerChildren(ctx, typeCode, index);
+}
+
+// The root container of a lazy map is expanded immediately. Stubbing its
+// children skips over (and so structurally validates) the rest of the document.
+static ksbonjson_decodeStatus mapScanLazyRoot(KSBONJSONMapContext* ctx, size_t* outIndex)
+{
+    MAP_SHOULD_HAVE_ROOM_FOR_BYTES(1);
+    uint8_t typeCode = ctx->input[ctx->position];
+    bool isContainer = typeCode == TYPE_ARRAY ||
+                       typeCode == TYPE_OBJECT ||
+                       typeCode == TYPE_RECORD_INSTANCE;
+    if (!isContainer)
+    {
+        return mapScanValue(ctx, outIndex);
+    }
+
+    MAP_SHOULD_HAVE_ENTRY_SPACE();
+    KSBONJSONMapEntry entry = {
+        .type = mapLazyContainerType(ctx, typeCode),
+        .data.container = { .firstChild = (uint32_t)ctx->position, .count = KSBONJSON_MAP_UNEXPANDED }
+    };
+    *outIndex = mapAddEntry(ctx, entry);
+    return mapExpandContainer(ctx, *outIndex);
+}
+
 
 // ============================================================================
 // Position Map Public API
@@ -1660,11 +2948,38 @@ void ksbonjson_map_beginWithFlags(
     ctx->entries = entries;
     ctx->entriesCapacity = entriesCapacity;
     ctx->entriesCount = 0;
+    ctx->growEntries = NULL;
+    ctx->growUserData = NULL;
     ctx->rootIndex = 0;
     ctx->position = 0;
+    ctx->isLazy = false;
+    ctx->compactRecords = false;
     ctx->containerDepth = 0;
     ctx->flags = flags;
+    ctx->maxDepth = flags.maxDepth < KSBONJSON_MAX_CONTAINER_DEPTH ? flags.maxDepth : KSBONJSON_MAX_CONTAINER_DEPTH;
+    ctx->maxStringLength = flags.maxStringLength < SIZE_MAX ? flags.maxStringLength : KSBONJSON_DEFAULT_MAX_STRING_LENGTH;
+    ctx->maxContainerSize = flags.maxContainerSize < SIZE_MAX ? flags.maxContainerSize : KSBONJSON_DEFAULT_MAX_CONTAINER_SIZE;
+    ctx->maxDocumentSize = flags.maxDocumentSize < SIZE_MAX ? flags.maxDocumentSize : KSBONJSON_DEFAULT_MAX_DOCUMENT_SIZE;
     ctx->recordDefCount = 0;
+    ctx->keyIndexMinPairs = 0;
+    ctx->keyIndexSlots = NULL;
+    ctx->keyIndexSlotsCount = 0;
+    ctx->keyIndexSlotsCapacity = 0;
+    ctx->keyIndexRefs = NULL;
+    ctx->keyIndexRefsCount = 0;
+    ctx->keyIndexRefsCapacity = 0;
+    ctx->internKeys = false;
+    ctx->keyIds = NULL;
+    ctx->keyIdsCapacity = 0;
+    ctx->internedKeys = NULL;
+    ctx->internedKeyCount = 0;
+    ctx->internedKeyCapacity = 0;
+    ctx->internSlots = NULL;
+    ctx->internSlotsCapacity = 0;
+    ctx->keySetSlots = NULL;
+    ctx->keySetCapacity = 0;
+    ctx->keySetTop = 0;
+    ctx->stats = NULL;
 }
 
 void ksbonjson_map_begin(
@@ -1677,7 +2992,250 @@ void ksbonjson_map_begin(
     ksbonjson_map_beginWithFlags(ctx, input, inputLength, entries, entriesCapacity, ksbonjson_defaultDecodeFlags());
 }
 
-ksbonjson_decodeStatus ksbonjson_map_scan(KSBONJSONMapContext* ctx)
+void ksbonjson_map_beginGrowable(
+    KSBONJSONMapContext* ctx,
+    const uint8_t* input,
+    size_t inputLength,
+    KSBONJSONDecodeFlags flags)
+{
+    ksbonjson_map_beginWithFlags(ctx, input, inputLength, NULL, 0, flags);
+    ctx->growEntries = ksbonjson_map_reallocEntries;
+    ctx->keyIndexMinPairs = KSBONJSON_MAP_KEY_INDEX_MIN_PAIRS;
+}
+
+void ksbonjson_map_resetGrowable(
+    KSBONJSONMapContext* ctx,
+    const uint8_t* input,
+    size_t inputLength,
+    KSBONJSONDecodeFlags flags)
+{
+    KSBONJSONMapEntry* const entries = ctx->entries;
+    const size_t entriesCapacity = ctx->entriesCapacity;
+    uint32_t* const keyIndexSlots = ctx->keyIndexSlots;
+    const size_t keyIndexSlotsCapacity = ctx->keyIndexSlotsCapacity;
+    KSBONJSONKeyIndexRef* const keyIndexRefs = ctx->keyIndexRefs;
+    const size_t keyIndexRefsCapacity = ctx->keyIndexRefsCapacity;
+    uint32_t* const keyIds = ctx->keyIds;
+    const size_t keyIdsCapacity = ctx->keyIdsCapacity;
+    KSBONJSONInternedKey* const internedKeys = ctx->internedKeys;
+    const size_t internedKeyCapacity = ctx->internedKeyCapacity;
+    uint32_t* const internSlots = ctx->internSlots;
+    const size_t internSlotsCapacity = ctx->internSlotsCapacity;
+    uint32_t* const keySetSlots = ctx->keySetSlots;
+    const size_t keySetCapacity = ctx->keySetCapacity;
+    KSBONJSONMapStats* const stats = ctx->stats;
+
+    ksbonjson_map_beginGrowable(ctx, input, inputLength, flags);
+
+    // Counts stay at zero from begin; only the allocations (and stats) carry over
+    ctx->entries = entries;
+    ctx->entriesCapacity = entriesCapacity;
+    ctx->keyIndexSlots = keyIndexSlots;
+    ctx->keyIndexSlotsCapacity = keyIndexSlotsCapacity;
+    ctx->keyIndexRefs = keyIndexRefs;
+    ctx->keyIndexRefsCapacity = keyIndexRefsCapacity;
+    ctx->keyIds = keyIds;
+    ctx->keyIdsCapacity = keyIdsCapacity;
+    ctx->internedKeys = internedKeys;
+    ctx->internedKeyCapacity = internedKeyCapacity;
+    ctx->internSlots = internSlots;
+    ctx->internSlotsCapacity = internSlotsCapacity;
+    ctx->keySetSlots = keySetSlots;
+    ctx->keySetCapacity = keySetCapacity;
+    if (internSlots != NULL)
+    {
+        // The old keys were in the old input
+        memset(internSlots, 0, internSlotsCapacity * sizeof(*internSlots));
+    }
+    ctx->stats = stats;
+}
+
+bool ksbonjson_map_reallocEntries(KSBONJSONMapContext* ctx, size_t requiredCapacity)
+{
+    size_t newCapacity;
+    if (ctx->entriesCapacity == 0)
+    {
+        // Typical documents average several bytes per value, so start well below
+        // the one-entry-per-byte worst case and let doubling absorb the rest.
+        newCapacity = ctx->inputLength / 8;
+        if (newCapacity < KSBONJSON_MAP_INITIAL_ENTRIES)
+        {
+            newCapacity = KSBONJSON_MAP_INITIAL_ENTRIES;
+        }
+    }
+    else
+    {
+        newCapacity = ctx->entriesCapacity * 2;
+    }
+    if (newCapacity < requiredCapacity)
+    {
+        newCapacity = requiredCapacity;
+    }
+
+    // Entry indices are stored as uint32_t
+    if (newCapacity > UINT32_MAX)
+    {
+        newCapacity = UINT32_MAX;
+    }
+    unlikely_if(newCapacity < requiredCapacity)
+    {
+        return false;
+    }
+
+    KSBONJSONMapEntry* newEntries = realloc(ctx->entries, newCapacity * sizeof(*newEntries));
+    unlikely_if(newEntries == NULL)
+    {
+        return false;
+    }
+    ctx->entries = newEntries;
+    ctx->entriesCapacity = newCapacity;
+    return true;
+}
+
+void ksbonjson_map_freeEntries(KSBONJSONMapContext* ctx)
+{
+    free(ctx->entries);
+    ctx->entries = NULL;
+    ctx->entriesCapacity = 0;
+    ctx->entriesCount = 0;
+    ksbonjson_map_freeKeyIndex(ctx);
+    mapFreeInternedKeys(ctx);
+    mapKeySetFree(ctx);
+}
+
+void ksbonjson_map_setKeyIndexMinPairs(KSBONJSONMapContext* ctx, size_t minPairs)
+{
+    ctx->keyIndexMinPairs = minPairs;
+}
+
+bool ksbonjson_map_hasKeyIndex(KSBONJSONMapContext* ctx, size_t objectIndex)
+{
+    return mapFindKeyIndex(ctx, objectIndex) != NULL;
+}
+
+void ksbonjson_map_freeKeyIndex(KSBONJSONMapContext* ctx)
+{
+    free(ctx->keyIndexSlots);
+    ctx->keyIndexSlots = NULL;
+    ctx->keyIndexSlotsCount = 0;
+    ctx->keyIndexSlotsCapacity = 0;
+    free(ctx->keyIndexRefs);
+    ctx->keyIndexRefs = NULL;
+    ctx->keyIndexRefsCount = 0;
+    ctx->keyIndexRefsCapacity = 0;
+}
+
+void ksbonjson_map_setInternKeys(KSBONJSONMapContext* ctx, bool internKeys)
+{
+    ctx->internKeys = internKeys;
+}
+
+uint32_t ksbonjson_map_findKeyId(KSBONJSONMapContext* ctx, const char* key, size_t keyLength)
+{
+    if (!ctx->internKeys || ctx->internedKeyCount == 0)
+    {
+        return KSBONJSON_MAP_NO_KEY_ID;
+    }
+    const uint8_t* bytes = (const uint8_t*)key;
+    uint32_t hash = mapHashKey(bytes, keyLength);
+    size_t mask = ctx->internSlotsCapacity - 1;
+    for (size_t slot = hash & mask; ctx->internSlots[slot] != 0; slot = (slot + 1) & mask)
+    {
+        uint32_t id = ctx->internSlots[slot] - 1;
+        const KSBONJSONInternedKey* interned = &ctx->internedKeys[id];
+        if (interned->hash == hash && interned->length == keyLength &&
+            memcmp(ctx->input + interned->offset, bytes, keyLength) == 0)
+        {
+            return id;
+        }
+    }
+    return KSBONJSON_MAP_NO_KEY_ID;
+}
+
+void ksbonjson_map_setLazy(KSBONJSONMapContext* ctx, bool isLazy)
+{
+    ctx->isLazy = isLazy;
+}
+
+void ksbonjson_map_setCompactRecords(KSBONJSONMapContext* ctx, bool compactRecords)
+{
+    ctx->compactRecords = compactRecords;
+}
+
+void ksbonjson_map_setStats(KSBONJSONMapContext* ctx, KSBONJSONMapStats* stats)
+{
+    ctx->stats = stats;
+}
+
+const KSBONJSONRecordDef* ksbonjson_map_getRecordDef(KSBONJSONMapContext* ctx, size_t recordIndex)
+{
+    if (recordIndex >= ctx->entriesCount)
+    {
+        return NULL;
+    }
+    const KSBONJSONMapEntry* entry = &ctx->entries[recordIndex];
+    if (entry->type != KSBONJSON_TYPE_RECORD || entry->data.record.definition >= ctx->recordDefCount)
+    {
+        return NULL;
+    }
+    return &ctx->recordDefs[entry->data.record.definition];
+}
+
+static bool mapIndexGrowEntries(KSBONJSONMapContext* ctx, size_t requiredCapacity);
+
+ksbonjson_decodeStatus ksbonjson_map_expand(KSBONJSONMapContext* ctx, size_t index)
+{
+    unlikely_if(index >= ctx->entriesCount)
+    {
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+
+    const KSBONJSONMapEntry* entry = &ctx->entries[index];
+    bool isSpan = entry->type == KSBONJSON_TYPE_TYPED_ARRAY;
+    bool isStub = (entry->type == KSBONJSON_TYPE_ARRAY || entry->type == KSBONJSON_TYPE_OBJECT ||
+                   entry->type == KSBONJSON_TYPE_RECORD) &&
+                  entry->data.container.count == KSBONJSON_MAP_UNEXPANDED;
+    if (!isSpan && !isStub)
+    {
+        return KSBONJSON_DECODE_OK;
+    }
+
+    // The span's entry is rewritten below, so an opened index's entries
+    // must be moved out of the index first (even if no elements are added)
+    unlikely_if(isSpan && ctx->growEntries == mapIndexGrowEntries && !mapGrowEntries(ctx, ctx->entriesCount + 1))
+    {
+        return KSBONJSON_DECODE_MAP_FULL;
+    }
+
+    STATS_TIMER_START(ctx, startTime);
+    size_t savedPosition = ctx->position;
+    size_t savedCount = ctx->entriesCount;
+    ksbonjson_decodeStatus status = mapExpandContainer(ctx, index);
+    mapKeySetRelease(ctx);
+    unlikely_if(status != KSBONJSON_DECODE_OK)
+    {
+        // The container entry is only written on success, so dropping the
+        // partially scanned children restores the map exactly.
+        ctx->entriesCount = savedCount;
+    }
+    else
+    {
+        STATS_ADD(ctx, expansionCount, 1);
+        STATS_COUNT_ENTRIES(ctx, savedCount);
+        if (isSpan)
+        {
+            // The elements were appended after the rest of the map, not inline.
+            ctx->entries[index].type = KSBONJSON_TYPE_ARRAY;
+            ctx->entries[index].subtreeSize = 1;
+        }
+    }
+    ctx->position = savedPosition;
+    ctx->containerDepth = 0;
+    STATS_TIMER_STOP(ctx, startTime, expandNanoseconds);
+    return status;
+}
+
+static ksbonjson_decodeStatus mapScan(KSBONJSONMapContext* ctx)
 {
     // Handle empty document
     if (ctx->inputLength == 0)
@@ -1685,9 +3243,7 @@ ksbonjson_decodeStatus ksbonjson_map_scan(KSBONJSONMapContext* ctx)
         return KSBONJSON_DECODE_INCOMPLETE;
     }
 
-    // Check max document size (SIZE_MAX means use spec default)
-    size_t maxDocSize = ctx->flags.maxDocumentSize < SIZE_MAX ? ctx->flags.maxDocumentSize : KSBONJSON_DEFAULT_MAX_DOCUMENT_SIZE;
-    unlikely_if(ctx->inputLength > maxDocSize)
+    unlikely_if(ctx->inputLength > ctx->maxDocumentSize)
     {
         return KSBONJSON_DECODE_MAX_DOCUMENT_SIZE_EXCEEDED;
     }
@@ -1699,13 +3255,17 @@ ksbonjson_decodeStatus ksbonjson_map_scan(KSBONJSONMapContext* ctx)
         ksbonjson_decodeStatus status = mapScanRecordDef(ctx);
         if (status != KSBONJSON_DECODE_OK)
         {
+            mapKeySetRelease(ctx);
             return status;
         }
     }
 
     // Scan the root value
     size_t rootIndex;
-    ksbonjson_decodeStatus status = mapScanValue(ctx, &rootIndex);
+    ksbonjson_decodeStatus status = ctx->isLazy ? mapScanLazyRoot(ctx, &rootIndex) : mapScanValue(ctx, &rootIndex);
+
+    mapKeySetRelease(ctx);
+
     if (status != KSBONJSON_DECODE_OK)
     {
         return status;
@@ -1728,6 +3288,434 @@ ksbonjson_decodeStatus ksbonjson_map_scan(KSBONJSONMapContext* ctx)
     return KSBONJSON_DECODE_OK;
 }
 
+ksbonjson_decodeStatus ksbonjson_map_scan(KSBONJSONMapContext* ctx)
+{
+    STATS_TIMER_START(ctx, startTime);
+    ksbonjson_decodeStatus status = mapScan(ctx);
+    STATS_COUNT_ENTRIES(ctx, 0);
+    STATS_TIMER_STOP(ctx, startTime, scanNanoseconds);
+    return status;
+}
+
+ksbonjson_decodeStatus ksbonjson_map_scanDocument(KSBONJSONMapContext* ctx, size_t* outLength)
+{
+    // Limit the scan to the largest allowed document, so that a document which
+    // runs past the limit is reported as too big rather than as incomplete
+    bool isClamped = ctx->inputLength > ctx->maxDocumentSize;
+    if (isClamped)
+    {
+        ctx->inputLength = ctx->maxDocumentSize;
+    }
+
+    // Whatever follows the document is the next document
+    bool rejectTrailingBytes = ctx->flags.rejectTrailingBytes;
+    ctx->flags.rejectTrailingBytes = false;
+    ksbonjson_decodeStatus status = ksbonjson_map_scan(ctx);
+    ctx->flags.rejectTrailingBytes = rejectTrailingBytes;
+
+    unlikely_if(status != KSBONJSON_DECODE_OK)
+    {
+        return isClamped && status == KSBONJSON_DECODE_INCOMPLETE ? KSBONJSON_DECODE_MAX_DOCUMENT_SIZE_EXCEEDED : status;
+    }
+
+    ctx->inputLength = ctx->position;
+    *outLength = ctx->position;
+    return KSBONJSON_DECODE_OK;
+}
+
+ksbonjson_decodeStatus ksbonjson_map_scanNextDocument(
+    KSBONJSONMapContext* ctx,
+    const uint8_t* input,
+    size_t inputLength,
+    size_t* offset)
+{
+    unlikely_if(*offset >= inputLength)
+    {
+        return KSBONJSON_DECODE_INCOMPLETE;
+    }
+
+    const bool isLazy = ctx->isLazy;
+    const bool compactRecords = ctx->compactRecords;
+    const size_t keyIndexMinPairs = ctx->keyIndexMinPairs;
+    const bool internKeys = ctx->internKeys;
+    ksbonjson_map_resetGrowable(ctx, input + *offset, inputLength - *offset, ctx->flags);
+    ctx->isLazy = isLazy;
+    ctx->compactRecords = compactRecords;
+    ctx->keyIndexMinPairs = keyIndexMinPairs;
+    ctx->internKeys = internKeys;
+
+    size_t length;
+    ksbonjson_decodeStatus status = ksbonjson_map_scanDocument(ctx, &length);
+    unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+
+    *offset += length;
+    return KSBONJSON_DECODE_OK;
+}
+
+// Undo a partition that found nothing worth splitting (or failed), so that the
+// context can be handed to ksbonjson_map_scan() as if freshly begun.
+static void mapRewind(KSBONJSONMapContext* ctx)
+{
+    mapKeySetRelease(ctx);
+    ctx->entriesCount = 0;
+    ctx->position = 0;
+    ctx->containerDepth = 0;
+    ctx->recordDefCount = 0;
+}
+
+static ksbonjson_decodeStatus mapPartition(
+    KSBONJSONMapContext* ctx,
+    KSBONJSONMapSegment* segments,
+    size_t maxSegments,
+    size_t* outSegmentCount)
+{
+    if (ctx->inputLength == 0)
+    {
+        return KSBONJSON_DECODE_INCOMPLETE;
+    }
+
+    unlikely_if(ctx->inputLength > ctx->maxDocumentSize)
+    {
+        return KSBONJSON_DECODE_MAX_DOCUMENT_SIZE_EXCEEDED;
+    }
+
+    // Segments need the record definitions (and their key entries) to scan instances
+    while (ctx->position < ctx->inputLength && ctx->input[ctx->position] == TYPE_RECORD_DEF)
+    {
+        ctx->position++; // consume TYPE_RECORD_DEF
+        ksbonjson_decodeStatus status = mapScanRecordDef(ctx);
+        unlikely_if(status != KSBONJSON_DECODE_OK)
+        {
+            mapKeySetRelease(ctx);
+            return status;
+        }
+    }
+    mapKeySetRelease(ctx);
+
+    size_t arrayStart = ctx->position + 1;
+    if (ctx->isLazy || maxSegments < 2 ||
+        ctx->position >= ctx->inputLength || ctx->input[ctx->position] != TYPE_ARRAY ||
+        ctx->inputLength - arrayStart < 2 * KSBONJSON_MAP_MIN_SEGMENT_BYTES)
+    {
+        mapRewind(ctx);
+        return KSBONJSON_DECODE_OK;
+    }
+
+    size_t segmentBytes = (ctx->inputLength - arrayStart) / maxSegments;
+    if (segmentBytes < KSBONJSON_MAP_MIN_SEGMENT_BYTES)
+    {
+        segmentBytes = KSBONJSON_MAP_MIN_SEGMENT_BYTES;
+    }
+
+    // Skip through the elements at depth 1, as the eager scan would see them
+    ctx->position = arrayStart;
+    ctx->containerDepth = 1;
+    size_t segmentCount = 0;
+    size_t totalCount = 0;
+    KSBONJSONMapSegment current = { .offset = arrayStart, .length = 0, .elementCount = 0 };
+    for (;;)
+    {
+        MAP_SHOULD_HAVE_ROOM_FOR_BYTES(1);
+        if (ctx->input[ctx->position] == TYPE_END)
+        {
+            break;
+        }
+
+        // Only split between elements, so an oversized element just makes a longer segment
+        if (ctx->position - current.offset >= segmentBytes && segmentCount < maxSegments - 1)
+        {
+            current.length = ctx->position - current.offset;
+            segments[segmentCount++] = current;
+            current = (KSBONJSONMapSegment){ .offset = ctx->position, .length = 0, .elementCount = 0 };
+        }
+
+        uint8_t typeCode = ctx->input[ctx->position++];
+        ksbonjson_decodeStatus status = mapSkipContainer(ctx, typeCode);
+        unlikely_if(status != KSBONJSON_DECODE_OK) return status;
+        current.elementCount++;
+
+        unlikely_if(++totalCount > ctx->maxContainerSize)
+        {
+            return KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED;
+        }
+    }
+    current.length = ctx->position - current.offset;
+    ctx->position++; // consume end marker
+    ctx->containerDepth = 0;
+
+    unlikely_if(ctx->flags.rejectTrailingBytes && ctx->position < ctx->inputLength)
+    {
+        return KSBONJSON_DECODE_TRAILING_BYTES;
+    }
+
+    if (segmentCount == 0)
+    {
+        // A few huge elements: nothing to share out
+        mapRewind(ctx);
+        return KSBONJSON_DECODE_OK;
+    }
+    segments[segmentCount++] = current;
+    *outSegmentCount = segmentCount;
+    return KSBONJSON_DECODE_OK;
+}
+
+ksbonjson_decodeStatus ksbonjson_map_partition(
+    KSBONJSONMapContext* ctx,
+    KSBONJSONMapSegment* segments,
+    size_t maxSegments,
+    size_t* outSegmentCount)
+{
+    *outSegmentCount = 0;
+    ksbonjson_decodeStatus status = mapPartition(ctx, segments, maxSegments, outSegmentCount);
+    unlikely_if(status != KSBONJSON_DECODE_OK)
+    {
+        // Skipping checks less than scanning does, so the same bad byte can fail
+        // differently. Scan serially to report what ksbonjson_map_scan() would.
+        *outSegmentCount = 0;
+        mapRewind(ctx);
+        ksbonjson_decodeStatus serialStatus = ksbonjson_map_scan(ctx);
+        return serialStatus != KSBONJSON_DECODE_OK ? serialStatus : status;
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+ksbonjson_decodeStatus ksbonjson_map_scanSegment(
+    KSBONJSONMapContext* segmentCtx,
+    const KSBONJSONMapContext* ctx,
+    KSBONJSONMapSegment segment)
+{
+    ksbonjson_map_beginGrowable(segmentCtx, ctx->input, ctx->inputLength, ctx->flags);
+    segmentCtx->keyIndexMinPairs = ctx->keyIndexMinPairs;
+    segmentCtx->compactRecords = ctx->compactRecords;
+    memcpy(segmentCtx->recordDefs, ctx->recordDefs, ctx->recordDefCount * sizeof(*ctx->recordDefs));
+    segmentCtx->recordDefCount = ctx->recordDefCount;
+
+    // Size the buffer from the segment rather than the whole input.
+    // The record definitions' key entries go first, at the indexes the definitions expect.
+    size_t preludeCount = ctx->entriesCount;
+    size_t initialCapacity = preludeCount + segment.length / 8;
+    if (initialCapacity < KSBONJSON_MAP_INITIAL_ENTRIES)
+    {
+        initialCapacity = KSBONJSON_MAP_INITIAL_ENTRIES;
+    }
+    segmentCtx->entries = malloc(initialCapacity * sizeof(*segmentCtx->entries));
+    unlikely_if(segmentCtx->entries == NULL)
+    {
+        return KSBONJSON_DECODE_MAP_FULL;
+    }
+    segmentCtx->entriesCapacity = initialCapacity;
+    // With no record definitions there are no entries yet, and ctx->entries may be NULL
+    if (preludeCount > 0)
+    {
+        memcpy(segmentCtx->entries, ctx->entries, preludeCount * sizeof(*ctx->entries));
+    }
+    segmentCtx->entriesCount = preludeCount;
+
+    // Start from the document's keys so far (the definitions' keys), so that those keep
+    // their ids. Keys new to the segment are renumbered when the segments are joined.
+    if (ctx->internKeys)
+    {
+        segmentCtx->internKeys = true;
+        unlikely_if(!mapReserveKeyId(segmentCtx, initialCapacity - 1) || !mapCopyInternedKeys(segmentCtx, ctx))
+        {
+            return KSBONJSON_DECODE_MAP_FULL;
+        }
+        if (preludeCount > 0)
+        {
+            memcpy(segmentCtx->keyIds, ctx->keyIds, preludeCount * sizeof(*ctx->keyIds));
+        }
+    }
+
+    segmentCtx->position = segment.offset;
+    // The elements are scanned at depth 1, as if inside the root array
+    segmentCtx->containerDepth = 1;
+    ksbonjson_decodeStatus status = KSBONJSON_DECODE_OK;
+    for (size_t i = 0; i < segment.elementCount && status == KSBONJSON_DECODE_OK; i++)
+    {
+        size_t elementIndex;
+        status = mapScanValue(segmentCtx, &elementIndex);
+    }
+    mapKeySetRelease(segmentCtx);
+    segmentCtx->containerDepth = 0;
+    return status;
+}
+
+// Intern the keys a segment found into the document's keys, then set the key ids of
+// the segment's key entries, which have been copied to [base, base + count)
+static bool mapJoinKeyIds(
+    KSBONJSONMapContext* ctx,
+    const KSBONJSONMapContext* segment,
+    uint32_t* keyIdMap,
+    size_t sharedKeyCount,
+    size_t base,
+    size_t count,
+    uint32_t delta)
+{
+    for (size_t id = sharedKeyCount; id < segment->internedKeyCount; id++)
+    {
+        const KSBONJSONInternedKey* key = &segment->internedKeys[id];
+        unlikely_if(!mapInternKeyBytes(ctx, key->offset, key->length, key->hash, &keyIdMap[id - sharedKeyCount]))
+        {
+            return false;
+        }
+    }
+
+    // Segments are never lazy, so every object's pairs are in place.
+    // Non-compact record instances are objects too; compact ones have no keys.
+    for (size_t j = base; j < base + count; j++)
+    {
+        if (ctx->entries[j].type != KSBONJSON_TYPE_OBJECT)
+        {
+            continue;
+        }
+        size_t keyIndex = ctx->entries[j].data.container.firstChild;
+        uint32_t pairCount = ctx->entries[j].data.container.count / 2;
+        for (uint32_t pair = 0; pair < pairCount; pair++)
+        {
+            uint32_t id = segment->keyIds[keyIndex - delta];
+            ctx->keyIds[keyIndex] = id < sharedKeyCount ? id : keyIdMap[id - sharedKeyCount];
+            size_t valueIndex = keyIndex + 1;
+            keyIndex = valueIndex + ctx->entries[valueIndex].subtreeSize;
+        }
+    }
+    return true;
+}
+
+ksbonjson_decodeStatus ksbonjson_map_joinSegments(
+    KSBONJSONMapContext* ctx,
+    const KSBONJSONMapContext* segmentContexts,
+    size_t segmentCount)
+{
+    size_t preludeCount = ctx->entriesCount;
+    size_t rootIndex = preludeCount;
+    size_t totalEntries = rootIndex + 1;
+    size_t totalSlots = ctx->keyIndexSlotsCount;
+    size_t totalRefs = ctx->keyIndexRefsCount;
+    size_t mostNewKeys = 0;
+    const size_t sharedKeyCount = ctx->internedKeyCount;
+    for (size_t i = 0; i < segmentCount; i++)
+    {
+        totalEntries += segmentContexts[i].entriesCount - preludeCount;
+        totalSlots += segmentContexts[i].keyIndexSlotsCount;
+        totalRefs += segmentContexts[i].keyIndexRefsCount;
+        if (segmentContexts[i].internedKeyCount - sharedKeyCount > mostNewKeys)
+        {
+            mostNewKeys = segmentContexts[i].internedKeyCount - sharedKeyCount;
+        }
+    }
+    MAP_SHOULD_HAVE_ENTRY_SPACE_FOR(totalEntries - ctx->entriesCount);
+
+    // Each segment numbered the keys it found after the shared ones itself;
+    // keyIdMap takes those ids to the document's
+    uint32_t* keyIdMap = NULL;
+    if (ctx->internKeys)
+    {
+        keyIdMap = malloc((mostNewKeys + 1) * sizeof(*keyIdMap));
+        unlikely_if(keyIdMap == NULL || !mapReserveKeyId(ctx, totalEntries - 1))
+        {
+            free(keyIdMap);
+            return KSBONJSON_DECODE_MAP_FULL;
+        }
+    }
+
+    // The key indexes are an optimization only, so drop them rather than fail
+    bool keepKeyIndex = totalSlots <= UINT32_MAX;
+    if (keepKeyIndex && totalSlots > ctx->keyIndexSlotsCapacity)
+    {
+        uint32_t* newSlots = realloc(ctx->keyIndexSlots, totalSlots * sizeof(*newSlots));
+        keepKeyIndex = newSlots != NULL;
+        if (keepKeyIndex)
+        {
+            ctx->keyIndexSlots = newSlots;
+            ctx->keyIndexSlotsCapacity = totalSlots;
+        }
+    }
+    if (keepKeyIndex && totalRefs > ctx->keyIndexRefsCapacity)
+    {
+        KSBONJSONKeyIndexRef* newRefs = realloc(ctx->keyIndexRefs, totalRefs * sizeof(*newRefs));
+        keepKeyIndex = newRefs != NULL;
+        if (keepKeyIndex)
+        {
+            ctx->keyIndexRefs = newRefs;
+            ctx->keyIndexRefsCapacity = totalRefs;
+        }
+    }
+    if (!keepKeyIndex)
+    {
+        ksbonjson_map_freeKeyIndex(ctx);
+    }
+
+    size_t base = rootIndex + 1;
+    uint32_t elementCount = 0;
+    for (size_t i = 0; i < segmentCount; i++)
+    {
+        const KSBONJSONMapContext* segment = &segmentContexts[i];
+        size_t count = segment->entriesCount - preludeCount;
+        // Segment indexes start after the prelude; their final home starts at base
+        uint32_t delta = (uint32_t)(base - preludeCount);
+
+        KSBONJSONMapEntry* dst = ctx->entries + base;
+        memcpy(dst, segment->entries + preludeCount, count * sizeof(*dst));
+        for (size_t j = 0; j < count; j++)
+        {
+            if (dst[j].type == KSBONJSON_TYPE_ARRAY || dst[j].type == KSBONJSON_TYPE_OBJECT)
+            {
+                dst[j].data.container.firstChild += delta;
+            }
+            else if (dst[j].type == KSBONJSON_TYPE_RECORD)
+            {
+                dst[j].data.record.firstChild += delta;
+            }
+        }
+        for (size_t j = 0; j < count; j += dst[j].subtreeSize)
+        {
+            elementCount++;
+        }
+
+        if (keyIdMap != NULL)
+        {
+            unlikely_if(!mapJoinKeyIds(ctx, segment, keyIdMap, sharedKeyCount, base, count, delta))
+            {
+                free(keyIdMap);
+                return KSBONJSON_DECODE_MAP_FULL;
+            }
+        }
+
+        if (keepKeyIndex)
+        {
+            uint32_t* slots = ctx->keyIndexSlots + ctx->keyIndexSlotsCount;
+            for (size_t j = 0; j < segment->keyIndexSlotsCount; j++)
+            {
+                uint32_t slot = segment->keyIndexSlots[j];
+                slots[j] = slot == 0 ? 0 : slot + delta;
+            }
+            KSBONJSONKeyIndexRef* refs = ctx->keyIndexRefs + ctx->keyIndexRefsCount;
+            for (size_t j = 0; j < segment->keyIndexRefsCount; j++)
+            {
+                refs[j] = segment->keyIndexRefs[j];
+                refs[j].objectIndex += delta;
+                refs[j].firstSlot += (uint32_t)ctx->keyIndexSlotsCount;
+            }
+            ctx->keyIndexSlotsCount += segment->keyIndexSlotsCount;
+            ctx->keyIndexRefsCount += segment->keyIndexRefsCount;
+        }
+
+        base += count;
+    }
+
+    free(keyIdMap);
+
+    ctx->entries[rootIndex] = (KSBONJSONMapEntry){
+        .type = KSBONJSON_TYPE_ARRAY,
+        .subtreeSize = (uint32_t)(totalEntries - rootIndex),
+        .data.container = { .firstChild = (uint32_t)(rootIndex + 1), .count = elementCount }
+    };
+    ctx->entriesCount = totalEntries;
+    ctx->rootIndex = rootIndex;
+    STATS_COUNT_ENTRIES(ctx, 0);
+    return KSBONJSON_DECODE_OK;
+}
+
 size_t ksbonjson_map_root(KSBONJSONMapContext* ctx)
 {
     return ctx->rootIndex;
@@ -1790,19 +3778,35 @@ size_t ksbonjson_map_getChild(
         return SIZE_MAX;
     }
 
+    unlikely_if(ksbonjson_map_expand(ctx, containerIndex) != KSBONJSON_DECODE_OK)
+    {
+        return SIZE_MAX;
+    }
+
     const KSBONJSONMapEntry* entry = &ctx->entries[containerIndex];
-    if (entry->type != KSBONJSON_TYPE_ARRAY && entry->type != KSBONJSON_TYPE_OBJECT)
+    size_t childCount;
+    size_t currentIndex;
+    if (entry->type == KSBONJSON_TYPE_RECORD)
+    {
+        childCount = ctx->recordDefs[entry->data.record.definition].keyCount;
+        currentIndex = entry->data.record.firstChild;
+    }
+    else if (entry->type == KSBONJSON_TYPE_ARRAY || entry->type == KSBONJSON_TYPE_OBJECT)
+    {
+        childCount = entry->data.container.count;
+        currentIndex = entry->data.container.firstChild;
+    }
+    else
     {
         return SIZE_MAX;
     }
 
-    if (childIndex >= entry->data.container.count)
+    if (childIndex >= childCount)
     {
         return SIZE_MAX;
     }
 
     // Walk from firstChild, skipping over subtrees until we reach childIndex
-    size_t currentIndex = entry->data.container.firstChild;
     for (size_t i = 0; i < childIndex; i++)
     {
         currentIndex += mapSubtreeSize(ctx, currentIndex);
@@ -1822,12 +3826,56 @@ size_t ksbonjson_map_findKey(
         return SIZE_MAX;
     }
 
+    unlikely_if(ksbonjson_map_expand(ctx, objectIndex) != KSBONJSON_DECODE_OK)
+    {
+        return SIZE_MAX;
+    }
+
     const KSBONJSONMapEntry* objEntry = &ctx->entries[objectIndex];
+    if (objEntry->type == KSBONJSON_TYPE_RECORD)
+    {
+        // Find the key's position in the definition, then step over that many values
+        const KSBONJSONRecordDef* def = &ctx->recordDefs[objEntry->data.record.definition];
+        for (uint32_t i = 0; i < def->keyCount; i++)
+        {
+            const KSBONJSONMapEntry* keyEntry = &ctx->entries[def->firstKeyIndex + i];
+            if (keyEntry->data.string.length == keyLength &&
+                memcmp(ctx->input + keyEntry->data.string.offset, key, keyLength) == 0)
+            {
+                size_t valueIndex = objEntry->data.record.firstChild;
+                for (uint32_t j = 0; j < i; j++)
+                {
+                    valueIndex += mapSubtreeSize(ctx, valueIndex);
+                }
+                return valueIndex;
+            }
+        }
+        return SIZE_MAX;
+    }
     if (objEntry->type != KSBONJSON_TYPE_OBJECT)
     {
         return SIZE_MAX;
     }
 
+    const KSBONJSONKeyIndexRef* keyIndex = mapFindKeyIndex(ctx, objectIndex);
+    if (keyIndex != NULL)
+    {
+        const uint32_t* table = ctx->keyIndexSlots + keyIndex->firstSlot;
+        size_t slot = mapHashKey((const uint8_t*)key, keyLength) & keyIndex->slotMask;
+        while (table[slot] != 0)
+        {
+            size_t keyEntryIndex = table[slot] - 1;
+            const KSBONJSONMapEntry* keyEntry = &ctx->entries[keyEntryIndex];
+            if (keyEntry->data.string.length == keyLength &&
+                memcmp(ctx->input + keyEntry->data.string.offset, key, keyLength) == 0)
+            {
+                return keyEntryIndex + 1;
+            }
+            slot = (slot + 1) & keyIndex->slotMask;
+        }
+        return SIZE_MAX;
+    }
+
     // Object children are stored as key, value, key, value, ...
     // count is the total number of entries (keys + values)
     size_t pairCount = objEntry->data.container.count / 2;
@@ -1864,6 +3912,51 @@ size_t ksbonjson_map_findKey(
     return SIZE_MAX;
 }
 
+KSBONJSONBigNumberValue ksbonjson_map_decodeBigNumber(
+    const uint8_t* input,
+    const KSBONJSONMapEntry* entry)
+{
+    KSBONJSONBigNumberValue value = {0};
+    if (entry->type != KSBONJSON_TYPE_BIGNUMBER)
+    {
+        return value;
+    }
+
+    // The payload was fully validated during the scan, so the reads can't fail here.
+    const uint8_t* payload = input + entry->data.bigNumber.offset;
+    size_t available = entry->data.bigNumber.length;
+
+    int64_t exponent = 0;
+    size_t bytesRead = ksbonjson_readZigzagLEB128(payload, available, &exponent);
+    payload += bytesRead;
+    available -= bytesRead;
+
+    int64_t signedLength = 0;
+    bytesRead = ksbonjson_readZigzagLEB128(payload, available, &signedLength);
+    payload += bytesRead;
+
+    if (signedLength != 0)
+    {
+        value.sign = signedLength < 0 ? -1 : 0;
+        size_t byteCount = (size_t)(signedLength < 0 ? -signedLength : signedLength);
+        memcpy(value.significand, payload, byteCount);
+    }
+    value.exponent = (int32_t)exponent;
+    return value;
+}
+
+KSBONJSONBigNumberValue ksbonjson_map_getBigNumber(
+    KSBONJSONMapContext* ctx,
+    size_t index)
+{
+    if (index >= ctx->entriesCount)
+    {
+        KSBONJSONBigNumberValue value = {0};
+        return value;
+    }
+    return ksbonjson_map_decodeBigNumber(ctx->input, &ctx->entries[index]);
+}
+
 size_t ksbonjson_map_estimateEntries(size_t inputLength)
 {
     // Conservative estimate: at minimum 1 byte per value (small ints),
@@ -1872,15 +3965,582 @@ size_t ksbonjson_map_estimateEntries(size_t inputLength)
     // We use inputLength as a safe upper bound.
     if (inputLength == 0)
     {
-        return 1; // At least one entry for empty container
+        return 1; // At least one entry for empty container
+    }
+    return inputLength;
+}
+
+
+bool ksbonjson_map_getTypedArray(
+    KSBONJSONMapContext* ctx,
+    size_t index,
+    KSBONJSONTypedArray* outArray)
+{
+    if (index >= ctx->entriesCount)
+    {
+        return false;
+    }
+
+    const KSBONJSONMapEntry* entry = &ctx->entries[index];
+    if (entry->type != KSBONJSON_TYPE_TYPED_ARRAY)
+    {
+        return false;
+    }
+
+    // The count was validated during the scan; re-reading it locates the data.
+    size_t offset = entry->data.typedArray.offset;
+    uint8_t typeCode = ctx->input[offset];
+    uint64_t count64;
+    size_t bytesRead = ksbonjson_readULEB128(ctx->input + offset + 1, ctx->inputLength - offset - 1, &count64);
+
+    size_t tableIndex = (size_t)(TYPE_TYPED_UINT8 - typeCode);
+    outArray->data = ctx->input + offset + 1 + bytesRead;
+    outArray->count = entry->data.typedArray.count;
+    outArray->elementSize = typedArrayElementSizes[tableIndex];
+    outArray->elementType = (KSBONJSONTypedElementType)tableIndex;
+    return true;
+}
+
+
+// ============================================================================
+// Map Indexes
+// ============================================================================
+
+// An index is a header followed by the map's tables, each starting on an
+// 8-byte boundary (so that an index read straight from a file is aligned).
+// Everything is stored in the writer's native layout.
+
+#define MAP_INDEX_MAGIC "KSBJMIDX"
+#define MAP_INDEX_VERSION 1
+#define MAP_INDEX_BYTE_ORDER_MARK 0x01020304u
+
+enum
+{
+    MAP_INDEX_RECORD_DEFS,
+    MAP_INDEX_ENTRIES,
+    MAP_INDEX_KEY_INDEX_SLOTS,
+    MAP_INDEX_KEY_INDEX_REFS,
+    MAP_INDEX_KEY_IDS,
+    MAP_INDEX_INTERNED_KEYS,
+    MAP_INDEX_INTERN_SLOTS,
+    MAP_INDEX_SECTION_COUNT,
+};
+
+static const size_t mapIndexElementSizes[MAP_INDEX_SECTION_COUNT] =
+{
+    sizeof(KSBONJSONRecordDef),
+    sizeof(KSBONJSONMapEntry),
+    sizeof(uint32_t),
+    sizeof(KSBONJSONKeyIndexRef),
+    sizeof(uint32_t),
+    sizeof(KSBONJSONInternedKey),
+    sizeof(uint32_t),
+};
+
+// What the scan was told to check. An index only opens with the same settings.
+typedef struct {
+    uint64_t maxDepth;             // The resolved limits
+    uint64_t maxStringLength;
+    uint64_t maxContainerSize;
+    uint64_t maxDocumentSize;
+    uint8_t rejectNUL;
+    uint8_t rejectInvalidUTF8;
+    uint8_t rejectDuplicateKeys;
+    uint8_t rejectTrailingBytes;
+    uint8_t padding[4];
+} MapIndexScanSettings;
+
+typedef struct {
+    char magic[8];
+    uint32_t byteOrderMark;        // MAP_INDEX_BYTE_ORDER_MARK in the writer's byte order
+    uint16_t version;
+    uint8_t entrySize;             // sizeof(KSBONJSONMapEntry) on the writer
+    uint8_t sizeSize;              // sizeof(size_t) on the writer (record definitions hold one)
+    uint64_t documentLength;
+    uint64_t documentFingerprint;
+    MapIndexScanSettings settings;
+    uint64_t rootIndex;
+    uint64_t keyIndexMinPairs;
+    uint64_t internSlotsCapacity;
+    uint8_t compactRecords;
+    uint8_t internKeys;
+    uint8_t padding[6];
+    uint64_t counts[MAP_INDEX_SECTION_COUNT];  // Elements in each table
+} MapIndexHeader;
+
+_Static_assert(sizeof(MapIndexHeader) % 8 == 0, "Map index sections must stay 8-byte aligned");
+
+static inline size_t mapIndexAlign(size_t offset)
+{
+    return (offset + 7) & ~(size_t)7;
+}
+
+static inline uint64_t mapIndexHashBytes(uint64_t hash, const uint8_t* bytes, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static void mapIndexFillScanSettings(MapIndexScanSettings* settings, const KSBONJSONMapContext* ctx)
+{
+    // Zeroed first, so that settings compare with memcmp()
+    memset(settings, 0, sizeof(*settings));
+    settings->maxDepth = ctx->maxDepth;
+    settings->maxStringLength = ctx->maxStringLength;
+    settings->maxContainerSize = ctx->maxContainerSize;
+    settings->maxDocumentSize = ctx->maxDocumentSize;
+    settings->rejectNUL = ctx->flags.rejectNUL;
+    settings->rejectInvalidUTF8 = ctx->flags.rejectInvalidUTF8;
+    settings->rejectDuplicateKeys = ctx->flags.rejectDuplicateKeys;
+    settings->rejectTrailingBytes = ctx->flags.rejectTrailingBytes;
+}
+
+// Work out where each table starts. Returns false if they don't fit in indexLength bytes.
+static bool mapIndexLayout(
+    const MapIndexHeader* header,
+    size_t indexLength,
+    size_t offsets[MAP_INDEX_SECTION_COUNT],
+    size_t* outLength)
+{
+    size_t offset = sizeof(*header);
+    for (int i = 0; i < MAP_INDEX_SECTION_COUNT; i++)
+    {
+        offsets[i] = offset;
+        unlikely_if(offset > indexLength || header->counts[i] > (indexLength - offset) / mapIndexElementSizes[i])
+        {
+            return false;
+        }
+        offset = mapIndexAlign(offset + (size_t)header->counts[i] * mapIndexElementSizes[i]);
+    }
+    unlikely_if(offset > indexLength)
+    {
+        return false;
+    }
+    *outLength = offset;
+    return true;
+}
+
+// Copy the key ids of every key entry, and KSBONJSON_MAP_NO_KEY_ID for the rest
+// (whose slots in ctx->keyIds were never written).
+static void mapIndexCopyKeyIds(const KSBONJSONMapContext* ctx, uint32_t* keyIds)
+{
+    for (size_t i = 0; i < ctx->entriesCount; i++)
+    {
+        keyIds[i] = KSBONJSON_MAP_NO_KEY_ID;
+    }
+    for (size_t i = 0; i < ctx->recordDefCount; i++)
+    {
+        const KSBONJSONRecordDef* def = &ctx->recordDefs[i];
+        for (size_t j = def->firstKeyIndex; j < def->firstKeyIndex + def->keyCount; j++)
+        {
+            keyIds[j] = ctx->keyIds[j];
+        }
+    }
+    for (size_t i = 0; i < ctx->entriesCount; i++)
+    {
+        const KSBONJSONMapEntry* entry = &ctx->entries[i];
+        if (entry->type != KSBONJSON_TYPE_OBJECT)
+        {
+            continue;
+        }
+        size_t keyIndex = entry->data.container.firstChild;
+        for (uint32_t pair = 0; pair < entry->data.container.count / 2; pair++)
+        {
+            keyIds[keyIndex] = ctx->keyIds[keyIndex];
+            keyIndex += 1 + ctx->entries[keyIndex + 1].subtreeSize;
+        }
+    }
+}
+
+// The first growth of an opened map's entries moves them out of the index,
+// after which they grow as a growable map's do.
+static bool mapIndexGrowEntries(KSBONJSONMapContext* ctx, size_t requiredCapacity)
+{
+    KSBONJSONMapEntry* const indexEntries = ctx->entries;
+    const size_t indexCapacity = ctx->entriesCapacity;
+    ctx->entries = NULL;
+    ctx->entriesCapacity = 0;
+    unlikely_if(!ksbonjson_map_reallocEntries(ctx, requiredCapacity))
+    {
+        ctx->entries = indexEntries;
+        ctx->entriesCapacity = indexCapacity;
+        return false;
+    }
+    memcpy(ctx->entries, indexEntries, ctx->entriesCount * sizeof(*indexEntries));
+    ctx->growEntries = ksbonjson_map_reallocEntries;
+    return true;
+}
+
+uint64_t ksbonjson_map_fingerprint(const uint8_t* input, size_t inputLength)
+{
+    uint64_t length = inputLength;
+    uint64_t hash = mapIndexHashBytes(14695981039346656037ull, (const uint8_t*)&length, sizeof(length));
+
+    const size_t sampleCount = KSBONJSON_MAP_INDEX_SAMPLE_COUNT;
+    const size_t sampleBytes = KSBONJSON_MAP_INDEX_SAMPLE_BYTES;
+    if (sampleCount < 2 || inputLength / sampleCount <= sampleBytes)
+    {
+        return mapIndexHashBytes(hash, input, inputLength);
+    }
+
+    // Evenly spaced blocks, the first at the start of the document and the last at its end
+    uint64_t span = inputLength - sampleBytes;
+    for (size_t i = 0; i < sampleCount; i++)
+    {
+        size_t offset = (size_t)(span * i / (sampleCount - 1));
+        hash = mapIndexHashBytes(hash, input + offset, sampleBytes);
+    }
+    return hash;
+}
+
+ksbonjson_decodeStatus ksbonjson_map_writeIndex(
+    KSBONJSONMapContext* ctx,
+    KSBONJSONMapIndexWriteFunc write,
+    void* userData)
+{
+    unlikely_if(ctx->isLazy || ctx->entriesCount == 0)
+    {
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+
+    MapIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAP_INDEX_MAGIC, sizeof(header.magic));
+    header.byteOrderMark = MAP_INDEX_BYTE_ORDER_MARK;
+    header.version = MAP_INDEX_VERSION;
+    header.entrySize = sizeof(KSBONJSONMapEntry);
+    header.sizeSize = sizeof(size_t);
+    header.documentLength = ctx->inputLength;
+    header.documentFingerprint = ksbonjson_map_fingerprint(ctx->input, ctx->inputLength);
+    mapIndexFillScanSettings(&header.settings, ctx);
+    header.rootIndex = ctx->rootIndex;
+    header.keyIndexMinPairs = ctx->keyIndexMinPairs;
+    header.compactRecords = ctx->compactRecords;
+    header.internKeys = ctx->internKeys;
+    header.counts[MAP_INDEX_RECORD_DEFS] = ctx->recordDefCount;
+    header.counts[MAP_INDEX_ENTRIES] = ctx->entriesCount;
+    header.counts[MAP_INDEX_KEY_INDEX_SLOTS] = ctx->keyIndexSlotsCount;
+    header.counts[MAP_INDEX_KEY_INDEX_REFS] = ctx->keyIndexRefsCount;
+
+    uint32_t* keyIds = NULL;
+    if (ctx->internKeys && ctx->internedKeyCount > 0)
+    {
+        keyIds = malloc(ctx->entriesCount * sizeof(*keyIds));
+        unlikely_if(keyIds == NULL)
+        {
+            return KSBONJSON_DECODE_OUT_OF_MEMORY;
+        }
+        mapIndexCopyKeyIds(ctx, keyIds);
+        header.counts[MAP_INDEX_KEY_IDS] = ctx->entriesCount;
+        header.counts[MAP_INDEX_INTERNED_KEYS] = ctx->internedKeyCount;
+        header.counts[MAP_INDEX_INTERN_SLOTS] = ctx->internSlotsCapacity;
+        header.internSlotsCapacity = ctx->internSlotsCapacity;
+    }
+
+    const void* tables[MAP_INDEX_SECTION_COUNT] =
+    {
+        ctx->recordDefs,
+        ctx->entries,
+        ctx->keyIndexSlots,
+        ctx->keyIndexRefs,
+        keyIds,
+        ctx->internedKeys,
+        ctx->internSlots,
+    };
+    static const uint8_t zeroes[8] = {0};
+
+    ksbonjson_decodeStatus status = KSBONJSON_DECODE_OK;
+    unlikely_if(!write((const uint8_t*)&header, sizeof(header), userData))
+    {
+        status = KSBONJSON_DECODE_COULD_NOT_PROCESS_DATA;
+    }
+    for (int i = 0; i < MAP_INDEX_SECTION_COUNT && status == KSBONJSON_DECODE_OK; i++)
+    {
+        size_t length = (size_t)header.counts[i] * mapIndexElementSizes[i];
+        if (length == 0)
+        {
+            continue;
+        }
+        unlikely_if(!write(tables[i], length, userData) ||
+                    (length % 8 != 0 && !write(zeroes, mapIndexAlign(length) - length, userData)))
+        {
+            status = KSBONJSON_DECODE_COULD_NOT_PROCESS_DATA;
+        }
+    }
+    free(keyIds);
+    return status;
+}
+
+ksbonjson_decodeStatus ksbonjson_map_openIndex(
+    KSBONJSONMapContext* ctx,
+    const uint8_t* input,
+    size_t inputLength,
+    const void* index,
+    size_t indexLength,
+    KSBONJSONDecodeFlags flags)
+{
+    ksbonjson_map_beginWithFlags(ctx, input, inputLength, NULL, 0, flags);
+
+    MapIndexHeader header;
+    unlikely_if(indexLength < sizeof(header) || ((uintptr_t)index & 7) != 0)
+    {
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+    memcpy(&header, index, sizeof(header));
+    unlikely_if(memcmp(header.magic, MAP_INDEX_MAGIC, sizeof(header.magic)) != 0)
+    {
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+
+    MapIndexScanSettings settings;
+    mapIndexFillScanSettings(&settings, ctx);
+    unlikely_if(header.byteOrderMark != MAP_INDEX_BYTE_ORDER_MARK ||
+                header.version != MAP_INDEX_VERSION ||
+                header.entrySize != sizeof(KSBONJSONMapEntry) ||
+                header.sizeSize != sizeof(size_t) ||
+                header.documentLength != inputLength ||
+                memcmp(&header.settings, &settings, sizeof(settings)) != 0 ||
+                header.documentFingerprint != ksbonjson_map_fingerprint(input, inputLength))
+    {
+        return KSBONJSON_DECODE_INDEX_MISMATCH;
+    }
+
+    // The tables are trusted, but must at least lie inside the index
+    size_t offsets[MAP_INDEX_SECTION_COUNT];
+    size_t length;
+    const uint64_t* counts = header.counts;
+    unlikely_if(!mapIndexLayout(&header, indexLength, offsets, &length) || length != indexLength ||
+                counts[MAP_INDEX_RECORD_DEFS] > KSBONJSON_MAX_RECORD_DEFS ||
+                header.rootIndex >= counts[MAP_INDEX_ENTRIES] ||
+                counts[MAP_INDEX_ENTRIES] > UINT32_MAX ||
+                (counts[MAP_INDEX_KEY_IDS] != 0 && counts[MAP_INDEX_KEY_IDS] != counts[MAP_INDEX_ENTRIES]) ||
+                counts[MAP_INDEX_INTERN_SLOTS] != header.internSlotsCapacity ||
+                (header.internSlotsCapacity & (header.internSlotsCapacity - 1)) != 0)
+    {
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+
+    // Only the record definitions are copied: the context holds them inline
+    const uint8_t* base = index;
+    memcpy(ctx->recordDefs, base + offsets[MAP_INDEX_RECORD_DEFS], counts[MAP_INDEX_RECORD_DEFS] * sizeof(*ctx->recordDefs));
+    ctx->recordDefCount = counts[MAP_INDEX_RECORD_DEFS];
+
+    // The index is never written through these: entries only change once
+    // mapIndexGrowEntries() has moved them out, and the other tables only
+    // change while scanning.
+    ctx->entries = (KSBONJSONMapEntry*)(base + offsets[MAP_INDEX_ENTRIES]);
+    ctx->entriesCount = counts[MAP_INDEX_ENTRIES];
+    ctx->entriesCapacity = ctx->entriesCount;
+    ctx->growEntries = mapIndexGrowEntries;
+    ctx->rootIndex = header.rootIndex;
+    ctx->position = inputLength;
+    ctx->compactRecords = header.compactRecords;
+    ctx->keyIndexMinPairs = header.keyIndexMinPairs;
+    ctx->keyIndexSlots = (uint32_t*)(base + offsets[MAP_INDEX_KEY_INDEX_SLOTS]);
+    ctx->keyIndexSlotsCount = counts[MAP_INDEX_KEY_INDEX_SLOTS];
+    ctx->keyIndexSlotsCapacity = ctx->keyIndexSlotsCount;
+    ctx->keyIndexRefs = (KSBONJSONKeyIndexRef*)(base + offsets[MAP_INDEX_KEY_INDEX_REFS]);
+    ctx->keyIndexRefsCount = counts[MAP_INDEX_KEY_INDEX_REFS];
+    ctx->keyIndexRefsCapacity = ctx->keyIndexRefsCount;
+    ctx->internKeys = header.internKeys;
+    if (counts[MAP_INDEX_KEY_IDS] != 0)
+    {
+        ctx->keyIds = (uint32_t*)(base + offsets[MAP_INDEX_KEY_IDS]);
+        ctx->keyIdsCapacity = counts[MAP_INDEX_KEY_IDS];
+        ctx->internedKeys = (KSBONJSONInternedKey*)(base + offsets[MAP_INDEX_INTERNED_KEYS]);
+        ctx->internedKeyCount = counts[MAP_INDEX_INTERNED_KEYS];
+        ctx->internedKeyCapacity = ctx->internedKeyCount;
+        ctx->internSlots = (uint32_t*)(base + offsets[MAP_INDEX_INTERN_SLOTS]);
+        ctx->internSlotsCapacity = header.internSlotsCapacity;
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+void ksbonjson_map_closeIndex(KSBONJSONMapContext* ctx)
+{
+    if (ctx->growEntries != mapIndexGrowEntries)
+    {
+        // Expanding a typed array moved the entries out of the index
+        free(ctx->entries);
+    }
+    ctx->entries = NULL;
+    ctx->entriesCapacity = 0;
+    ctx->entriesCount = 0;
+    ctx->growEntries = NULL;
+    ctx->keyIndexSlots = NULL;
+    ctx->keyIndexSlotsCount = 0;
+    ctx->keyIndexSlotsCapacity = 0;
+    ctx->keyIndexRefs = NULL;
+    ctx->keyIndexRefsCount = 0;
+    ctx->keyIndexRefsCapacity = 0;
+    ctx->keyIds = NULL;
+    ctx->keyIdsCapacity = 0;
+    ctx->internedKeys = NULL;
+    ctx->internedKeyCount = 0;
+    ctx->internedKeyCapacity = 0;
+    ctx->internSlots = NULL;
+    ctx->internSlotsCapacity = 0;
+    mapKeySetFree(ctx);
+}
+
+
+// ============================================================================
+// Batch Decode Functions
+// ============================================================================
+
+// Typed array element loads. Elements are little-endian and unaligned.
+
+static inline uint8_t loadTypedUInt8(const uint8_t* p) { return *p; }
+static inline int8_t loadTypedSInt8(const uint8_t* p) { return (int8_t)*p; }
+
+static inline uint16_t loadTypedUInt16(const uint8_t* p)
+{
+#if KSBONJSON_IS_LITTLE_ENDIAN
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+#else
+    return (uint16_t)(p[0] | (p[1] << 8));
+#endif
+}
+
+static inline uint32_t loadTypedUInt32(const uint8_t* p)
+{
+#if KSBONJSON_IS_LITTLE_ENDIAN
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+#else
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+#endif
+}
+
+static inline uint64_t loadTypedUInt64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return fromLittleEndian(v);
+}
+
+static inline int16_t loadTypedSInt16(const uint8_t* p) { return (int16_t)loadTypedUInt16(p); }
+static inline int32_t loadTypedSInt32(const uint8_t* p) { return (int32_t)loadTypedUInt32(p); }
+static inline int64_t loadTypedSInt64(const uint8_t* p) { return (int64_t)loadTypedUInt64(p); }
+
+static inline float loadTypedFloat32(const uint8_t* p)
+{
+    uint32_t bits = loadTypedUInt32(p);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static inline double loadTypedFloat64(const uint8_t* p)
+{
+    uint64_t bits = loadTypedUInt64(p);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// Convert the first COUNT elements of a typed array into OUT, casting each to OUT_TYPE.
+// Each case is a simple widening loop that compilers can vectorize.
+#define CONVERT_TYPED_ELEMENTS(OUT, DATA, COUNT, OUT_TYPE, LOAD, SIZE) \
+    for (size_t i = 0; i < (COUNT); i++) \
+    { \
+        (OUT)[i] = (OUT_TYPE)LOAD((DATA) + i * (SIZE)); \
+    }
+
+#define CONVERT_TYPED_ARRAY(ARRAY, OUT, COUNT, OUT_TYPE) \
+    do \
+    { \
+        const uint8_t* convertData = (ARRAY)->data; \
+        switch ((ARRAY)->elementType) \
+        { \
+            case KSBONJSON_TYPED_ELEMENT_UINT8: \
+                CONVERT_TYPED_ELEMENTS(OUT, convertData, COUNT, OUT_TYPE, loadTypedUInt8, 1); break; \
+            case KSBONJSON_TYPED_ELEMENT_UINT16: \
+                CONVERT_TYPED_ELEMENTS(OUT, convertData, COUNT, OUT_TYPE, loadTypedUInt16, 2); break; \
+            case KSBONJSON_TYPED_ELEMENT_UINT32: \
+                CONVERT_TYPED_ELEMENTS(OUT, convertData, COUNT, OUT_TYPE, loadTypedUInt32, 4); break; \
+            case KSBONJSON_TYPED_ELEMENT_UINT64: \
+                CONVERT_TYPED_ELEMENTS(OUT, convertData, COUNT, OUT_TYPE, loadTypedUInt64, 8); break; \
+            case KSBONJSON_TYPED_ELEMENT_SINT8: \
+                CONVERT_TYPED_ELEMENTS(OUT, convertData, COUNT, OUT_TYPE, loadTypedSInt8, 1); break; \
+            case KSBONJSON_TYPED_ELEMENT_SINT16: \
+                CONVERT_TYPED_ELEMENTS(OUT, convertData, COUNT, OUT_TYPE, loadTypedSInt16, 2); break; \
+            case KSBONJSON_TYPED_ELEMENT_SINT32: \
+                CONVERT_TYPED_ELEMENTS(OUT, convertData, COUNT, OUT_TYPE, loadTypedSInt32, 4); break; \
+            case KSBONJSON_TYPED_ELEMENT_SINT64: \
+                CONVERT_TYPED_ELEMENTS(OUT, convertData, COUNT, OUT_TYPE, loadTypedSInt64, 8); break; \
+            case KSBONJSON_TYPED_ELEMENT_FLOAT32: \
+                CONVERT_TYPED_ELEMENTS(OUT, convertData, COUNT, OUT_TYPE, loadTypedFloat32, 4); break; \
+            case KSBONJSON_TYPED_ELEMENT_FLOAT64: \
+                CONVERT_TYPED_ELEMENTS(OUT, convertData, COUNT, OUT_TYPE, loadTypedFloat64, 8); break; \
+        } \
+    } \
+    while(0)
+
+// Typed array to output conversions. An element type that matches the output
+// type exactly is copied in one go on little-endian hosts.
+
+static void typedArrayToInt64(const KSBONJSONTypedArray* array, int64_t* out, size_t count)
+{
+#if KSBONJSON_IS_LITTLE_ENDIAN
+    if (array->elementType == KSBONJSON_TYPED_ELEMENT_SINT64)
+    {
+        memcpy(out, array->data, count * sizeof(*out));
+        return;
+    }
+#endif
+    CONVERT_TYPED_ARRAY(array, out, count, int64_t);
+}
+
+static void typedArrayToUInt64(const KSBONJSONTypedArray* array, uint64_t* out, size_t count)
+{
+#if KSBONJSON_IS_LITTLE_ENDIAN
+    if (array->elementType == KSBONJSON_TYPED_ELEMENT_UINT64)
+    {
+        memcpy(out, array->data, count * sizeof(*out));
+        return;
+    }
+#endif
+    CONVERT_TYPED_ARRAY(array, out, count, uint64_t);
+}
+
+static void typedArrayToDouble(const KSBONJSONTypedArray* array, double* out, size_t count)
+{
+#if KSBONJSON_IS_LITTLE_ENDIAN
+    if (array->elementType == KSBONJSON_TYPED_ELEMENT_FLOAT64)
+    {
+        memcpy(out, array->data, count * sizeof(*out));
+        return;
     }
-    return inputLength;
+#endif
+    CONVERT_TYPED_ARRAY(array, out, count, double);
 }
 
+static void typedArrayToBool(const KSBONJSONTypedArray* array, bool* out, size_t count)
+{
+    CONVERT_TYPED_ARRAY(array, out, count, bool);
+}
 
-// ============================================================================
-// Batch Decode Functions
-// ============================================================================
+// Decode a typed array span straight into the output buffer.
+// Returns false if the entry at index isn't a span.
+#define DECODE_TYPED_ARRAY_SPAN(CTX, INDEX, OUT, MAX_COUNT, CONVERT) \
+    do \
+    { \
+        KSBONJSONTypedArray typedArray; \
+        if (ksbonjson_map_getTypedArray(CTX, INDEX, &typedArray)) \
+        { \
+            size_t spanCount = typedArray.count < (MAX_COUNT) ? typedArray.count : (MAX_COUNT); \
+            CONVERT(&typedArray, OUT, spanCount); \
+            return spanCount; \
+        } \
+    } \
+    while(0)
 
 // Helper to convert any numeric entry to int64
 static inline int64_t entryToInt64(const KSBONJSONMapEntry* entry)
@@ -1925,7 +4585,7 @@ static inline uint64_t entryToUInt64(const KSBONJSONMapEntry* entry)
 }
 
 // Helper to convert any numeric entry to double
-static inline double entryToDouble(const KSBONJSONMapEntry* entry)
+static inline double entryToDouble(const KSBONJSONMapContext* ctx, const KSBONJSONMapEntry* entry)
 {
     switch (entry->type)
     {
@@ -1937,14 +4597,16 @@ static inline double entryToDouble(const KSBONJSONMapEntry* entry)
             return (double)entry->data.uintValue;
         case KSBONJSON_TYPE_BIGNUMBER:
         {
+            KSBONJSONBigNumberValue bigNumber = ksbonjson_map_decodeBigNumber(ctx->input, entry);
+
             // Convert little-endian bytes to uint64 (using first 8 bytes)
             uint64_t significand = 0;
             for (size_t i = 0; i < 8 && i < KSBONJSON_MAX_BIGNUMBER_MAGNITUDE_BYTES; i++)
             {
-                significand |= (uint64_t)entry->data.bigNumber.significand[i] << (i * 8);
+                significand |= (uint64_t)bigNumber.significand[i] << (i * 8);
             }
-            double result = (double)significand * pow(10.0, (double)entry->data.bigNumber.exponent);
-            return entry->data.bigNumber.sign < 0 ? -result : result;
+            double result = (double)significand * pow(10.0, (double)bigNumber.exponent);
+            return bigNumber.sign < 0 ? -result : result;
         }
         case KSBONJSON_TYPE_TRUE:
             return 1.0;
@@ -1988,6 +4650,13 @@ size_t ksbonjson_map_decodeInt64Array(
         return 0;
     }
 
+    DECODE_TYPED_ARRAY_SPAN(ctx, arrayIndex, outBuffer, maxCount, typedArrayToInt64);
+
+    unlikely_if(ksbonjson_map_expand(ctx, arrayIndex) != KSBONJSON_DECODE_OK)
+    {
+        return 0;
+    }
+
     const KSBONJSONMapEntry* arrayEntry = &ctx->entries[arrayIndex];
     if (arrayEntry->type != KSBONJSON_TYPE_ARRAY)
     {
@@ -2024,6 +4693,13 @@ size_t ksbonjson_map_decodeUInt64Array(
         return 0;
     }
 
+    DECODE_TYPED_ARRAY_SPAN(ctx, arrayIndex, outBuffer, maxCount, typedArrayToUInt64);
+
+    unlikely_if(ksbonjson_map_expand(ctx, arrayIndex) != KSBONJSON_DECODE_OK)
+    {
+        return 0;
+    }
+
     const KSBONJSONMapEntry* arrayEntry = &ctx->entries[arrayIndex];
     if (arrayEntry->type != KSBONJSON_TYPE_ARRAY)
     {
@@ -2058,6 +4734,13 @@ size_t ksbonjson_map_decodeDoubleArray(
         return 0;
     }
 
+    DECODE_TYPED_ARRAY_SPAN(ctx, arrayIndex, outBuffer, maxCount, typedArrayToDouble);
+
+    unlikely_if(ksbonjson_map_expand(ctx, arrayIndex) != KSBONJSON_DECODE_OK)
+    {
+        return 0;
+    }
+
     const KSBONJSONMapEntry* arrayEntry = &ctx->entries[arrayIndex];
     if (arrayEntry->type != KSBONJSON_TYPE_ARRAY)
     {
@@ -2074,7 +4757,7 @@ size_t ksbonjson_map_decodeDoubleArray(
     for (uint32_t i = 0; i < count; i++)
     {
         const KSBONJSONMapEntry* childEntry = &ctx->entries[childIndex];
-        outBuffer[i] = entryToDouble(childEntry);
+        outBuffer[i] = entryToDouble(ctx, childEntry);
         childIndex++;
     }
 
@@ -2092,6 +4775,13 @@ size_t ksbonjson_map_decodeBoolArray(
         return 0;
     }
 
+    DECODE_TYPED_ARRAY_SPAN(ctx, arrayIndex, outBuffer, maxCount, typedArrayToBool);
+
+    unlikely_if(ksbonjson_map_expand(ctx, arrayIndex) != KSBONJSON_DECODE_OK)
+    {
+        return 0;
+    }
+
     const KSBONJSONMapEntry* arrayEntry = &ctx->entries[arrayIndex];
     if (arrayEntry->type != KSBONJSON_TYPE_ARRAY)
     {
@@ -2126,6 +4816,17 @@ size_t ksbonjson_map_decodeStringArray(
         return 0;
     }
 
+    // Typed arrays hold no strings, so there's no point expanding them here
+    if (ctx->entries[arrayIndex].type == KSBONJSON_TYPE_TYPED_ARRAY)
+    {
+        return 0;
+    }
+
+    unlikely_if(ksbonjson_map_expand(ctx, arrayIndex) != KSBONJSON_DECODE_OK)
+    {
+        return 0;
+    }
+
     const KSBONJSONMapEntry* arrayEntry = &ctx->entries[arrayIndex];
     if (arrayEntry->type != KSBONJSON_TYPE_ARRAY)
     {
@@ -2158,3 +4859,460 @@ size_t ksbonjson_map_decodeStringArray(
 
     return count;
 }
+
+
+// ============================================================================
+// Path Queries
+// ============================================================================
+
+static bool pathAddStep(KSBONJSONPath* path, KSBONJSONPathStep step)
+{
+    unlikely_if(path->stepCount >= KSBONJSON_MAX_PATH_STEPS)
+    {
+        return false;
+    }
+    path->steps[path->stepCount++] = step;
+    return true;
+}
+
+// Add a KEY step for an unquoted name, which runs up to the next '.' or '['.
+// Characters that end an unquoted name, or that can only appear in a quoted one
+static inline bool pathIsBareNameDelimiter(const char c)
+{
+    switch (c)
+    {
+        case '.': case '[': case ']': case '*': case '\'': case '"':
+            return true;
+        default:
+            // Whitespace and other control characters
+            return (unsigned char)c <= ' ' || c == 0x7F;
+    }
+}
+
+static bool pathAddBareName(KSBONJSONPath* path, const char* expression, size_t length, size_t* pos)
+{
+    size_t start = *pos;
+    size_t end = start;
+    while (end < length && !pathIsBareNameDelimiter(expression[end]))
+    {
+        end++;
+    }
+    // Anything but the start of the next step is a syntax error
+    unlikely_if(end < length && expression[end] != '.' && expression[end] != '[')
+    {
+        return false;
+    }
+    unlikely_if(end == start)
+    {
+        return false;
+    }
+    *pos = end;
+    KSBONJSONPathStep step = {
+        .type = KSBONJSON_PATH_STEP_KEY,
+        .keyOffset = (uint32_t)start,
+        .keyLength = (uint32_t)(end - start),
+    };
+    return pathAddStep(path, step);
+}
+
+// Add the step for a bracketed selector. *pos is just past the '['.
+static bool pathAddBracket(KSBONJSONPath* path, const char* expression, size_t length, size_t* pos)
+{
+    size_t p = *pos;
+    unlikely_if(p >= length)
+    {
+        return false;
+    }
+
+    KSBONJSONPathStep step = {0};
+    char c = expression[p];
+    if (c == '*')
+    {
+        step.type = KSBONJSON_PATH_STEP_WILDCARD;
+        p++;
+    }
+    else if (c == '"' || c == '\'')
+    {
+        size_t start = ++p;
+        while (p < length && expression[p] != c)
+        {
+            p++;
+        }
+        unlikely_if(p >= length)
+        {
+            return false;
+        }
+        step.type = KSBONJSON_PATH_STEP_KEY;
+        step.keyOffset = (uint32_t)start;
+        step.keyLength = (uint32_t)(p - start);
+        p++;
+    }
+    else if (c >= '0' && c <= '9')
+    {
+        size_t index = 0;
+        while (p < length && expression[p] >= '0' && expression[p] <= '9')
+        {
+            size_t digit = (size_t)(expression[p] - '0');
+            unlikely_if(index > (SIZE_MAX - digit) / 10)
+            {
+                return false;
+            }
+            index = index * 10 + digit;
+            p++;
+        }
+        step.type = KSBONJSON_PATH_STEP_INDEX;
+        step.index = index;
+    }
+    else
+    {
+        return false;
+    }
+
+    unlikely_if(p >= length || expression[p] != ']')
+    {
+        return false;
+    }
+    *pos = p + 1;
+    return pathAddStep(path, step);
+}
+
+bool ksbonjson_path_compile(KSBONJSONPath* path, const char* expression, size_t length)
+{
+    path->expression = expression;
+    path->stepCount = 0;
+
+    // Names are stored as 32-bit offsets
+    unlikely_if(length > UINT32_MAX)
+    {
+        return false;
+    }
+
+    size_t pos = 0;
+    if (length > 0 && expression[0] == '$')
+    {
+        pos = 1;
+    }
+    else if (length > 0 && expression[0] != '.' && expression[0] != '[')
+    {
+        // A bare leading name ("user.id")
+        unlikely_if(!pathAddBareName(path, expression, length, &pos))
+        {
+            return false;
+        }
+    }
+
+    while (pos < length)
+    {
+        char c = expression[pos++];
+        if (c == '.')
+        {
+            if (pos < length && expression[pos] == '*')
+            {
+                KSBONJSONPathStep step = { .type = KSBONJSON_PATH_STEP_WILDCARD };
+                unlikely_if(!pathAddStep(path, step))
+                {
+                    return false;
+                }
+                pos++;
+            }
+            else
+            {
+                unlikely_if(!pathAddBareName(path, expression, length, &pos))
+                {
+                    return false;
+                }
+            }
+        }
+        else if (c == '[')
+        {
+            unlikely_if(!pathAddBracket(path, expression, length, &pos))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+typedef struct PathVisit PathVisit;
+
+struct PathVisit
+{
+    // Store the match at map index into output slot (only called for slots below maxCount)
+    void (*store)(KSBONJSONMapContext* ctx, size_t index, void* out, size_t slot);
+
+    // Convert a typed array span's elements into output slots [slot, slot + count).
+    // When set, a final wildcard over a span reads the span directly instead of expanding it.
+    void (*storeSpan)(const KSBONJSONTypedArray* array, void* out, size_t slot, size_t count);
+
+    void* out;
+    size_t maxCount;
+
+    // Walking stops once this many matches are found
+    size_t limit;
+
+    size_t matchCount;
+
+    // Status of the first container that failed to expand
+    ksbonjson_decodeStatus status;
+};
+
+static void pathVisitMatch(KSBONJSONMapContext* ctx, size_t index, PathVisit* visit)
+{
+    if (visit->matchCount < visit->maxCount)
+    {
+        visit->store(ctx, index, visit->out, visit->matchCount);
+    }
+    visit->matchCount++;
+}
+
+// Expand the container at index, recording the failure if it can't be scanned.
+static bool pathExpand(KSBONJSONMapContext* ctx, size_t index, PathVisit* visit)
+{
+    ksbonjson_decodeStatus status = ksbonjson_map_expand(ctx, index);
+    unlikely_if(status != KSBONJSON_DECODE_OK)
+    {
+        if (visit->status == KSBONJSON_DECODE_OK)
+        {
+            visit->status = status;
+        }
+        return false;
+    }
+    return true;
+}
+
+static void pathWalk(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t stepIndex, size_t index, PathVisit* visit);
+
+static void pathWalkWildcard(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t stepIndex, size_t index, PathVisit* visit)
+{
+    bool isLastStep = stepIndex + 1 == path->stepCount;
+    KSBONJSONTypedArray typedArray;
+    if (isLastStep && visit->storeSpan != NULL && ksbonjson_map_getTypedArray(ctx, index, &typedArray))
+    {
+        size_t available = visit->matchCount < visit->maxCount ? visit->maxCount - visit->matchCount : 0;
+        size_t storeCount = typedArray.count < available ? typedArray.count : available;
+        if (storeCount > 0)
+        {
+            visit->storeSpan(&typedArray, visit->out, visit->matchCount, storeCount);
+        }
+        visit->matchCount += typedArray.count;
+        return;
+    }
+
+    unlikely_if(!pathExpand(ctx, index, visit))
+    {
+        return;
+    }
+
+    // Only indices are held across the loop: expanding a child can move ctx->entries.
+    const KSBONJSONMapEntry* entry = &ctx->entries[index];
+    size_t count;
+    size_t childIndex;
+    bool hasKeys = false;
+    switch (entry->type)
+    {
+        case KSBONJSON_TYPE_ARRAY:
+            count = entry->data.container.count;
+            childIndex = entry->data.container.firstChild;
+            break;
+        case KSBONJSON_TYPE_OBJECT:
+            count = entry->data.container.count / 2;
+            childIndex = entry->data.container.firstChild;
+            hasKeys = true;
+            break;
+        case KSBONJSON_TYPE_RECORD:
+            count = ctx->recordDefs[entry->data.record.definition].keyCount;
+            childIndex = entry->data.record.firstChild;
+            break;
+        default:
+            return;
+    }
+
+    for (size_t i = 0; i < count && visit->matchCount < visit->limit; i++)
+    {
+        if (hasKeys)
+        {
+            childIndex += mapSubtreeSize(ctx, childIndex);
+        }
+        size_t valueIndex = childIndex;
+        childIndex += mapSubtreeSize(ctx, valueIndex);
+        pathWalk(ctx, path, stepIndex + 1, valueIndex, visit);
+    }
+}
+
+static void pathWalk(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t stepIndex, size_t index, PathVisit* visit)
+{
+    if (stepIndex == path->stepCount)
+    {
+        pathVisitMatch(ctx, index, visit);
+        return;
+    }
+
+    // Containers are expanded here rather than by findKey() and getChild(), which
+    // can't tell a container that failed to scan from a missing member.
+    const KSBONJSONPathStep* step = &path->steps[stepIndex];
+    KSBONJSONValueType type = ctx->entries[index].type;
+    size_t nextIndex = SIZE_MAX;
+    switch (step->type)
+    {
+        case KSBONJSON_PATH_STEP_KEY:
+            if ((type == KSBONJSON_TYPE_OBJECT || type == KSBONJSON_TYPE_RECORD) && pathExpand(ctx, index, visit))
+            {
+                nextIndex = ksbonjson_map_findKey(
+                    ctx, index, path->expression + step->keyOffset, step->keyLength);
+            }
+            break;
+        case KSBONJSON_PATH_STEP_INDEX:
+            // getChild() also indexes object keys and record fields, which an index step must not
+            if ((type == KSBONJSON_TYPE_ARRAY || type == KSBONJSON_TYPE_TYPED_ARRAY) && pathExpand(ctx, index, visit))
+            {
+                nextIndex = ksbonjson_map_getChild(ctx, index, step->index);
+            }
+            break;
+        case KSBONJSON_PATH_STEP_WILDCARD:
+            pathWalkWildcard(ctx, path, stepIndex, index, visit);
+            return;
+    }
+
+    if (nextIndex != SIZE_MAX)
+    {
+        pathWalk(ctx, path, stepIndex + 1, nextIndex, visit);
+    }
+}
+
+static size_t pathEvaluate(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex,
+    PathVisit* visit, ksbonjson_decodeStatus* outStatus)
+{
+    visit->matchCount = 0;
+    visit->status = KSBONJSON_DECODE_OK;
+    if (startIndex < ctx->entriesCount)
+    {
+        pathWalk(ctx, path, 0, startIndex, visit);
+    }
+    if (outStatus != NULL)
+    {
+        *outStatus = visit->status;
+    }
+    return visit->matchCount;
+}
+
+static void pathStoreIndex(KSBONJSONMapContext* ctx, size_t index, void* out, size_t slot)
+{
+    (void)ctx;
+    ((size_t*)out)[slot] = index;
+}
+
+size_t ksbonjson_path_find(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex,
+    ksbonjson_decodeStatus* outStatus)
+{
+    size_t found = SIZE_MAX;
+    PathVisit visit = {
+        .store = pathStoreIndex,
+        .out = &found,
+        .maxCount = 1,
+        .limit = 1,
+    };
+    pathEvaluate(ctx, path, startIndex, &visit, outStatus);
+    return found;
+}
+
+size_t ksbonjson_path_findAll(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex,
+    size_t* outIndices, size_t maxCount, ksbonjson_decodeStatus* outStatus)
+{
+    PathVisit visit = {
+        .store = pathStoreIndex,
+        .out = outIndices,
+        .maxCount = maxCount,
+        .limit = SIZE_MAX,
+    };
+    return pathEvaluate(ctx, path, startIndex, &visit, outStatus);
+}
+
+static void pathStoreInt64(KSBONJSONMapContext* ctx, size_t index, void* out, size_t slot)
+{
+    ((int64_t*)out)[slot] = entryToInt64(&ctx->entries[index]);
+}
+
+static void pathStoreInt64Span(const KSBONJSONTypedArray* array, void* out, size_t slot, size_t count)
+{
+    typedArrayToInt64(array, (int64_t*)out + slot, count);
+}
+
+static void pathStoreUInt64(KSBONJSONMapContext* ctx, size_t index, void* out, size_t slot)
+{
+    ((uint64_t*)out)[slot] = entryToUInt64(&ctx->entries[index]);
+}
+
+static void pathStoreUInt64Span(const KSBONJSONTypedArray* array, void* out, size_t slot, size_t count)
+{
+    typedArrayToUInt64(array, (uint64_t*)out + slot, count);
+}
+
+static void pathStoreDouble(KSBONJSONMapContext* ctx, size_t index, void* out, size_t slot)
+{
+    ((double*)out)[slot] = entryToDouble(ctx, &ctx->entries[index]);
+}
+
+static void pathStoreDoubleSpan(const KSBONJSONTypedArray* array, void* out, size_t slot, size_t count)
+{
+    typedArrayToDouble(array, (double*)out + slot, count);
+}
+
+static void pathStoreBool(KSBONJSONMapContext* ctx, size_t index, void* out, size_t slot)
+{
+    ((bool*)out)[slot] = entryToBool(&ctx->entries[index]);
+}
+
+static void pathStoreBoolSpan(const KSBONJSONTypedArray* array, void* out, size_t slot, size_t count)
+{
+    typedArrayToBool(array, (bool*)out + slot, count);
+}
+
+static void pathStoreString(KSBONJSONMapContext* ctx, size_t index, void* out, size_t slot)
+{
+    const KSBONJSONMapEntry* entry = &ctx->entries[index];
+    KSBONJSONStringRef* ref = (KSBONJSONStringRef*)out + slot;
+    if (entry->type == KSBONJSON_TYPE_STRING)
+    {
+        ref->offset = entry->data.string.offset;
+        ref->length = entry->data.string.length;
+    }
+    else
+    {
+        // Non-string values get zero offset/length
+        ref->offset = 0;
+        ref->length = 0;
+    }
+}
+
+#define DEFINE_PATH_DECODE(NAME, TYPE, STORE, STORE_SPAN) \
+size_t NAME( \
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex, \
+    TYPE* outBuffer, size_t maxCount, ksbonjson_decodeStatus* outStatus) \
+{ \
+    PathVisit visit = { \
+        .store = STORE, \
+        .storeSpan = STORE_SPAN, \
+        .out = outBuffer, \
+        .maxCount = maxCount, \
+        .limit = SIZE_MAX, \
+    }; \
+    return pathEvaluate(ctx, path, startIndex, &visit, outStatus); \
+}
+
+DEFINE_PATH_DECODE(ksbonjson_path_decodeInt64s, int64_t, pathStoreInt64, pathStoreInt64Span)
+DEFINE_PATH_DECODE(ksbonjson_path_decodeUInt64s, uint64_t, pathStoreUInt64, pathStoreUInt64Span)
+DEFINE_PATH_DECODE(ksbonjson_path_decodeDoubles, double, pathStoreDouble, pathStoreDoubleSpan)
+DEFINE_PATH_DECODE(ksbonjson_path_decodeBools, bool, pathStoreBool, pathStoreBoolSpan)
+// Typed arrays hold no strings: a wildcard over one yields a zero ref per element
+DEFINE_PATH_DECODE(ksbonjson_path_decodeStrings, KSBONJSONStringRef, pathStoreString, NULL)
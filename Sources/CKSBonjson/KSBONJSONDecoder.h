@@ -57,6 +57,26 @@ extern "C" {
 #   define KSBONJSON_DEFAULT_MAX_DOCUMENT_SIZE 2000000000
 #endif
 
+#ifndef KSBONJSON_MAP_INITIAL_ENTRIES
+#   define KSBONJSON_MAP_INITIAL_ENTRIES 256
+#endif
+// Objects with at least this many pairs get a hash index in growable maps
+#ifndef KSBONJSON_MAP_KEY_INDEX_MIN_PAIRS
+#   define KSBONJSON_MAP_KEY_INDEX_MIN_PAIRS 16
+#endif
+// Root arrays are only split for a parallel scan into segments at least this large
+#ifndef KSBONJSON_MAP_MIN_SEGMENT_BYTES
+#   define KSBONJSON_MAP_MIN_SEGMENT_BYTES 65536
+#endif
+// A map index fingerprints its document by hashing this many blocks of this size
+// (documents no larger than both together are hashed whole)
+#ifndef KSBONJSON_MAP_INDEX_SAMPLE_COUNT
+#   define KSBONJSON_MAP_INDEX_SAMPLE_COUNT 64
+#endif
+#ifndef KSBONJSON_MAP_INDEX_SAMPLE_BYTES
+#   define KSBONJSON_MAP_INDEX_SAMPLE_BYTES 4096
+#endif
+
 #ifndef KSBONJSON_RESTRICT
 #   ifdef __cplusplus
 #       define KSBONJSON_RESTRICT __restrict__
@@ -124,6 +144,8 @@ typedef enum
     KSBONJSON_DECODE_MAX_STRING_LENGTH_EXCEEDED = 17,
     KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED = 18,
     KSBONJSON_DECODE_MAX_DOCUMENT_SIZE_EXCEEDED = 19,
+    KSBONJSON_DECODE_OUT_OF_MEMORY = 20,
+    KSBONJSON_DECODE_INDEX_MISMATCH = 21,
     KSBONJSON_DECODE_COULD_NOT_PROCESS_DATA = 100,
 } ksbonjson_decodeStatus;
 
@@ -177,6 +199,8 @@ typedef enum {
     KSBONJSON_TYPE_STRING,
     KSBONJSON_TYPE_ARRAY,
     KSBONJSON_TYPE_OBJECT,
+    KSBONJSON_TYPE_TYPED_ARRAY, // Array of fixed-size numbers kept as one span of input bytes
+    KSBONJSON_TYPE_RECORD,      // Record instance stored as values only (see ksbonjson_map_setCompactRecords)
 } KSBONJSONValueType;
 
 typedef struct {
@@ -195,13 +219,72 @@ typedef struct {
             uint32_t count;
         } container;
         struct {
-            uint8_t significand[16];  // Little-endian magnitude bytes
-            int32_t exponent;
-            int32_t sign;            // -1 for negative, 0 for positive/zero
+            uint32_t offset;  // Offset of the encoded payload (after the type code) in input
+            uint32_t length;  // Length of the encoded payload in bytes
         } bigNumber;
+        struct {
+            uint32_t offset;  // Offset of the typed array's type code in input
+            uint32_t count;   // Number of elements
+        } typedArray;
+        struct {
+            uint32_t firstChild;  // First value; the values follow in definition key order
+            uint32_t definition;  // Index into ctx->recordDefs (overlays data.container.count)
+        } record;
     } data;
 } KSBONJSONMapEntry;
 
+/**
+ * A decoded big number.
+ *
+ * Map entries are kept at 16 bytes by storing only the location of a big
+ * number's payload; this struct is materialized on demand from the input
+ * via ksbonjson_map_getBigNumber() or ksbonjson_map_decodeBigNumber().
+ */
+typedef struct {
+    uint8_t significand[16];  // Little-endian magnitude bytes
+    int32_t exponent;
+    int32_t sign;            // -1 for negative, 0 for positive/zero
+} KSBONJSONBigNumberValue;
+
+/**
+ * Element type of a typed array span.
+ *
+ * The order matches the typed array type codes, counting down from 0xFE.
+ */
+typedef enum {
+    KSBONJSON_TYPED_ELEMENT_UINT8 = 0,
+    KSBONJSON_TYPED_ELEMENT_UINT16,
+    KSBONJSON_TYPED_ELEMENT_UINT32,
+    KSBONJSON_TYPED_ELEMENT_UINT64,
+    KSBONJSON_TYPED_ELEMENT_SINT8,
+    KSBONJSON_TYPED_ELEMENT_SINT16,
+    KSBONJSON_TYPED_ELEMENT_SINT32,
+    KSBONJSON_TYPED_ELEMENT_SINT64,
+    KSBONJSON_TYPED_ELEMENT_FLOAT32,
+    KSBONJSON_TYPED_ELEMENT_FLOAT64,
+} KSBONJSONTypedElementType;
+
+/**
+ * The element data of a typed array, located in the input buffer.
+ *
+ * Elements are stored little-endian and are not necessarily aligned.
+ * See ksbonjson_map_getTypedArray().
+ */
+typedef struct {
+    const uint8_t* data;
+    size_t count;
+    size_t elementSize;
+    KSBONJSONTypedElementType elementType;
+} KSBONJSONTypedArray;
+
+/**
+ * Value of data.container.count for a container in a lazy map whose children
+ * haven't been scanned yet. data.container.firstChild then holds the input
+ * offset of the container's type code instead of an entry index.
+ * See ksbonjson_map_setLazy().
+ */
+#define KSBONJSON_MAP_UNEXPANDED UINT32_MAX
+
 #define KSBONJSON_MAX_RECORD_DEFS 256
 
 typedef struct {
@@ -209,21 +292,163 @@ typedef struct {
     uint32_t keyCount;
 } KSBONJSONRecordDef;
 
+/**
+ * Locates one object's key hash table within ctx->keyIndexSlots.
+ * Each slot holds (key entry index + 1), or 0 if empty; the value is the entry after the key.
+ */
+typedef struct {
+    uint32_t objectIndex;  // Map index of the indexed object
+    uint32_t firstSlot;    // Offset of the object's table in keyIndexSlots
+    uint32_t slotMask;     // Table size - 1 (tables are a power of two in size)
+} KSBONJSONKeyIndexRef;
+
+/**
+ * One distinct object key (see ksbonjson_map_setInternKeys). Its key id is its
+ * index in ctx->internedKeys.
+ */
+typedef struct {
+    uint32_t offset;  // Offset in input of the first occurrence mapped
+    uint32_t length;
+    uint32_t hash;
+} KSBONJSONInternedKey;
+
+// Returned by ksbonjson_map_findKeyId() for bytes that are no key in the document
+#define KSBONJSON_MAP_NO_KEY_ID UINT32_MAX
+
+/**
+ * Scratch hash set of key entry indices, used for duplicate key detection.
+ * Sets are stacked in ctx->keySetSlots: a nested object's set sits above its
+ * parent's, and a parent only inserts once its children are finished, so the
+ * topmost set can always grow in place. Slots hold (key entry index + 1), 0 if empty.
+ */
+typedef struct {
+    size_t base;   // Offset of this set's table in ctx->keySetSlots
+    size_t size;   // Table size (power of two), 0 until the first key
+    size_t count;
+} KSBONJSONMapKeySet;
+
+/**
+ * A container whose children are being scanned. The scanner keeps one per open
+ * container in ctx->containerStack and loops over them instead of recursing.
+ */
+typedef struct {
+    uint32_t entryIndex;        // Map index of the container's entry
+    uint32_t firstChild;        // Map index of its first child
+    uint32_t count;             // Children scanned so far (keys and values, for objects)
+    uint32_t recordDef;         // Definition of a record instance
+    uint8_t kind;               // Array, object or record instance
+    KSBONJSONMapKeySet keySet;  // An object's keys, when rejecting duplicates
+} KSBONJSONMapFrame;
+
+/**
+ * A run of consecutive root array elements, scanned independently of the
+ * others in a parallel scan. See ksbonjson_map_partition().
+ */
+typedef struct {
+    size_t offset;        // Input offset of the run's first element
+    size_t length;        // Input bytes covered by the run
+    size_t elementCount;  // Number of elements in the run
+} KSBONJSONMapSegment;
+
+#define KSBONJSON_VALUE_TYPE_COUNT (KSBONJSON_TYPE_RECORD + 1)
+
+/**
+ * Counters a map fills in while scanning, for finding out why a document is slow to decode.
+ * Nothing is counted unless the library is built with KSBONJSON_STATS defined; otherwise the
+ * instrumentation compiles out. See ksbonjson_map_setStats().
+ *
+ * Counts accumulate across scans and expansions until the caller zeroes the struct.
+ * The segments of a parallel scan are only counted in valueCounts.
+ */
 typedef struct {
+    bool measuresTime;               // Set by the caller to fill in the *Nanoseconds fields
+
+    size_t valueCounts[KSBONJSON_VALUE_TYPE_COUNT]; // Entries mapped, by KSBONJSONValueType
+    size_t shortStringCount;         // Strings (keys included) with the length in the type code
+    size_t shortStringBytes;
+    size_t longStringCount;          // 0xFF-terminated strings
+    size_t longStringBytes;
+    size_t fastValidationCount;      // Strings accepted by the SIMD (or all-ASCII) check
+    size_t fastValidationBytes;
+    size_t slowValidationCount;      // Strings that fell back to the byte-by-byte validator
+    size_t slowValidationBytes;
+    size_t duplicateKeyComparisons;  // Keys compared while rejecting duplicate keys
+    size_t maxDepth;                 // Deepest nesting reached by one scan or expansion
+    size_t recordInstanceCount;      // Record instances whose values were scanned
+    size_t expansionCount;           // Containers expanded on a lazy map
+    size_t entryBufferGrowths;       // Calls to growEntries for more entry space
+    uint64_t scanNanoseconds;        // Time in ksbonjson_map_scan() and the scanDocument functions
+    uint64_t expandNanoseconds;      // Time in ksbonjson_map_expand()
+} KSBONJSONMapStats;
+
+struct KSBONJSONMapContext;
+
+/**
+ * Called when the scan runs out of entry space.
+ * Must update ctx->entries and ctx->entriesCapacity so that at least
+ * requiredCapacity entries fit, preserving the entries already written.
+ * Return false if the buffer cannot grow (the scan then fails with MAP_FULL).
+ */
+typedef bool (*KSBONJSONMapGrowEntriesFunc)(struct KSBONJSONMapContext* ctx, size_t requiredCapacity);
+
+typedef struct KSBONJSONMapContext {
     const uint8_t* input;
     size_t inputLength;
     KSBONJSONMapEntry* entries;
     size_t entriesCapacity;
     size_t entriesCount;
+    KSBONJSONMapGrowEntriesFunc growEntries; // NULL for a fixed-size entry buffer
+    void* growUserData;                      // Available to custom growEntries implementations
     size_t rootIndex;
     size_t position;
+    bool isLazy;                             // Expand containers on first access (see ksbonjson_map_setLazy)
+    bool compactRecords;                     // Map record instances as KSBONJSON_TYPE_RECORD (see ksbonjson_map_setCompactRecords)
     int containerDepth;
-    size_t containerStack[KSBONJSON_MAX_CONTAINER_DEPTH];
+    KSBONJSONMapFrame containerStack[KSBONJSON_MAX_CONTAINER_DEPTH];
     KSBONJSONDecodeFlags flags;
+
+    // The flags' limits, with SIZE_MAX resolved to the defaults when the scan begins.
+    // maxDepth is also clamped to KSBONJSON_MAX_CONTAINER_DEPTH.
+    size_t maxDepth;
+    size_t maxStringLength;
+    size_t maxContainerSize;
+    size_t maxDocumentSize;
     KSBONJSONRecordDef recordDefs[KSBONJSON_MAX_RECORD_DEFS];
     size_t recordDefCount;
+
+    // Per-object key indexes (see ksbonjson_map_setKeyIndexMinPairs)
+    size_t keyIndexMinPairs;                 // 0 disables key indexing
+    uint32_t* keyIndexSlots;
+    size_t keyIndexSlotsCount;
+    size_t keyIndexSlotsCapacity;
+    KSBONJSONKeyIndexRef* keyIndexRefs;      // Sorted by objectIndex
+    size_t keyIndexRefsCount;
+    size_t keyIndexRefsCapacity;
+
+    // Interned object keys (see ksbonjson_map_setInternKeys)
+    bool internKeys;
+    uint32_t* keyIds;                        // Key id of each key entry, by entry index (undefined for other entries)
+    size_t keyIdsCapacity;
+    KSBONJSONInternedKey* internedKeys;      // Indexed by key id
+    size_t internedKeyCount;
+    size_t internedKeyCapacity;
+    uint32_t* internSlots;                   // Hash table of (key id + 1), or 0 if empty
+    size_t internSlotsCapacity;
+
+    // Scratch hash sets for duplicate key detection, shared by all objects
+    // in a scan and released when the scan (or expansion) finishes
+    uint32_t* keySetSlots;
+    size_t keySetCapacity;
+    size_t keySetTop;
+
+    KSBONJSONMapStats* stats;                // NULL unless collecting (see ksbonjson_map_setStats)
 } KSBONJSONMapContext;
 
+/**
+ * Begin a scan into a caller-provided entry buffer.
+ * Every field a scan reads is set here (the container stack and record definitions
+ * are only read up to their current counts), so the context needn't be zeroed first.
+ */
 KSBONJSON_PUBLIC void ksbonjson_map_beginWithFlags(
     KSBONJSONMapContext* ctx,
     const uint8_t* input,
@@ -239,7 +464,312 @@ KSBONJSON_PUBLIC void ksbonjson_map_begin(
     KSBONJSONMapEntry* entries,
     size_t entriesCapacity);
 
+/**
+ * Begin a scan with an entry buffer that the decoder allocates and grows itself
+ * (via ksbonjson_map_reallocEntries), so allocation stays proportional to the
+ * number of values and the document is scanned exactly once.
+ * Release the buffer with ksbonjson_map_freeEntries() when done with the map.
+ */
+KSBONJSON_PUBLIC void ksbonjson_map_beginGrowable(
+    KSBONJSONMapContext* ctx,
+    const uint8_t* input,
+    size_t inputLength,
+    KSBONJSONDecodeFlags flags);
+
+/**
+ * Begin a new growable scan on a context that has already been used for one,
+ * keeping its entry buffer, key index, intern and duplicate-key tables instead of
+ * freeing them. Repeated small scans then reuse buffers that have already grown to size.
+ * The context must have been started with ksbonjson_map_beginGrowable().
+ */
+KSBONJSON_PUBLIC void ksbonjson_map_resetGrowable(
+    KSBONJSONMapContext* ctx,
+    const uint8_t* input,
+    size_t inputLength,
+    KSBONJSONDecodeFlags flags);
+
+/**
+ * Default growEntries implementation: grows ctx->entries with realloc().
+ * The first allocation is sized from the input length; later ones double.
+ * ctx->entries must be NULL or a buffer previously returned by this function.
+ */
+KSBONJSON_PUBLIC bool ksbonjson_map_reallocEntries(KSBONJSONMapContext* ctx, size_t requiredCapacity);
+
+/**
+ * Free an entry buffer allocated by ksbonjson_map_reallocEntries(),
+ * along with any key indexes (see ksbonjson_map_freeKeyIndex()), interned keys and the
+ * duplicate-key scratch table that a growable map keeps between scans.
+ */
+KSBONJSON_PUBLIC void ksbonjson_map_freeEntries(KSBONJSONMapContext* ctx);
+
+/**
+ * Build a hash index of the keys of every object with at least minPairs
+ * key-value pairs, making ksbonjson_map_findKey() O(1) for those objects.
+ * Pass 0 to disable indexing (the default for ksbonjson_map_begin*();
+ * ksbonjson_map_beginGrowable() uses KSBONJSON_MAP_KEY_INDEX_MIN_PAIRS).
+ * Must be called after begin and before scan.
+ *
+ * Index tables are allocated with realloc() as objects are scanned; an
+ * allocation failure only leaves that object unindexed. Release them with
+ * ksbonjson_map_freeKeyIndex().
+ */
+KSBONJSON_PUBLIC void ksbonjson_map_setKeyIndexMinPairs(KSBONJSONMapContext* ctx, size_t minPairs);
+
+/**
+ * Returns true if the object at the given index has a key index.
+ */
+KSBONJSON_PUBLIC bool ksbonjson_map_hasKeyIndex(KSBONJSONMapContext* ctx, size_t objectIndex);
+
+/**
+ * Free the key index tables built during the scan.
+ */
+KSBONJSON_PUBLIC void ksbonjson_map_freeKeyIndex(KSBONJSONMapContext* ctx);
+
+/**
+ * Give every object key entry (record definition keys included) a key id in
+ * ctx->keyIds, shared by all keys with the same bytes. Ids are dense and numbered
+ * in the order the keys are first mapped (document order, unless lazy), and
+ * ctx->internedKeys holds where each was first mapped.
+ * Off by default. Must be called after begin and before scan.
+ *
+ * Matching keys by id is an integer compare, and a caller caching one string per
+ * id builds it once however many objects repeat the key. The tables grow with
+ * realloc() like the entry buffer, and the scan fails with KSBONJSON_DECODE_MAP_FULL
+ * if they can't. Lazily mapped containers' keys are interned as they are expanded.
+ * ksbonjson_map_freeEntries() releases them.
+ */
+KSBONJSON_PUBLIC void ksbonjson_map_setInternKeys(KSBONJSONMapContext* ctx, bool internKeys);
+
+/**
+ * Find the key id of a key. Returns KSBONJSON_MAP_NO_KEY_ID if no object key
+ * mapped so far has these bytes, or if keys aren't being interned.
+ */
+KSBONJSON_PUBLIC uint32_t ksbonjson_map_findKeyId(KSBONJSONMapContext* ctx, const char* key, size_t keyLength);
+
+/**
+ * Switch the map to lazy mode. Must be called after begin and before scan.
+ *
+ * A lazy scan still walks the whole document to check its structure (bounds,
+ * nesting depth, container delimiters), but only creates entries for the root
+ * container's direct children. Every other container is recorded as a single
+ * unexpanded entry (see KSBONJSON_MAP_UNEXPANDED) whose children are scanned
+ * the first time ksbonjson_map_getChild(), ksbonjson_map_findKey() or a batch
+ * decode function touches it, or when ksbonjson_map_expand() is called.
+ * String validation, duplicate key detection and container size limits are
+ * only applied to containers as they are expanded.
+ *
+ * Expanded children are appended to the entries buffer, so every container's
+ * subtreeSize is 1 and a growable or generously sized buffer is required.
+ * Expansion may reallocate the buffer, invalidating entry pointers obtained
+ * earlier (indices remain valid).
+ */
+KSBONJSON_PUBLIC void ksbonjson_map_setLazy(KSBONJSONMapContext* ctx, bool isLazy);
+
+/**
+ * Map record instances as KSBONJSON_TYPE_RECORD entries rather than as objects.
+ * Must be called after begin and before scan.
+ *
+ * By default every record instance is expanded into a regular object, with a copy
+ * of its definition's key entries before each value. A compact record instead holds
+ * only its values (one per definition key, in key order, with missing trailing values
+ * padded as nulls) plus the index of its definition, so the keys can be resolved to
+ * value positions once per definition and shared by every instance.
+ *
+ * Compact records are never key indexed. ksbonjson_map_getChild() steps over values
+ * only and ksbonjson_map_findKey() searches the definition's keys.
+ * On a lazy map, an unexpanded compact record has data.record.definition set to
+ * KSBONJSON_MAP_UNEXPANDED until it is expanded.
+ */
+KSBONJSON_PUBLIC void ksbonjson_map_setCompactRecords(KSBONJSONMapContext* ctx, bool compactRecords);
+
+/**
+ * Count what the scan (and any later expansions) does into stats, which must stay valid
+ * for as long as the map is used. Pass NULL to stop counting.
+ * Must be called after begin (which clears it; ksbonjson_map_resetGrowable() keeps it) and before scan.
+ *
+ * Has no effect unless the library is built with KSBONJSON_STATS defined.
+ */
+KSBONJSON_PUBLIC void ksbonjson_map_setStats(KSBONJSONMapContext* ctx, KSBONJSONMapStats* stats);
+
+/**
+ * Get the definition of the compact record at the given index, whose keys are the
+ * KSBONJSON_TYPE_STRING entries firstKeyIndex to firstKeyIndex + keyCount - 1.
+ * Returns NULL if the entry isn't an expanded KSBONJSON_TYPE_RECORD.
+ */
+KSBONJSON_PUBLIC const KSBONJSONRecordDef* ksbonjson_map_getRecordDef(KSBONJSONMapContext* ctx, size_t recordIndex);
+
+/**
+ * Scan the children of an unexpanded container in a lazy map, or convert a
+ * typed array span into a regular array with an entry per element.
+ * Does nothing (and returns OK) if the entry is already expanded or isn't a container.
+ * On failure the container stays unexpanded and the map is otherwise unchanged.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_map_expand(KSBONJSONMapContext* ctx, size_t index);
+
 KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_map_scan(KSBONJSONMapContext* ctx);
+
+// ----------------------------------------------------------------------------
+// Document sequences
+// ----------------------------------------------------------------------------
+// A buffer of concatenated documents (such as an append-only event log) is
+// mapped one document at a time, reusing one growable context:
+//
+//    size_t offset = 0;
+//    ksbonjson_map_beginGrowable(&ctx, input, inputLength, flags);
+//    while (offset < inputLength)
+//    {
+//        status = ksbonjson_map_scanNextDocument(&ctx, input, inputLength, &offset);
+//        // ... use the map (offsets in it are relative to the document) ...
+//    }
+//    ksbonjson_map_freeEntries(&ctx);
+
+/**
+ * Scan the document at the start of ctx->input, allowing other documents to follow it.
+ * Must be called after begin instead of ksbonjson_map_scan().
+ *
+ * Trailing bytes are never rejected, and maxDocumentSize limits the document
+ * itself rather than the whole input. On success *outLength is set to the
+ * document's length in bytes and ctx->inputLength is trimmed to it.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_map_scanDocument(KSBONJSONMapContext* ctx, size_t* outLength);
+
+/**
+ * Map the document starting at *offset in a buffer of concatenated documents,
+ * then advance *offset past it (it is left unchanged on failure).
+ *
+ * ctx must have been begun with ksbonjson_map_beginGrowable(). Each call resets it
+ * as ksbonjson_map_resetGrowable() does, keeping its allocations and its lazy,
+ * compact record, key index and key interning settings, so a long sequence costs
+ * no per-document setup.
+ * The map's input is the document alone: its offsets are relative to the document start.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_map_scanNextDocument(
+    KSBONJSONMapContext* ctx,
+    const uint8_t* input,
+    size_t inputLength,
+    size_t* offset);
+
+// ----------------------------------------------------------------------------
+// Parallel scanning
+// ----------------------------------------------------------------------------
+// A large root array can be scanned on several threads instead of calling
+// ksbonjson_map_scan():
+//
+// 1. ksbonjson_map_partition() walks the document's structure once (creating
+//    no entries) and splits the root array's elements into segments.
+// 2. ksbonjson_map_scanSegment() scans each segment into its own growable
+//    context. Segments only read the partitioned context, so they can be
+//    scanned concurrently.
+// 3. ksbonjson_map_joinSegments() appends the segments to the partitioned
+//    context in order, leaving the same map a serial eager scan produces.
+//
+// Threading is left to the caller.
+
+/**
+ * Check the document's structure and split the root array's elements into at most
+ * maxSegments runs of similar byte size, each at least KSBONJSON_MAP_MIN_SEGMENT_BYTES.
+ * Must be called after begin (on an eager, growable map) instead of ksbonjson_map_scan().
+ *
+ * If the root isn't an array or is too small to split, *outSegmentCount is set to 0
+ * and ctx is left ready for ksbonjson_map_scan(). If the document is malformed, it is
+ * scanned serially to return the same status ksbonjson_map_scan() would.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_map_partition(
+    KSBONJSONMapContext* ctx,
+    KSBONJSONMapSegment* segments,
+    size_t maxSegments,
+    size_t* outSegmentCount);
+
+/**
+ * Scan one segment of a partitioned context into segmentCtx, which is begun
+ * here as a growable map. Release it with ksbonjson_map_freeEntries() once joined
+ * (or on failure).
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_map_scanSegment(
+    KSBONJSONMapContext* segmentCtx,
+    const KSBONJSONMapContext* ctx,
+    KSBONJSONMapSegment segment);
+
+/**
+ * Append the scanned segments (in partition order) to ctx and add the root array entry.
+ * The segment contexts are left untouched.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_map_joinSegments(
+    KSBONJSONMapContext* ctx,
+    const KSBONJSONMapContext* segmentContexts,
+    size_t segmentCount);
+
+// ----------------------------------------------------------------------------
+// Map indexes
+// ----------------------------------------------------------------------------
+// A finished eager map can be saved as an index, so that later processes open
+// the same (immutable) document without scanning it again:
+//
+//    ksbonjson_map_writeIndex(&ctx, writeToFile, file);
+//    ...
+//    ksbonjson_map_openIndex(&ctx, document, documentLength, index, indexLength, flags);
+//    // ... use the map ...
+//    ksbonjson_map_closeIndex(&ctx);
+//
+// An opened map points into the index rather than copying it, so opening costs
+// the same however large the document is, and memory-mapped documents and
+// indexes are shared through the page cache by every process that opens them.
+//
+// The index records the scan's settings and a fingerprint of the document (its
+// length and a hash of sampled blocks), and only opens with matching ones. The
+// fingerprint catches a replaced or rewritten document, but not every edit in
+// place: the index is otherwise trusted, so only open indexes the caller wrote.
+
+/**
+ * Called with each part of an index being written. Return false to stop writing.
+ */
+typedef bool (*KSBONJSONMapIndexWriteFunc)(const uint8_t* data, size_t dataLength, void* userData);
+
+/**
+ * Fingerprint a document as a map index does.
+ */
+KSBONJSON_PUBLIC uint64_t ksbonjson_map_fingerprint(const uint8_t* input, size_t inputLength);
+
+/**
+ * Write ctx's map as an index of its document, handing it to write in parts.
+ * The map must have been scanned eagerly (any typed arrays expanded since are
+ * kept). Returns KSBONJSON_DECODE_INVALID_DATA for a lazy map,
+ * KSBONJSON_DECODE_COULD_NOT_PROCESS_DATA if write fails, or
+ * KSBONJSON_DECODE_OUT_OF_MEMORY if the interned key table can't be copied.
+ *
+ * The index is only readable on machines with the same byte order and entry layout.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_map_writeIndex(
+    KSBONJSONMapContext* ctx,
+    KSBONJSONMapIndexWriteFunc write,
+    void* userData);
+
+/**
+ * Begin ctx as the map an index was written from, instead of scanning the document.
+ * Both input and index must stay valid (and unchanged) until ksbonjson_map_closeIndex().
+ * index must be 8-byte aligned; it is never written to.
+ *
+ * Returns KSBONJSON_DECODE_INDEX_MISMATCH if the index was written for another
+ * document, with other flags, scan settings or library version, or on another
+ * kind of machine, and KSBONJSON_DECODE_INVALID_DATA if it is truncated, misaligned
+ * or not an index.
+ *
+ * Expanding a typed array copies the entries into a buffer of ctx's own first.
+ * An opened map must not be reset, rescanned or freed with ksbonjson_map_freeEntries().
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_map_openIndex(
+    KSBONJSONMapContext* ctx,
+    const uint8_t* input,
+    size_t inputLength,
+    const void* index,
+    size_t indexLength,
+    KSBONJSONDecodeFlags flags);
+
+/**
+ * Release what an opened map allocated for itself. The index can be unmapped afterwards.
+ */
+KSBONJSON_PUBLIC void ksbonjson_map_closeIndex(KSBONJSONMapContext* ctx);
+
 KSBONJSON_PUBLIC size_t ksbonjson_map_root(KSBONJSONMapContext* ctx);
 KSBONJSON_PUBLIC const KSBONJSONMapEntry* ksbonjson_map_get(KSBONJSONMapContext* ctx, size_t index);
 KSBONJSON_PUBLIC size_t ksbonjson_map_count(KSBONJSONMapContext* ctx);
@@ -254,15 +784,57 @@ KSBONJSON_PUBLIC size_t ksbonjson_map_getChild(
     size_t containerIndex,
     size_t childIndex);
 
+/**
+ * Find the value for a key in an object. Returns SIZE_MAX if not found.
+ * Uses the object's key index when it has one, otherwise scans the pairs in order.
+ * Either way, the first occurrence of a duplicated key wins.
+ */
 KSBONJSON_PUBLIC size_t ksbonjson_map_findKey(
     KSBONJSONMapContext* ctx,
     size_t objectIndex,
     const char* key,
     size_t keyLength);
 
+/**
+ * Locate the element data of the typed array span at the given map index.
+ * Returns false if the index is out of range or not a KSBONJSON_TYPE_TYPED_ARRAY.
+ *
+ * Typed arrays are mapped as a single span entry rather than one entry per
+ * element. ksbonjson_map_getChild() and ksbonjson_map_expand() convert a span
+ * into a regular array (appending an entry per element) when element-wise
+ * access is needed; the batch decode functions read spans directly.
+ */
+KSBONJSON_PUBLIC bool ksbonjson_map_getTypedArray(
+    KSBONJSONMapContext* ctx,
+    size_t index,
+    KSBONJSONTypedArray* outArray);
+
+/**
+ * Decode the big number at the given map index.
+ * Returns a zero value if the index is out of range or not a big number.
+ */
+KSBONJSON_PUBLIC KSBONJSONBigNumberValue ksbonjson_map_getBigNumber(
+    KSBONJSONMapContext* ctx,
+    size_t index);
+
+/**
+ * Decode a big number entry's payload directly from the input it was scanned from.
+ * Useful when the caller holds the input and entries but not a live context.
+ */
+KSBONJSON_PUBLIC KSBONJSONBigNumberValue ksbonjson_map_decodeBigNumber(
+    const uint8_t* input,
+    const KSBONJSONMapEntry* entry);
+
+/**
+ * Upper bound on the entries a document without records needs, for callers
+ * that supply a fixed buffer. Record instances can still exceed it; prefer
+ * ksbonjson_map_beginGrowable() when the input isn't trusted to be small.
+ */
 KSBONJSON_PUBLIC size_t ksbonjson_map_estimateEntries(size_t inputLength);
 
 // Batch decode functions
+// Each decodes up to maxCount elements of an array and returns the number decoded.
+// Typed array spans are converted straight from the input without being expanded.
 KSBONJSON_PUBLIC size_t ksbonjson_map_decodeInt64Array(
     KSBONJSONMapContext* ctx, size_t arrayIndex, int64_t* outBuffer, size_t maxCount);
 
@@ -284,6 +856,100 @@ KSBONJSON_PUBLIC size_t ksbonjson_map_decodeStringArray(
     KSBONJSONMapContext* ctx, size_t arrayIndex, KSBONJSONStringRef* outBuffer, size_t maxCount);
 
 
+// ============================================================================
+// Path Queries
+// ============================================================================
+// A path expression selects values in a position map without decoding the rest:
+//
+//    $.user.id          member "id" of member "user" of the root
+//    $.items[0]         first element of the "items" array
+//    $.items[*].price   member "price" of every element of "items"
+//    $["key.with.dots"] a member whose name needs quoting ('...' works too)
+//    $.config.*         every member value of an object
+//
+// The leading "$" is optional. Quoted names have no escapes. A path is compiled
+// once and can be evaluated against any number of maps. On a lazy map only the
+// containers the path passes through are expanded.
+
+#define KSBONJSON_MAX_PATH_STEPS 32
+
+typedef enum {
+    KSBONJSON_PATH_STEP_KEY = 0,  // Object member (or compact record field)
+    KSBONJSON_PATH_STEP_INDEX,    // Array element
+    KSBONJSON_PATH_STEP_WILDCARD, // Every array element or object member value
+} KSBONJSONPathStepType;
+
+typedef struct {
+    KSBONJSONPathStepType type;
+    uint32_t keyOffset;  // KEY: name's offset in the expression
+    uint32_t keyLength;  // KEY: name's length in bytes
+    size_t index;        // INDEX: element index
+} KSBONJSONPathStep;
+
+typedef struct {
+    /**
+     * The compiled expression. Names are stored as offsets into it, so it must stay
+     * valid while the path is used (or be set again to an identical copy).
+     */
+    const char* expression;
+    KSBONJSONPathStep steps[KSBONJSON_MAX_PATH_STEPS];
+    size_t stepCount;
+} KSBONJSONPath;
+
+/**
+ * Compile a path expression. Returns false if it is malformed, has an empty unquoted
+ * name, or has more than KSBONJSON_MAX_PATH_STEPS steps. Unquoted names can't contain
+ * whitespace, control characters, quotes, brackets or '*'.
+ */
+KSBONJSON_PUBLIC bool ksbonjson_path_compile(KSBONJSONPath* path, const char* expression, size_t length);
+
+/**
+ * Find the first value the path selects, starting from the entry at startIndex
+ * (usually ksbonjson_map_root()). Returns its map index, or SIZE_MAX if nothing matches.
+ *
+ * Every path function sets *outStatus (if not NULL) to KSBONJSON_DECODE_OK, or to the
+ * status of the first container on the path that a lazy map failed to expand, whose
+ * matches are skipped.
+ */
+KSBONJSON_PUBLIC size_t ksbonjson_path_find(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex,
+    ksbonjson_decodeStatus* outStatus);
+
+/**
+ * Find every value the path selects, in document order, writing up to maxCount map
+ * indices to outIndices. Returns the number of matches, which may exceed maxCount.
+ * Entry indices stay valid, but expanding a lazy map may move ctx->entries.
+ */
+KSBONJSON_PUBLIC size_t ksbonjson_path_findAll(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex,
+    size_t* outIndices, size_t maxCount, ksbonjson_decodeStatus* outStatus);
+
+// Path batch decode functions
+// Each converts up to maxCount selected values as the matching batch decode function
+// does, and returns the number of matches (which may exceed maxCount).
+// When the last step is a wildcard over a typed array span ("$.samples[*]"), the span's
+// elements are converted directly, without expanding it to an entry per element.
+KSBONJSON_PUBLIC size_t ksbonjson_path_decodeInt64s(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex,
+    int64_t* outBuffer, size_t maxCount, ksbonjson_decodeStatus* outStatus);
+
+KSBONJSON_PUBLIC size_t ksbonjson_path_decodeUInt64s(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex,
+    uint64_t* outBuffer, size_t maxCount, ksbonjson_decodeStatus* outStatus);
+
+KSBONJSON_PUBLIC size_t ksbonjson_path_decodeDoubles(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex,
+    double* outBuffer, size_t maxCount, ksbonjson_decodeStatus* outStatus);
+
+KSBONJSON_PUBLIC size_t ksbonjson_path_decodeBools(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex,
+    bool* outBuffer, size_t maxCount, ksbonjson_decodeStatus* outStatus);
+
+KSBONJSON_PUBLIC size_t ksbonjson_path_decodeStrings(
+    KSBONJSONMapContext* ctx, const KSBONJSONPath* path, size_t startIndex,
+    KSBONJSONStringRef* outBuffer, size_t maxCount, ksbonjson_decodeStatus* outStatus);
+
+
 // ============================================================================
 // Callback-Based Decoder (Legacy API)
 // ============================================================================
@@ -305,6 +971,13 @@ typedef struct KSBONJSONDecodeCallbacks
     ksbonjson_decodeStatus (*onEndData)(void* userData);
 } KSBONJSONDecodeCallbacks;
 
+/**
+ * Decode a whole document, reporting each value to the callbacks.
+ *
+ * Record instances are reported as objects: onString with each definition key
+ * before its value, then a key and onNull for each value the instance leaves out.
+ * Record definitions are only accepted at the top level.
+ */
 KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_decode(
     const uint8_t* KSBONJSON_RESTRICT document,
     size_t documentLength,
@@ -312,6 +985,97 @@ KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_decode(
     void* KSBONJSON_RESTRICT userData,
     size_t* KSBONJSON_RESTRICT decodedOffset);
 
+
+// ============================================================================
+// Incremental Callback-Based Decoder
+// ============================================================================
+
+typedef struct {
+    uint8_t isObject: 1;
+    uint8_t isExpectingName: 1;  // In a record: the next field's key hasn't been reported
+    uint8_t isRecord: 1;
+    uint16_t recordDef;    // Record: index of the instance's definition
+    uint32_t recordField;  // Record: index of the next field
+} KSBONJSONDecodeContainerState;
+
+/**
+ * The record definitions a callback decoder has read, kept so that it can report
+ * the keys of their instances. Fields are managed by the decoder.
+ */
+typedef struct {
+    struct {
+        uint32_t firstKey;
+        uint32_t keyCount;
+    } defs[KSBONJSON_MAX_RECORD_DEFS];
+    size_t defCount;
+
+    // Key i is keyBytes[keyEnds[i-1] ..< keyEnds[i]] (keyEnds[-1] being 0)
+    uint8_t* keyBytes;
+    size_t keyBytesLength;
+    size_t keyBytesCapacity;
+    size_t* keyEnds;
+    size_t keyCount;
+    size_t keyCapacity;
+} KSBONJSONDecodeRecordDefs;
+
+/**
+ * Callback decoder state kept between the chunks of a document that arrives
+ * piece by piece. Set up with ksbonjson_decodeIncremental_begin(); the fields
+ * are managed by the decoder.
+ */
+typedef struct {
+    const KSBONJSONDecodeCallbacks* callbacks;
+    void* userData;
+    ksbonjson_decodeStatus status;  // First failure; later calls return it again
+    int containerDepth;
+    KSBONJSONDecodeContainerState containers[KSBONJSON_MAX_CONTAINER_DEPTH + 1];
+
+    // The typed array whose elements are being reported (0 when there is none)
+    uint8_t typedArrayType;
+    uint64_t typedArrayRemaining;
+
+    KSBONJSONDecodeRecordDefs recordDefs;
+
+    // The start of a token that was cut off by the end of a chunk
+    uint8_t* pending;
+    size_t pendingLength;
+    size_t pendingCapacity;
+
+    size_t decodedOffset;  // Document bytes fully decoded so far
+} KSBONJSONIncrementalDecodeContext;
+
+KSBONJSON_PUBLIC void ksbonjson_decodeIncremental_begin(
+    KSBONJSONIncrementalDecodeContext* ctx,
+    const KSBONJSONDecodeCallbacks* callbacks,
+    void* userData);
+
+/**
+ * Decode the next chunk of a document, reporting every token that it completes.
+ *
+ * A token cut off by the end of the chunk is copied and finished by later
+ * chunks, so at most one string, number or typed array element is buffered
+ * at a time; typed arrays are reported element by element as they arrive.
+ * Strings passed to onString are only valid for the duration of the callback.
+ * The chunk itself need not outlive the call.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_decodeIncremental_feed(
+    KSBONJSONIncrementalDecodeContext* ctx,
+    const uint8_t* chunk,
+    size_t chunkLength);
+
+/**
+ * Finish the document, reporting onEndData if it ended cleanly, and release
+ * the context's buffer. Must be called even if an earlier feed failed.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_decodeIncremental_end(KSBONJSONIncrementalDecodeContext* ctx);
+
+/**
+ * Check that data is valid UTF-8 (with no NUL characters if rejectNUL is set), as the
+ * position map checks strings. Returns KSBONJSON_DECODE_OK, KSBONJSON_DECODE_INVALID_UTF8
+ * or KSBONJSON_DECODE_NUL_CHARACTER, whichever the first problem in the data is.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_validateUTF8(const uint8_t* data, size_t length, bool rejectNUL);
+
 KSBONJSON_PUBLIC const char* ksbonjson_describeDecodeStatus(ksbonjson_decodeStatus status) __attribute__((const));
 
 
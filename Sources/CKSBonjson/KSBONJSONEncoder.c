@@ -72,7 +72,7 @@ static inline KSBONJSONContainerState* getBufferContainer(KSBONJSONBufferEncodeC
 static inline bool bufferWouldExceedDocumentSize(KSBONJSONBufferEncodeContext* ctx, size_t length)
 {
     size_t maxSize = ctx->flags.maxDocumentSize < SIZE_MAX ? ctx->flags.maxDocumentSize : KSBONJSON_DEFAULT_MAX_DOCUMENT_SIZE;
-    return (ctx->position + length) > maxSize;
+    return (ctx->flushedBytes + ctx->position + length) > maxSize;
 }
 
 static inline void bufferWriteBytes(KSBONJSONBufferEncodeContext* ctx,
@@ -122,7 +122,49 @@ ssize_t ksbonjson_encodeToBuffer_end(KSBONJSONBufferEncodeContext* ctx)
     {
         return -KSBONJSON_ENCODE_CONTAINERS_ARE_STILL_OPEN;
     }
-    return (ssize_t)ctx->position;
+    return (ssize_t)(ctx->flushedBytes + ctx->position);
+}
+
+void ksbonjson_encodeToBuffer_setStats(KSBONJSONBufferEncodeContext* ctx,
+                                       KSBONJSONEncodeStats* stats)
+{
+    ctx->stats = stats;
+}
+
+void ksbonjson_encodeToBuffer_setFlushCallback(KSBONJSONBufferEncodeContext* ctx,
+                                               KSBONJSONAddEncodedDataFunc flushData,
+                                               void* userData)
+{
+    ctx->flushData = flushData;
+    ctx->flushUserData = userData;
+}
+
+ssize_t ksbonjson_encodeToBuffer_flush(KSBONJSONBufferEncodeContext* ctx, size_t length)
+{
+    unlikely_if(ctx->flushData == NULL)
+    {
+        return -KSBONJSON_ENCODE_NULL_POINTER;
+    }
+    unlikely_if(length > ctx->position)
+    {
+        return -KSBONJSON_ENCODE_TOO_BIG;
+    }
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    ksbonjson_encodeStatus status = ctx->flushData(ctx->buffer, length, ctx->flushUserData);
+    unlikely_if(status != KSBONJSON_ENCODE_OK)
+    {
+        return -(ssize_t)status;
+    }
+
+    memmove(ctx->buffer, ctx->buffer + length, ctx->position - length);
+    ctx->position -= length;
+    ctx->flushedBytes += length;
+    STATS_ADD(ctx, flushCount, 1);
+    return (ssize_t)length;
 }
 
 int ksbonjson_encodeToBuffer_getDepth(KSBONJSONBufferEncodeContext* ctx)
@@ -170,6 +212,7 @@ ssize_t ksbonjson_encodeToBuffer_null(KSBONJSONBufferEncodeContext* ctx)
     container->isExpectingName = true;
     incrementContainerCount(ctx);
 
+    STATS_ADD(ctx, nullCount, 1);
     bufferWriteByte(ctx, TYPE_NULL);
     return 1;
 }
@@ -188,6 +231,7 @@ ssize_t ksbonjson_encodeToBuffer_bool(KSBONJSONBufferEncodeContext* ctx, bool va
     container->isExpectingName = true;
     incrementContainerCount(ctx);
 
+    STATS_ADD(ctx, boolCount, 1);
     bufferWriteByte(ctx, value ? TYPE_TRUE : TYPE_FALSE);
     return 1;
 }
@@ -205,6 +249,7 @@ ssize_t ksbonjson_encodeToBuffer_int(KSBONJSONBufferEncodeContext* ctx, int64_t
     }
     container->isExpectingName = true;
     incrementContainerCount(ctx);
+    STATS_ADD(ctx, intCount, 1);
 
     if (value >= 0 && value <= SMALLINT_MAX)
     {
@@ -258,6 +303,7 @@ ssize_t ksbonjson_encodeToBuffer_uint(KSBONJSONBufferEncodeContext* ctx, uint64_
     }
     container->isExpectingName = true;
     incrementContainerCount(ctx);
+    STATS_ADD(ctx, intCount, 1);
 
     if (value <= (uint64_t)SMALLINT_MAX)
     {
@@ -307,6 +353,7 @@ ssize_t ksbonjson_encodeToBuffer_float(KSBONJSONBufferEncodeContext* ctx, double
 
     container->isExpectingName = true;
     incrementContainerCount(ctx);
+    STATS_ADD(ctx, floatCount, 1);
 
     // Try float32
     const union num32_bits b32 = { .f32 = (float)value };
@@ -342,6 +389,7 @@ ssize_t ksbonjson_encodeToBuffer_bigNumber(KSBONJSONBufferEncodeContext* ctx, KS
 
     container->isExpectingName = true;
     incrementContainerCount(ctx);
+    STATS_ADD(ctx, bigNumberCount, 1);
 
     bufferWriteByte(ctx, TYPE_BIG_NUMBER);
     size_t totalBytes = 1;
@@ -424,12 +472,16 @@ ssize_t ksbonjson_encodeToBuffer_string(KSBONJSONBufferEncodeContext* ctx,
 
     if (length <= 66)
     {
+        STATS_ADD(ctx, shortStringCount, 1);
+        STATS_ADD(ctx, shortStringBytes, length);
         bufferWriteByte(ctx, (uint8_t)(TYPE_STRING0 + length));
         bufferWriteBytes(ctx, (const uint8_t*)value, length);
         return (ssize_t)(1 + length);
     }
 
     // Long string: FF + data + FF
+    STATS_ADD(ctx, longStringCount, 1);
+    STATS_ADD(ctx, longStringBytes, length);
     bufferWriteByte(ctx, TYPE_STRING_LONG);
     bufferWriteBytes(ctx, (const uint8_t*)value, length);
     bufferWriteByte(ctx, TYPE_STRING_LONG);
@@ -463,6 +515,8 @@ ssize_t ksbonjson_encodeToBuffer_beginObject(KSBONJSONBufferEncodeContext* ctx)
         .isExpectingName = true,
     };
     ctx->containerElementCounts[ctx->containerDepth] = 0;
+    STATS_ADD(ctx, objectCount, 1);
+    STATS_MAX(ctx, maxDepth, ctx->containerDepth);
 
     bufferWriteByte(ctx, TYPE_OBJECT);
     return 1;
@@ -492,6 +546,8 @@ ssize_t ksbonjson_encodeToBuffer_beginArray(KSBONJSONBufferEncodeContext* ctx)
     ctx->containerDepth++;
     ctx->containers[ctx->containerDepth] = (KSBONJSONContainerState){0};
     ctx->containerElementCounts[ctx->containerDepth] = 0;
+    STATS_ADD(ctx, arrayCount, 1);
+    STATS_MAX(ctx, maxDepth, ctx->containerDepth);
 
     bufferWriteByte(ctx, TYPE_ARRAY);
     return 1;
@@ -534,6 +590,53 @@ ssize_t ksbonjson_encodeToBuffer_endAllContainers(KSBONJSONBufferEncodeContext*
     return totalBytes;
 }
 
+ssize_t ksbonjson_encodeToBuffer_fragment(KSBONJSONBufferEncodeContext* ctx,
+                                          const uint8_t* fragment,
+                                          size_t length,
+                                          size_t depth)
+{
+    KSBONJSONContainerState* const container = getBufferContainer(ctx);
+    unlikely_if(!fragment)
+    {
+        return -KSBONJSON_ENCODE_NULL_POINTER;
+    }
+    unlikely_if(container->isObject & container->isExpectingName)
+    {
+        return -KSBONJSON_ENCODE_EXPECTED_OBJECT_NAME;
+    }
+
+    // An empty fragment, a stray end marker or a record can't stand in for a value here
+    unlikely_if(length == 0)
+    {
+        return -KSBONJSON_ENCODE_INVALID_DATA;
+    }
+    uint8_t typeCode = fragment[0];
+    unlikely_if(typeCode == TYPE_END || typeCode == TYPE_RECORD_DEF || typeCode == TYPE_RECORD_INSTANCE)
+    {
+        return -KSBONJSON_ENCODE_INVALID_DATA;
+    }
+
+    unlikely_if(bufferWouldExceedDocumentSize(ctx, length))
+    {
+        return -KSBONJSON_ENCODE_MAX_DOCUMENT_SIZE_EXCEEDED;
+    }
+
+    size_t maxDepth = ctx->flags.maxDepth < SIZE_MAX ? ctx->flags.maxDepth : KSBONJSON_MAX_CONTAINER_DEPTH;
+    unlikely_if(depth > maxDepth || (size_t)ctx->containerDepth > maxDepth - depth)
+    {
+        return -KSBONJSON_ENCODE_MAX_DEPTH_EXCEEDED;
+    }
+
+    container->isExpectingName = true;
+    incrementContainerCount(ctx);
+
+    STATS_MAX(ctx, maxDepth, (size_t)ctx->containerDepth + depth);
+    STATS_ADD(ctx, fragmentCount, 1);
+    STATS_ADD(ctx, fragmentBytes, length);
+    bufferWriteBytes(ctx, fragment, length);
+    return (ssize_t)length;
+}
+
 
 // ============================================================================
 // Batch encoding (optimized for arrays of primitives)
@@ -627,6 +730,8 @@ ssize_t ksbonjson_encodeToBuffer_int64Array(
     }
     totalBytes += count * 8;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -658,9 +763,99 @@ ssize_t ksbonjson_encodeToBuffer_doubleArray(
     }
     totalBytes += count * 8;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
+// The narrowest typed array type holding values with these ksbonjson_simd_int64Bits() results
+static inline uint8_t narrowestInt64ArrayType(uint64_t bits, uint64_t magnitudeBits)
+{
+    if ((int64_t)bits >= 0)
+    {
+        return bits <= UINT8_MAX ? TYPE_TYPED_UINT8
+             : bits <= UINT16_MAX ? TYPE_TYPED_UINT16
+             : bits <= UINT32_MAX ? TYPE_TYPED_UINT32
+             : TYPE_TYPED_SINT64;
+    }
+    return magnitudeBits <= INT8_MAX ? TYPE_TYPED_SINT8
+         : magnitudeBits <= INT16_MAX ? TYPE_TYPED_SINT16
+         : magnitudeBits <= INT32_MAX ? TYPE_TYPED_SINT32
+         : TYPE_TYPED_SINT64;
+}
+
+ssize_t ksbonjson_encodeToBuffer_narrowInt64Array(
+    KSBONJSONBufferEncodeContext* ctx,
+    const int64_t* values,
+    size_t count)
+{
+    uint64_t bits;
+    uint64_t magnitudeBits;
+    ksbonjson_simd_int64Bits(values, count, &bits, &magnitudeBits);
+    const uint8_t typeCode = narrowestInt64ArrayType(bits, magnitudeBits);
+    if (typeCode == TYPE_TYPED_SINT64)
+    {
+        return ksbonjson_encodeToBuffer_int64Array(ctx, values, count);
+    }
+
+    KSBONJSONContainerState* const container = getBufferContainer(ctx);
+    unlikely_if(container->isObject & container->isExpectingName)
+    {
+        return -KSBONJSON_ENCODE_EXPECTED_OBJECT_NAME;
+    }
+    container->isExpectingName = true;
+    incrementContainerCount(ctx);
+
+    // Typed array: type + ULEB128(count) + raw little-endian values of 1, 2 or 4 bytes
+    bufferWriteByte(ctx, typeCode);
+    uint8_t countBuf[10];
+    size_t countBytes = ksbonjson_writeULEB128(countBuf, (uint64_t)count);
+    bufferWriteBytes(ctx, countBuf, countBytes);
+
+    const size_t elementSize = typeCode == TYPE_TYPED_UINT8 || typeCode == TYPE_TYPED_SINT8 ? 1
+                             : typeCode == TYPE_TYPED_UINT16 || typeCode == TYPE_TYPED_SINT16 ? 2
+                             : 4;
+    ksbonjson_simd_narrowInt64(values, count, BUF_PTR(ctx), elementSize);
+    ctx->position += count * elementSize;
+
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
+    return (ssize_t)(1 + countBytes + count * elementSize);
+}
+
+ssize_t ksbonjson_encodeToBuffer_narrowDoubleArray(
+    KSBONJSONBufferEncodeContext* ctx,
+    const double* values,
+    size_t count)
+{
+    uint8_t countBuf[10];
+    size_t countBytes = ksbonjson_writeULEB128(countBuf, (uint64_t)count);
+
+    // Convert straight into place (the capacity reserved for float64 elements covers it),
+    // leaving the whole array to the float64 encoder if any value doesn't survive
+    if (!ksbonjson_simd_narrowFloat64(values, count, BUF_PTR(ctx) + 1 + countBytes))
+    {
+        return ksbonjson_encodeToBuffer_doubleArray(ctx, values, count);
+    }
+
+    KSBONJSONContainerState* const container = getBufferContainer(ctx);
+    unlikely_if(container->isObject & container->isExpectingName)
+    {
+        return -KSBONJSON_ENCODE_EXPECTED_OBJECT_NAME;
+    }
+    container->isExpectingName = true;
+    incrementContainerCount(ctx);
+
+    // Typed array: TYPE_TYPED_FLOAT32 + ULEB128(count) + the raw 4-byte LE values written above
+    bufferWriteByte(ctx, TYPE_TYPED_FLOAT32);
+    bufferWriteBytes(ctx, countBuf, countBytes);
+    ctx->position += count * 4;
+
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
+    return (ssize_t)(1 + countBytes + count * 4);
+}
+
 ssize_t ksbonjson_encodeToBuffer_float32Array(
     KSBONJSONBufferEncodeContext* ctx,
     const float* values,
@@ -692,6 +887,8 @@ ssize_t ksbonjson_encodeToBuffer_float32Array(
     }
     totalBytes += count * 4;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -718,6 +915,8 @@ ssize_t ksbonjson_encodeToBuffer_uint8Array(
     bufferWriteBytes(ctx, values, count);
     totalBytes += count;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -751,6 +950,8 @@ ssize_t ksbonjson_encodeToBuffer_uint16Array(
     }
     totalBytes += count * 2;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -784,6 +985,8 @@ ssize_t ksbonjson_encodeToBuffer_uint32Array(
     }
     totalBytes += count * 4;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -814,6 +1017,8 @@ ssize_t ksbonjson_encodeToBuffer_uint64Array(
     }
     totalBytes += count * 8;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -840,6 +1045,8 @@ ssize_t ksbonjson_encodeToBuffer_int8Array(
     bufferWriteBytes(ctx, (const uint8_t*)values, count);
     totalBytes += count;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -873,6 +1080,8 @@ ssize_t ksbonjson_encodeToBuffer_int16Array(
     }
     totalBytes += count * 2;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -906,6 +1115,8 @@ ssize_t ksbonjson_encodeToBuffer_int32Array(
     }
     totalBytes += count * 4;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -935,6 +1146,8 @@ ssize_t ksbonjson_encodeToBuffer_boolArray(
     bufferWriteByte(ctx, TYPE_END);
     totalBytes += 1;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -995,6 +1208,8 @@ ssize_t ksbonjson_encodeToBuffer_stringArray(
     bufferWriteByte(ctx, TYPE_END);
     totalBytes++;
 
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, count);
     return (ssize_t)totalBytes;
 }
 
@@ -1049,6 +1264,8 @@ ssize_t ksbonjson_encodeToBuffer_beginRecordInstance(KSBONJSONBufferEncodeContex
     ctx->containerDepth++;
     ctx->containers[ctx->containerDepth] = (KSBONJSONContainerState){0};
     ctx->containerElementCounts[ctx->containerDepth] = 0;
+    STATS_ADD(ctx, recordInstanceCount, 1);
+    STATS_MAX(ctx, maxDepth, ctx->containerDepth);
 
     bufferWriteByte(ctx, TYPE_RECORD_INSTANCE);
     uint8_t indexBuf[10];
@@ -1059,6 +1276,321 @@ ssize_t ksbonjson_encodeToBuffer_beginRecordInstance(KSBONJSONBufferEncodeContex
 }
 
 
+// ============================================================================
+// Column Encoding
+// ============================================================================
+
+static inline size_t columnStride(const KSBONJSONColumn* column)
+{
+    if (column->stride != 0)
+    {
+        return column->stride;
+    }
+    switch (column->type)
+    {
+        case KSBONJSON_COLUMN_INT64:  return sizeof(int64_t);
+        case KSBONJSON_COLUMN_UINT64: return sizeof(uint64_t);
+        case KSBONJSON_COLUMN_DOUBLE: return sizeof(double);
+        case KSBONJSON_COLUMN_BOOL:   return sizeof(bool);
+        case KSBONJSON_COLUMN_STRING: return sizeof(KSBONJSONColumnString);
+    }
+    return 0;
+}
+
+static inline const void* columnValue(const KSBONJSONColumn* column, size_t stride, size_t row)
+{
+    return (const uint8_t*)column->values + row * stride;
+}
+
+// Internal: encode a single uint64 without container state checks (as ksbonjson_encodeToBuffer_uint)
+static inline size_t encodeUInt64Fast(KSBONJSONBufferEncodeContext* ctx, uint64_t value)
+{
+    if (value <= (uint64_t)SMALLINT_MAX)
+    {
+        bufferWriteByte(ctx, (uint8_t)value);
+        return 1;
+    }
+
+    size_t byteCount = ksbonjson_roundToNativeSize(ksbonjson_uintBytesMin1(value));
+    uint8_t msb = (uint8_t)(value >> (byteCount * 8 - 1));
+    uint8_t base = msb ? TYPE_UINT8 : TYPE_SINT8;
+    uint8_t typeCode = (uint8_t)(base + ksbonjson_nativeSizeIndex[byteCount]);
+
+    bufferWriteNumeric(ctx, typeCode, value, byteCount);
+    return byteCount + 1;
+}
+
+// Internal: encode a single double without container state checks (as ksbonjson_encodeToBuffer_float)
+static inline size_t encodeFloatFast(KSBONJSONBufferEncodeContext* ctx, double value)
+{
+    // The range check keeps the int64 conversion defined (NaN fails it too)
+    if (value >= -9223372036854775808.0 && value < 9223372036854775808.0)
+    {
+        const int64_t asInt = (int64_t)value;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+        if ((double)asInt == value && !signbit(value))
+#pragma GCC diagnostic pop
+        {
+            return encodeInt64Fast(ctx, asInt);
+        }
+    }
+
+    const union num32_bits b32 = { .f32 = (float)value };
+    union num64_bits compare = { .f64 = (double)b32.f32 };
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+    if (compare.f64 == value)
+#pragma GCC diagnostic pop
+    {
+        bufferWriteNumeric(ctx, TYPE_FLOAT32, b32.u32, 4);
+        return 5;
+    }
+
+    union num64_bits b64 = {.f64 = value};
+    bufferWriteNumeric(ctx, TYPE_FLOAT64, b64.u64, 8);
+    return 9;
+}
+
+size_t ksbonjson_maxEncodedSize_columns(const KSBONJSONColumn* columns,
+                                        size_t columnCount,
+                                        size_t rowCount,
+                                        bool asRecords)
+{
+    // Container begin + end, or record instance type + ULEB128 index + end
+    size_t rowOverhead = asRecords ? 12 : 2;
+    size_t total = rowCount * rowOverhead;
+
+    for (size_t i = 0; i < columnCount; i++)
+    {
+        const KSBONJSONColumn* column = &columns[i];
+        if (!asRecords)
+        {
+            total += rowCount * ksbonjson_maxEncodedSize_string(column->keyLength);
+        }
+        switch (column->type)
+        {
+            case KSBONJSON_COLUMN_INT64:
+            case KSBONJSON_COLUMN_UINT64:
+            case KSBONJSON_COLUMN_DOUBLE:
+                total += rowCount * 9;
+                break;
+            case KSBONJSON_COLUMN_BOOL:
+                total += rowCount;
+                break;
+            case KSBONJSON_COLUMN_STRING:
+            {
+                size_t stride = columnStride(column);
+                for (size_t row = 0; row < rowCount; row++)
+                {
+                    const KSBONJSONColumnString* s = columnValue(column, stride, row);
+                    total += ksbonjson_maxEncodedSize_string(s->length);
+                }
+                break;
+            }
+        }
+    }
+    return total;
+}
+
+// Check every key and value against the encode flags before anything is written.
+static ksbonjson_encodeStatus validateColumns(KSBONJSONBufferEncodeContext* ctx,
+                                              const KSBONJSONColumn* columns,
+                                              size_t columnCount,
+                                              size_t rowCount,
+                                              bool asRecords)
+{
+    KSBONJSONContainerState* const container = getBufferContainer(ctx);
+    unlikely_if(container->isObject & container->isExpectingName)
+    {
+        return KSBONJSON_ENCODE_EXPECTED_OBJECT_NAME;
+    }
+    unlikely_if(columnCount > 0 && !columns)
+    {
+        return KSBONJSON_ENCODE_NULL_POINTER;
+    }
+
+    size_t maxDepth = ctx->flags.maxDepth < SIZE_MAX ? ctx->flags.maxDepth : KSBONJSON_MAX_CONTAINER_DEPTH;
+    unlikely_if(rowCount > 0 && (size_t)(ctx->containerDepth + 1) > maxDepth)
+    {
+        return KSBONJSON_ENCODE_MAX_DEPTH_EXCEEDED;
+    }
+
+    size_t maxLen = ctx->flags.maxStringLength < SIZE_MAX ? ctx->flags.maxStringLength : KSBONJSON_DEFAULT_MAX_STRING_LENGTH;
+    const bool rejectNUL = ctx->flags.rejectNUL;
+
+    for (size_t i = 0; i < columnCount; i++)
+    {
+        const KSBONJSONColumn* column = &columns[i];
+        unlikely_if(rowCount > 0 && !column->values)
+        {
+            return KSBONJSON_ENCODE_NULL_POINTER;
+        }
+        if (!asRecords)
+        {
+            unlikely_if(!column->key)
+            {
+                return KSBONJSON_ENCODE_NULL_POINTER;
+            }
+            unlikely_if(column->keyLength > maxLen)
+            {
+                return KSBONJSON_ENCODE_MAX_STRING_LENGTH_EXCEEDED;
+            }
+            unlikely_if(rejectNUL && ksbonjson_simd_containsByte((const uint8_t*)column->key, column->keyLength, 0x00))
+            {
+                return KSBONJSON_ENCODE_NUL_CHARACTER;
+            }
+        }
+
+        const size_t stride = columnStride(column);
+        switch (column->type)
+        {
+            case KSBONJSON_COLUMN_INT64:
+            case KSBONJSON_COLUMN_UINT64:
+            case KSBONJSON_COLUMN_BOOL:
+                break;
+            case KSBONJSON_COLUMN_DOUBLE:
+                if (ctx->flags.rejectNonFiniteFloat)
+                {
+                    for (size_t row = 0; row < rowCount; row++)
+                    {
+                        union num64_bits b64 = {.f64 = *(const double*)columnValue(column, stride, row)};
+                        unlikely_if((b64.u64 & 0x7ff0000000000000ULL) == 0x7ff0000000000000ULL)
+                        {
+                            return KSBONJSON_ENCODE_INVALID_DATA;
+                        }
+                    }
+                }
+                break;
+            case KSBONJSON_COLUMN_STRING:
+                for (size_t row = 0; row < rowCount; row++)
+                {
+                    const KSBONJSONColumnString* s = columnValue(column, stride, row);
+                    unlikely_if(!s->bytes)
+                    {
+                        return KSBONJSON_ENCODE_NULL_POINTER;
+                    }
+                    unlikely_if(s->length > maxLen)
+                    {
+                        return KSBONJSON_ENCODE_MAX_STRING_LENGTH_EXCEEDED;
+                    }
+                    unlikely_if(rejectNUL && ksbonjson_simd_containsByte((const uint8_t*)s->bytes, s->length, 0x00))
+                    {
+                        return KSBONJSON_ENCODE_NUL_CHARACTER;
+                    }
+                }
+                break;
+            default:
+                return KSBONJSON_ENCODE_INVALID_DATA;
+        }
+    }
+
+    unlikely_if(bufferWouldExceedDocumentSize(ctx, ksbonjson_maxEncodedSize_columns(columns, columnCount, rowCount, asRecords)))
+    {
+        return KSBONJSON_ENCODE_MAX_DOCUMENT_SIZE_EXCEEDED;
+    }
+    return KSBONJSON_ENCODE_OK;
+}
+
+static inline size_t encodeColumnValue(KSBONJSONBufferEncodeContext* ctx,
+                                       const KSBONJSONColumn* column,
+                                       const void* value)
+{
+    switch (column->type)
+    {
+        case KSBONJSON_COLUMN_INT64:
+            return encodeInt64Fast(ctx, *(const int64_t*)value);
+        case KSBONJSON_COLUMN_UINT64:
+            return encodeUInt64Fast(ctx, *(const uint64_t*)value);
+        case KSBONJSON_COLUMN_DOUBLE:
+            return encodeFloatFast(ctx, *(const double*)value);
+        case KSBONJSON_COLUMN_BOOL:
+            bufferWriteByte(ctx, *(const bool*)value ? TYPE_TRUE : TYPE_FALSE);
+            return 1;
+        case KSBONJSON_COLUMN_STRING:
+        {
+            const KSBONJSONColumnString* s = value;
+            return encodeStringFast(ctx, s->bytes, s->length);
+        }
+    }
+    return 0;
+}
+
+// Shared by objectRows and recordRows: the only difference is each row's header.
+static ssize_t encodeRows(KSBONJSONBufferEncodeContext* ctx,
+                          bool asRecords,
+                          uint64_t defIndex,
+                          const KSBONJSONColumn* columns,
+                          size_t columnCount,
+                          size_t rowCount)
+{
+    ksbonjson_encodeStatus status = validateColumns(ctx, columns, columnCount, rowCount, asRecords);
+    unlikely_if(status != KSBONJSON_ENCODE_OK)
+    {
+        return -(ssize_t)status;
+    }
+
+    uint8_t header[11];
+    size_t headerLength = 1;
+    if (asRecords)
+    {
+        header[0] = TYPE_RECORD_INSTANCE;
+        headerLength += ksbonjson_writeULEB128(header + 1, defIndex);
+    }
+    else
+    {
+        header[0] = TYPE_OBJECT;
+    }
+
+    if (rowCount > 0)
+    {
+        getBufferContainer(ctx)->isExpectingName = true;
+    }
+
+    size_t totalBytes = 0;
+    for (size_t row = 0; row < rowCount; row++)
+    {
+        incrementContainerCount(ctx);
+        bufferWriteBytes(ctx, header, headerLength);
+        totalBytes += headerLength;
+
+        for (size_t i = 0; i < columnCount; i++)
+        {
+            const KSBONJSONColumn* column = &columns[i];
+            if (!asRecords)
+            {
+                totalBytes += encodeStringFast(ctx, column->key, column->keyLength);
+            }
+            totalBytes += encodeColumnValue(ctx, column, columnValue(column, columnStride(column), row));
+        }
+
+        bufferWriteByte(ctx, TYPE_END);
+        totalBytes++;
+    }
+
+    STATS_ADD(ctx, batchCount, 1);
+    STATS_ADD(ctx, batchValueCount, rowCount);
+    return (ssize_t)totalBytes;
+}
+
+ssize_t ksbonjson_encodeToBuffer_objectRows(KSBONJSONBufferEncodeContext* ctx,
+                                            const KSBONJSONColumn* columns,
+                                            size_t columnCount,
+                                            size_t rowCount)
+{
+    return encodeRows(ctx, false, 0, columns, columnCount, rowCount);
+}
+
+ssize_t ksbonjson_encodeToBuffer_recordRows(KSBONJSONBufferEncodeContext* ctx,
+                                            uint64_t defIndex,
+                                            const KSBONJSONColumn* columns,
+                                            size_t columnCount,
+                                            size_t rowCount)
+{
+    return encodeRows(ctx, true, defIndex, columns, columnCount, rowCount);
+}
+
+
 // ============================================================================
 // Callback-Based Encoder Implementation (Legacy API)
 // ============================================================================
@@ -160,14 +160,56 @@ typedef struct {
     uint8_t isExpectingName: 1;
 } KSBONJSONContainerState;
 
+typedef ksbonjson_encodeStatus (*KSBONJSONAddEncodedDataFunc)(
+    const uint8_t* KSBONJSON_RESTRICT data,
+    size_t dataLength,
+    void* KSBONJSON_RESTRICT userData);
+
+/**
+ * Counters an encoder fills in, for finding out what a document's encoding spends its time on.
+ * Nothing is counted unless the library is built with KSBONJSON_STATS defined; otherwise the
+ * instrumentation compiles out. See ksbonjson_encodeToBuffer_setStats().
+ *
+ * Values are counted by how they were encoded (a float that is written as an integer
+ * counts as an integer), including any the caller later rewinds.
+ */
+typedef struct {
+    size_t nullCount;
+    size_t boolCount;
+    size_t intCount;                 // Signed and unsigned
+    size_t floatCount;
+    size_t bigNumberCount;
+    size_t shortStringCount;         // Strings (keys included) with the length in the type code
+    size_t shortStringBytes;
+    size_t longStringCount;          // 0xFF-terminated strings
+    size_t longStringBytes;
+    size_t arrayCount;
+    size_t objectCount;
+    size_t recordInstanceCount;
+    size_t batchCount;               // Calls to the array and column batch functions
+    size_t batchValueCount;          // Values written by those calls
+    size_t fragmentCount;
+    size_t fragmentBytes;
+    size_t maxDepth;
+    size_t flushCount;
+    size_t bufferGrowths;            // Not counted by the encoder: for callers that grow the buffer
+} KSBONJSONEncodeStats;
+
 typedef struct {
     uint8_t* buffer;
     size_t capacity;
     size_t position;
     int containerDepth;
-    KSBONJSONContainerState containers[KSBONJSON_MAX_CONTAINER_DEPTH];
-    size_t containerElementCounts[KSBONJSON_MAX_CONTAINER_DEPTH];
+    KSBONJSONContainerState containers[KSBONJSON_MAX_CONTAINER_DEPTH + 1];
+    size_t containerElementCounts[KSBONJSON_MAX_CONTAINER_DEPTH + 1];
     KSBONJSONEncodeFlags flags;
+
+    // Streaming sink (NULL when encoding into a single growing buffer)
+    KSBONJSONAddEncodedDataFunc flushData;
+    void* flushUserData;
+    size_t flushedBytes;
+
+    KSBONJSONEncodeStats* stats; // NULL unless collecting (see ksbonjson_encodeToBuffer_setStats)
 } KSBONJSONBufferEncodeContext;
 
 KSBONJSON_PUBLIC void ksbonjson_encodeToBuffer_beginWithFlags(
@@ -186,8 +228,50 @@ KSBONJSON_PUBLIC void ksbonjson_encodeToBuffer_setBuffer(
     uint8_t* buffer,
     size_t capacity);
 
+/**
+ * End the document.
+ *
+ * @return The total document size (flushed bytes plus bytes still in the
+ *         buffer), or a negative status on error.
+ */
 KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_end(KSBONJSONBufferEncodeContext* ctx);
 
+/**
+ * Route encoded output to a sink so that the buffer can stay a fixed size.
+ *
+ * Once set, ksbonjson_encodeToBuffer_flush() hands the leading bytes of the
+ * buffer to the sink and slides any unflushed tail down to the buffer start.
+ * Document size limits count flushed bytes as well as buffered ones.
+ *
+ * @param flushData The sink function (NULL disables streaming).
+ * @param userData Passed through to flushData.
+ */
+KSBONJSON_PUBLIC void ksbonjson_encodeToBuffer_setFlushCallback(
+    KSBONJSONBufferEncodeContext* ctx,
+    KSBONJSONAddEncodedDataFunc flushData,
+    void* userData);
+
+/**
+ * Hand the first `length` buffered bytes to the flush callback.
+ *
+ * Bytes past `length` are kept (moved to the start of the buffer), which lets
+ * the caller hold back a region it may still rewind.
+ *
+ * @return The number of bytes flushed, or a negative status on error. The
+ *         buffer is left untouched if the sink fails.
+ */
+KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_flush(KSBONJSONBufferEncodeContext* ctx, size_t length);
+
+/**
+ * Count what the encoder writes into stats, which must stay valid while encoding.
+ * Pass NULL to stop counting. Must be called after begin (which clears it).
+ *
+ * Has no effect unless the library is built with KSBONJSON_STATS defined.
+ */
+KSBONJSON_PUBLIC void ksbonjson_encodeToBuffer_setStats(
+    KSBONJSONBufferEncodeContext* ctx,
+    KSBONJSONEncodeStats* stats);
+
 // Max encoded sizes for capacity calculations
 #define KSBONJSON_MAX_ENCODED_SIZE_NULL           1
 #define KSBONJSON_MAX_ENCODED_SIZE_BOOL           1
@@ -221,6 +305,23 @@ KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_endAllContainers(KSBONJSONBuff
 KSBONJSON_PUBLIC int ksbonjson_encodeToBuffer_getDepth(KSBONJSONBufferEncodeContext* ctx);
 KSBONJSON_PUBLIC bool ksbonjson_encodeToBuffer_isInObject(KSBONJSONBufferEncodeContext* ctx);
 
+/**
+ * Copy a pre-encoded BONJSON value (such as a cached sub-object) into the output as the
+ * next value, updating container state and element counts as if it had been encoded here.
+ *
+ * The bytes must be exactly one complete value without record definitions or record
+ * instances (a record can't refer to definitions outside itself). Only the leading type
+ * code is checked; the rest is copied as-is. The capacity needed is the fragment length.
+ *
+ * depth is how deeply the fragment's containers nest (0 for a scalar, 1 for a flat
+ * container), which must fit within maxDepth at the current depth.
+ */
+KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_fragment(
+    KSBONJSONBufferEncodeContext* ctx,
+    const uint8_t* fragment,
+    size_t length,
+    size_t depth);
+
 // Batch encoding functions
 KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_int64Array(
     KSBONJSONBufferEncodeContext* ctx,
@@ -244,6 +345,27 @@ static inline size_t ksbonjson_maxEncodedSize_doubleArray(size_t count)
     return 11 + count * 8;
 }
 
+/**
+ * Batch encode as the narrowest typed array that holds every value exactly: unsigned
+ * 8, 16 or 32-bit elements if none is negative, signed 8, 16 or 32-bit elements
+ * otherwise, and signed 64-bit elements if nothing narrower fits.
+ * The capacity needed is ksbonjson_maxEncodedSize_int64Array().
+ */
+KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_narrowInt64Array(
+    KSBONJSONBufferEncodeContext* ctx,
+    const int64_t* values,
+    size_t count);
+
+/**
+ * Batch encode as a typed float32 array if every value converts to float32 and back
+ * unchanged, and as a typed float64 array otherwise.
+ * The capacity needed is ksbonjson_maxEncodedSize_doubleArray().
+ */
+KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_narrowDoubleArray(
+    KSBONJSONBufferEncodeContext* ctx,
+    const double* values,
+    size_t count);
+
 KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_float32Array(
     KSBONJSONBufferEncodeContext* ctx,
     const float* values,
@@ -347,6 +469,76 @@ static inline size_t ksbonjson_maxEncodedSize_stringArray(size_t count, size_t t
     return 2 + count * 2 + totalStringLength;
 }
 
+// Column encoding (batches of same-shaped objects)
+
+typedef enum
+{
+    KSBONJSON_COLUMN_INT64,  // int64_t
+    KSBONJSON_COLUMN_UINT64, // uint64_t
+    KSBONJSON_COLUMN_DOUBLE, // double
+    KSBONJSON_COLUMN_BOOL,   // bool
+    KSBONJSON_COLUMN_STRING, // KSBONJSONColumnString
+} KSBONJSONColumnType;
+
+typedef struct
+{
+    const char* bytes;
+    size_t length;
+} KSBONJSONColumnString;
+
+/**
+ * One field of a batch of rows: its key, and where to find its value for each row.
+ * Row i's value is at (const uint8_t*)values + i * stride, so a column can point straight
+ * into an array of C structs (stride = sizeof the struct) or into a plain value array.
+ */
+typedef struct
+{
+    const char* key;
+    size_t keyLength;
+    KSBONJSONColumnType type;
+    const void* values;
+    // Bytes between consecutive rows' values (0 = the size of the column type)
+    size_t stride;
+} KSBONJSONColumn;
+
+/**
+ * Encode rowCount objects as the next rowCount values of the current container. Row i is
+ * an object holding each column's key and row i value, in column order. Each value is
+ * encoded exactly as the single-value functions would encode it.
+ *
+ * Everything is validated before anything is written, so on failure the output is
+ * unchanged. The capacity needed is ksbonjson_maxEncodedSize_columns(..., false).
+ */
+KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_objectRows(
+    KSBONJSONBufferEncodeContext* ctx,
+    const KSBONJSONColumn* columns,
+    size_t columnCount,
+    size_t rowCount);
+
+/**
+ * Encode rowCount record instances of definition defIndex, as the next rowCount values of
+ * the current container. The columns must be in the definition's key order; their keys
+ * are not used. Otherwise as ksbonjson_encodeToBuffer_objectRows().
+ *
+ * The capacity needed is ksbonjson_maxEncodedSize_columns(..., true).
+ */
+KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_recordRows(
+    KSBONJSONBufferEncodeContext* ctx,
+    uint64_t defIndex,
+    const KSBONJSONColumn* columns,
+    size_t columnCount,
+    size_t rowCount);
+
+/**
+ * Get the most bytes that encoding rowCount rows of these columns as objects (or as
+ * record instances) can take.
+ */
+KSBONJSON_PUBLIC size_t ksbonjson_maxEncodedSize_columns(
+    const KSBONJSONColumn* columns,
+    size_t columnCount,
+    size_t rowCount,
+    bool asRecords);
+
 // Record encoding functions
 KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_beginRecordDef(KSBONJSONBufferEncodeContext* ctx);
 KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_endRecordDef(KSBONJSONBufferEncodeContext* ctx);
@@ -357,11 +549,6 @@ KSBONJSON_PUBLIC ssize_t ksbonjson_encodeToBuffer_beginRecordInstance(KSBONJSONB
 // Callback-Based Encoder (Legacy API)
 // ============================================================================
 
-typedef ksbonjson_encodeStatus (*KSBONJSONAddEncodedDataFunc)(
-    const uint8_t* KSBONJSON_RESTRICT data,
-    size_t dataLength,
-    void* KSBONJSON_RESTRICT userData);
-
 typedef struct
 {
     KSBONJSONAddEncodedDataFunc addEncodedData;
@@ -1,5 +1,5 @@
 // ABOUTME: Platform-adaptive SIMD primitives for accelerated byte scanning.
-// ABOUTME: Provides fast 0xFF search, NUL detection, and ASCII validation.
+// ABOUTME: Provides fast 0xFF search, NUL detection, ASCII and UTF-8 validation, JSON string scanning and numeric narrowing.
 
 #ifndef KSBONJSON_SIMD_H
 #define KSBONJSON_SIMD_H
@@ -8,6 +8,8 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <string.h>
+#include <float.h>
+#include <math.h>
 
 // ============================================================================
 // Platform Detection
@@ -22,6 +24,17 @@
         #define KSBONJSON_SIMD_SSE2 1
         #include <emmintrin.h>
         #define KSBONJSON_SIMD_WIDTH 16
+        #if defined(__SSSE3__) || defined(__AVX__)
+            #define KSBONJSON_SIMD_SSSE3 1
+            #include <tmmintrin.h>
+        #endif
+        // GCC and Clang can compile individual functions for newer instruction sets,
+        // so wider kernels are built in and picked at runtime from the CPU's features.
+        // Define KSBONJSON_SIMD_NO_DISPATCH to use only the compile-time baseline.
+        #if (defined(__GNUC__) || defined(__clang__)) && !defined(KSBONJSON_SIMD_NO_DISPATCH)
+            #define KSBONJSON_SIMD_X86_DISPATCH 1
+            #include <immintrin.h>
+        #endif
     #endif
 #endif
 
@@ -30,6 +43,121 @@
 #endif
 
 
+// ============================================================================
+// UTF-8 Validation Tables
+// ============================================================================
+
+#if KSBONJSON_SIMD_NEON || KSBONJSON_SIMD_SSSE3 || KSBONJSON_SIMD_X86_DISPATCH
+
+// Vectorized UTF-8 validation using the lookup algorithm from Keiser & Lemire,
+// "Validating UTF-8 In Less Than One Instruction Per Byte" (as used by simdutf).
+//
+// Each byte is classified by three 16-entry table lookups: the high and low nibbles
+// of the previous byte and the high nibble of the current byte. Each table entry is a
+// set of error classes that the nibble is compatible with, so ANDing the three results
+// leaves a bit set only where the byte pair is invalid. Third and fourth bytes of
+// multi-byte sequences are checked separately against the bytes 2 and 3 positions back.
+
+#define KSBONJSON_UTF8_TOO_SHORT      (1 << 0) // 11______ 0_______ or 11______ 11______
+#define KSBONJSON_UTF8_TOO_LONG       (1 << 1) // 0_______ 10______
+#define KSBONJSON_UTF8_OVERLONG_3     (1 << 2) // 11100000 100_____
+#define KSBONJSON_UTF8_TOO_LARGE      (1 << 3) // 11110100 1001____ or 11110100 101_____
+#define KSBONJSON_UTF8_SURROGATE      (1 << 4) // 11101101 101_____
+#define KSBONJSON_UTF8_OVERLONG_2     (1 << 5) // 1100000_ 10______
+#define KSBONJSON_UTF8_TOO_LARGE_1000 (1 << 6) // 11110101 1000____ (and higher leads)
+#define KSBONJSON_UTF8_OVERLONG_4     (1 << 6) // 11110000 1000____
+#define KSBONJSON_UTF8_TWO_CONTS      (1 << 7) // 10______ 10______ (unless a 3rd/4th byte)
+#define KSBONJSON_UTF8_CARRY          (KSBONJSON_UTF8_TOO_SHORT | KSBONJSON_UTF8_TOO_LONG | KSBONJSON_UTF8_TWO_CONTS)
+
+// Indexed by the high nibble of the previous byte
+static const uint8_t ksbonjson_utf8Byte1High[16] = {
+    // 0_______: ASCII
+    KSBONJSON_UTF8_TOO_LONG, KSBONJSON_UTF8_TOO_LONG, KSBONJSON_UTF8_TOO_LONG, KSBONJSON_UTF8_TOO_LONG,
+    KSBONJSON_UTF8_TOO_LONG, KSBONJSON_UTF8_TOO_LONG, KSBONJSON_UTF8_TOO_LONG, KSBONJSON_UTF8_TOO_LONG,
+    // 10______: continuation
+    KSBONJSON_UTF8_TWO_CONTS, KSBONJSON_UTF8_TWO_CONTS, KSBONJSON_UTF8_TWO_CONTS, KSBONJSON_UTF8_TWO_CONTS,
+    // 1100____, 1101____: two byte lead
+    KSBONJSON_UTF8_TOO_SHORT | KSBONJSON_UTF8_OVERLONG_2,
+    KSBONJSON_UTF8_TOO_SHORT,
+    // 1110____: three byte lead
+    KSBONJSON_UTF8_TOO_SHORT | KSBONJSON_UTF8_OVERLONG_3 | KSBONJSON_UTF8_SURROGATE,
+    // 1111____: four byte lead
+    KSBONJSON_UTF8_TOO_SHORT | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000 | KSBONJSON_UTF8_OVERLONG_4,
+};
+
+// Indexed by the low nibble of the previous byte
+static const uint8_t ksbonjson_utf8Byte1Low[16] = {
+    // ____0000
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_OVERLONG_3 | KSBONJSON_UTF8_OVERLONG_2 | KSBONJSON_UTF8_OVERLONG_4,
+    // ____0001
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_OVERLONG_2,
+    // ____001_
+    KSBONJSON_UTF8_CARRY,
+    KSBONJSON_UTF8_CARRY,
+    // ____0100
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE,
+    // ____0101 - ____1100
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000,
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000,
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000,
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000,
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000,
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000,
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000,
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000,
+    // ____1101
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000 | KSBONJSON_UTF8_SURROGATE,
+    // ____111_
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000,
+    KSBONJSON_UTF8_CARRY | KSBONJSON_UTF8_TOO_LARGE | KSBONJSON_UTF8_TOO_LARGE_1000,
+};
+
+// Indexed by the high nibble of the current byte
+static const uint8_t ksbonjson_utf8Byte2High[16] = {
+    // 0_______: ASCII
+    KSBONJSON_UTF8_TOO_SHORT, KSBONJSON_UTF8_TOO_SHORT, KSBONJSON_UTF8_TOO_SHORT, KSBONJSON_UTF8_TOO_SHORT,
+    KSBONJSON_UTF8_TOO_SHORT, KSBONJSON_UTF8_TOO_SHORT, KSBONJSON_UTF8_TOO_SHORT, KSBONJSON_UTF8_TOO_SHORT,
+    // 1000____
+    KSBONJSON_UTF8_TOO_LONG | KSBONJSON_UTF8_OVERLONG_2 | KSBONJSON_UTF8_TWO_CONTS |
+        KSBONJSON_UTF8_OVERLONG_3 | KSBONJSON_UTF8_TOO_LARGE_1000 | KSBONJSON_UTF8_OVERLONG_4,
+    // 1001____
+    KSBONJSON_UTF8_TOO_LONG | KSBONJSON_UTF8_OVERLONG_2 | KSBONJSON_UTF8_TWO_CONTS |
+        KSBONJSON_UTF8_OVERLONG_3 | KSBONJSON_UTF8_TOO_LARGE,
+    // 101_____
+    KSBONJSON_UTF8_TOO_LONG | KSBONJSON_UTF8_OVERLONG_2 | KSBONJSON_UTF8_TWO_CONTS |
+        KSBONJSON_UTF8_SURROGATE | KSBONJSON_UTF8_TOO_LARGE,
+    KSBONJSON_UTF8_TOO_LONG | KSBONJSON_UTF8_OVERLONG_2 | KSBONJSON_UTF8_TWO_CONTS |
+        KSBONJSON_UTF8_SURROGATE | KSBONJSON_UTF8_TOO_LARGE,
+    // 11______: lead byte
+    KSBONJSON_UTF8_TOO_SHORT, KSBONJSON_UTF8_TOO_SHORT, KSBONJSON_UTF8_TOO_SHORT, KSBONJSON_UTF8_TOO_SHORT,
+};
+
+// A block whose last bytes exceed these values ends partway through a sequence
+static const uint8_t ksbonjson_utf8MaxTrailingValue[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+
+#if KSBONJSON_SIMD_X86_DISPATCH
+// The same limits for 32-byte (AVX2) and 64-byte (AVX-512) blocks
+static const uint8_t ksbonjson_utf8MaxTrailingValue32[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+static const uint8_t ksbonjson_utf8MaxTrailingValue64[64] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+#endif
+
+// Bytes used to pad the final partial block. Any ASCII byte other than NUL works.
+#define KSBONJSON_UTF8_PADDING 0x20
+
+#endif
+
+
 // ============================================================================
 // SIMD Implementations
 // ============================================================================
@@ -49,14 +177,13 @@ static inline size_t ksbonjson_simd_findByte(const uint8_t *ptr, size_t len, uin
     {
         uint8x16_t data = vld1q_u8(ptr + i);
         uint8x16_t cmp = vceqq_u8(data, vneedle);
-        uint8x16_t folded = vpmaxq_u8(cmp, cmp);
-        if (vgetq_lane_u64(vreinterpretq_u64_u8(folded), 0) != 0)
+        // NEON has no movemask: narrowing each 16-bit lane by 4 bits keeps a
+        // nibble per byte, giving a 64-bit mask with 4 bits per input byte.
+        uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+        if (mask != 0)
         {
-            // Found a match in this block — find exact position
-            for (size_t j = i; j < i + 16; j++)
-            {
-                if (ptr[j] == needle) return j;
-            }
+            return i + ((size_t)__builtin_ctzll(mask) >> 2);
         }
         i += 16;
     }
@@ -69,6 +196,38 @@ static inline size_t ksbonjson_simd_findByte(const uint8_t *ptr, size_t len, uin
     return len;
 }
 
+/**
+ * Find the first byte that a JSON string can't hold as-is (a quote, backslash
+ * or control character) using NEON. Returns the offset from ptr, or len if none.
+ */
+static inline size_t ksbonjson_simd_findJSONSpecial(const uint8_t *ptr, size_t len)
+{
+    size_t i = 0;
+    uint8x16_t vquote = vdupq_n_u8('"');
+    uint8x16_t vbackslash = vdupq_n_u8('\\');
+    uint8x16_t vspace = vdupq_n_u8(0x20);
+
+    while (i + 16 <= len)
+    {
+        uint8x16_t data = vld1q_u8(ptr + i);
+        uint8x16_t cmp = vorrq_u8(vorrq_u8(vceqq_u8(data, vquote), vceqq_u8(data, vbackslash)),
+                                  vcltq_u8(data, vspace));
+        uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+        if (mask != 0)
+        {
+            return i + ((size_t)__builtin_ctzll(mask) >> 2);
+        }
+        i += 16;
+    }
+
+    for (; i < len; i++)
+    {
+        if (ptr[i] == '"' || ptr[i] == '\\' || ptr[i] < 0x20) return i;
+    }
+    return len;
+}
+
 /**
  * Check if a buffer contains a specific byte using NEON.
  * Returns true if the byte is found.
@@ -126,9 +285,105 @@ static inline bool ksbonjson_simd_isAllAscii(const uint8_t *ptr, size_t len)
     return true;
 }
 
+/**
+ * Classify each byte of a block against the bytes before it (from the previous block).
+ * Returns a vector that is non-zero wherever the input is invalid UTF-8.
+ */
+static inline uint8x16_t ksbonjson_simd_utf8BlockErrors(uint8x16_t input, uint8x16_t prevInput)
+{
+    const uint8x16_t lowNibbleMask = vdupq_n_u8(0x0F);
+    uint8x16_t prev1 = vextq_u8(prevInput, input, 15);
+    uint8x16_t byte1High = vqtbl1q_u8(vld1q_u8(ksbonjson_utf8Byte1High), vshrq_n_u8(prev1, 4));
+    uint8x16_t byte1Low = vqtbl1q_u8(vld1q_u8(ksbonjson_utf8Byte1Low), vandq_u8(prev1, lowNibbleMask));
+    uint8x16_t byte2High = vqtbl1q_u8(vld1q_u8(ksbonjson_utf8Byte2High), vshrq_n_u8(input, 4));
+    uint8x16_t specialCases = vandq_u8(vandq_u8(byte1High, byte1Low), byte2High);
+
+    // Bytes 2 or 3 after a 3 or 4 byte lead must be continuations (and so
+    // were flagged as TWO_CONTS above); flip those flags to cancel them out.
+    uint8x16_t prev2 = vextq_u8(prevInput, input, 14);
+    uint8x16_t prev3 = vextq_u8(prevInput, input, 13);
+    uint8x16_t isThirdByte = vqsubq_u8(prev2, vdupq_n_u8(0xE0 - 0x80));
+    uint8x16_t isFourthByte = vqsubq_u8(prev3, vdupq_n_u8(0xF0 - 0x80));
+    uint8x16_t must23 = vandq_u8(vorrq_u8(isThirdByte, isFourthByte), vdupq_n_u8(0x80));
+    return veorq_u8(must23, specialCases);
+}
+
+/**
+ * Check that a buffer is valid UTF-8 and, if rejectNUL is set, contains no NUL bytes.
+ * Returns false if it isn't; the caller can then locate the exact error with a scalar pass.
+ */
+static inline bool ksbonjson_simd_isValidUTF8(const uint8_t *ptr, size_t len, bool rejectNUL)
+{
+    if (len == 0)
+    {
+        return true;
+    }
+
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t maxTrailingValue = vld1q_u8(ksbonjson_utf8MaxTrailingValue);
+    uint8x16_t error = zero;
+    uint8x16_t nulBytes = zero;
+    uint8x16_t prevInput = zero;
+    uint8x16_t prevIncomplete = zero;
+    uint8_t tail[16];
+    size_t i = 0;
+
+    for (;;)
+    {
+        uint8x16_t input;
+        bool isLastBlock = i + 16 > len;
+        if (isLastBlock)
+        {
+            // Pad the final partial (possibly empty) block with ASCII so that
+            // a sequence truncated by the end of the buffer shows up as an error.
+            memset(tail, KSBONJSON_UTF8_PADDING, sizeof(tail));
+            memcpy(tail, ptr + i, len - i);
+            input = vld1q_u8(tail);
+        }
+        else
+        {
+            input = vld1q_u8(ptr + i);
+        }
+
+        if (rejectNUL)
+        {
+            nulBytes = vorrq_u8(nulBytes, vceqq_u8(input, zero));
+        }
+        if (vmaxvq_u8(input) < 0x80)
+        {
+            error = vorrq_u8(error, prevIncomplete);
+            prevIncomplete = zero;
+        }
+        else
+        {
+            error = vorrq_u8(error, ksbonjson_simd_utf8BlockErrors(input, prevInput));
+            prevIncomplete = vqsubq_u8(input, maxTrailingValue);
+        }
+        prevInput = input;
+
+        if (isLastBlock)
+        {
+            break;
+        }
+        i += 16;
+    }
+
+    return vmaxvq_u8(vorrq_u8(error, nulBytes)) == 0;
+}
+
 #elif KSBONJSON_SIMD_SSE2
 
-static inline size_t ksbonjson_simd_findByte(const uint8_t *ptr, size_t len, uint8_t needle)
+#if KSBONJSON_SIMD_X86_DISPATCH
+    #define KSBONJSON_SIMD_TARGET(FEATURES) __attribute__((target(FEATURES)))
+#else
+    #define KSBONJSON_SIMD_TARGET(FEATURES)
+#endif
+
+// ----------------------------------------------------------------------------
+// SSE2 (baseline). These also finish off the tails of the wider kernels.
+// ----------------------------------------------------------------------------
+
+static inline size_t ksbonjson_simd_findByte_sse2(const uint8_t *ptr, size_t len, uint8_t needle)
 {
     size_t i = 0;
     __m128i vneedle = _mm_set1_epi8((char)needle);
@@ -152,7 +407,36 @@ static inline size_t ksbonjson_simd_findByte(const uint8_t *ptr, size_t len, uin
     return len;
 }
 
-static inline bool ksbonjson_simd_containsByte(const uint8_t *ptr, size_t len, uint8_t needle)
+static inline size_t ksbonjson_simd_findJSONSpecial_sse2(const uint8_t *ptr, size_t len)
+{
+    size_t i = 0;
+    __m128i vquote = _mm_set1_epi8('"');
+    __m128i vbackslash = _mm_set1_epi8('\\');
+    __m128i vcontrolMax = _mm_set1_epi8(0x1F);
+
+    while (i + 16 <= len)
+    {
+        __m128i data = _mm_loadu_si128((const __m128i *)(ptr + i));
+        // SSE2 has no unsigned compare: data <= 0x1F exactly when min(data, 0x1F) == data
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(data, vcontrolMax), data);
+        __m128i cmp = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(data, vquote), _mm_cmpeq_epi8(data, vbackslash)),
+                                   control);
+        int mask = _mm_movemask_epi8(cmp);
+        if (mask != 0)
+        {
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+        }
+        i += 16;
+    }
+
+    for (; i < len; i++)
+    {
+        if (ptr[i] == '"' || ptr[i] == '\\' || ptr[i] < 0x20) return i;
+    }
+    return len;
+}
+
+static inline bool ksbonjson_simd_containsByte_sse2(const uint8_t *ptr, size_t len, uint8_t needle)
 {
     size_t i = 0;
     __m128i vneedle = _mm_set1_epi8((char)needle);
@@ -175,7 +459,7 @@ static inline bool ksbonjson_simd_containsByte(const uint8_t *ptr, size_t len, u
     return false;
 }
 
-static inline bool ksbonjson_simd_isAllAscii(const uint8_t *ptr, size_t len)
+static inline bool ksbonjson_simd_isAllAscii_sse2(const uint8_t *ptr, size_t len)
 {
     size_t i = 0;
 
@@ -196,6 +480,571 @@ static inline bool ksbonjson_simd_isAllAscii(const uint8_t *ptr, size_t len)
     return true;
 }
 
+// Without SSSE3 shuffles only all-ASCII input can be confirmed as valid UTF-8;
+// anything else returns false for the caller's scalar validator to decide.
+static inline bool ksbonjson_simd_isValidUTF8_sse2(const uint8_t *ptr, size_t len, bool rejectNUL)
+{
+    return ksbonjson_simd_isAllAscii_sse2(ptr, len) &&
+           !(rejectNUL && ksbonjson_simd_containsByte_sse2(ptr, len, 0x00));
+}
+
+// ----------------------------------------------------------------------------
+// SSSE3 UTF-8 validation. See the NEON implementation for the algorithm.
+// ----------------------------------------------------------------------------
+
+#if KSBONJSON_SIMD_SSSE3 || KSBONJSON_SIMD_X86_DISPATCH
+
+KSBONJSON_SIMD_TARGET("ssse3")
+static inline __m128i ksbonjson_simd_utf8BlockErrors_ssse3(__m128i input, __m128i prevInput)
+{
+    const __m128i lowNibbleMask = _mm_set1_epi8(0x0F);
+    const __m128i byte1HighTable = _mm_loadu_si128((const __m128i *)ksbonjson_utf8Byte1High);
+    const __m128i byte1LowTable = _mm_loadu_si128((const __m128i *)ksbonjson_utf8Byte1Low);
+    const __m128i byte2HighTable = _mm_loadu_si128((const __m128i *)ksbonjson_utf8Byte2High);
+
+    __m128i prev1 = _mm_alignr_epi8(input, prevInput, 15);
+    __m128i byte1High = _mm_shuffle_epi8(byte1HighTable, _mm_and_si128(_mm_srli_epi16(prev1, 4), lowNibbleMask));
+    __m128i byte1Low = _mm_shuffle_epi8(byte1LowTable, _mm_and_si128(prev1, lowNibbleMask));
+    __m128i byte2High = _mm_shuffle_epi8(byte2HighTable, _mm_and_si128(_mm_srli_epi16(input, 4), lowNibbleMask));
+    __m128i specialCases = _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+
+    __m128i prev2 = _mm_alignr_epi8(input, prevInput, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prevInput, 13);
+    __m128i isThirdByte = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80)));
+    __m128i isFourthByte = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80)));
+    __m128i must23 = _mm_and_si128(_mm_or_si128(isThirdByte, isFourthByte), _mm_set1_epi8((char)0x80));
+    return _mm_xor_si128(must23, specialCases);
+}
+
+KSBONJSON_SIMD_TARGET("ssse3")
+static inline bool ksbonjson_simd_isValidUTF8_ssse3(const uint8_t *ptr, size_t len, bool rejectNUL)
+{
+    if (len == 0)
+    {
+        return true;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i maxTrailingValue = _mm_loadu_si128((const __m128i *)ksbonjson_utf8MaxTrailingValue);
+    __m128i error = zero;
+    __m128i nulBytes = zero;
+    __m128i prevInput = zero;
+    __m128i prevIncomplete = zero;
+    uint8_t tail[16];
+    size_t i = 0;
+
+    for (;;)
+    {
+        __m128i input;
+        bool isLastBlock = i + 16 > len;
+        if (isLastBlock)
+        {
+            memset(tail, KSBONJSON_UTF8_PADDING, sizeof(tail));
+            memcpy(tail, ptr + i, len - i);
+            input = _mm_loadu_si128((const __m128i *)tail);
+        }
+        else
+        {
+            input = _mm_loadu_si128((const __m128i *)(ptr + i));
+        }
+
+        if (rejectNUL)
+        {
+            nulBytes = _mm_or_si128(nulBytes, _mm_cmpeq_epi8(input, zero));
+        }
+        if (_mm_movemask_epi8(input) == 0)
+        {
+            error = _mm_or_si128(error, prevIncomplete);
+            prevIncomplete = zero;
+        }
+        else
+        {
+            error = _mm_or_si128(error, ksbonjson_simd_utf8BlockErrors_ssse3(input, prevInput));
+            prevIncomplete = _mm_subs_epu8(input, maxTrailingValue);
+        }
+        prevInput = input;
+
+        if (isLastBlock)
+        {
+            break;
+        }
+        i += 16;
+    }
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(error, nulBytes), zero)) == 0xFFFF;
+}
+
+#endif // KSBONJSON_SIMD_SSSE3 || KSBONJSON_SIMD_X86_DISPATCH
+
+#if KSBONJSON_SIMD_X86_DISPATCH
+
+// ----------------------------------------------------------------------------
+// AVX2: 32-byte blocks
+// ----------------------------------------------------------------------------
+
+KSBONJSON_SIMD_TARGET("avx2")
+static inline size_t ksbonjson_simd_findByte_avx2(const uint8_t *ptr, size_t len, uint8_t needle)
+{
+    size_t i = 0;
+    __m256i vneedle = _mm256_set1_epi8((char)needle);
+
+    while (i + 32 <= len)
+    {
+        __m256i data = _mm256_loadu_si256((const __m256i *)(ptr + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, vneedle));
+        if (mask != 0)
+        {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+        i += 32;
+    }
+
+    return i + ksbonjson_simd_findByte_sse2(ptr + i, len - i, needle);
+}
+
+KSBONJSON_SIMD_TARGET("avx2")
+static inline size_t ksbonjson_simd_findJSONSpecial_avx2(const uint8_t *ptr, size_t len)
+{
+    size_t i = 0;
+    __m256i vquote = _mm256_set1_epi8('"');
+    __m256i vbackslash = _mm256_set1_epi8('\\');
+    __m256i vcontrolMax = _mm256_set1_epi8(0x1F);
+
+    while (i + 32 <= len)
+    {
+        __m256i data = _mm256_loadu_si256((const __m256i *)(ptr + i));
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(data, vcontrolMax), data);
+        __m256i cmp = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(data, vquote),
+                                                      _mm256_cmpeq_epi8(data, vbackslash)),
+                                      control);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(cmp);
+        if (mask != 0)
+        {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+        i += 32;
+    }
+
+    return i + ksbonjson_simd_findJSONSpecial_sse2(ptr + i, len - i);
+}
+
+KSBONJSON_SIMD_TARGET("avx2")
+static inline bool ksbonjson_simd_containsByte_avx2(const uint8_t *ptr, size_t len, uint8_t needle)
+{
+    size_t i = 0;
+    __m256i vneedle = _mm256_set1_epi8((char)needle);
+
+    while (i + 32 <= len)
+    {
+        __m256i data = _mm256_loadu_si256((const __m256i *)(ptr + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, vneedle)) != 0)
+        {
+            return true;
+        }
+        i += 32;
+    }
+
+    return ksbonjson_simd_containsByte_sse2(ptr + i, len - i, needle);
+}
+
+KSBONJSON_SIMD_TARGET("avx2")
+static inline bool ksbonjson_simd_isAllAscii_avx2(const uint8_t *ptr, size_t len)
+{
+    size_t i = 0;
+
+    while (i + 32 <= len)
+    {
+        __m256i data = _mm256_loadu_si256((const __m256i *)(ptr + i));
+        if (_mm256_movemask_epi8(data) != 0)
+        {
+            return false;
+        }
+        i += 32;
+    }
+
+    return ksbonjson_simd_isAllAscii_sse2(ptr + i, len - i);
+}
+
+KSBONJSON_SIMD_TARGET("avx2")
+static inline __m256i ksbonjson_simd_utf8BlockErrors_avx2(__m256i input, __m256i prevInput)
+{
+    const __m256i lowNibbleMask = _mm256_set1_epi8(0x0F);
+    const __m256i byte1HighTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ksbonjson_utf8Byte1High));
+    const __m256i byte1LowTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ksbonjson_utf8Byte1Low));
+    const __m256i byte2HighTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ksbonjson_utf8Byte2High));
+
+    // Byte shifts only work within 128-bit lanes, so pair each lane with the one
+    // before it (for the low lane, that's the previous block's high lane).
+    __m256i prevLanes = _mm256_permute2x128_si256(prevInput, input, 0x21);
+
+    __m256i prev1 = _mm256_alignr_epi8(input, prevLanes, 15);
+    __m256i byte1High = _mm256_shuffle_epi8(byte1HighTable, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), lowNibbleMask));
+    __m256i byte1Low = _mm256_shuffle_epi8(byte1LowTable, _mm256_and_si256(prev1, lowNibbleMask));
+    __m256i byte2High = _mm256_shuffle_epi8(byte2HighTable, _mm256_and_si256(_mm256_srli_epi16(input, 4), lowNibbleMask));
+    __m256i specialCases = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+    __m256i prev2 = _mm256_alignr_epi8(input, prevLanes, 14);
+    __m256i prev3 = _mm256_alignr_epi8(input, prevLanes, 13);
+    __m256i isThirdByte = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i isFourthByte = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(isThirdByte, isFourthByte), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must23, specialCases);
+}
+
+KSBONJSON_SIMD_TARGET("avx2")
+static inline bool ksbonjson_simd_isValidUTF8_avx2(const uint8_t *ptr, size_t len, bool rejectNUL)
+{
+    if (len == 0)
+    {
+        return true;
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i maxTrailingValue = _mm256_loadu_si256((const __m256i *)ksbonjson_utf8MaxTrailingValue32);
+    __m256i error = zero;
+    __m256i nulBytes = zero;
+    __m256i prevInput = zero;
+    __m256i prevIncomplete = zero;
+    uint8_t tail[32];
+    size_t i = 0;
+
+    for (;;)
+    {
+        __m256i input;
+        bool isLastBlock = i + 32 > len;
+        if (isLastBlock)
+        {
+            memset(tail, KSBONJSON_UTF8_PADDING, sizeof(tail));
+            memcpy(tail, ptr + i, len - i);
+            input = _mm256_loadu_si256((const __m256i *)tail);
+        }
+        else
+        {
+            input = _mm256_loadu_si256((const __m256i *)(ptr + i));
+        }
+
+        if (rejectNUL)
+        {
+            nulBytes = _mm256_or_si256(nulBytes, _mm256_cmpeq_epi8(input, zero));
+        }
+        if (_mm256_movemask_epi8(input) == 0)
+        {
+            error = _mm256_or_si256(error, prevIncomplete);
+            prevIncomplete = zero;
+        }
+        else
+        {
+            error = _mm256_or_si256(error, ksbonjson_simd_utf8BlockErrors_avx2(input, prevInput));
+            prevIncomplete = _mm256_subs_epu8(input, maxTrailingValue);
+        }
+        prevInput = input;
+
+        if (isLastBlock)
+        {
+            break;
+        }
+        i += 32;
+    }
+
+    __m256i combined = _mm256_or_si256(error, nulBytes);
+    return _mm256_testz_si256(combined, combined) != 0;
+}
+
+// ----------------------------------------------------------------------------
+// AVX-512 (BW): 64-byte blocks
+// ----------------------------------------------------------------------------
+
+KSBONJSON_SIMD_TARGET("avx512f,avx512bw")
+static inline size_t ksbonjson_simd_findByte_avx512(const uint8_t *ptr, size_t len, uint8_t needle)
+{
+    size_t i = 0;
+    __m512i vneedle = _mm512_set1_epi8((char)needle);
+
+    while (i + 64 <= len)
+    {
+        __m512i data = _mm512_loadu_si512((const void *)(ptr + i));
+        uint64_t mask = (uint64_t)_mm512_cmpeq_epi8_mask(data, vneedle);
+        if (mask != 0)
+        {
+            return i + (size_t)__builtin_ctzll(mask);
+        }
+        i += 64;
+    }
+
+    return i + ksbonjson_simd_findByte_sse2(ptr + i, len - i, needle);
+}
+
+KSBONJSON_SIMD_TARGET("avx512f,avx512bw")
+static inline size_t ksbonjson_simd_findJSONSpecial_avx512(const uint8_t *ptr, size_t len)
+{
+    size_t i = 0;
+    __m512i vquote = _mm512_set1_epi8('"');
+    __m512i vbackslash = _mm512_set1_epi8('\\');
+    __m512i vspace = _mm512_set1_epi8(0x20);
+
+    while (i + 64 <= len)
+    {
+        __m512i data = _mm512_loadu_si512((const void *)(ptr + i));
+        uint64_t mask = (uint64_t)(_mm512_cmpeq_epi8_mask(data, vquote) |
+                                   _mm512_cmpeq_epi8_mask(data, vbackslash) |
+                                   _mm512_cmplt_epu8_mask(data, vspace));
+        if (mask != 0)
+        {
+            return i + (size_t)__builtin_ctzll(mask);
+        }
+        i += 64;
+    }
+
+    return i + ksbonjson_simd_findJSONSpecial_sse2(ptr + i, len - i);
+}
+
+KSBONJSON_SIMD_TARGET("avx512f,avx512bw")
+static inline bool ksbonjson_simd_containsByte_avx512(const uint8_t *ptr, size_t len, uint8_t needle)
+{
+    size_t i = 0;
+    __m512i vneedle = _mm512_set1_epi8((char)needle);
+
+    while (i + 64 <= len)
+    {
+        __m512i data = _mm512_loadu_si512((const void *)(ptr + i));
+        if (_mm512_cmpeq_epi8_mask(data, vneedle) != 0)
+        {
+            return true;
+        }
+        i += 64;
+    }
+
+    return ksbonjson_simd_containsByte_sse2(ptr + i, len - i, needle);
+}
+
+KSBONJSON_SIMD_TARGET("avx512f,avx512bw")
+static inline bool ksbonjson_simd_isAllAscii_avx512(const uint8_t *ptr, size_t len)
+{
+    size_t i = 0;
+
+    while (i + 64 <= len)
+    {
+        __m512i data = _mm512_loadu_si512((const void *)(ptr + i));
+        if (_mm512_movepi8_mask(data) != 0)
+        {
+            return false;
+        }
+        i += 64;
+    }
+
+    return ksbonjson_simd_isAllAscii_sse2(ptr + i, len - i);
+}
+
+KSBONJSON_SIMD_TARGET("avx512f,avx512bw")
+static inline __m512i ksbonjson_simd_utf8BlockErrors_avx512(__m512i input, __m512i prevInput)
+{
+    const __m512i lowNibbleMask = _mm512_set1_epi8(0x0F);
+    const __m512i byte1HighTable = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)ksbonjson_utf8Byte1High));
+    const __m512i byte1LowTable = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)ksbonjson_utf8Byte1Low));
+    const __m512i byte2HighTable = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)ksbonjson_utf8Byte2High));
+
+    // As with AVX2, pair each 128-bit lane with the one before it:
+    // (prev lane 3, input lanes 0-2).
+    __m512i prevLanes = _mm512_alignr_epi64(input, prevInput, 6);
+
+    __m512i prev1 = _mm512_alignr_epi8(input, prevLanes, 15);
+    __m512i byte1High = _mm512_shuffle_epi8(byte1HighTable, _mm512_and_si512(_mm512_srli_epi16(prev1, 4), lowNibbleMask));
+    __m512i byte1Low = _mm512_shuffle_epi8(byte1LowTable, _mm512_and_si512(prev1, lowNibbleMask));
+    __m512i byte2High = _mm512_shuffle_epi8(byte2HighTable, _mm512_and_si512(_mm512_srli_epi16(input, 4), lowNibbleMask));
+    __m512i specialCases = _mm512_and_si512(_mm512_and_si512(byte1High, byte1Low), byte2High);
+
+    __m512i prev2 = _mm512_alignr_epi8(input, prevLanes, 14);
+    __m512i prev3 = _mm512_alignr_epi8(input, prevLanes, 13);
+    __m512i isThirdByte = _mm512_subs_epu8(prev2, _mm512_set1_epi8((char)(0xE0 - 0x80)));
+    __m512i isFourthByte = _mm512_subs_epu8(prev3, _mm512_set1_epi8((char)(0xF0 - 0x80)));
+    __m512i must23 = _mm512_and_si512(_mm512_or_si512(isThirdByte, isFourthByte), _mm512_set1_epi8((char)0x80));
+    return _mm512_xor_si512(must23, specialCases);
+}
+
+KSBONJSON_SIMD_TARGET("avx512f,avx512bw")
+static inline bool ksbonjson_simd_isValidUTF8_avx512(const uint8_t *ptr, size_t len, bool rejectNUL)
+{
+    if (len == 0)
+    {
+        return true;
+    }
+
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i maxTrailingValue = _mm512_loadu_si512((const void *)ksbonjson_utf8MaxTrailingValue64);
+    __m512i error = zero;
+    __m512i prevInput = zero;
+    __m512i prevIncomplete = zero;
+    uint64_t nulBytes = 0;
+    uint8_t tail[64];
+    size_t i = 0;
+
+    for (;;)
+    {
+        __m512i input;
+        bool isLastBlock = i + 64 > len;
+        if (isLastBlock)
+        {
+            memset(tail, KSBONJSON_UTF8_PADDING, sizeof(tail));
+            memcpy(tail, ptr + i, len - i);
+            input = _mm512_loadu_si512((const void *)tail);
+        }
+        else
+        {
+            input = _mm512_loadu_si512((const void *)(ptr + i));
+        }
+
+        if (rejectNUL)
+        {
+            nulBytes |= (uint64_t)_mm512_cmpeq_epi8_mask(input, zero);
+        }
+        if (_mm512_movepi8_mask(input) == 0)
+        {
+            error = _mm512_or_si512(error, prevIncomplete);
+            prevIncomplete = zero;
+        }
+        else
+        {
+            error = _mm512_or_si512(error, ksbonjson_simd_utf8BlockErrors_avx512(input, prevInput));
+            prevIncomplete = _mm512_subs_epu8(input, maxTrailingValue);
+        }
+        prevInput = input;
+
+        if (isLastBlock)
+        {
+            break;
+        }
+        i += 64;
+    }
+
+    return nulBytes == 0 && _mm512_test_epi8_mask(error, error) == 0;
+}
+
+// ----------------------------------------------------------------------------
+// Runtime dispatch
+// ----------------------------------------------------------------------------
+
+enum
+{
+    KSBONJSON_SIMD_LEVEL_SSE2 = 0,
+    KSBONJSON_SIMD_LEVEL_SSSE3,
+    KSBONJSON_SIMD_LEVEL_AVX2,
+    KSBONJSON_SIMD_LEVEL_AVX512,
+};
+
+/**
+ * The widest instruction set this CPU (and OS) supports.
+ * Detected on first use and cached; threads racing here store the same value.
+ */
+static inline int ksbonjson_simd_x86Level(void)
+{
+    static int cachedLevel = -1;
+    int level = __atomic_load_n(&cachedLevel, __ATOMIC_RELAXED);
+    if (level < 0)
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512bw"))
+        {
+            level = KSBONJSON_SIMD_LEVEL_AVX512;
+        }
+        else if (__builtin_cpu_supports("avx2"))
+        {
+            level = KSBONJSON_SIMD_LEVEL_AVX2;
+        }
+        else if (__builtin_cpu_supports("ssse3"))
+        {
+            level = KSBONJSON_SIMD_LEVEL_SSSE3;
+        }
+        else
+        {
+            level = KSBONJSON_SIMD_LEVEL_SSE2;
+        }
+        __atomic_store_n(&cachedLevel, level, __ATOMIC_RELAXED);
+    }
+    return level;
+}
+
+#endif // KSBONJSON_SIMD_X86_DISPATCH
+
+// ----------------------------------------------------------------------------
+// Public entry points. Each uses the widest kernel whose block fits the input.
+// ----------------------------------------------------------------------------
+
+static inline size_t ksbonjson_simd_findByte(const uint8_t *ptr, size_t len, uint8_t needle)
+{
+#if KSBONJSON_SIMD_X86_DISPATCH
+    if (len >= 32)
+    {
+        int level = ksbonjson_simd_x86Level();
+        if (len >= 64 && level >= KSBONJSON_SIMD_LEVEL_AVX512) return ksbonjson_simd_findByte_avx512(ptr, len, needle);
+        if (level >= KSBONJSON_SIMD_LEVEL_AVX2) return ksbonjson_simd_findByte_avx2(ptr, len, needle);
+    }
+#endif
+    return ksbonjson_simd_findByte_sse2(ptr, len, needle);
+}
+
+/**
+ * Find the first byte that a JSON string can't hold as-is (a quote, backslash
+ * or control character). Returns the offset from ptr, or len if there is none.
+ */
+static inline size_t ksbonjson_simd_findJSONSpecial(const uint8_t *ptr, size_t len)
+{
+#if KSBONJSON_SIMD_X86_DISPATCH
+    if (len >= 32)
+    {
+        int level = ksbonjson_simd_x86Level();
+        if (len >= 64 && level >= KSBONJSON_SIMD_LEVEL_AVX512) return ksbonjson_simd_findJSONSpecial_avx512(ptr, len);
+        if (level >= KSBONJSON_SIMD_LEVEL_AVX2) return ksbonjson_simd_findJSONSpecial_avx2(ptr, len);
+    }
+#endif
+    return ksbonjson_simd_findJSONSpecial_sse2(ptr, len);
+}
+
+static inline bool ksbonjson_simd_containsByte(const uint8_t *ptr, size_t len, uint8_t needle)
+{
+#if KSBONJSON_SIMD_X86_DISPATCH
+    if (len >= 32)
+    {
+        int level = ksbonjson_simd_x86Level();
+        if (len >= 64 && level >= KSBONJSON_SIMD_LEVEL_AVX512) return ksbonjson_simd_containsByte_avx512(ptr, len, needle);
+        if (level >= KSBONJSON_SIMD_LEVEL_AVX2) return ksbonjson_simd_containsByte_avx2(ptr, len, needle);
+    }
+#endif
+    return ksbonjson_simd_containsByte_sse2(ptr, len, needle);
+}
+
+static inline bool ksbonjson_simd_isAllAscii(const uint8_t *ptr, size_t len)
+{
+#if KSBONJSON_SIMD_X86_DISPATCH
+    if (len >= 32)
+    {
+        int level = ksbonjson_simd_x86Level();
+        if (len >= 64 && level >= KSBONJSON_SIMD_LEVEL_AVX512) return ksbonjson_simd_isAllAscii_avx512(ptr, len);
+        if (level >= KSBONJSON_SIMD_LEVEL_AVX2) return ksbonjson_simd_isAllAscii_avx2(ptr, len);
+    }
+#endif
+    return ksbonjson_simd_isAllAscii_sse2(ptr, len);
+}
+
+/**
+ * Check that a buffer is valid UTF-8 and, if rejectNUL is set, contains no NUL bytes.
+ * Returns false if it isn't (or, without SSSE3, if it isn't all ASCII); the caller
+ * can then locate the exact error with a scalar pass.
+ */
+static inline bool ksbonjson_simd_isValidUTF8(const uint8_t *ptr, size_t len, bool rejectNUL)
+{
+#if KSBONJSON_SIMD_X86_DISPATCH
+    int level = ksbonjson_simd_x86Level();
+    if (len >= 64 && level >= KSBONJSON_SIMD_LEVEL_AVX512) return ksbonjson_simd_isValidUTF8_avx512(ptr, len, rejectNUL);
+    if (len >= 32 && level >= KSBONJSON_SIMD_LEVEL_AVX2) return ksbonjson_simd_isValidUTF8_avx2(ptr, len, rejectNUL);
+    if (level >= KSBONJSON_SIMD_LEVEL_SSSE3) return ksbonjson_simd_isValidUTF8_ssse3(ptr, len, rejectNUL);
+    return ksbonjson_simd_isValidUTF8_sse2(ptr, len, rejectNUL);
+#elif KSBONJSON_SIMD_SSSE3
+    return ksbonjson_simd_isValidUTF8_ssse3(ptr, len, rejectNUL);
+#else
+    return ksbonjson_simd_isValidUTF8_sse2(ptr, len, rejectNUL);
+#endif
+}
+
 #else
 
 // Scalar fallbacks using word-at-a-time tricks
@@ -210,6 +1059,15 @@ static inline bool ksbonjson_simd_containsByte(const uint8_t *ptr, size_t len, u
     return memchr(ptr, needle, len) != NULL;
 }
 
+static inline size_t ksbonjson_simd_findJSONSpecial(const uint8_t *ptr, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (ptr[i] == '"' || ptr[i] == '\\' || ptr[i] < 0x20) return i;
+    }
+    return len;
+}
+
 static inline bool ksbonjson_simd_isAllAscii(const uint8_t *ptr, size_t len)
 {
     for (size_t i = 0; i < len; i++)
@@ -219,6 +1077,268 @@ static inline bool ksbonjson_simd_isAllAscii(const uint8_t *ptr, size_t len)
     return true;
 }
 
+/**
+ * Only all-ASCII input can be confirmed without SIMD; anything else returns
+ * false for the caller's scalar validator to decide.
+ */
+static inline bool ksbonjson_simd_isValidUTF8(const uint8_t *ptr, size_t len, bool rejectNUL)
+{
+    return ksbonjson_simd_isAllAscii(ptr, len) &&
+           !(rejectNUL && ksbonjson_simd_containsByte(ptr, len, 0x00));
+}
+
+#endif
+
+// ============================================================================
+// Numeric Array Narrowing
+// ============================================================================
+
+// Used by the batch encoders to write an array with the narrowest typed array element
+// that holds every value exactly. Elements are written little-endian whatever the host;
+// the vector kernels are only built for little-endian hosts.
+
+#if KSBONJSON_SIMD_NEON && !defined(__AARCH64EB__)
+    #define KSBONJSON_SIMD_NARROW_NEON 1
+#elif KSBONJSON_SIMD_SSE2
+    #define KSBONJSON_SIMD_NARROW_SSE2 1
+#endif
+
+static inline void ksbonjson_narrowInt64_scalar(const int64_t *values, size_t count, uint8_t *dst, size_t elementSize)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint64_t value = (uint64_t)values[i];
+        for (size_t b = 0; b < elementSize; b++)
+        {
+            *dst++ = (uint8_t)(value >> (b * 8));
+        }
+    }
+}
+
+static inline bool ksbonjson_narrowFloat64_scalar(const double *values, size_t count, uint8_t *dst)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const double value = values[i];
+        // Converting a finite double beyond float's range is undefined, so range check first
+        float narrow = (float)INFINITY;
+        if (value >= -FLT_MAX && value <= FLT_MAX)
+        {
+            narrow = (float)value;
+        }
+        else if (value < 0)
+        {
+            narrow = -(float)INFINITY;
+        }
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+        if ((double)narrow != value)
+#pragma GCC diagnostic pop
+        {
+            return false;
+        }
+        uint32_t bits;
+        memcpy(&bits, &narrow, 4);
+        for (size_t b = 0; b < 4; b++)
+        {
+            *dst++ = (uint8_t)(bits >> (b * 8));
+        }
+    }
+    return true;
+}
+
+/**
+ * OR together every value (outBits) and every value's magnitude bits, the value with
+ * its copies of the sign bit cleared (outMagnitudeBits). The values all fit an unsigned
+ * type of N bits if outBits < 2^N, and a signed type of N bits if outMagnitudeBits < 2^(N-1).
+ */
+static inline void ksbonjson_simd_int64Bits(const int64_t *values, size_t count,
+                                            uint64_t *outBits, uint64_t *outMagnitudeBits)
+{
+    size_t i = 0;
+    uint64_t bits = 0;
+    uint64_t magnitudeBits = 0;
+
+#if KSBONJSON_SIMD_NARROW_NEON
+    uint64x2_t vbits = vdupq_n_u64(0);
+    uint64x2_t vmagnitude = vdupq_n_u64(0);
+    for (; i + 2 <= count; i += 2)
+    {
+        int64x2_t v = vld1q_s64(values + i);
+        vbits = vorrq_u64(vbits, vreinterpretq_u64_s64(v));
+        vmagnitude = vorrq_u64(vmagnitude, vreinterpretq_u64_s64(veorq_s64(v, vshrq_n_s64(v, 63))));
+    }
+    bits = vgetq_lane_u64(vbits, 0) | vgetq_lane_u64(vbits, 1);
+    magnitudeBits = vgetq_lane_u64(vmagnitude, 0) | vgetq_lane_u64(vmagnitude, 1);
+#elif KSBONJSON_SIMD_NARROW_SSE2
+    __m128i vbits = _mm_setzero_si128();
+    __m128i vmagnitude = _mm_setzero_si128();
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+        // SSE2 has no 64-bit arithmetic shift: spread each high dword's sign over its lane
+        __m128i sign = _mm_shuffle_epi32(_mm_srai_epi32(v, 31), _MM_SHUFFLE(3, 3, 1, 1));
+        vbits = _mm_or_si128(vbits, v);
+        vmagnitude = _mm_or_si128(vmagnitude, _mm_xor_si128(v, sign));
+    }
+    vbits = _mm_or_si128(vbits, _mm_unpackhi_epi64(vbits, vbits));
+    vmagnitude = _mm_or_si128(vmagnitude, _mm_unpackhi_epi64(vmagnitude, vmagnitude));
+    _mm_storel_epi64((__m128i *)&bits, vbits);
+    _mm_storel_epi64((__m128i *)&magnitudeBits, vmagnitude);
+#endif
+
+    for (; i < count; i++)
+    {
+        const int64_t value = values[i];
+        bits |= (uint64_t)value;
+        magnitudeBits |= (uint64_t)(value < 0 ? ~value : value);
+    }
+    *outBits = bits;
+    *outMagnitudeBits = magnitudeBits;
+}
+
+#if KSBONJSON_SIMD_NARROW_SSE2
+// The low dwords of four int64s, in order
+static inline __m128i ksbonjson_simd_lowDwords_sse2(const int64_t *values)
+{
+    __m128i a = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)values), _MM_SHUFFLE(2, 0, 2, 0));
+    __m128i b = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(values + 2)), _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm_unpacklo_epi64(a, b);
+}
+
+// The low words of eight int64s, in order. Each dword is sign-extended from its low
+// word first so that the saturating pack leaves it as it is.
+static inline __m128i ksbonjson_simd_lowWords_sse2(const int64_t *values)
+{
+    __m128i a = ksbonjson_simd_lowDwords_sse2(values);
+    __m128i b = ksbonjson_simd_lowDwords_sse2(values + 4);
+    a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+    b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+    return _mm_packs_epi32(a, b);
+}
 #endif
 
+/**
+ * Write the low elementSize (1, 2, 4 or 8) bytes of each value to dst, little-endian.
+ * The values are expected to fit (see ksbonjson_simd_int64Bits); the rest is dropped.
+ */
+static inline void ksbonjson_simd_narrowInt64(const int64_t *values, size_t count, uint8_t *dst, size_t elementSize)
+{
+    size_t i = 0;
+
+#if KSBONJSON_SIMD_NARROW_NEON
+    switch (elementSize)
+    {
+        case 4:
+            for (; i + 4 <= count; i += 4)
+            {
+                int32x4_t v = vcombine_s32(vmovn_s64(vld1q_s64(values + i)), vmovn_s64(vld1q_s64(values + i + 2)));
+                vst1q_u8(dst + i * 4, vreinterpretq_u8_s32(v));
+            }
+            break;
+        case 2:
+            for (; i + 8 <= count; i += 8)
+            {
+                int32x4_t a = vcombine_s32(vmovn_s64(vld1q_s64(values + i)), vmovn_s64(vld1q_s64(values + i + 2)));
+                int32x4_t b = vcombine_s32(vmovn_s64(vld1q_s64(values + i + 4)), vmovn_s64(vld1q_s64(values + i + 6)));
+                vst1q_u8(dst + i * 2, vreinterpretq_u8_s16(vcombine_s16(vmovn_s32(a), vmovn_s32(b))));
+            }
+            break;
+        case 1:
+            for (; i + 16 <= count; i += 16)
+            {
+                int16x8_t words[2];
+                for (int half = 0; half < 2; half++)
+                {
+                    const int64_t *p = values + i + half * 8;
+                    int32x4_t a = vcombine_s32(vmovn_s64(vld1q_s64(p)), vmovn_s64(vld1q_s64(p + 2)));
+                    int32x4_t b = vcombine_s32(vmovn_s64(vld1q_s64(p + 4)), vmovn_s64(vld1q_s64(p + 6)));
+                    words[half] = vcombine_s16(vmovn_s32(a), vmovn_s32(b));
+                }
+                vst1q_u8(dst + i, vreinterpretq_u8_s8(vcombine_s8(vmovn_s16(words[0]), vmovn_s16(words[1]))));
+            }
+            break;
+        default:
+            memcpy(dst, values, count * 8);
+            return;
+    }
+#elif KSBONJSON_SIMD_NARROW_SSE2
+    switch (elementSize)
+    {
+        case 4:
+            for (; i + 4 <= count; i += 4)
+            {
+                _mm_storeu_si128((__m128i *)(dst + i * 4), ksbonjson_simd_lowDwords_sse2(values + i));
+            }
+            break;
+        case 2:
+            for (; i + 8 <= count; i += 8)
+            {
+                _mm_storeu_si128((__m128i *)(dst + i * 2), ksbonjson_simd_lowWords_sse2(values + i));
+            }
+            break;
+        case 1:
+        {
+            // Mask each word to its low byte so that the unsigned saturating pack keeps it
+            __m128i lowBytes = _mm_set1_epi16(0xFF);
+            for (; i + 16 <= count; i += 16)
+            {
+                __m128i a = _mm_and_si128(ksbonjson_simd_lowWords_sse2(values + i), lowBytes);
+                __m128i b = _mm_and_si128(ksbonjson_simd_lowWords_sse2(values + i + 8), lowBytes);
+                _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
+            }
+            break;
+        }
+        default:
+            memcpy(dst, values, count * 8);
+            return;
+    }
+#endif
+
+    ksbonjson_narrowInt64_scalar(values + i, count - i, dst + i * elementSize, elementSize);
+}
+
+/**
+ * Convert each value to float32 and write it to dst, little-endian. Returns false as
+ * soon as a value doesn't convert back to the same double (NaNs never do), leaving dst
+ * partly written.
+ */
+static inline bool ksbonjson_simd_narrowFloat64(const double *values, size_t count, uint8_t *dst)
+{
+    size_t i = 0;
+
+#if KSBONJSON_SIMD_NARROW_NEON
+    for (; i + 4 <= count; i += 4)
+    {
+        float64x2_t a = vld1q_f64(values + i);
+        float64x2_t b = vld1q_f64(values + i + 2);
+        float32x2_t narrowA = vcvt_f32_f64(a);
+        float32x2_t narrowB = vcvt_f32_f64(b);
+        uint64x2_t same = vandq_u64(vceqq_f64(vcvt_f64_f32(narrowA), a), vceqq_f64(vcvt_f64_f32(narrowB), b));
+        if ((vgetq_lane_u64(same, 0) & vgetq_lane_u64(same, 1)) != UINT64_MAX)
+        {
+            return false;
+        }
+        vst1q_u8(dst + i * 4, vreinterpretq_u8_f32(vcombine_f32(narrowA, narrowB)));
+    }
+#elif KSBONJSON_SIMD_NARROW_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+        // Out-of-range values convert to infinity, which then doesn't compare equal
+        __m128d a = _mm_loadu_pd(values + i);
+        __m128d b = _mm_loadu_pd(values + i + 2);
+        __m128 narrowA = _mm_cvtpd_ps(a);
+        __m128 narrowB = _mm_cvtpd_ps(b);
+        __m128d same = _mm_and_pd(_mm_cmpeq_pd(_mm_cvtps_pd(narrowA), a), _mm_cmpeq_pd(_mm_cvtps_pd(narrowB), b));
+        if (_mm_movemask_pd(same) != 3)
+        {
+            return false;
+        }
+        _mm_storeu_ps((float *)(void *)(dst + i * 4), _mm_movelh_ps(narrowA, narrowB));
+    }
+#endif
+
+    return ksbonjson_narrowFloat64_scalar(values + i, count - i, dst + i * 4);
+}
+
 #endif // KSBONJSON_SIMD_H
@@ -0,0 +1,2348 @@
+//
+//  KSBONJSONTranscoder.c
+//
+//  Copyright (c) 2024 Karl Stenerud. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// ABOUTME: Streaming JSON to BONJSON and BONJSON to JSON conversion.
+// ABOUTME: A chunked JSON parser drives the buffer encoder; the callback decoder drives a JSON writer.
+
+#include "KSBONJSONTranscoder.h"
+#include "KSBONJSONCommon.h"
+#include "KSBONJSONSimd.h"
+#include <string.h> // For memcpy(), memcmp() and memmove()
+#include <stdlib.h> // For malloc(), realloc(), free() and strtod()
+#include <stdio.h>  // For snprintf()
+#include <math.h>   // For isinf(), fabs() and fpclassify()
+#include <float.h>  // For FLT_MAX and FLT_EVAL_METHOD
+#include <locale.h> // For localeconv()
+
+#pragma GCC diagnostic ignored "-Wdeclaration-after-statement"
+
+
+// ============================================================================
+// Macros
+// ============================================================================
+
+#define PROPAGATE_ERROR(CALL) \
+    do \
+    { \
+        const ksbonjson_decodeStatus propagatedResult = CALL; \
+        unlikely_if(propagatedResult != KSBONJSON_DECODE_OK) \
+        { \
+            return propagatedResult; \
+        } \
+    } \
+    while(0)
+
+// Run an encoder call, returning its failure as a decode status
+#define ENCODE(CALL) \
+    do \
+    { \
+        const ssize_t encodeResult = CALL; \
+        unlikely_if(encodeResult < 0) \
+        { \
+            return fromEncodeStatus((ksbonjson_encodeStatus)-encodeResult); \
+        } \
+    } \
+    while(0)
+
+
+// ============================================================================
+// Utility
+// ============================================================================
+
+static inline size_t limitOrDefault(const size_t limit, const size_t defaultLimit)
+{
+    return limit < SIZE_MAX ? limit : defaultLimit;
+}
+
+static inline bool isDigit(const uint8_t ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+static inline bool isWhitespace(const uint8_t ch)
+{
+    return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+}
+
+static inline const uint8_t* skipWhitespace(const uint8_t* cur, const uint8_t* const end)
+{
+    while (cur < end && isWhitespace(*cur))
+    {
+        cur++;
+    }
+    return cur;
+}
+
+static ksbonjson_decodeStatus fromEncodeStatus(const ksbonjson_encodeStatus status)
+{
+    switch (status)
+    {
+        case KSBONJSON_ENCODE_NUL_CHARACTER:
+            return KSBONJSON_DECODE_NUL_CHARACTER;
+        case KSBONJSON_ENCODE_MAX_DEPTH_EXCEEDED:
+            return KSBONJSON_DECODE_MAX_DEPTH_EXCEEDED;
+        case KSBONJSON_ENCODE_MAX_STRING_LENGTH_EXCEEDED:
+            return KSBONJSON_DECODE_MAX_STRING_LENGTH_EXCEEDED;
+        case KSBONJSON_ENCODE_MAX_CONTAINER_SIZE_EXCEEDED:
+            return KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED;
+        case KSBONJSON_ENCODE_MAX_DOCUMENT_SIZE_EXCEEDED:
+            return KSBONJSON_DECODE_MAX_DOCUMENT_SIZE_EXCEEDED;
+        case KSBONJSON_ENCODE_COULD_NOT_ADD_DATA:
+            return KSBONJSON_DECODE_COULD_NOT_PROCESS_DATA;
+        default:
+            return KSBONJSON_DECODE_INVALID_DATA;
+    }
+}
+
+
+// ============================================================================
+// JSON to BONJSON: State
+// ============================================================================
+
+enum
+{
+    CONTAINER_ARRAY = 0,
+    CONTAINER_OBJECT,
+    CONTAINER_RECORD,   // An object written as a record instance (its keys aren't written)
+};
+
+enum
+{
+    PHASE_VALUE = 0,    // The root value, or a value after ':' or an array's ','
+    PHASE_FIRST_VALUE,  // After '[': a value or ']'
+    PHASE_FIRST_KEY,    // After '{': a key or '}'
+    PHASE_KEY,          // After an object's ','
+    PHASE_COLON,        // After a key
+    PHASE_AFTER_VALUE,  // ',' or the end of the container (at the top level, the end of the document)
+};
+
+// Whether a container can be written in a more compact form. Probes never fail:
+// anything they don't like is left for the parser to convert (or reject) as usual.
+typedef enum
+{
+    PROBE_NO,
+    PROBE_WAIT,  // More input is needed to tell
+    PROBE_YES,
+} ProbeResult;
+
+static inline size_t getMaxDepth(const KSBONJSONFromJSONContext* const ctx)
+{
+    const size_t maxDepth = limitOrDefault(ctx->flags.maxDepth, KSBONJSON_MAX_CONTAINER_DEPTH);
+    return maxDepth < KSBONJSON_MAX_CONTAINER_DEPTH ? maxDepth : KSBONJSON_MAX_CONTAINER_DEPTH;
+}
+
+static inline size_t getMaxContainerSize(const KSBONJSONFromJSONContext* const ctx)
+{
+    return limitOrDefault(ctx->flags.maxContainerSize, KSBONJSON_DEFAULT_MAX_CONTAINER_SIZE);
+}
+
+static bool ensureScratch(KSBONJSONFromJSONContext* const ctx, const size_t capacity)
+{
+    if (capacity <= ctx->scratchCapacity)
+    {
+        return true;
+    }
+    size_t newCapacity = ctx->scratchCapacity == 0 ? 256 : ctx->scratchCapacity * 2;
+    if (newCapacity < capacity)
+    {
+        newCapacity = capacity;
+    }
+    uint8_t* const newScratch = realloc(ctx->scratch, newCapacity);
+    unlikely_if(newScratch == NULL)
+    {
+        return false;
+    }
+    ctx->scratch = newScratch;
+    ctx->scratchCapacity = newCapacity;
+    return true;
+}
+
+/**
+ * Make room for the next length bytes of output, handing everything written so far
+ * to the sink. Room is made for values bigger than the buffer by growing it.
+ */
+static ksbonjson_decodeStatus reserveOutput(KSBONJSONFromJSONContext* const ctx, const size_t length)
+{
+    KSBONJSONBufferEncodeContext* const encoder = &ctx->encoder;
+    if (encoder->capacity - encoder->position >= length)
+    {
+        return KSBONJSON_DECODE_OK;
+    }
+    unlikely_if(ksbonjson_encodeToBuffer_flush(encoder, encoder->position) < 0)
+    {
+        return KSBONJSON_DECODE_COULD_NOT_PROCESS_DATA;
+    }
+    if (encoder->capacity < length)
+    {
+        uint8_t* const newBuffer = realloc(encoder->buffer, length);
+        unlikely_if(newBuffer == NULL)
+        {
+            return KSBONJSON_DECODE_OUT_OF_MEMORY;
+        }
+        ksbonjson_encodeToBuffer_setBuffer(encoder, newBuffer, length);
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+/**
+ * The buffer encoder checks the document size for values, but not for raw bytes or
+ * whole typed arrays.
+ */
+static inline ksbonjson_decodeStatus checkDocumentSize(const KSBONJSONFromJSONContext* const ctx, const size_t length)
+{
+    const size_t maxDocumentSize = limitOrDefault(ctx->flags.maxDocumentSize, KSBONJSON_DEFAULT_MAX_DOCUMENT_SIZE);
+    unlikely_if(ctx->encoder.flushedBytes + ctx->encoder.position + length > maxDocumentSize)
+    {
+        return KSBONJSON_DECODE_MAX_DOCUMENT_SIZE_EXCEEDED;
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+/**
+ * Account for a value about to be written in the current container.
+ */
+static inline ksbonjson_decodeStatus beginValue(KSBONJSONFromJSONContext* const ctx)
+{
+    if (ctx->depth == 0)
+    {
+        ctx->hasRootValue = true;
+        return KSBONJSON_DECODE_OK;
+    }
+    unlikely_if(++ctx->containerSizes[ctx->depth] > getMaxContainerSize(ctx))
+    {
+        return KSBONJSON_DECODE_MAX_CONTAINER_SIZE_EXCEEDED;
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+static inline ksbonjson_decodeStatus checkCanOpenContainer(const KSBONJSONFromJSONContext* const ctx)
+{
+    unlikely_if((size_t)ctx->depth >= getMaxDepth(ctx))
+    {
+        return KSBONJSON_DECODE_MAX_DEPTH_EXCEEDED;
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+static inline void pushContainer(KSBONJSONFromJSONContext* const ctx, const uint8_t kind)
+{
+    ctx->depth++;
+    ctx->containerKinds[ctx->depth] = kind;
+    ctx->containerSizes[ctx->depth] = 0;
+    ctx->phase = kind == CONTAINER_ARRAY ? PHASE_FIRST_VALUE : PHASE_FIRST_KEY;
+}
+
+
+// ============================================================================
+// JSON to BONJSON: Record Definition Keys
+// ============================================================================
+
+static bool addRecordKey(KSBONJSONFromJSONContext* const ctx, const uint8_t* const key, const size_t length)
+{
+    const size_t requiredBytes = ctx->recordKeyBytesLength + length;
+    if (requiredBytes > ctx->recordKeyBytesCapacity || ctx->recordKeyBytes == NULL)
+    {
+        size_t newCapacity = ctx->recordKeyBytesCapacity == 0 ? 256 : ctx->recordKeyBytesCapacity * 2;
+        if (newCapacity < requiredBytes)
+        {
+            newCapacity = requiredBytes;
+        }
+        uint8_t* const newBytes = realloc(ctx->recordKeyBytes, newCapacity);
+        unlikely_if(newBytes == NULL)
+        {
+            return false;
+        }
+        ctx->recordKeyBytes = newBytes;
+        ctx->recordKeyBytesCapacity = newCapacity;
+    }
+    if (ctx->recordKeyCount == ctx->recordKeyCapacity)
+    {
+        const size_t newCapacity = ctx->recordKeyCapacity == 0 ? 16 : ctx->recordKeyCapacity * 2;
+        size_t* const newEnds = realloc(ctx->recordKeyEnds, newCapacity * sizeof(*newEnds));
+        unlikely_if(newEnds == NULL)
+        {
+            return false;
+        }
+        ctx->recordKeyEnds = newEnds;
+        ctx->recordKeyCapacity = newCapacity;
+    }
+    memcpy(ctx->recordKeyBytes + ctx->recordKeyBytesLength, key, length);
+    ctx->recordKeyBytesLength = requiredBytes;
+    ctx->recordKeyEnds[ctx->recordKeyCount++] = requiredBytes;
+    return true;
+}
+
+static inline size_t recordKeyBegin(const KSBONJSONFromJSONContext* const ctx, const size_t index)
+{
+    return index == 0 ? 0 : ctx->recordKeyEnds[index - 1];
+}
+
+static inline bool recordKeyMatches(const KSBONJSONFromJSONContext* const ctx,
+                                    const size_t index,
+                                    const uint8_t* const key,
+                                    const size_t length)
+{
+    if (index >= ctx->recordKeyCount)
+    {
+        return false;
+    }
+    const size_t begin = recordKeyBegin(ctx, index);
+    return ctx->recordKeyEnds[index] - begin == length &&
+           memcmp(ctx->recordKeyBytes + begin, key, length) == 0;
+}
+
+
+// ============================================================================
+// JSON to BONJSON: Strings
+// ============================================================================
+
+static inline int hexDigitValue(const uint8_t ch)
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+static ksbonjson_decodeStatus readHex4(const uint8_t* const cur, const uint8_t* const end, uint32_t* const outValue)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        unlikely_if(cur + i >= end)
+        {
+            return KSBONJSON_DECODE_INCOMPLETE;
+        }
+        const int digit = hexDigitValue(cur[i]);
+        unlikely_if(digit < 0)
+        {
+            return KSBONJSON_DECODE_INVALID_DATA;
+        }
+        value = (value << 4) | (uint32_t)digit;
+    }
+    *outValue = value;
+    return KSBONJSON_DECODE_OK;
+}
+
+static inline size_t writeUTF8(uint8_t* const dst, const uint32_t codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        dst[0] = (uint8_t)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800)
+    {
+        dst[0] = (uint8_t)(0xC0 | (codepoint >> 6));
+        dst[1] = (uint8_t)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000)
+    {
+        dst[0] = (uint8_t)(0xE0 | (codepoint >> 12));
+        dst[1] = (uint8_t)(0x80 | ((codepoint >> 6) & 0x3F));
+        dst[2] = (uint8_t)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    dst[0] = (uint8_t)(0xF0 | (codepoint >> 18));
+    dst[1] = (uint8_t)(0x80 | ((codepoint >> 12) & 0x3F));
+    dst[2] = (uint8_t)(0x80 | ((codepoint >> 6) & 0x3F));
+    dst[3] = (uint8_t)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+/**
+ * Unescape the \\u escape at cur (just past the backslash and 'u'), pairing surrogates.
+ */
+static ksbonjson_decodeStatus unescapeUnicode(const KSBONJSONFromJSONContext* const ctx,
+                                              const uint8_t** const pCur,
+                                              const uint8_t* const end,
+                                              uint8_t* const dst,
+                                              size_t* const outLength)
+{
+    const uint8_t* cur = *pCur;
+    uint32_t codepoint;
+    PROPAGATE_ERROR(readHex4(cur, end, &codepoint));
+    cur += 4;
+    if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+    {
+        // A high surrogate pairs with a low surrogate escape straight after it
+        unlikely_if(cur == end || (cur[0] == '\\' && cur + 1 == end))
+        {
+            return KSBONJSON_DECODE_INCOMPLETE;
+        }
+        uint32_t low;
+        if (cur[0] == '\\' && cur[1] == 'u')
+        {
+            PROPAGATE_ERROR(readHex4(cur + 2, end, &low));
+            if (low >= 0xDC00 && low <= 0xDFFF)
+            {
+                codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                cur += 6;
+            }
+        }
+    }
+    // An unpaired surrogate has no UTF-8 encoding. If it's allowed through, it's
+    // written the way WTF-8 writes it.
+    unlikely_if(codepoint >= 0xD800 && codepoint <= 0xDFFF && ctx->flags.rejectInvalidUTF8)
+    {
+        return KSBONJSON_DECODE_INVALID_UTF8;
+    }
+    *outLength = writeUTF8(dst, codepoint);
+    *pCur = cur;
+    return KSBONJSON_DECODE_OK;
+}
+
+/**
+ * Parse the string at cur (on the opening quote). Strings without escapes are
+ * returned in place; others are unescaped into the scratch buffer.
+ */
+static ksbonjson_decodeStatus parseString(KSBONJSONFromJSONContext* const ctx,
+                                          const uint8_t* const cur,
+                                          const uint8_t* const end,
+                                          const uint8_t** const outString,
+                                          size_t* const outLength,
+                                          const uint8_t** const next)
+{
+    const uint8_t* const begin = cur + 1;
+    const size_t plainLength = ksbonjson_simd_findJSONSpecial(begin, (size_t)(end - begin));
+    const uint8_t* src = begin + plainLength;
+    unlikely_if(src == end)
+    {
+        return KSBONJSON_DECODE_INCOMPLETE;
+    }
+
+    const uint8_t* string = begin;
+    size_t length = plainLength;
+    if (*src != '"')
+    {
+        // Unescaping never makes the string longer
+        unlikely_if(!ensureScratch(ctx, (size_t)(end - begin)))
+        {
+            return KSBONJSON_DECODE_OUT_OF_MEMORY;
+        }
+        uint8_t* const dstBegin = ctx->scratch;
+        memcpy(dstBegin, begin, plainLength);
+        uint8_t* dst = dstBegin + plainLength;
+        for (;;)
+        {
+            const uint8_t ch = *src;
+            if (ch == '"')
+            {
+                break;
+            }
+            unlikely_if(ch < 0x20)
+            {
+                return KSBONJSON_DECODE_INVALID_DATA;
+            }
+            // A backslash
+            unlikely_if(src + 1 >= end)
+            {
+                return KSBONJSON_DECODE_INCOMPLETE;
+            }
+            const uint8_t escape = src[1];
+            src += 2;
+            switch (escape)
+            {
+                case '"':  *dst++ = '"';  break;
+                case '\\': *dst++ = '\\'; break;
+                case '/':  *dst++ = '/';  break;
+                case 'b':  *dst++ = '\b'; break;
+                case 'f':  *dst++ = '\f'; break;
+                case 'n':  *dst++ = '\n'; break;
+                case 'r':  *dst++ = '\r'; break;
+                case 't':  *dst++ = '\t'; break;
+                case 'u':
+                {
+                    size_t encodedLength;
+                    PROPAGATE_ERROR(unescapeUnicode(ctx, &src, end, dst, &encodedLength));
+                    dst += encodedLength;
+                    break;
+                }
+                default:
+                    return KSBONJSON_DECODE_INVALID_DATA;
+            }
+
+            const size_t runLength = ksbonjson_simd_findJSONSpecial(src, (size_t)(end - src));
+            memcpy(dst, src, runLength);
+            dst += runLength;
+            src += runLength;
+            unlikely_if(src == end)
+            {
+                return KSBONJSON_DECODE_INCOMPLETE;
+            }
+        }
+        string = dstBegin;
+        length = (size_t)(dst - dstBegin);
+    }
+
+    if (ctx->flags.rejectInvalidUTF8)
+    {
+        // Any NUL is left for the encoder, which checks for it when rejectNUL is set
+        PROPAGATE_ERROR(ksbonjson_validateUTF8(string, length, false));
+    }
+    *outString = string;
+    *outLength = length;
+    *next = src + 1;
+    return KSBONJSON_DECODE_OK;
+}
+
+
+// ============================================================================
+// JSON to BONJSON: Numbers
+// ============================================================================
+
+typedef enum
+{
+    NUMBER_INT,
+    NUMBER_UINT,
+    NUMBER_BIG,
+    NUMBER_FLOAT,
+} NumberKind;
+
+typedef struct
+{
+    NumberKind kind;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+        KSBigNumber big;
+    } as;
+} Number;
+
+/**
+ * Find the end of the number at cur, checking it against the JSON grammar. A number
+ * that runs to the end of the input might go on in the next chunk.
+ */
+static ksbonjson_decodeStatus scanNumber(const uint8_t* const cur,
+                                         const uint8_t* const end,
+                                         const bool atEnd,
+                                         const uint8_t** const outEnd,
+                                         bool* const outIsInteger)
+{
+    const uint8_t* p = cur;
+    bool isInteger = true;
+    if (*p == '-')
+    {
+        p++;
+    }
+    unlikely_if(p == end)
+    {
+        return KSBONJSON_DECODE_INCOMPLETE;
+    }
+    if (*p == '0')
+    {
+        p++;
+    }
+    else if (*p >= '1' && *p <= '9')
+    {
+        do
+        {
+            p++;
+        }
+        while (p < end && isDigit(*p));
+    }
+    else
+    {
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+
+    if (p < end && *p == '.')
+    {
+        isInteger = false;
+        const uint8_t* const digits = ++p;
+        while (p < end && isDigit(*p))
+        {
+            p++;
+        }
+        unlikely_if(p == digits)
+        {
+            return p == end ? KSBONJSON_DECODE_INCOMPLETE : KSBONJSON_DECODE_INVALID_DATA;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        isInteger = false;
+        p++;
+        if (p < end && (*p == '+' || *p == '-'))
+        {
+            p++;
+        }
+        const uint8_t* const digits = p;
+        while (p < end && isDigit(*p))
+        {
+            p++;
+        }
+        unlikely_if(p == digits)
+        {
+            return p == end ? KSBONJSON_DECODE_INCOMPLETE : KSBONJSON_DECODE_INVALID_DATA;
+        }
+    }
+    unlikely_if(p == end && !atEnd)
+    {
+        return KSBONJSON_DECODE_INCOMPLETE;
+    }
+    *outEnd = p;
+    *outIsInteger = isInteger;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus parseFloatWithStrtod(const uint8_t* const text, const size_t length, Number* const out)
+{
+    char stackBuffer[64];
+    char* const buffer = length < sizeof(stackBuffer) ? stackBuffer : malloc(length + 1);
+    unlikely_if(buffer == NULL)
+    {
+        return KSBONJSON_DECODE_OUT_OF_MEMORY;
+    }
+    memcpy(buffer, text, length);
+    buffer[length] = 0;
+
+    // strtod() expects the locale's decimal point
+    const char decimalPoint = *localeconv()->decimal_point;
+    if (decimalPoint != '.')
+    {
+        char* const dot = memchr(buffer, '.', length);
+        if (dot != NULL)
+        {
+            *dot = decimalPoint;
+        }
+    }
+    const double value = strtod(buffer, NULL);
+    if (buffer != stackBuffer)
+    {
+        free(buffer);
+    }
+
+    unlikely_if(isinf(value))
+    {
+        return KSBONJSON_DECODE_VALUE_OUT_OF_RANGE;
+    }
+    out->kind = NUMBER_FLOAT;
+    out->as.d = value;
+    return KSBONJSON_DECODE_OK;
+}
+
+// Clinger's fast path: a significand of at most 2^53 scaled by an exactly
+// representable power of ten is correctly rounded by a single multiply or divide.
+// It relies on double arithmetic being done in double precision.
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#   define KSBONJSON_FAST_FLOAT_PARSE 1
+#else
+#   define KSBONJSON_FAST_FLOAT_PARSE 0
+#endif
+
+#if KSBONJSON_FAST_FLOAT_PARSE
+static const double exactPowersOfTen[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+#endif
+
+static ksbonjson_decodeStatus parseFloat(const uint8_t* const text, const size_t length, Number* const out)
+{
+#if KSBONJSON_FAST_FLOAT_PARSE
+    const uint8_t* p = text;
+    const uint8_t* const end = text + length;
+    const bool isNegative = *p == '-';
+    if (isNegative)
+    {
+        p++;
+    }
+
+    uint64_t significand = 0;
+    int digitCount = 0;
+    int32_t exponent = 0;
+    bool isExact = true;
+    for (bool isFraction = false; p < end; p++)
+    {
+        const uint8_t ch = *p;
+        if (ch == '.')
+        {
+            isFraction = true;
+            continue;
+        }
+        if (!isDigit(ch))
+        {
+            break;
+        }
+        if (significand != 0 || ch != '0')
+        {
+            if (digitCount == 19)
+            {
+                isExact = false;
+                break;
+            }
+            significand = significand * 10 + (uint64_t)(ch - '0');
+            digitCount++;
+        }
+        if (isFraction)
+        {
+            exponent--;
+        }
+    }
+    if (isExact && p < end)
+    {
+        // The exponent
+        p++;
+        const bool isExponentNegative = *p == '-';
+        if (*p == '-' || *p == '+')
+        {
+            p++;
+        }
+        int32_t explicitExponent = 0;
+        for (; p < end; p++)
+        {
+            if (explicitExponent < 100000)
+            {
+                explicitExponent = explicitExponent * 10 + (*p - '0');
+            }
+        }
+        exponent += isExponentNegative ? -explicitExponent : explicitExponent;
+    }
+
+    if (isExact && significand <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double value = (double)significand;
+        value = exponent < 0 ? value / exactPowersOfTen[-exponent] : value * exactPowersOfTen[exponent];
+        out->kind = NUMBER_FLOAT;
+        out->as.d = isNegative ? -value : value;
+        return KSBONJSON_DECODE_OK;
+    }
+#endif
+    return parseFloatWithStrtod(text, length, out);
+}
+
+/**
+ * Parse a number found by scanNumber(). Integers are kept exact wherever BONJSON can
+ * hold them: in 64 bits, or as a big number once their trailing zeros are taken off.
+ */
+static ksbonjson_decodeStatus parseNumber(const uint8_t* const text,
+                                          const size_t length,
+                                          const bool isInteger,
+                                          Number* const out)
+{
+    if (isInteger)
+    {
+        const uint8_t* const end = text + length;
+        const bool isNegative = *text == '-';
+        const uint8_t* const digits = isNegative ? text + 1 : text;
+
+        uint64_t significand = 0;
+        const uint8_t* p = digits;
+        for (; p < end; p++)
+        {
+            const uint64_t digit = (uint64_t)(*p - '0');
+            unlikely_if(significand > (UINT64_MAX - digit) / 10)
+            {
+                break;
+            }
+            significand = significand * 10 + digit;
+        }
+        if (p == end)
+        {
+            if (!isNegative)
+            {
+                if (significand <= INT64_MAX)
+                {
+                    out->kind = NUMBER_INT;
+                    out->as.i = (int64_t)significand;
+                }
+                else
+                {
+                    out->kind = NUMBER_UINT;
+                    out->as.u = significand;
+                }
+            }
+            else if (significand <= (uint64_t)INT64_MAX + 1)
+            {
+                out->kind = NUMBER_INT;
+                out->as.i = significand == (uint64_t)INT64_MAX + 1 ? INT64_MIN : -(int64_t)significand;
+            }
+            else
+            {
+                out->kind = NUMBER_BIG;
+                out->as.big = ksbonjson_newBigNumber(-1, significand, 0);
+            }
+            return KSBONJSON_DECODE_OK;
+        }
+
+        // Too many digits for 64 bits, but the trailing zeros can go in the exponent
+        const uint8_t* significantEnd = end;
+        while (significantEnd > digits && significantEnd[-1] == '0')
+        {
+            significantEnd--;
+        }
+        significand = 0;
+        for (p = digits; p < significantEnd; p++)
+        {
+            const uint64_t digit = (uint64_t)(*p - '0');
+            unlikely_if(significand > (UINT64_MAX - digit) / 10)
+            {
+                break;
+            }
+            significand = significand * 10 + digit;
+        }
+        if (p == significantEnd && end - significantEnd <= INT32_MAX)
+        {
+            out->kind = NUMBER_BIG;
+            out->as.big = ksbonjson_newBigNumber(isNegative ? -1 : 1, significand, (int32_t)(end - significantEnd));
+            return KSBONJSON_DECODE_OK;
+        }
+    }
+    return parseFloat(text, length, out);
+}
+
+
+// ============================================================================
+// JSON to BONJSON: Probes
+// ============================================================================
+
+/**
+ * The input a probe of the container at cur may look at. isFinal is set if the
+ * container can't be seen past it: the document ends there, or the lookahead does.
+ */
+static inline const uint8_t* probeLimit(const KSBONJSONFromJSONContext* const ctx,
+                                        const uint8_t* const cur,
+                                        const uint8_t* const end,
+                                        const bool atEnd,
+                                        bool* const isFinal)
+{
+    if ((size_t)(end - cur) > ctx->maxLookahead)
+    {
+        *isFinal = true;
+        return cur + ctx->maxLookahead;
+    }
+    *isFinal = atEnd;
+    return end;
+}
+
+/**
+ * Find the end of the string at cur (on the opening quote) without unescaping it.
+ * Returns NULL if the string doesn't end before limit.
+ */
+static const uint8_t* skipString(const uint8_t* cur, const uint8_t* const limit)
+{
+    cur++;
+    for (;;)
+    {
+        cur += ksbonjson_simd_findJSONSpecial(cur, (size_t)(limit - cur));
+        if (cur == limit)
+        {
+            return NULL;
+        }
+        if (*cur == '"')
+        {
+            return cur + 1;
+        }
+        // A backslash skips the escaped character; a control character is left for
+        // the parser to reject.
+        cur += *cur == '\\' ? 2 : 1;
+        if (cur >= limit)
+        {
+            return NULL;
+        }
+    }
+}
+
+/**
+ * Find the end of the value at cur without converting it. Only strings and nesting
+ * are followed; the rest is checked when the value is converted.
+ */
+static ProbeResult skipValue(const uint8_t* cur, const uint8_t* const limit, const uint8_t** const outEnd)
+{
+    size_t depth = 0;
+    do
+    {
+        const uint8_t ch = *cur;
+        switch (ch)
+        {
+            case '"':
+                cur = skipString(cur, limit);
+                if (cur == NULL)
+                {
+                    return PROBE_WAIT;
+                }
+                break;
+            case '[':
+            case '{':
+                depth++;
+                cur++;
+                break;
+            case ']':
+            case '}':
+                if (depth == 0)
+                {
+                    return PROBE_NO;
+                }
+                depth--;
+                cur++;
+                break;
+            case ',':
+            case ':':
+            case ' ':
+            case '\n':
+            case '\r':
+            case '\t':
+                if (depth == 0)
+                {
+                    return PROBE_NO;
+                }
+                cur++;
+                break;
+            default:
+                // A scalar, which runs until the next delimiter
+                while (cur < limit && !isWhitespace(*cur) && *cur != ',' && *cur != ':' &&
+                       *cur != ']' && *cur != '}' && *cur != '[' && *cur != '{' && *cur != '"')
+                {
+                    cur++;
+                }
+                if (depth == 0 && cur == limit)
+                {
+                    return PROBE_WAIT;
+                }
+                break;
+        }
+    }
+    while (depth > 0 && cur < limit);
+
+    if (depth > 0)
+    {
+        return PROBE_WAIT;
+    }
+    *outEnd = cur;
+    return PROBE_YES;
+}
+
+/**
+ * Check the object at cur against the record definition, or (when collecting) make
+ * its keys the definition. Keys with escapes aren't used in definitions.
+ */
+static ProbeResult probeObject(KSBONJSONFromJSONContext* const ctx,
+                               const uint8_t* const cur,
+                               const uint8_t* const limit,
+                               const bool isFinal,
+                               const bool isCollecting,
+                               const uint8_t** const outEnd)
+{
+    const ProbeResult outOfInput = isFinal ? PROBE_NO : PROBE_WAIT;
+    const size_t maxStringLength = limitOrDefault(ctx->flags.maxStringLength, KSBONJSON_DEFAULT_MAX_STRING_LENGTH);
+    size_t keyIndex = 0;
+
+    const uint8_t* p = skipWhitespace(cur + 1, limit);
+    if (p == limit)
+    {
+        return outOfInput;
+    }
+    if (*p != '}')
+    {
+        for (;;)
+        {
+            if (*p != '"')
+            {
+                return PROBE_NO;
+            }
+            const uint8_t* const key = p + 1;
+            const size_t keyLength = ksbonjson_simd_findJSONSpecial(key, (size_t)(limit - key));
+            if (key + keyLength == limit)
+            {
+                return outOfInput;
+            }
+            if (key[keyLength] != '"')
+            {
+                return PROBE_NO;
+            }
+            if (isCollecting)
+            {
+                // A long string can't hold 0xFF, which only turns up in invalid UTF-8
+                if (keyLength > maxStringLength || keyIndex >= getMaxContainerSize(ctx) ||
+                    ksbonjson_simd_containsByte(key, keyLength, TYPE_STRING_LONG) ||
+                    (ctx->flags.rejectInvalidUTF8 && ksbonjson_validateUTF8(key, keyLength, false) != KSBONJSON_DECODE_OK) ||
+                    !addRecordKey(ctx, key, keyLength))
+                {
+                    return PROBE_NO;
+                }
+            }
+            else if (!recordKeyMatches(ctx, keyIndex, key, keyLength))
+            {
+                return PROBE_NO;
+            }
+            keyIndex++;
+
+            p = skipWhitespace(key + keyLength + 1, limit);
+            if (p == limit)
+            {
+                return outOfInput;
+            }
+            if (*p != ':')
+            {
+                return PROBE_NO;
+            }
+            p = skipWhitespace(p + 1, limit);
+            if (p == limit)
+            {
+                return outOfInput;
+            }
+            const ProbeResult skipped = skipValue(p, limit, &p);
+            if (skipped != PROBE_YES)
+            {
+                return skipped == PROBE_WAIT ? outOfInput : PROBE_NO;
+            }
+            p = skipWhitespace(p, limit);
+            if (p == limit)
+            {
+                return outOfInput;
+            }
+            if (*p == '}')
+            {
+                break;
+            }
+            if (*p != ',')
+            {
+                return PROBE_NO;
+            }
+            p = skipWhitespace(p + 1, limit);
+            if (p == limit)
+            {
+                return outOfInput;
+            }
+        }
+    }
+
+    if (isCollecting ? keyIndex == 0 : keyIndex != ctx->recordKeyCount)
+    {
+        return PROBE_NO;
+    }
+    *outEnd = p + 1;
+    return PROBE_YES;
+}
+
+/**
+ * Check whether the root array at cur starts with two objects with the same keys,
+ * and if so make those keys the record definition.
+ */
+static ProbeResult probeRecordArray(KSBONJSONFromJSONContext* const ctx,
+                                    const uint8_t* const cur,
+                                    const uint8_t* const end,
+                                    const bool atEnd)
+{
+    bool isFinal;
+    const uint8_t* const limit = probeLimit(ctx, cur, end, atEnd, &isFinal);
+    const ProbeResult outOfInput = isFinal ? PROBE_NO : PROBE_WAIT;
+
+    const uint8_t* p = skipWhitespace(cur + 1, limit);
+    if (p == limit)
+    {
+        return outOfInput;
+    }
+    if (*p != '{')
+    {
+        return PROBE_NO;
+    }
+
+    ctx->recordKeyCount = 0;
+    ctx->recordKeyBytesLength = 0;
+    ProbeResult result = probeObject(ctx, p, limit, isFinal, true, &p);
+    if (result == PROBE_YES)
+    {
+        p = skipWhitespace(p, limit);
+        if (p == limit)
+        {
+            result = outOfInput;
+        }
+        else if (*p != ',')
+        {
+            result = PROBE_NO;
+        }
+        else
+        {
+            p = skipWhitespace(p + 1, limit);
+            if (p == limit)
+            {
+                result = outOfInput;
+            }
+            else if (*p != '{')
+            {
+                result = PROBE_NO;
+            }
+            else
+            {
+                result = probeObject(ctx, p, limit, isFinal, false, &p);
+            }
+        }
+    }
+    if (result != PROBE_YES)
+    {
+        ctx->recordKeyCount = 0;
+        ctx->recordKeyBytesLength = 0;
+    }
+    return result;
+}
+
+typedef struct
+{
+    uint8_t typeCode;       // TYPE_TYPED_xyz
+    size_t count;
+    const uint8_t* end;     // Just past the closing bracket
+} TypedArrayProbe;
+
+#define MAX_EXACT_DOUBLE_INTEGER (1LL << 53)
+
+/**
+ * Check whether the array at cur holds nothing but numbers, leaving their values in
+ * the scratch buffer (8 bytes each) and choosing the narrowest element type that holds
+ * them all exactly.
+ */
+static ProbeResult probeTypedArray(KSBONJSONFromJSONContext* const ctx,
+                                   const uint8_t* const cur,
+                                   const uint8_t* const end,
+                                   const bool atEnd,
+                                   TypedArrayProbe* const out)
+{
+    bool isFinal;
+    const uint8_t* const limit = probeLimit(ctx, cur, end, atEnd, &isFinal);
+    const ProbeResult outOfInput = isFinal ? PROBE_NO : PROBE_WAIT;
+    const size_t maxCount = getMaxContainerSize(ctx);
+
+    const uint8_t* p = skipWhitespace(cur + 1, limit);
+    if (p == limit)
+    {
+        return outOfInput;
+    }
+
+    size_t count = 0;
+    bool hasFloats = false;
+    bool hasBigUnsigned = false;
+    int64_t minValue = 0;
+    int64_t maxValue = 0;
+    for (;;)
+    {
+        if (*p != '-' && !isDigit(*p))
+        {
+            // Also rejects empty arrays, which have no element type to choose
+            return PROBE_NO;
+        }
+        const uint8_t* numberEnd;
+        bool isInteger;
+        const ksbonjson_decodeStatus status = scanNumber(p, limit, isFinal, &numberEnd, &isInteger);
+        if (status != KSBONJSON_DECODE_OK)
+        {
+            return status == KSBONJSON_DECODE_INCOMPLETE ? outOfInput : PROBE_NO;
+        }
+        Number number;
+        if (parseNumber(p, (size_t)(numberEnd - p), isInteger, &number) != KSBONJSON_DECODE_OK ||
+            count >= maxCount || !ensureScratch(ctx, (count + 1) * 8))
+        {
+            return PROBE_NO;
+        }
+
+        uint8_t* const slot = ctx->scratch + count * 8;
+        switch (number.kind)
+        {
+            case NUMBER_FLOAT:
+                if (!hasFloats)
+                {
+                    // The integers so far become floats, if they can do so exactly
+                    if (hasBigUnsigned || minValue < -MAX_EXACT_DOUBLE_INTEGER || maxValue > MAX_EXACT_DOUBLE_INTEGER)
+                    {
+                        return PROBE_NO;
+                    }
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        int64_t intValue;
+                        memcpy(&intValue, ctx->scratch + i * 8, 8);
+                        const double floatValue = (double)intValue;
+                        memcpy(ctx->scratch + i * 8, &floatValue, 8);
+                    }
+                    hasFloats = true;
+                }
+                memcpy(slot, &number.as.d, 8);
+                break;
+            case NUMBER_INT:
+                if (hasFloats)
+                {
+                    if (number.as.i < -MAX_EXACT_DOUBLE_INTEGER || number.as.i > MAX_EXACT_DOUBLE_INTEGER)
+                    {
+                        return PROBE_NO;
+                    }
+                    const double floatValue = (double)number.as.i;
+                    memcpy(slot, &floatValue, 8);
+                    break;
+                }
+                if (hasBigUnsigned && number.as.i < 0)
+                {
+                    return PROBE_NO;
+                }
+                minValue = number.as.i < minValue ? number.as.i : minValue;
+                maxValue = number.as.i > maxValue ? number.as.i : maxValue;
+                memcpy(slot, &number.as.i, 8);
+                break;
+            case NUMBER_UINT:
+                if (hasFloats || minValue < 0)
+                {
+                    return PROBE_NO;
+                }
+                hasBigUnsigned = true;
+                memcpy(slot, &number.as.u, 8);
+                break;
+            default:
+                return PROBE_NO;
+        }
+        count++;
+
+        p = skipWhitespace(numberEnd, limit);
+        if (p == limit)
+        {
+            return outOfInput;
+        }
+        if (*p == ']')
+        {
+            break;
+        }
+        if (*p != ',')
+        {
+            return PROBE_NO;
+        }
+        p = skipWhitespace(p + 1, limit);
+        if (p == limit)
+        {
+            return outOfInput;
+        }
+    }
+
+    if (hasFloats)
+    {
+        out->typeCode = TYPE_TYPED_FLOAT32;
+        for (size_t i = 0; i < count; i++)
+        {
+            double value;
+            memcpy(&value, ctx->scratch + i * 8, 8);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+            if (fabs(value) > FLT_MAX || (double)(float)value != value)
+#pragma GCC diagnostic pop
+            {
+                out->typeCode = TYPE_TYPED_FLOAT64;
+                break;
+            }
+        }
+    }
+    else if (hasBigUnsigned)
+    {
+        out->typeCode = TYPE_TYPED_UINT64;
+    }
+    else if (minValue >= 0)
+    {
+        out->typeCode = maxValue <= UINT8_MAX ? TYPE_TYPED_UINT8
+                      : maxValue <= UINT16_MAX ? TYPE_TYPED_UINT16
+                      : maxValue <= UINT32_MAX ? TYPE_TYPED_UINT32
+                      : TYPE_TYPED_SINT64;
+    }
+    else
+    {
+        out->typeCode = minValue >= INT8_MIN && maxValue <= INT8_MAX ? TYPE_TYPED_SINT8
+                      : minValue >= INT16_MIN && maxValue <= INT16_MAX ? TYPE_TYPED_SINT16
+                      : minValue >= INT32_MIN && maxValue <= INT32_MAX ? TYPE_TYPED_SINT32
+                      : TYPE_TYPED_SINT64;
+    }
+    out->count = count;
+    out->end = p + 1;
+    return PROBE_YES;
+}
+
+
+// ============================================================================
+// JSON to BONJSON: Conversion
+// ============================================================================
+
+static size_t typedElementSize(const uint8_t typeCode)
+{
+    switch (typeCode)
+    {
+        case TYPE_TYPED_UINT8:
+        case TYPE_TYPED_SINT8:
+            return 1;
+        case TYPE_TYPED_UINT16:
+        case TYPE_TYPED_SINT16:
+            return 2;
+        case TYPE_TYPED_UINT32:
+        case TYPE_TYPED_SINT32:
+        case TYPE_TYPED_FLOAT32:
+            return 4;
+        default:
+            return 8;
+    }
+}
+
+/**
+ * Pack the probed 8-byte values in the scratch buffer down to the element type.
+ */
+static void narrowScratch(uint8_t* const scratch, const size_t count, const uint8_t typeCode)
+{
+    const size_t elementSize = typedElementSize(typeCode);
+    if (elementSize == 8)
+    {
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t bits;
+        memcpy(&bits, scratch + i * 8, 8);
+        uint8_t* const dst = scratch + i * elementSize;
+        switch (typeCode)
+        {
+            case TYPE_TYPED_UINT8:
+            case TYPE_TYPED_SINT8:
+                *dst = (uint8_t)bits;
+                break;
+            case TYPE_TYPED_UINT16:
+            case TYPE_TYPED_SINT16:
+            {
+                const uint16_t value = (uint16_t)bits;
+                memcpy(dst, &value, 2);
+                break;
+            }
+            case TYPE_TYPED_FLOAT32:
+            {
+                double wide;
+                memcpy(&wide, &bits, 8);
+                const float value = (float)wide;
+                memcpy(dst, &value, 4);
+                break;
+            }
+            default:
+            {
+                const uint32_t value = (uint32_t)bits;
+                memcpy(dst, &value, 4);
+                break;
+            }
+        }
+    }
+}
+
+static ksbonjson_decodeStatus writeTypedArray(KSBONJSONFromJSONContext* const ctx,
+                                              const TypedArrayProbe* const array,
+                                              const uint8_t** const next)
+{
+    const size_t encodedSize = 11 + array->count * typedElementSize(array->typeCode);
+    PROPAGATE_ERROR(beginValue(ctx));
+    PROPAGATE_ERROR(checkDocumentSize(ctx, encodedSize));
+    PROPAGATE_ERROR(reserveOutput(ctx, encodedSize));
+
+    KSBONJSONBufferEncodeContext* const encoder = &ctx->encoder;
+    const void* const values = ctx->scratch;
+    const size_t count = array->count;
+    narrowScratch(ctx->scratch, count, array->typeCode);
+    switch (array->typeCode)
+    {
+        case TYPE_TYPED_UINT8:   ENCODE(ksbonjson_encodeToBuffer_uint8Array(encoder, values, count));   break;
+        case TYPE_TYPED_UINT16:  ENCODE(ksbonjson_encodeToBuffer_uint16Array(encoder, values, count));  break;
+        case TYPE_TYPED_UINT32:  ENCODE(ksbonjson_encodeToBuffer_uint32Array(encoder, values, count));  break;
+        case TYPE_TYPED_UINT64:  ENCODE(ksbonjson_encodeToBuffer_uint64Array(encoder, values, count));  break;
+        case TYPE_TYPED_SINT8:   ENCODE(ksbonjson_encodeToBuffer_int8Array(encoder, values, count));    break;
+        case TYPE_TYPED_SINT16:  ENCODE(ksbonjson_encodeToBuffer_int16Array(encoder, values, count));   break;
+        case TYPE_TYPED_SINT32:  ENCODE(ksbonjson_encodeToBuffer_int32Array(encoder, values, count));   break;
+        case TYPE_TYPED_SINT64:  ENCODE(ksbonjson_encodeToBuffer_int64Array(encoder, values, count));   break;
+        case TYPE_TYPED_FLOAT32: ENCODE(ksbonjson_encodeToBuffer_float32Array(encoder, values, count)); break;
+        default:                 ENCODE(ksbonjson_encodeToBuffer_doubleArray(encoder, values, count));  break;
+    }
+    ctx->phase = PHASE_AFTER_VALUE;
+    *next = array->end;
+    return KSBONJSON_DECODE_OK;
+}
+
+/**
+ * Write the record definition (which goes in front of the root value) and open the
+ * root array.
+ */
+static ksbonjson_decodeStatus writeRecordArray(KSBONJSONFromJSONContext* const ctx,
+                                               const uint8_t* const cur,
+                                               const uint8_t** const next)
+{
+    KSBONJSONBufferEncodeContext* const encoder = &ctx->encoder;
+    PROPAGATE_ERROR(beginValue(ctx));
+    PROPAGATE_ERROR(reserveOutput(ctx, 1));
+    ENCODE(ksbonjson_encodeToBuffer_beginRecordDef(encoder));
+    for (size_t i = 0; i < ctx->recordKeyCount; i++)
+    {
+        const size_t begin = recordKeyBegin(ctx, i);
+        const size_t length = ctx->recordKeyEnds[i] - begin;
+        const size_t encodedSize = ksbonjson_maxEncodedSize_string(length);
+        PROPAGATE_ERROR(checkDocumentSize(ctx, encodedSize));
+        PROPAGATE_ERROR(reserveOutput(ctx, encodedSize));
+        // Definition keys are outside the encoder's container tracking, so they're written raw
+        uint8_t* dst = encoder->buffer + encoder->position;
+        if (length <= TYPE_SHORT_STRING_MAX - TYPE_STRING0)
+        {
+            *dst++ = (uint8_t)(TYPE_STRING0 + length);
+            memcpy(dst, ctx->recordKeyBytes + begin, length);
+            dst += length;
+        }
+        else
+        {
+            *dst++ = TYPE_STRING_LONG;
+            memcpy(dst, ctx->recordKeyBytes + begin, length);
+            dst += length;
+            *dst++ = TYPE_STRING_LONG;
+        }
+        encoder->position = (size_t)(dst - encoder->buffer);
+    }
+    PROPAGATE_ERROR(reserveOutput(ctx, 2));
+    ENCODE(ksbonjson_encodeToBuffer_endRecordDef(encoder));
+    ENCODE(ksbonjson_encodeToBuffer_beginArray(encoder));
+    pushContainer(ctx, CONTAINER_ARRAY);
+    ctx->rootArrayHasRecords = true;
+    *next = cur + 1;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus openArray(KSBONJSONFromJSONContext* const ctx,
+                                        const uint8_t* const cur,
+                                        const uint8_t* const end,
+                                        const bool atEnd,
+                                        const uint8_t** const next)
+{
+    PROPAGATE_ERROR(checkCanOpenContainer(ctx));
+    if (ctx->useRecords && ctx->depth == 0)
+    {
+        const ProbeResult result = probeRecordArray(ctx, cur, end, atEnd);
+        if (result == PROBE_WAIT)
+        {
+            return KSBONJSON_DECODE_INCOMPLETE;
+        }
+        if (result == PROBE_YES)
+        {
+            return writeRecordArray(ctx, cur, next);
+        }
+    }
+    if (ctx->useTypedArrays)
+    {
+        TypedArrayProbe array;
+        const ProbeResult result = probeTypedArray(ctx, cur, end, atEnd, &array);
+        if (result == PROBE_WAIT)
+        {
+            return KSBONJSON_DECODE_INCOMPLETE;
+        }
+        if (result == PROBE_YES)
+        {
+            return writeTypedArray(ctx, &array, next);
+        }
+    }
+
+    PROPAGATE_ERROR(beginValue(ctx));
+    PROPAGATE_ERROR(reserveOutput(ctx, 1));
+    ENCODE(ksbonjson_encodeToBuffer_beginArray(&ctx->encoder));
+    pushContainer(ctx, CONTAINER_ARRAY);
+    *next = cur + 1;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus openObject(KSBONJSONFromJSONContext* const ctx,
+                                         const uint8_t* const cur,
+                                         const uint8_t* const end,
+                                         const bool atEnd,
+                                         const uint8_t** const next)
+{
+    PROPAGATE_ERROR(checkCanOpenContainer(ctx));
+    if (ctx->rootArrayHasRecords && ctx->depth == 1)
+    {
+        bool isFinal;
+        const uint8_t* const limit = probeLimit(ctx, cur, end, atEnd, &isFinal);
+        const uint8_t* objectEnd;
+        const ProbeResult result = probeObject(ctx, cur, limit, isFinal, false, &objectEnd);
+        if (result == PROBE_WAIT)
+        {
+            return KSBONJSON_DECODE_INCOMPLETE;
+        }
+        if (result == PROBE_YES)
+        {
+            PROPAGATE_ERROR(beginValue(ctx));
+            PROPAGATE_ERROR(reserveOutput(ctx, 11));
+            ENCODE(ksbonjson_encodeToBuffer_beginRecordInstance(&ctx->encoder, 0));
+            pushContainer(ctx, CONTAINER_RECORD);
+            ctx->recordField = 0;
+            *next = cur + 1;
+            return KSBONJSON_DECODE_OK;
+        }
+    }
+
+    PROPAGATE_ERROR(beginValue(ctx));
+    PROPAGATE_ERROR(reserveOutput(ctx, 1));
+    ENCODE(ksbonjson_encodeToBuffer_beginObject(&ctx->encoder));
+    pushContainer(ctx, CONTAINER_OBJECT);
+    *next = cur + 1;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus closeContainer(KSBONJSONFromJSONContext* const ctx,
+                                             const uint8_t* const cur,
+                                             const uint8_t** const next)
+{
+    unlikely_if(ctx->containerKinds[ctx->depth] == CONTAINER_RECORD && ctx->recordField != ctx->recordKeyCount)
+    {
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+    PROPAGATE_ERROR(reserveOutput(ctx, 1));
+    ENCODE(ksbonjson_encodeToBuffer_endContainer(&ctx->encoder));
+    ctx->depth--;
+    ctx->phase = PHASE_AFTER_VALUE;
+    *next = cur + 1;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus convertKey(KSBONJSONFromJSONContext* const ctx,
+                                         const uint8_t* const cur,
+                                         const uint8_t* const end,
+                                         const uint8_t** const next)
+{
+    unlikely_if(*cur != '"')
+    {
+        return KSBONJSON_DECODE_EXPECTED_OBJECT_NAME;
+    }
+    const uint8_t* string;
+    size_t length;
+    PROPAGATE_ERROR(parseString(ctx, cur, end, &string, &length, next));
+    if (ctx->containerKinds[ctx->depth] == CONTAINER_RECORD)
+    {
+        // The probe found the definition's keys here, so the key isn't written
+        unlikely_if(!recordKeyMatches(ctx, ctx->recordField, string, length))
+        {
+            return KSBONJSON_DECODE_INVALID_DATA;
+        }
+        ctx->recordField++;
+    }
+    else
+    {
+        PROPAGATE_ERROR(reserveOutput(ctx, ksbonjson_maxEncodedSize_string(length)));
+        ENCODE(ksbonjson_encodeToBuffer_string(&ctx->encoder, (const char*)string, length));
+    }
+    ctx->phase = PHASE_COLON;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus matchLiteral(const uint8_t* const cur,
+                                           const uint8_t* const end,
+                                           const char* const literal,
+                                           const size_t length)
+{
+    const size_t available = (size_t)(end - cur);
+    if (available < length)
+    {
+        return memcmp(cur, literal, available) == 0 ? KSBONJSON_DECODE_INCOMPLETE : KSBONJSON_DECODE_INVALID_DATA;
+    }
+    return memcmp(cur, literal, length) == 0 ? KSBONJSON_DECODE_OK : KSBONJSON_DECODE_INVALID_DATA;
+}
+
+static ksbonjson_decodeStatus convertValue(KSBONJSONFromJSONContext* const ctx,
+                                           const uint8_t* const cur,
+                                           const uint8_t* const end,
+                                           const bool atEnd,
+                                           const uint8_t** const next)
+{
+    KSBONJSONBufferEncodeContext* const encoder = &ctx->encoder;
+    switch (*cur)
+    {
+        case '"':
+        {
+            const uint8_t* string;
+            size_t length;
+            PROPAGATE_ERROR(parseString(ctx, cur, end, &string, &length, next));
+            PROPAGATE_ERROR(beginValue(ctx));
+            PROPAGATE_ERROR(reserveOutput(ctx, ksbonjson_maxEncodedSize_string(length)));
+            ENCODE(ksbonjson_encodeToBuffer_string(encoder, (const char*)string, length));
+            break;
+        }
+        case '{':
+            return openObject(ctx, cur, end, atEnd, next);
+        case '[':
+            return openArray(ctx, cur, end, atEnd, next);
+        case 't':
+            PROPAGATE_ERROR(matchLiteral(cur, end, "true", 4));
+            PROPAGATE_ERROR(beginValue(ctx));
+            PROPAGATE_ERROR(reserveOutput(ctx, KSBONJSON_MAX_ENCODED_SIZE_BOOL));
+            ENCODE(ksbonjson_encodeToBuffer_bool(encoder, true));
+            *next = cur + 4;
+            break;
+        case 'f':
+            PROPAGATE_ERROR(matchLiteral(cur, end, "false", 5));
+            PROPAGATE_ERROR(beginValue(ctx));
+            PROPAGATE_ERROR(reserveOutput(ctx, KSBONJSON_MAX_ENCODED_SIZE_BOOL));
+            ENCODE(ksbonjson_encodeToBuffer_bool(encoder, false));
+            *next = cur + 5;
+            break;
+        case 'n':
+            PROPAGATE_ERROR(matchLiteral(cur, end, "null", 4));
+            PROPAGATE_ERROR(beginValue(ctx));
+            PROPAGATE_ERROR(reserveOutput(ctx, KSBONJSON_MAX_ENCODED_SIZE_NULL));
+            ENCODE(ksbonjson_encodeToBuffer_null(encoder));
+            *next = cur + 4;
+            break;
+        default:
+        {
+            unlikely_if(*cur != '-' && !isDigit(*cur))
+            {
+                return ctx->depth > 0 && ctx->containerKinds[ctx->depth] != CONTAINER_ARRAY
+                    ? KSBONJSON_DECODE_EXPECTED_OBJECT_VALUE
+                    : KSBONJSON_DECODE_INVALID_DATA;
+            }
+            const uint8_t* numberEnd;
+            bool isInteger;
+            PROPAGATE_ERROR(scanNumber(cur, end, atEnd, &numberEnd, &isInteger));
+            Number number;
+            PROPAGATE_ERROR(parseNumber(cur, (size_t)(numberEnd - cur), isInteger, &number));
+            PROPAGATE_ERROR(beginValue(ctx));
+            // Big numbers are the largest: type, two LEB128 headers and up to 8 bytes
+            PROPAGATE_ERROR(reserveOutput(ctx, 32));
+            switch (number.kind)
+            {
+                case NUMBER_INT:   ENCODE(ksbonjson_encodeToBuffer_int(encoder, number.as.i));         break;
+                case NUMBER_UINT:  ENCODE(ksbonjson_encodeToBuffer_uint(encoder, number.as.u));        break;
+                case NUMBER_BIG:   ENCODE(ksbonjson_encodeToBuffer_bigNumber(encoder, number.as.big)); break;
+                case NUMBER_FLOAT: ENCODE(ksbonjson_encodeToBuffer_float(encoder, number.as.d));       break;
+            }
+            *next = numberEnd;
+            break;
+        }
+    }
+    ctx->phase = PHASE_AFTER_VALUE;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus convertToken(KSBONJSONFromJSONContext* const ctx,
+                                           const uint8_t* const cur,
+                                           const uint8_t* const end,
+                                           const bool atEnd,
+                                           const uint8_t** const next)
+{
+    const uint8_t ch = *cur;
+    switch (ctx->phase)
+    {
+        case PHASE_FIRST_KEY:
+            if (ch == '}')
+            {
+                return closeContainer(ctx, cur, next);
+            }
+            return convertKey(ctx, cur, end, next);
+        case PHASE_KEY:
+            return convertKey(ctx, cur, end, next);
+        case PHASE_COLON:
+            unlikely_if(ch != ':')
+            {
+                return KSBONJSON_DECODE_INVALID_DATA;
+            }
+            ctx->phase = PHASE_VALUE;
+            *next = cur + 1;
+            return KSBONJSON_DECODE_OK;
+        case PHASE_FIRST_VALUE:
+            if (ch == ']')
+            {
+                return closeContainer(ctx, cur, next);
+            }
+            return convertValue(ctx, cur, end, atEnd, next);
+        case PHASE_VALUE:
+            return convertValue(ctx, cur, end, atEnd, next);
+        default:
+            break;
+    }
+
+    // After a value
+    if (ctx->depth == 0)
+    {
+        unlikely_if(ctx->flags.rejectTrailingBytes)
+        {
+            return KSBONJSON_DECODE_TRAILING_BYTES;
+        }
+        *next = end;
+        return KSBONJSON_DECODE_OK;
+    }
+    const bool isArray = ctx->containerKinds[ctx->depth] == CONTAINER_ARRAY;
+    if (ch == ',')
+    {
+        ctx->phase = isArray ? PHASE_VALUE : PHASE_KEY;
+        *next = cur + 1;
+        return KSBONJSON_DECODE_OK;
+    }
+    if (ch == (isArray ? ']' : '}'))
+    {
+        return closeContainer(ctx, cur, next);
+    }
+    return KSBONJSON_DECODE_INVALID_DATA;
+}
+
+/**
+ * Convert as much of buffer as can be. Conversion stops at a token that runs past the
+ * end of the buffer (unless atEnd, when that's an error); nothing of it is written,
+ * so it can be retried once more input has arrived.
+ */
+static ksbonjson_decodeStatus convertBuffer(KSBONJSONFromJSONContext* const ctx,
+                                            const uint8_t* const buffer,
+                                            const size_t length,
+                                            const bool atEnd,
+                                            size_t* const outConsumed)
+{
+    const uint8_t* const end = buffer + length;
+    const uint8_t* cur = buffer;
+    ksbonjson_decodeStatus status = KSBONJSON_DECODE_OK;
+    for (;;)
+    {
+        cur = skipWhitespace(cur, end);
+        if (cur == end)
+        {
+            break;
+        }
+        const uint8_t* next = cur;
+        status = convertToken(ctx, cur, end, atEnd, &next);
+        if (status == KSBONJSON_DECODE_INCOMPLETE && !atEnd)
+        {
+            status = KSBONJSON_DECODE_OK;
+            break;
+        }
+        unlikely_if(status != KSBONJSON_DECODE_OK)
+        {
+            break;
+        }
+        cur = next;
+    }
+    *outConsumed = (size_t)(cur - buffer);
+    return status;
+}
+
+static bool appendPending(KSBONJSONFromJSONContext* const ctx, const uint8_t* const bytes, const size_t length)
+{
+    if (length == 0)
+    {
+        return true;
+    }
+    const size_t required = ctx->pendingLength + length;
+    if (required > ctx->pendingCapacity)
+    {
+        size_t newCapacity = ctx->pendingCapacity == 0 ? 64 : ctx->pendingCapacity * 2;
+        if (newCapacity < required)
+        {
+            newCapacity = required;
+        }
+        uint8_t* const newPending = realloc(ctx->pending, newCapacity);
+        unlikely_if(newPending == NULL)
+        {
+            return false;
+        }
+        ctx->pending = newPending;
+        ctx->pendingCapacity = newCapacity;
+    }
+    memcpy(ctx->pending + ctx->pendingLength, bytes, length);
+    ctx->pendingLength = required;
+    return true;
+}
+
+
+// ============================================================================
+// JSON to BONJSON: API
+// ============================================================================
+
+void ksbonjson_fromJSON_begin(KSBONJSONFromJSONContext* const ctx,
+                              const KSBONJSONDecodeFlags flags,
+                              const KSBONJSONAddEncodedDataFunc sink,
+                              void* const userData)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->flags = flags;
+    ctx->useTypedArrays = true;
+    ctx->useRecords = true;
+    ctx->maxLookahead = KSBONJSON_TRANSCODE_MAX_LOOKAHEAD;
+
+    const KSBONJSONEncodeFlags encodeFlags = {
+        .rejectNUL = flags.rejectNUL,
+        .rejectNonFiniteFloat = true,
+        .maxDepth = flags.maxDepth,
+        .maxStringLength = flags.maxStringLength,
+        .maxContainerSize = flags.maxContainerSize,
+        .maxDocumentSize = flags.maxDocumentSize,
+    };
+    uint8_t* const buffer = malloc(KSBONJSON_TRANSCODE_CHUNK_SIZE);
+    ksbonjson_encodeToBuffer_beginWithFlags(&ctx->encoder, buffer, buffer == NULL ? 0 : KSBONJSON_TRANSCODE_CHUNK_SIZE, encodeFlags);
+    ksbonjson_encodeToBuffer_setFlushCallback(&ctx->encoder, sink, userData);
+    ctx->status = buffer == NULL ? KSBONJSON_DECODE_OUT_OF_MEMORY : KSBONJSON_DECODE_OK;
+}
+
+void ksbonjson_fromJSON_setUseTypedArrays(KSBONJSONFromJSONContext* const ctx, const bool useTypedArrays)
+{
+    ctx->useTypedArrays = useTypedArrays;
+}
+
+void ksbonjson_fromJSON_setUseRecords(KSBONJSONFromJSONContext* const ctx, const bool useRecords)
+{
+    ctx->useRecords = useRecords;
+}
+
+ksbonjson_decodeStatus ksbonjson_fromJSON_feed(KSBONJSONFromJSONContext* const ctx,
+                                               const uint8_t* chunk,
+                                               size_t chunkLength)
+{
+    unlikely_if(ctx->status != KSBONJSON_DECODE_OK)
+    {
+        return ctx->status;
+    }
+    ctx->inputLength += chunkLength;
+    unlikely_if(ctx->inputLength > limitOrDefault(ctx->flags.maxDocumentSize, KSBONJSON_DEFAULT_MAX_DOCUMENT_SIZE))
+    {
+        return ctx->status = KSBONJSON_DECODE_MAX_DOCUMENT_SIZE_EXCEEDED;
+    }
+
+    // As in the incremental decoder, first finish what an earlier chunk cut off,
+    // topping the buffer up in steps that grow with it.
+    while (ctx->pendingLength > 0 && chunkLength > 0)
+    {
+        size_t step = ctx->pendingLength < 64 ? 64 : ctx->pendingLength;
+        if (step > chunkLength)
+        {
+            step = chunkLength;
+        }
+        unlikely_if(!appendPending(ctx, chunk, step))
+        {
+            return ctx->status = KSBONJSON_DECODE_OUT_OF_MEMORY;
+        }
+        chunk += step;
+        chunkLength -= step;
+
+        size_t consumed;
+        ctx->status = convertBuffer(ctx, ctx->pending, ctx->pendingLength, false, &consumed);
+        unlikely_if(ctx->status != KSBONJSON_DECODE_OK)
+        {
+            return ctx->status;
+        }
+        ctx->decodedOffset += consumed;
+        const size_t unused = ctx->pendingLength - consumed;
+        if (consumed > 0 && unused <= step)
+        {
+            // Whatever is left came from this chunk, so convert it from there instead
+            chunk -= unused;
+            chunkLength += unused;
+            ctx->pendingLength = 0;
+        }
+        else if (consumed > 0)
+        {
+            // A probe gave up on a container it had buffered, and conversion stopped
+            // inside it. The rest has to stay buffered.
+            memmove(ctx->pending, ctx->pending + consumed, unused);
+            ctx->pendingLength = unused;
+        }
+    }
+    if (ctx->pendingLength > 0)
+    {
+        return KSBONJSON_DECODE_OK;
+    }
+
+    size_t consumed;
+    ctx->status = convertBuffer(ctx, chunk, chunkLength, false, &consumed);
+    unlikely_if(ctx->status != KSBONJSON_DECODE_OK)
+    {
+        return ctx->status;
+    }
+    ctx->decodedOffset += consumed;
+
+    unlikely_if(!appendPending(ctx, chunk + consumed, chunkLength - consumed))
+    {
+        return ctx->status = KSBONJSON_DECODE_OUT_OF_MEMORY;
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+ksbonjson_decodeStatus ksbonjson_fromJSON_end(KSBONJSONFromJSONContext* const ctx)
+{
+    ksbonjson_decodeStatus status = ctx->status;
+    if (status == KSBONJSON_DECODE_OK && ctx->pendingLength > 0)
+    {
+        size_t consumed;
+        status = convertBuffer(ctx, ctx->pending, ctx->pendingLength, true, &consumed);
+        ctx->decodedOffset += consumed;
+    }
+    if (status == KSBONJSON_DECODE_OK)
+    {
+        if (!ctx->hasRootValue)
+        {
+            status = KSBONJSON_DECODE_INCOMPLETE;
+        }
+        else if (ctx->depth > 0)
+        {
+            status = KSBONJSON_DECODE_UNCLOSED_CONTAINERS;
+        }
+        else
+        {
+            const ssize_t result = ksbonjson_encodeToBuffer_end(&ctx->encoder);
+            if (result < 0)
+            {
+                status = fromEncodeStatus((ksbonjson_encodeStatus)-result);
+            }
+            else if (ksbonjson_encodeToBuffer_flush(&ctx->encoder, ctx->encoder.position) < 0)
+            {
+                status = KSBONJSON_DECODE_COULD_NOT_PROCESS_DATA;
+            }
+        }
+    }
+
+    free(ctx->encoder.buffer);
+    ctx->encoder.buffer = NULL;
+    ctx->encoder.capacity = 0;
+    free(ctx->pending);
+    ctx->pending = NULL;
+    ctx->pendingLength = 0;
+    ctx->pendingCapacity = 0;
+    free(ctx->scratch);
+    ctx->scratch = NULL;
+    ctx->scratchCapacity = 0;
+    free(ctx->recordKeyBytes);
+    ctx->recordKeyBytes = NULL;
+    free(ctx->recordKeyEnds);
+    ctx->recordKeyEnds = NULL;
+    ctx->recordKeyCount = 0;
+    ctx->status = status;
+    return status;
+}
+
+
+// ============================================================================
+// BONJSON to JSON: Output
+// ============================================================================
+
+// Writer state bits, one set per open container
+enum
+{
+    WRITER_OBJECT          = 0x01,
+    WRITER_EXPECTING_NAME  = 0x02,
+    WRITER_HAS_ELEMENTS    = 0x04,
+};
+
+static ksbonjson_decodeStatus flushJSON(KSBONJSONToJSONContext* const ctx)
+{
+    if (ctx->outputLength == 0)
+    {
+        return KSBONJSON_DECODE_OK;
+    }
+    unlikely_if(ctx->sink(ctx->output, ctx->outputLength, ctx->userData) != KSBONJSON_ENCODE_OK)
+    {
+        ctx->sinkFailed = true;
+        return KSBONJSON_DECODE_COULD_NOT_PROCESS_DATA;
+    }
+    ctx->outputLength = 0;
+    return KSBONJSON_DECODE_OK;
+}
+
+/**
+ * Make room for length bytes (at most a chunk) at the end of the output buffer.
+ */
+static inline ksbonjson_decodeStatus reserveJSON(KSBONJSONToJSONContext* const ctx, const size_t length)
+{
+    unlikely_if(ctx->outputLength + length > KSBONJSON_TRANSCODE_CHUNK_SIZE)
+    {
+        return flushJSON(ctx);
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus writeJSONBytes(KSBONJSONToJSONContext* const ctx, const uint8_t* bytes, size_t length)
+{
+    while (length > 0)
+    {
+        if (ctx->outputLength == KSBONJSON_TRANSCODE_CHUNK_SIZE)
+        {
+            PROPAGATE_ERROR(flushJSON(ctx));
+        }
+        size_t copyLength = KSBONJSON_TRANSCODE_CHUNK_SIZE - ctx->outputLength;
+        if (copyLength > length)
+        {
+            copyLength = length;
+        }
+        memcpy(ctx->output + ctx->outputLength, bytes, copyLength);
+        ctx->outputLength += copyLength;
+        bytes += copyLength;
+        length -= copyLength;
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+static inline void appendJSONByte(KSBONJSONToJSONContext* const ctx, const uint8_t byte)
+{
+    ctx->output[ctx->outputLength++] = byte;
+}
+
+/**
+ * Write whatever separates the next key or value from the one before it, and report
+ * whether it's an object key.
+ */
+static ksbonjson_decodeStatus beginJSONElement(KSBONJSONToJSONContext* const ctx, bool* const isName)
+{
+    PROPAGATE_ERROR(reserveJSON(ctx, 1));
+    *isName = false;
+    if (ctx->depth == 0)
+    {
+        if (ctx->hasRootValue)
+        {
+            appendJSONByte(ctx, '\n');
+        }
+        ctx->hasRootValue = true;
+        return KSBONJSON_DECODE_OK;
+    }
+
+    uint8_t* const state = &ctx->containers[ctx->depth];
+    if ((*state & WRITER_OBJECT) && !(*state & WRITER_EXPECTING_NAME))
+    {
+        // A value follows its key's ':'
+        *state |= WRITER_EXPECTING_NAME;
+        return KSBONJSON_DECODE_OK;
+    }
+    if (*state & WRITER_HAS_ELEMENTS)
+    {
+        appendJSONByte(ctx, ',');
+    }
+    *state |= WRITER_HAS_ELEMENTS;
+    if (*state & WRITER_OBJECT)
+    {
+        *state &= (uint8_t)~WRITER_EXPECTING_NAME;
+        *isName = true;
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus beginJSONValue(KSBONJSONToJSONContext* const ctx)
+{
+    bool isName;
+    PROPAGATE_ERROR(beginJSONElement(ctx, &isName));
+    // The decoder only reports strings as keys
+    unlikely_if(isName)
+    {
+        return KSBONJSON_DECODE_EXPECTED_OBJECT_NAME;
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+static const char digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * Write value in decimal to dst, which must have room for 20 bytes.
+ */
+static size_t formatUInt64(uint8_t* const dst, uint64_t value)
+{
+    uint8_t digits[20];
+    uint8_t* p = digits + sizeof(digits);
+    while (value >= 100)
+    {
+        const size_t pair = (size_t)(value % 100) * 2;
+        value /= 100;
+        *--p = (uint8_t)digitPairs[pair + 1];
+        *--p = (uint8_t)digitPairs[pair];
+    }
+    if (value >= 10)
+    {
+        const size_t pair = (size_t)value * 2;
+        *--p = (uint8_t)digitPairs[pair + 1];
+        *--p = (uint8_t)digitPairs[pair];
+    }
+    else
+    {
+        *--p = (uint8_t)('0' + value);
+    }
+    const size_t length = (size_t)(digits + sizeof(digits) - p);
+    memcpy(dst, p, length);
+    return length;
+}
+
+static size_t formatInt64(uint8_t* const dst, const int64_t value)
+{
+    if (value < 0)
+    {
+        dst[0] = '-';
+        return 1 + formatUInt64(dst + 1, (uint64_t)0 - (uint64_t)value);
+    }
+    return formatUInt64(dst, (uint64_t)value);
+}
+
+/**
+ * Write value to dst (which must have room for 32 bytes) with the fewest significant
+ * digits that read back as the same value.
+ *
+ * Any decimal of up to 15 digits reads back as the normal double nearest it, so for
+ * normal values %.15g (which drops trailing zeros) is already the shortest form when
+ * one that short exists. Subnormals have fewer bits of precision and may need fewer
+ * digits than that, so their search starts at 1.
+ */
+static size_t formatDouble(uint8_t* const dst, const double value)
+{
+    char text[32];
+    int length = 0;
+    const int minPrecision = fpclassify(value) == FP_SUBNORMAL ? 1 : 15;
+    for (int precision = minPrecision; precision <= 17; precision++)
+    {
+        length = snprintf(text, sizeof(text), "%.*g", precision, value);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+        if (precision == 17 || strtod(text, NULL) == value)
+#pragma GCC diagnostic pop
+        {
+            break;
+        }
+    }
+
+    // snprintf() writes the locale's decimal point
+    const char decimalPoint = *localeconv()->decimal_point;
+    for (int i = 0; i < length; i++)
+    {
+        dst[i] = text[i] == decimalPoint ? '.' : (uint8_t)text[i];
+    }
+    return (size_t)length;
+}
+
+static ksbonjson_decodeStatus writeJSONString(KSBONJSONToJSONContext* const ctx, const uint8_t* string, size_t length)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    PROPAGATE_ERROR(reserveJSON(ctx, 1));
+    appendJSONByte(ctx, '"');
+    for (;;)
+    {
+        const size_t plainLength = ksbonjson_simd_findJSONSpecial(string, length);
+        PROPAGATE_ERROR(writeJSONBytes(ctx, string, plainLength));
+        if (plainLength == length)
+        {
+            break;
+        }
+
+        PROPAGATE_ERROR(reserveJSON(ctx, 6));
+        const uint8_t ch = string[plainLength];
+        appendJSONByte(ctx, '\\');
+        switch (ch)
+        {
+            case '"':  appendJSONByte(ctx, '"');  break;
+            case '\\': appendJSONByte(ctx, '\\'); break;
+            case '\b': appendJSONByte(ctx, 'b');  break;
+            case '\f': appendJSONByte(ctx, 'f');  break;
+            case '\n': appendJSONByte(ctx, 'n');  break;
+            case '\r': appendJSONByte(ctx, 'r');  break;
+            case '\t': appendJSONByte(ctx, 't');  break;
+            default:
+                appendJSONByte(ctx, 'u');
+                appendJSONByte(ctx, '0');
+                appendJSONByte(ctx, '0');
+                appendJSONByte(ctx, (uint8_t)hexDigits[ch >> 4]);
+                appendJSONByte(ctx, (uint8_t)hexDigits[ch & 0x0F]);
+                break;
+        }
+        string += plainLength + 1;
+        length -= plainLength + 1;
+    }
+    PROPAGATE_ERROR(reserveJSON(ctx, 1));
+    appendJSONByte(ctx, '"');
+    return KSBONJSON_DECODE_OK;
+}
+
+
+// ============================================================================
+// BONJSON to JSON: Decoder Callbacks
+// ============================================================================
+
+static ksbonjson_decodeStatus onJSONBoolean(bool value, void* userData)
+{
+    KSBONJSONToJSONContext* const ctx = (KSBONJSONToJSONContext*)userData;
+    PROPAGATE_ERROR(beginJSONValue(ctx));
+    return value ? writeJSONBytes(ctx, (const uint8_t*)"true", 4) : writeJSONBytes(ctx, (const uint8_t*)"false", 5);
+}
+
+static ksbonjson_decodeStatus onJSONUnsignedInteger(uint64_t value, void* userData)
+{
+    KSBONJSONToJSONContext* const ctx = (KSBONJSONToJSONContext*)userData;
+    PROPAGATE_ERROR(beginJSONValue(ctx));
+    PROPAGATE_ERROR(reserveJSON(ctx, 20));
+    ctx->outputLength += formatUInt64(ctx->output + ctx->outputLength, value);
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onJSONSignedInteger(int64_t value, void* userData)
+{
+    KSBONJSONToJSONContext* const ctx = (KSBONJSONToJSONContext*)userData;
+    PROPAGATE_ERROR(beginJSONValue(ctx));
+    PROPAGATE_ERROR(reserveJSON(ctx, 21));
+    ctx->outputLength += formatInt64(ctx->output + ctx->outputLength, value);
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onJSONFloat(double value, void* userData)
+{
+    KSBONJSONToJSONContext* const ctx = (KSBONJSONToJSONContext*)userData;
+    // JSON has no way to write these
+    unlikely_if(isnan(value) || isinf(value))
+    {
+        return KSBONJSON_DECODE_INVALID_DATA;
+    }
+    PROPAGATE_ERROR(beginJSONValue(ctx));
+    PROPAGATE_ERROR(reserveJSON(ctx, 32));
+    ctx->outputLength += formatDouble(ctx->output + ctx->outputLength, value);
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onJSONBigNumber(KSBigNumber value, void* userData)
+{
+    KSBONJSONToJSONContext* const ctx = (KSBONJSONToJSONContext*)userData;
+    PROPAGATE_ERROR(beginJSONValue(ctx));
+    PROPAGATE_ERROR(reserveJSON(ctx, 40));
+    if (value.significandSign < 0)
+    {
+        appendJSONByte(ctx, '-');
+    }
+    ctx->outputLength += formatUInt64(ctx->output + ctx->outputLength, value.significand);
+    if (value.exponent != 0 && value.significand != 0)
+    {
+        appendJSONByte(ctx, 'e');
+        ctx->outputLength += formatInt64(ctx->output + ctx->outputLength, value.exponent);
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onJSONNull(void* userData)
+{
+    KSBONJSONToJSONContext* const ctx = (KSBONJSONToJSONContext*)userData;
+    PROPAGATE_ERROR(beginJSONValue(ctx));
+    return writeJSONBytes(ctx, (const uint8_t*)"null", 4);
+}
+
+static ksbonjson_decodeStatus onJSONString(const char* KSBONJSON_RESTRICT value,
+                                           size_t length,
+                                           void* KSBONJSON_RESTRICT userData)
+{
+    KSBONJSONToJSONContext* const ctx = (KSBONJSONToJSONContext*)userData;
+    const uint8_t* const string = (const uint8_t*)value;
+    // JSON text has to be UTF-8, whatever the decoder was told to accept
+    unlikely_if(ksbonjson_validateUTF8(string, length, false) != KSBONJSON_DECODE_OK)
+    {
+        return KSBONJSON_DECODE_INVALID_UTF8;
+    }
+    bool isName;
+    PROPAGATE_ERROR(beginJSONElement(ctx, &isName));
+    PROPAGATE_ERROR(writeJSONString(ctx, string, length));
+    if (isName)
+    {
+        PROPAGATE_ERROR(reserveJSON(ctx, 1));
+        appendJSONByte(ctx, ':');
+    }
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus beginJSONContainer(KSBONJSONToJSONContext* const ctx, const uint8_t opener, const uint8_t state)
+{
+    PROPAGATE_ERROR(beginJSONValue(ctx));
+    PROPAGATE_ERROR(reserveJSON(ctx, 1));
+    appendJSONByte(ctx, opener);
+    // The decoder enforces the depth limit
+    ctx->depth++;
+    ctx->containers[ctx->depth] = state;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onJSONBeginObject(void* userData)
+{
+    return beginJSONContainer((KSBONJSONToJSONContext*)userData, '{', WRITER_OBJECT | WRITER_EXPECTING_NAME);
+}
+
+static ksbonjson_decodeStatus onJSONBeginArray(void* userData)
+{
+    return beginJSONContainer((KSBONJSONToJSONContext*)userData, '[', 0);
+}
+
+static ksbonjson_decodeStatus onJSONEndContainer(void* userData)
+{
+    KSBONJSONToJSONContext* const ctx = (KSBONJSONToJSONContext*)userData;
+    PROPAGATE_ERROR(reserveJSON(ctx, 1));
+    appendJSONByte(ctx, (ctx->containers[ctx->depth] & WRITER_OBJECT) ? '}' : ']');
+    ctx->depth--;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onJSONEndData(void* userData)
+{
+    return flushJSON((KSBONJSONToJSONContext*)userData);
+}
+
+
+// ============================================================================
+// BONJSON to JSON: API
+// ============================================================================
+
+void ksbonjson_toJSON_begin(KSBONJSONToJSONContext* const ctx,
+                            const KSBONJSONAddEncodedDataFunc sink,
+                            void* const userData)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->callbacks = (KSBONJSONDecodeCallbacks){
+        .onBoolean = onJSONBoolean,
+        .onUnsignedInteger = onJSONUnsignedInteger,
+        .onSignedInteger = onJSONSignedInteger,
+        .onFloat = onJSONFloat,
+        .onBigNumber = onJSONBigNumber,
+        .onNull = onJSONNull,
+        .onString = onJSONString,
+        .onBeginObject = onJSONBeginObject,
+        .onBeginArray = onJSONBeginArray,
+        .onEndContainer = onJSONEndContainer,
+        .onEndData = onJSONEndData,
+    };
+    ctx->sink = sink;
+    ctx->userData = userData;
+    ctx->output = malloc(KSBONJSON_TRANSCODE_CHUNK_SIZE);
+    ksbonjson_decodeIncremental_begin(&ctx->decoder, &ctx->callbacks, ctx);
+    unlikely_if(ctx->output == NULL)
+    {
+        ctx->decoder.status = KSBONJSON_DECODE_OUT_OF_MEMORY;
+    }
+}
+
+ksbonjson_decodeStatus ksbonjson_toJSON_feed(KSBONJSONToJSONContext* const ctx,
+                                             const uint8_t* const chunk,
+                                             const size_t chunkLength)
+{
+    return ksbonjson_decodeIncremental_feed(&ctx->decoder, chunk, chunkLength);
+}
+
+ksbonjson_decodeStatus ksbonjson_toJSON_end(KSBONJSONToJSONContext* const ctx)
+{
+    ksbonjson_decodeStatus status = ksbonjson_decodeIncremental_end(&ctx->decoder);
+    if (status == KSBONJSON_DECODE_OK && !ctx->hasRootValue)
+    {
+        status = KSBONJSON_DECODE_INCOMPLETE;
+    }
+    free(ctx->output);
+    ctx->output = NULL;
+    ctx->outputLength = 0;
+    return status;
+}
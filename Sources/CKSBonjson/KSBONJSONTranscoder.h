@@ -0,0 +1,206 @@
+//
+//  KSBONJSONTranscoder.h
+//
+//  Copyright (c) 2024 Karl Stenerud. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// ABOUTME: Public API for streaming JSON to BONJSON and BONJSON to JSON conversion.
+// ABOUTME: Both directions take input in chunks and hand output to a sink in chunks.
+
+#ifndef KSBONJSONTranscoder_h
+#define KSBONJSONTranscoder_h
+
+#include "KSBONJSONEncoder.h"
+#include "KSBONJSONDecoder.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ============================================================================
+// Compile-time Configuration
+// ============================================================================
+
+// Output is collected into a buffer of this size and handed to the sink when it fills.
+// The JSON writer reserves up to 40 bytes at once (for a formatted number), so the
+// buffer must be at least 64 bytes.
+#ifndef KSBONJSON_TRANSCODE_CHUNK_SIZE
+#   define KSBONJSON_TRANSCODE_CHUNK_SIZE 65536
+#endif
+#if KSBONJSON_TRANSCODE_CHUNK_SIZE < 64
+#   error "KSBONJSON_TRANSCODE_CHUNK_SIZE must be at least 64"
+#endif
+// The most JSON that is buffered to find out whether an array can be written as a
+// typed array, or an object as a record instance
+#ifndef KSBONJSON_TRANSCODE_MAX_LOOKAHEAD
+#   define KSBONJSON_TRANSCODE_MAX_LOOKAHEAD 262144
+#endif
+
+
+// ============================================================================
+// JSON to BONJSON
+// ============================================================================
+
+// Numbers become integers if they are written without a fraction or exponent and fit
+// in 64 bits, big numbers if they are such integers that only fit once their trailing
+// zeros are taken off, and floats otherwise. Non-empty arrays of numbers become typed
+// arrays of the narrowest element type that holds them all exactly. When the first two
+// elements of the root array are objects with the same keys in the same order, those
+// keys become a record definition and every element with the same keys a record instance.
+//
+// The flags' limits and string checks are applied while converting. Duplicate object
+// keys are passed through (a decoder that rejects them will reject the output).
+//
+// Memory use is bounded by KSBONJSON_TRANSCODE_MAX_LOOKAHEAD and the longest string or
+// number in the input, however long the document is.
+
+typedef struct {
+    KSBONJSONBufferEncodeContext encoder;
+    KSBONJSONDecodeFlags flags;
+    ksbonjson_decodeStatus status;  // First failure; later calls return it again
+    bool useTypedArrays;
+    bool useRecords;
+    size_t maxLookahead;
+
+    // Input not yet converted: the start of a token cut off by the end of a chunk, or
+    // a container that has to be seen whole to choose how to write it
+    uint8_t* pending;
+    size_t pendingLength;
+    size_t pendingCapacity;
+    size_t inputLength;             // Document bytes fed so far
+    size_t decodedOffset;           // Document bytes fully converted so far
+
+    // Parser state: the open containers, indexed by depth (0 is the top level)
+    int depth;
+    uint8_t phase;
+    uint8_t containerKinds[KSBONJSON_MAX_CONTAINER_DEPTH + 1];
+    size_t containerSizes[KSBONJSON_MAX_CONTAINER_DEPTH + 1];
+    bool hasRootValue;
+    bool rootArrayHasRecords;
+
+    // The keys of the record definition, if one was written, and the next key
+    // expected in the record instance being converted
+    uint8_t* recordKeyBytes;
+    size_t recordKeyBytesLength;
+    size_t recordKeyBytesCapacity;
+    size_t* recordKeyEnds;
+    size_t recordKeyCount;
+    size_t recordKeyCapacity;
+    size_t recordField;
+
+    // Scratch space for unescaped strings and typed array elements
+    uint8_t* scratch;
+    size_t scratchCapacity;
+} KSBONJSONFromJSONContext;
+
+/**
+ * Begin converting a JSON document, whose BONJSON encoding will be handed to sink in
+ * chunks of about KSBONJSON_TRANSCODE_CHUNK_SIZE bytes. A sink failure stops the
+ * conversion with KSBONJSON_DECODE_COULD_NOT_PROCESS_DATA.
+ */
+KSBONJSON_PUBLIC void ksbonjson_fromJSON_begin(
+    KSBONJSONFromJSONContext* ctx,
+    KSBONJSONDecodeFlags flags,
+    KSBONJSONAddEncodedDataFunc sink,
+    void* userData);
+
+/**
+ * Choose whether arrays of numbers may become typed arrays, and whether root arrays of
+ * same-shaped objects may become record instances (both are on by default).
+ * Must be called before the first feed.
+ */
+KSBONJSON_PUBLIC void ksbonjson_fromJSON_setUseTypedArrays(KSBONJSONFromJSONContext* ctx, bool useTypedArrays);
+KSBONJSON_PUBLIC void ksbonjson_fromJSON_setUseRecords(KSBONJSONFromJSONContext* ctx, bool useRecords);
+
+/**
+ * Convert the next chunk of the document. The chunk need not outlive the call.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_fromJSON_feed(
+    KSBONJSONFromJSONContext* ctx,
+    const uint8_t* chunk,
+    size_t chunkLength);
+
+/**
+ * Finish the document, hand the rest of the output to the sink, and release the
+ * context's buffers. Must be called even if an earlier feed failed.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_fromJSON_end(KSBONJSONFromJSONContext* ctx);
+
+
+// ============================================================================
+// BONJSON to JSON
+// ============================================================================
+
+// The JSON is compact (no whitespace). Floats are written with the fewest digits that
+// read back as the same value, big numbers as <significand>e<exponent>, typed arrays
+// as arrays and record instances as objects. A sequence of top-level values is written
+// one per line.
+
+typedef struct {
+    KSBONJSONIncrementalDecodeContext decoder;
+    KSBONJSONDecodeCallbacks callbacks;
+    KSBONJSONAddEncodedDataFunc sink;
+    void* userData;
+    bool sinkFailed;
+
+    uint8_t* output;
+    size_t outputLength;
+
+    // Writer state, indexed by depth (0 is the top level)
+    int depth;
+    uint8_t containers[KSBONJSON_MAX_CONTAINER_DEPTH + 1];
+    bool hasRootValue;
+} KSBONJSONToJSONContext;
+
+/**
+ * Begin converting a BONJSON document, whose JSON encoding will be handed to sink in
+ * chunks of up to KSBONJSON_TRANSCODE_CHUNK_SIZE bytes. A sink failure stops the
+ * conversion with KSBONJSON_DECODE_COULD_NOT_PROCESS_DATA.
+ *
+ * The context must not move until ksbonjson_toJSON_end() is called.
+ */
+KSBONJSON_PUBLIC void ksbonjson_toJSON_begin(
+    KSBONJSONToJSONContext* ctx,
+    KSBONJSONAddEncodedDataFunc sink,
+    void* userData);
+
+/**
+ * Convert the next chunk of the document. The chunk need not outlive the call.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_toJSON_feed(
+    KSBONJSONToJSONContext* ctx,
+    const uint8_t* chunk,
+    size_t chunkLength);
+
+/**
+ * Finish the document, hand the rest of the output to the sink, and release the
+ * context's buffers. Must be called even if an earlier feed failed.
+ */
+KSBONJSON_PUBLIC ksbonjson_decodeStatus ksbonjson_toJSON_end(KSBONJSONToJSONContext* ctx);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // KSBONJSONTranscoder_h
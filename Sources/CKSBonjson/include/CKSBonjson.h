@@ -1,10 +1,11 @@
 // ABOUTME: Umbrella header for CKSBonjson C library.
-// ABOUTME: Exposes the BONJSON encoder and decoder C APIs to Swift.
+// ABOUTME: Exposes the BONJSON encoder, decoder and transcoder C APIs to Swift.
 
 #ifndef CKSBonjson_h
 #define CKSBonjson_h
 
 #include "../KSBONJSONEncoder.h"
 #include "../KSBONJSONDecoder.h"
+#include "../KSBONJSONTranscoder.h"
 
 #endif /* CKSBonjson_h */
@@ -0,0 +1,12 @@
+// ABOUTME: Allocation counter shared by the C benchmarks and the counted decoder build.
+// ABOUTME: Every malloc()/realloc() the decoder makes increments benchAllocationCount.
+
+#ifndef BenchAlloc_h
+#define BenchAlloc_h
+
+#include <stddef.h>
+
+// Heap allocation calls made by the decoder since the counter was last reset
+extern size_t benchAllocationCount;
+
+#endif /* BenchAlloc_h */
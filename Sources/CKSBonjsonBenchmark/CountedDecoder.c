@@ -0,0 +1,25 @@
+// ABOUTME: Compiles the decoder with its heap calls routed through counting wrappers.
+// ABOUTME: Lets the benchmarks report allocations per operation without platform malloc hooks.
+
+#include <stdlib.h>
+#include "BenchAlloc.h"
+
+size_t benchAllocationCount = 0;
+
+static void* countedMalloc(size_t size)
+{
+    benchAllocationCount++;
+    return malloc(size);
+}
+
+static void* countedRealloc(void* pointer, size_t size)
+{
+    benchAllocationCount++;
+    return realloc(pointer, size);
+}
+
+// <stdlib.h> is already included, so these only affect the decoder's own calls
+#define malloc(SIZE) countedMalloc(SIZE)
+#define realloc(POINTER, SIZE) countedRealloc(POINTER, SIZE)
+
+#include "../CKSBonjson/KSBONJSONDecoder.c"
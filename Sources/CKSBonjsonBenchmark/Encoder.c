@@ -0,0 +1,4 @@
+// ABOUTME: Compiles the encoder into the benchmark executable.
+// ABOUTME: The benchmark builds the C sources itself so that the decoder can be instrumented.
+
+#include "../CKSBonjson/KSBONJSONEncoder.c"
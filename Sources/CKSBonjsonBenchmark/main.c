@@ -0,0 +1,820 @@
+// ABOUTME: Microbenchmarks that drive the CKSBonjson C API directly, without Swift overhead.
+// ABOUTME: Prints one tab-separated row per benchmark; scripts/benchmark.sh compares runs to a baseline.
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#   define _POSIX_C_SOURCE 199309L // For clock_gettime()
+#endif
+
+#include "../CKSBonjson/KSBONJSONEncoder.h"
+#include "../CKSBonjson/KSBONJSONDecoder.h"
+#include "../CKSBonjson/KSBONJSONSimd.h"
+#include "BenchAlloc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Bump whenever a corpus generator changes, so that results from different
+// corpora are never compared against each other.
+#define CORPUS_VERSION 1
+
+#define RECORD_ROWS 1000
+#define TELEMETRY_SAMPLES 4096
+#define CJK_STRING_COUNT 512
+#define NESTING_DEPTH 256
+#define KERNEL_BUFFER_SIZE 65536
+
+
+// ============================================================================
+// Utility
+// ============================================================================
+
+static uint64_t nowNanoseconds(void)
+{
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Deterministic xorshift generator so that every run sees the same corpus
+static uint64_t randomState;
+
+static void seedRandom(uint64_t seed)
+{
+    randomState = seed;
+}
+
+static uint64_t nextRandom(void)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return randomState;
+}
+
+static size_t appendUTF8(char* dst, uint32_t codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        dst[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800)
+    {
+        dst[0] = (char)(0xC0 | (codepoint >> 6));
+        dst[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000)
+    {
+        dst[0] = (char)(0xE0 | (codepoint >> 12));
+        dst[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        dst[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    dst[0] = (char)(0xF0 | (codepoint >> 18));
+    dst[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+    dst[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    dst[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+// Mostly CJK ideographs and kana, with some ASCII, Cyrillic and emoji mixed in
+static size_t appendCJKText(char* dst, size_t characterCount)
+{
+    size_t length = 0;
+    for (size_t i = 0; i < characterCount; i++)
+    {
+        uint64_t r = nextRandom() % 100;
+        uint32_t codepoint;
+        if (r < 60)      codepoint = 0x4E00 + (uint32_t)(nextRandom() % 0x5200);
+        else if (r < 80) codepoint = 0x3041 + (uint32_t)(nextRandom() % 0x56);
+        else if (r < 92) codepoint = 0x20 + (uint32_t)(nextRandom() % 0x5F);
+        else if (r < 97) codepoint = 0x0410 + (uint32_t)(nextRandom() % 0x40);
+        else            codepoint = 0x1F600 + (uint32_t)(nextRandom() % 0x50);
+        length += appendUTF8(dst + length, codepoint);
+    }
+    return length;
+}
+
+#define KEY(CTX, LITERAL) ksbonjson_encodeToBuffer_string(CTX, LITERAL, sizeof(LITERAL) - 1)
+
+// Stop encoding a corpus at the first failure
+#define ENCODE(CALL) \
+    do \
+    { \
+        ssize_t encodeResult = CALL; \
+        if (encodeResult < 0) return (ksbonjson_encodeStatus)-encodeResult; \
+    } \
+    while (0)
+
+
+// ============================================================================
+// Corpus
+// ============================================================================
+
+// Each generator encodes its document from pre-built inputs, so that the
+// encode benchmarks time only the encoder.
+
+// --- rpc_small: one small request message ---
+
+static ksbonjson_encodeStatus encodeRPCSmall(KSBONJSONBufferEncodeContext* ctx)
+{
+    static const char* const fields[] = {"name", "price", "stock"};
+    static const size_t fieldLengths[] = {4, 5, 5};
+
+    ENCODE(ksbonjson_encodeToBuffer_beginObject(ctx));
+    ENCODE(KEY(ctx, "jsonrpc"));
+    ENCODE(KEY(ctx, "2.0"));
+    ENCODE(KEY(ctx, "id"));
+    ENCODE(ksbonjson_encodeToBuffer_int(ctx, 48213));
+    ENCODE(KEY(ctx, "method"));
+    ENCODE(KEY(ctx, "inventory.lookup"));
+    ENCODE(KEY(ctx, "params"));
+    ENCODE(ksbonjson_encodeToBuffer_beginObject(ctx));
+    ENCODE(KEY(ctx, "sku"));
+    ENCODE(KEY(ctx, "AB-1234-XY"));
+    ENCODE(KEY(ctx, "warehouse"));
+    ENCODE(ksbonjson_encodeToBuffer_int(ctx, 7));
+    ENCODE(KEY(ctx, "maxPrice"));
+    ENCODE(ksbonjson_encodeToBuffer_float(ctx, 199.95));
+    ENCODE(KEY(ctx, "includeReserved"));
+    ENCODE(ksbonjson_encodeToBuffer_bool(ctx, false));
+    ENCODE(KEY(ctx, "cursor"));
+    ENCODE(ksbonjson_encodeToBuffer_null(ctx));
+    ENCODE(KEY(ctx, "fields"));
+    ENCODE(ksbonjson_encodeToBuffer_stringArray(ctx, fields, fieldLengths, 3));
+    ENCODE(ksbonjson_encodeToBuffer_endContainer(ctx));
+    ENCODE(ksbonjson_encodeToBuffer_endContainer(ctx));
+    return KSBONJSON_ENCODE_OK;
+}
+
+// --- records: an array of user rows as record instances ---
+
+typedef struct
+{
+    int64_t id;
+    char name[16];
+    size_t nameLength;
+    char email[40];
+    size_t emailLength;
+    int64_t age;
+    double score;
+    bool active;
+} UserRow;
+
+static UserRow userRows[RECORD_ROWS];
+
+static void buildRecords(void)
+{
+    seedRandom(0x5EED0001);
+    for (size_t i = 0; i < RECORD_ROWS; i++)
+    {
+        UserRow* row = &userRows[i];
+        row->id = (int64_t)(100000 + i * 7);
+        row->nameLength = (size_t)snprintf(row->name, sizeof(row->name), "user%zu", i);
+        row->emailLength = (size_t)snprintf(row->email, sizeof(row->email), "user%zu@example.com", i);
+        row->age = 18 + (int64_t)(nextRandom() % 60);
+        row->score = (double)(nextRandom() % 100000) / 100.0;
+        row->active = (nextRandom() & 1) != 0;
+    }
+}
+
+static ksbonjson_encodeStatus encodeRecords(KSBONJSONBufferEncodeContext* ctx)
+{
+    ENCODE(ksbonjson_encodeToBuffer_beginRecordDef(ctx));
+    ENCODE(KEY(ctx, "id"));
+    ENCODE(KEY(ctx, "name"));
+    ENCODE(KEY(ctx, "email"));
+    ENCODE(KEY(ctx, "age"));
+    ENCODE(KEY(ctx, "score"));
+    ENCODE(KEY(ctx, "active"));
+    ENCODE(ksbonjson_encodeToBuffer_endRecordDef(ctx));
+
+    ENCODE(ksbonjson_encodeToBuffer_beginArray(ctx));
+    for (size_t i = 0; i < RECORD_ROWS; i++)
+    {
+        const UserRow* row = &userRows[i];
+        ENCODE(ksbonjson_encodeToBuffer_beginRecordInstance(ctx, 0));
+        ENCODE(ksbonjson_encodeToBuffer_int(ctx, row->id));
+        ENCODE(ksbonjson_encodeToBuffer_string(ctx, row->name, row->nameLength));
+        ENCODE(ksbonjson_encodeToBuffer_string(ctx, row->email, row->emailLength));
+        ENCODE(ksbonjson_encodeToBuffer_int(ctx, row->age));
+        ENCODE(ksbonjson_encodeToBuffer_float(ctx, row->score));
+        ENCODE(ksbonjson_encodeToBuffer_bool(ctx, row->active));
+        ENCODE(ksbonjson_encodeToBuffer_endContainer(ctx));
+    }
+    ENCODE(ksbonjson_encodeToBuffer_endContainer(ctx));
+    return KSBONJSON_ENCODE_OK;
+}
+
+// --- telemetry: typed arrays of sensor samples ---
+
+static int64_t telemetryTimestamps[TELEMETRY_SAMPLES];
+static double telemetryTemperatures[TELEMETRY_SAMPLES];
+static float telemetryAcceleration[TELEMETRY_SAMPLES * 3];
+static uint8_t telemetryLevels[TELEMETRY_SAMPLES];
+
+static void buildTelemetry(void)
+{
+    seedRandom(0x5EED0002);
+    int64_t timestamp = 1700000000000;
+    for (size_t i = 0; i < TELEMETRY_SAMPLES; i++)
+    {
+        timestamp += 250 + (int64_t)(nextRandom() % 5);
+        telemetryTimestamps[i] = timestamp;
+        telemetryTemperatures[i] = 21.0 + (double)(nextRandom() % 2000) / 1000.0;
+        telemetryLevels[i] = (uint8_t)(nextRandom() % 101);
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            telemetryAcceleration[i * 3 + axis] = (float)((double)(nextRandom() % 20000) / 10000.0 - 1.0);
+        }
+    }
+}
+
+static ksbonjson_encodeStatus encodeTelemetry(KSBONJSONBufferEncodeContext* ctx)
+{
+    ENCODE(ksbonjson_encodeToBuffer_beginObject(ctx));
+    ENCODE(KEY(ctx, "device"));
+    ENCODE(KEY(ctx, "sensor-17"));
+    ENCODE(KEY(ctx, "timestamps"));
+    ENCODE(ksbonjson_encodeToBuffer_int64Array(ctx, telemetryTimestamps, TELEMETRY_SAMPLES));
+    ENCODE(KEY(ctx, "temperatures"));
+    ENCODE(ksbonjson_encodeToBuffer_doubleArray(ctx, telemetryTemperatures, TELEMETRY_SAMPLES));
+    ENCODE(KEY(ctx, "acceleration"));
+    ENCODE(ksbonjson_encodeToBuffer_float32Array(ctx, telemetryAcceleration, TELEMETRY_SAMPLES * 3));
+    ENCODE(KEY(ctx, "levels"));
+    ENCODE(ksbonjson_encodeToBuffer_uint8Array(ctx, telemetryLevels, TELEMETRY_SAMPLES));
+    ENCODE(ksbonjson_encodeToBuffer_endContainer(ctx));
+    return KSBONJSON_ENCODE_OK;
+}
+
+// --- cjk_strings: an array of short and long CJK-heavy strings ---
+
+static char* cjkPool;
+static size_t cjkOffsets[CJK_STRING_COUNT];
+static size_t cjkLengths[CJK_STRING_COUNT];
+
+static void buildCJKStrings(void)
+{
+    seedRandom(0x5EED0003);
+    // At most 200 characters of at most 4 bytes each
+    cjkPool = malloc(CJK_STRING_COUNT * 800);
+    size_t offset = 0;
+    for (size_t i = 0; i < CJK_STRING_COUNT; i++)
+    {
+        // A quarter fit in a short string; the rest need a long string
+        size_t characters = (i % 4 == 0) ? 4 + (size_t)(nextRandom() % 16) : 24 + (size_t)(nextRandom() % 176);
+        cjkOffsets[i] = offset;
+        cjkLengths[i] = appendCJKText(cjkPool + offset, characters);
+        offset += cjkLengths[i];
+    }
+}
+
+static ksbonjson_encodeStatus encodeCJKStrings(KSBONJSONBufferEncodeContext* ctx)
+{
+    ENCODE(ksbonjson_encodeToBuffer_beginArray(ctx));
+    for (size_t i = 0; i < CJK_STRING_COUNT; i++)
+    {
+        ENCODE(ksbonjson_encodeToBuffer_string(ctx, cjkPool + cjkOffsets[i], cjkLengths[i]));
+    }
+    ENCODE(ksbonjson_encodeToBuffer_endContainer(ctx));
+    return KSBONJSON_ENCODE_OK;
+}
+
+// --- deep_nesting: alternating objects and arrays, NESTING_DEPTH levels deep ---
+
+static ksbonjson_encodeStatus encodeDeepNesting(KSBONJSONBufferEncodeContext* ctx)
+{
+    for (int level = 0; level < NESTING_DEPTH; level++)
+    {
+        if (level % 2 == 0)
+        {
+            ENCODE(ksbonjson_encodeToBuffer_beginObject(ctx));
+            ENCODE(KEY(ctx, "level"));
+            ENCODE(ksbonjson_encodeToBuffer_int(ctx, level));
+            ENCODE(KEY(ctx, "name"));
+            ENCODE(KEY(ctx, "node"));
+            ENCODE(KEY(ctx, "child"));
+        }
+        else
+        {
+            ENCODE(ksbonjson_encodeToBuffer_beginArray(ctx));
+            ENCODE(ksbonjson_encodeToBuffer_int(ctx, level));
+            ENCODE(ksbonjson_encodeToBuffer_bool(ctx, true));
+        }
+    }
+    ENCODE(ksbonjson_encodeToBuffer_null(ctx));
+    ENCODE(ksbonjson_encodeToBuffer_endAllContainers(ctx));
+    return KSBONJSON_ENCODE_OK;
+}
+
+typedef struct
+{
+    const char* name;
+    ksbonjson_encodeStatus (*encode)(KSBONJSONBufferEncodeContext* ctx);
+    size_t capacity;
+
+    // Filled in by prepareCorpus()
+    uint8_t* document;
+    size_t length;
+    size_t valueCount; // Every scalar, key and container, counting typed array elements singly
+} Corpus;
+
+static Corpus corpora[] =
+{
+    {"rpc_small",    encodeRPCSmall,    256,                         NULL, 0, 0},
+    {"records",      encodeRecords,     RECORD_ROWS * 96,            NULL, 0, 0},
+    {"telemetry",    encodeTelemetry,   TELEMETRY_SAMPLES * 32,      NULL, 0, 0},
+    {"cjk_strings",  encodeCJKStrings,  CJK_STRING_COUNT * 810,      NULL, 0, 0},
+    {"deep_nesting", encodeDeepNesting, NESTING_DEPTH * 32,          NULL, 0, 0},
+};
+
+#define CORPUS_COUNT (sizeof(corpora) / sizeof(*corpora))
+
+static KSBONJSONEncodeFlags benchmarkEncodeFlags(void)
+{
+    KSBONJSONEncodeFlags flags = ksbonjson_defaultEncodeFlags();
+    flags.maxDepth = SIZE_MAX;
+    flags.maxStringLength = SIZE_MAX;
+    flags.maxContainerSize = SIZE_MAX;
+    flags.maxDocumentSize = SIZE_MAX;
+    return flags;
+}
+
+static ksbonjson_encodeStatus encodeCorpus(const Corpus* corpus, uint8_t* buffer, size_t* outLength)
+{
+    KSBONJSONBufferEncodeContext ctx;
+    ksbonjson_encodeToBuffer_beginWithFlags(&ctx, buffer, corpus->capacity, benchmarkEncodeFlags());
+    ksbonjson_encodeStatus status = corpus->encode(&ctx);
+    if (status != KSBONJSON_ENCODE_OK)
+    {
+        return status;
+    }
+    ssize_t length = ksbonjson_encodeToBuffer_end(&ctx);
+    if (length < 0)
+    {
+        return (ksbonjson_encodeStatus)-length;
+    }
+    *outLength = (size_t)length;
+    return KSBONJSON_ENCODE_OK;
+}
+
+static bool prepareCorpus(Corpus* corpus)
+{
+    corpus->document = malloc(corpus->capacity);
+    ksbonjson_encodeStatus status = encodeCorpus(corpus, corpus->document, &corpus->length);
+    if (status != KSBONJSON_ENCODE_OK)
+    {
+        fprintf(stderr, "Could not encode corpus %s: status %d\n", corpus->name, (int)status);
+        return false;
+    }
+
+    KSBONJSONMapContext ctx;
+    ksbonjson_map_beginGrowable(&ctx, corpus->document, corpus->length, ksbonjson_defaultDecodeFlags());
+    ksbonjson_map_setCompactRecords(&ctx, false);
+    ksbonjson_decodeStatus scanStatus = ksbonjson_map_scan(&ctx);
+    corpus->valueCount = 0;
+    for (size_t i = 0; i < ksbonjson_map_count(&ctx); i++)
+    {
+        const KSBONJSONMapEntry* entry = ksbonjson_map_get(&ctx, i);
+        corpus->valueCount += entry->type == KSBONJSON_TYPE_TYPED_ARRAY ? entry->data.typedArray.count : 1;
+    }
+    ksbonjson_map_freeEntries(&ctx);
+    if (scanStatus != KSBONJSON_DECODE_OK)
+    {
+        fprintf(stderr, "Could not scan corpus %s: status %d\n", corpus->name, (int)scanStatus);
+        return false;
+    }
+    return true;
+}
+
+// Buffers for the SIMD kernels: plain ASCII text, and CJK-heavy UTF-8
+static uint8_t asciiText[KERNEL_BUFFER_SIZE];
+static uint8_t cjkText[KERNEL_BUFFER_SIZE];
+
+static void buildKernelBuffers(void)
+{
+    static const char sentence[] = "The quick brown fox jumps over the lazy dog. ";
+    for (size_t i = 0; i < KERNEL_BUFFER_SIZE; i++)
+    {
+        asciiText[i] = (uint8_t)sentence[i % (sizeof(sentence) - 1)];
+    }
+
+    seedRandom(0x5EED0004);
+    char character[4];
+    size_t length = 0;
+    while (length < KERNEL_BUFFER_SIZE)
+    {
+        size_t characterLength = appendCJKText(character, 1);
+        if (length + characterLength > KERNEL_BUFFER_SIZE)
+        {
+            break;
+        }
+        memcpy(cjkText + length, character, characterLength);
+        length += characterLength;
+    }
+    // Pad with spaces so the whole buffer stays valid UTF-8
+    memset(cjkText + length, ' ', KERNEL_BUFFER_SIZE - length);
+}
+
+
+// ============================================================================
+// Benchmarks
+// ============================================================================
+
+// Runs one operation; returns false if the operation failed
+typedef bool (*BenchmarkFunc)(const Corpus* corpus);
+
+static uint64_t targetNanoseconds = 200000000;
+static int roundCount = 5;
+static const char* filter = NULL;
+static volatile uint64_t sink;
+
+static uint8_t* encodeBuffer;
+
+static bool benchEncode(const Corpus* corpus)
+{
+    size_t length = 0;
+    bool success = encodeCorpus(corpus, encodeBuffer, &length) == KSBONJSON_ENCODE_OK;
+    sink += length;
+    return success;
+}
+
+static bool scanCorpus(const Corpus* corpus, bool isLazy)
+{
+    KSBONJSONMapContext ctx;
+    ksbonjson_map_beginGrowable(&ctx, corpus->document, corpus->length, ksbonjson_defaultDecodeFlags());
+    ksbonjson_map_setLazy(&ctx, isLazy);
+    ksbonjson_decodeStatus status = ksbonjson_map_scan(&ctx);
+    sink += ksbonjson_map_count(&ctx);
+    ksbonjson_map_freeEntries(&ctx);
+    return status == KSBONJSON_DECODE_OK;
+}
+
+static bool benchMapScan(const Corpus* corpus)
+{
+    return scanCorpus(corpus, false);
+}
+
+static bool benchMapScanLazy(const Corpus* corpus)
+{
+    return scanCorpus(corpus, true);
+}
+
+static KSBONJSONMapContext reusedMap;
+static bool reusedMapStarted = false;
+
+static bool benchMapScanReused(const Corpus* corpus)
+{
+    if (!reusedMapStarted)
+    {
+        ksbonjson_map_beginGrowable(&reusedMap, corpus->document, corpus->length, ksbonjson_defaultDecodeFlags());
+        reusedMapStarted = true;
+    }
+    else
+    {
+        ksbonjson_map_resetGrowable(&reusedMap, corpus->document, corpus->length, ksbonjson_defaultDecodeFlags());
+    }
+    ksbonjson_decodeStatus status = ksbonjson_map_scan(&reusedMap);
+    sink += ksbonjson_map_count(&reusedMap);
+    return status == KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onBoolean(bool value, void* userData)
+{
+    *(uint64_t*)userData += value;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onUnsignedInteger(uint64_t value, void* userData)
+{
+    *(uint64_t*)userData += value;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onSignedInteger(int64_t value, void* userData)
+{
+    *(uint64_t*)userData += (uint64_t)value;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onFloat(double value, void* userData)
+{
+    *(uint64_t*)userData += (uint64_t)(int64_t)value;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onBigNumber(KSBigNumber value, void* userData)
+{
+    *(uint64_t*)userData += value.significand;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onString(const char* KSBONJSON_RESTRICT value,
+                                       size_t length,
+                                       void* KSBONJSON_RESTRICT userData)
+{
+    (void)value;
+    *(uint64_t*)userData += length;
+    return KSBONJSON_DECODE_OK;
+}
+
+static ksbonjson_decodeStatus onEvent(void* userData)
+{
+    *(uint64_t*)userData += 1;
+    return KSBONJSON_DECODE_OK;
+}
+
+static const KSBONJSONDecodeCallbacks countingCallbacks =
+{
+    .onBoolean = onBoolean,
+    .onUnsignedInteger = onUnsignedInteger,
+    .onSignedInteger = onSignedInteger,
+    .onFloat = onFloat,
+    .onBigNumber = onBigNumber,
+    .onNull = onEvent,
+    .onString = onString,
+    .onBeginObject = onEvent,
+    .onBeginArray = onEvent,
+    .onEndContainer = onEvent,
+    .onEndData = onEvent,
+};
+
+static bool benchDecodeCallbacks(const Corpus* corpus)
+{
+    uint64_t total = 0;
+    size_t decodedOffset = 0;
+    ksbonjson_decodeStatus status = ksbonjson_decode(corpus->document, corpus->length,
+                                                     &countingCallbacks, &total, &decodedOffset);
+    sink += total;
+    return status == KSBONJSON_DECODE_OK;
+}
+
+// The SIMD kernels ignore the corpus and run over a kernel buffer instead.
+// asciiText contains no 0xFF, so findByte scans the whole buffer.
+
+static bool benchFindByte(const Corpus* corpus)
+{
+    (void)corpus;
+    sink += ksbonjson_simd_findByte(asciiText, KERNEL_BUFFER_SIZE, 0xFF);
+    return true;
+}
+
+static bool benchContainsByte(const Corpus* corpus)
+{
+    (void)corpus;
+    sink += ksbonjson_simd_containsByte(asciiText, KERNEL_BUFFER_SIZE, 0);
+    return true;
+}
+
+static bool benchIsAllAscii(const Corpus* corpus)
+{
+    (void)corpus;
+    return ksbonjson_simd_isAllAscii(asciiText, KERNEL_BUFFER_SIZE);
+}
+
+static bool benchIsValidUTF8ASCII(const Corpus* corpus)
+{
+    (void)corpus;
+    return ksbonjson_simd_isValidUTF8(asciiText, KERNEL_BUFFER_SIZE, true);
+}
+
+static bool benchIsValidUTF8CJK(const Corpus* corpus)
+{
+    (void)corpus;
+    return ksbonjson_simd_isValidUTF8(cjkText, KERNEL_BUFFER_SIZE, true);
+}
+
+static uint64_t timeIterations(BenchmarkFunc func, const Corpus* corpus, uint64_t iterations)
+{
+    uint64_t start = nowNanoseconds();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        func(corpus);
+    }
+    return nowNanoseconds() - start;
+}
+
+/**
+ * Time a benchmark and print its row.
+ *
+ * The iteration count is calibrated so that each round takes about
+ * targetNanoseconds / roundCount, and the fastest round is reported.
+ *
+ * @param bytes The bytes processed per operation.
+ * @param values The values processed per operation (bytes for the SIMD kernels).
+ * @return The decoder allocations per operation in the timed rounds (0 if not run).
+ */
+static double runBenchmark(const char* name, const char* corpusName, BenchmarkFunc func,
+                         const Corpus* corpus, size_t bytes, size_t values)
+{
+    if (filter != NULL && strstr(name, filter) == NULL && strstr(corpusName, filter) == NULL)
+    {
+        return 0;
+    }
+
+    if (!func(corpus))
+    {
+        printf("# %s\t%s\tskipped: the operation fails on this corpus\n", name, corpusName);
+        return 0;
+    }
+
+    uint64_t roundNanoseconds = targetNanoseconds / (uint64_t)roundCount;
+    uint64_t iterations = 1;
+    uint64_t elapsed = timeIterations(func, corpus, iterations);
+    while (elapsed < roundNanoseconds / 10)
+    {
+        iterations *= 2;
+        elapsed = timeIterations(func, corpus, iterations);
+    }
+    if (elapsed < roundNanoseconds)
+    {
+        iterations = iterations * roundNanoseconds / (elapsed > 0 ? elapsed : 1);
+    }
+
+    double bestNanosecondsPerOp = 0;
+    size_t allocationsBefore = benchAllocationCount;
+    for (int round = 0; round < roundCount; round++)
+    {
+        double nanosecondsPerOp = (double)timeIterations(func, corpus, iterations) / (double)iterations;
+        if (round == 0 || nanosecondsPerOp < bestNanosecondsPerOp)
+        {
+            bestNanosecondsPerOp = nanosecondsPerOp;
+        }
+    }
+    double allocationsPerOp = (double)(benchAllocationCount - allocationsBefore) /
+                              ((double)iterations * (double)roundCount);
+    if (bestNanosecondsPerOp <= 0)
+    {
+        bestNanosecondsPerOp = 1.0 / (double)iterations;
+    }
+
+    printf("%s\t%s\t%zu\t%zu\t%llu\t%.1f\t%.0f\t%.3f\t%.2f\n",
+           name,
+           corpusName,
+           bytes,
+           values,
+           (unsigned long long)iterations,
+           bestNanosecondsPerOp,
+           (double)bytes * 1e9 / bestNanosecondsPerOp,
+           bestNanosecondsPerOp / (double)(values > 0 ? values : 1),
+           allocationsPerOp);
+    fflush(stdout);
+    return allocationsPerOp;
+}
+
+typedef struct
+{
+    const char* name;
+    BenchmarkFunc func;
+    bool mustNotAllocate; // The run fails if a timed operation allocates
+} CorpusBenchmark;
+
+static const CorpusBenchmark corpusBenchmarks[] =
+{
+    {"encode", benchEncode, false},
+    {"map_scan", benchMapScan, false},
+    {"map_scan_lazy", benchMapScanLazy, false},
+    // A reset context keeps every table it grew, so once warmed up it never allocates
+    {"map_scan_reused", benchMapScanReused, true},
+    {"decode_callbacks", benchDecodeCallbacks, false},
+};
+
+static const char* simdLevelName(void)
+{
+#if KSBONJSON_SIMD_NEON
+    return "neon";
+#elif KSBONJSON_SIMD_X86_DISPATCH
+    switch (ksbonjson_simd_x86Level())
+    {
+        case KSBONJSON_SIMD_LEVEL_AVX512: return "avx512";
+        case KSBONJSON_SIMD_LEVEL_AVX2: return "avx2";
+        case KSBONJSON_SIMD_LEVEL_SSSE3: return "ssse3";
+        default: return "sse2";
+    }
+#elif KSBONJSON_SIMD_SSSE3
+    return "ssse3";
+#elif KSBONJSON_SIMD_SSE2
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+static void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [--filter TEXT] [--time-ms N] [--rounds N] [--list]\n"
+            "  --filter TEXT  Only run benchmarks whose name or corpus contains TEXT\n"
+            "  --time-ms N    Approximate time spent timing each benchmark (default 200)\n"
+            "  --rounds N     Timed rounds per benchmark; the fastest is reported (default 5)\n"
+            "  --list         Print the corpus documents and their sizes, then exit\n",
+            program);
+}
+
+int main(int argc, char** argv)
+{
+    bool listOnly = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--time-ms") == 0 && i + 1 < argc)
+        {
+            targetNanoseconds = strtoull(argv[++i], NULL, 10) * 1000000u;
+        }
+        else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+        {
+            roundCount = atoi(argv[++i]);
+            if (roundCount < 1)
+            {
+                roundCount = 1;
+            }
+        }
+        else if (strcmp(argv[i], "--list") == 0)
+        {
+            listOnly = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    buildRecords();
+    buildTelemetry();
+    buildCJKStrings();
+    buildKernelBuffers();
+
+    size_t maxCapacity = 0;
+    for (size_t i = 0; i < CORPUS_COUNT; i++)
+    {
+        if (!prepareCorpus(&corpora[i]))
+        {
+            return 1;
+        }
+        if (corpora[i].capacity > maxCapacity)
+        {
+            maxCapacity = corpora[i].capacity;
+        }
+    }
+    encodeBuffer = malloc(maxCapacity);
+
+    printf("# corpus-version %d\tsimd %s\n", CORPUS_VERSION, simdLevelName());
+    if (listOnly)
+    {
+        printf("corpus\tbytes\tvalues\n");
+        for (size_t i = 0; i < CORPUS_COUNT; i++)
+        {
+            printf("%s\t%zu\t%zu\n", corpora[i].name, corpora[i].length, corpora[i].valueCount);
+        }
+        return 0;
+    }
+
+    int exitStatus = 0;
+    printf("benchmark\tcorpus\tbytes\tvalues\titerations\tns_per_op\tbytes_per_sec\tns_per_value\tallocs_per_op\n");
+    for (size_t i = 0; i < CORPUS_COUNT; i++)
+    {
+        const Corpus* corpus = &corpora[i];
+        for (size_t b = 0; b < sizeof(corpusBenchmarks) / sizeof(*corpusBenchmarks); b++)
+        {
+            double allocationsPerOp = runBenchmark(corpusBenchmarks[b].name, corpus->name, corpusBenchmarks[b].func,
+                                                   corpus, corpus->length, corpus->valueCount);
+            if (corpusBenchmarks[b].mustNotAllocate && allocationsPerOp > 0)
+            {
+                fprintf(stderr, "ERROR: %s allocates on %s (%.2f allocs/op)\n",
+                        corpusBenchmarks[b].name, corpus->name, allocationsPerOp);
+                exitStatus = 1;
+            }
+        }
+    }
+
+    runBenchmark("simd_findByte", "ascii_64k", benchFindByte, NULL, KERNEL_BUFFER_SIZE, KERNEL_BUFFER_SIZE);
+    runBenchmark("simd_containsByte", "ascii_64k", benchContainsByte, NULL, KERNEL_BUFFER_SIZE, KERNEL_BUFFER_SIZE);
+    runBenchmark("simd_isAllAscii", "ascii_64k", benchIsAllAscii, NULL, KERNEL_BUFFER_SIZE, KERNEL_BUFFER_SIZE);
+    runBenchmark("simd_isValidUTF8", "ascii_64k", benchIsValidUTF8ASCII, NULL, KERNEL_BUFFER_SIZE, KERNEL_BUFFER_SIZE);
+    runBenchmark("simd_isValidUTF8", "cjk_64k", benchIsValidUTF8CJK, NULL, KERNEL_BUFFER_SIZE, KERNEL_BUFFER_SIZE);
+
+    if (reusedMapStarted)
+    {
+        ksbonjson_map_freeEntries(&reusedMap);
+    }
+    for (size_t i = 0; i < CORPUS_COUNT; i++)
+    {
+        free(corpora[i].document);
+    }
+    free(encodeBuffer);
+    free(cjkPool);
+    (void)sink;
+    return exitStatus;
+}
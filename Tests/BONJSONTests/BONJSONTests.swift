@@ -3,6 +3,7 @@
 
 import XCTest
 @testable import BONJSON
+import CKSBonjson
 
 // MARK: - BONJSON Type Codes for Testing
 // These match the BONJSON specification for verifying encoded output.
@@ -386,6 +387,252 @@ final class BONJSONDecoderTests: XCTestCase {
         XCTAssertEqual(decoded, [1, 2, 3])
     }
 
+    // MARK: - Zero-Copy Inputs
+
+    func testDecodeFromRawBuffer() throws {
+        struct Item: Codable, Equatable {
+            var name: String
+            var values: [Int]
+        }
+        let item = Item(name: "buffer", values: [1, 2, 3])
+        let bytes = Array(try BONJSONEncoder().encode(item))
+
+        let decoded = try bytes.withUnsafeBytes { buffer in
+            try BONJSONDecoder().decode(Item.self, from: buffer)
+        }
+        XCTAssertEqual(decoded, item)
+    }
+
+    func testDecodeFromEmptyRawBufferThrows() {
+        let bytes: [UInt8] = []
+        XCTAssertThrowsError(try bytes.withUnsafeBytes { buffer in
+            try BONJSONDecoder().decode(Int.self, from: buffer)
+        })
+    }
+
+    func testDecodeContentsOfFile() throws {
+        struct Item: Codable, Equatable {
+            var id: Int
+            var label: String
+        }
+        let items = (0..<50).map { Item(id: $0, label: "label \($0)") }
+        let url = FileManager.default.temporaryDirectory
+            .appendingPathComponent("bonjson-\(UUID().uuidString).bonjson")
+        try BONJSONEncoder().encode(items).write(to: url)
+        defer { try? FileManager.default.removeItem(at: url) }
+
+        let decoded = try BONJSONDecoder().decode([Item].self, contentsOf: url)
+        XCTAssertEqual(decoded, items)
+    }
+
+    // MARK: - Lazy Mapping
+
+    func testLazyMappingMatchesEager() throws {
+        struct Inner: Codable, Equatable {
+            var tags: [String]
+            var scores: [Double]
+        }
+        struct Outer: Codable, Equatable {
+            var id: Int
+            var inner: Inner
+            var lookup: [String: [Int]]
+            var rows: [[Int]]
+        }
+        let value = Outer(
+            id: 42,
+            inner: Inner(tags: ["a", "bb", String(repeating: "c", count: 100)], scores: [1.5, -2.25]),
+            lookup: ["x": [1, 2, 3], "y": []],
+            rows: [[1], [2, 3], []]
+        )
+        let data = try BONJSONEncoder().encode(value)
+
+        let decoder = BONJSONDecoder()
+        decoder.mappingStrategy = .lazy
+        XCTAssertEqual(try decoder.decode(Outer.self, from: data), value)
+    }
+
+    func testLazyMappingSkipsUnreadSubtrees() throws {
+        struct Header: Decodable, Equatable {
+            var id: Int
+        }
+        // {"id": 7, "body": ["\u{FF}"]} - the body holds invalid UTF-8 that is never read
+        let data = Data([
+            TestTypeCode.objectStart,
+            TestTypeCode.stringShort(length: 2), 0x69, 0x64,
+            TestTypeCode.smallInt(7),
+            TestTypeCode.stringShort(length: 4), 0x62, 0x6F, 0x64, 0x79,
+            TestTypeCode.arrayStart, TestTypeCode.stringShort(length: 1), 0xFE, TestTypeCode.containerEnd,
+            TestTypeCode.containerEnd,
+        ])
+
+        XCTAssertThrowsError(try BONJSONDecoder().decode(Header.self, from: data))
+
+        let decoder = BONJSONDecoder()
+        decoder.mappingStrategy = .lazy
+        XCTAssertEqual(try decoder.decode(Header.self, from: data), Header(id: 7))
+    }
+
+    func testLazyMappingReportsErrorsInReadSubtrees() {
+        // ["\u{FF}"] nested one level down, so it is only validated when decoded
+        let data = Data([
+            TestTypeCode.arrayStart,
+            TestTypeCode.arrayStart, TestTypeCode.stringShort(length: 1), 0xFE, TestTypeCode.containerEnd,
+            TestTypeCode.containerEnd,
+        ])
+        let decoder = BONJSONDecoder()
+        decoder.mappingStrategy = .lazy
+        XCTAssertThrowsError(try decoder.decode([[String]].self, from: data))
+    }
+
+    func testLazyMappingRejectsTruncatedDocument() {
+        let data = Data([
+            TestTypeCode.arrayStart,
+            TestTypeCode.arrayStart, TestTypeCode.smallInt(1),
+            TestTypeCode.containerEnd,
+        ])
+        let decoder = BONJSONDecoder()
+        decoder.mappingStrategy = .lazy
+        XCTAssertThrowsError(try decoder.decode([[Int]].self, from: data))
+    }
+
+    // MARK: - Parallel Mapping
+
+    func testParallelMappingMatchesEager() throws {
+        struct Item: Codable, Equatable {
+            var id: Int
+            var label: String
+            var values: [Int]
+        }
+        // Several hundred kilobytes, so the root array is split into segments
+        let items = (0..<20_000).map { Item(id: $0, label: "item number \($0)", values: [$0, -$0]) }
+        let data = try BONJSONEncoder().encode(items)
+
+        let decoder = BONJSONDecoder()
+        decoder.mappingStrategy = .parallel
+        XCTAssertEqual(try decoder.decode([Item].self, from: data), items)
+        XCTAssertEqual(try decoder.decode([Item].self, from: try BONJSONEncoder().encode(Array(items.prefix(3)))),
+                       Array(items.prefix(3)))
+    }
+
+    func testParallelMappingReportsErrorsInLastSegment() throws {
+        var data = try BONJSONEncoder().encode(Array(repeating: "abcd", count: 60_000))
+        // Make the last string's final byte invalid UTF-8
+        data[data.count - 2] = 0xFE
+
+        let decoder = BONJSONDecoder()
+        decoder.mappingStrategy = .parallel
+        XCTAssertThrowsError(try decoder.decode([String].self, from: data))
+    }
+
+    func testParallelMappingReportsSameErrorsAsEager() throws {
+        // 30,000 copies of {"k": "abcd"}, enough to be split into segments
+        let element: [UInt8] = [
+            TestTypeCode.objectStart,
+            TestTypeCode.stringShort(length: 1), 0x6B,
+            TestTypeCode.stringShort(length: 4), 0x61, 0x62, 0x63, 0x64,
+            TestTypeCode.containerEnd,
+        ]
+        var document = [TestTypeCode.arrayStart]
+        for _ in 0..<30_000 {
+            document += element
+        }
+        document.append(TestTypeCode.containerEnd)
+        let middle = 1 + element.count * 15_000
+
+        var corruptions: [(String, [UInt8])] = []
+        var badKey = document
+        badKey[middle + 1] = TestTypeCode.smallInt(1)
+        corruptions.append(("non-string key", badKey))
+        var badString = document
+        badString[middle + 4] = 0xFE
+        corruptions.append(("invalid UTF-8", badString))
+        corruptions.append(("invalid UTF-8 with trailing bytes", badString + [TestTypeCode.null]))
+
+        for (name, bytes) in corruptions {
+            var errors: [String] = []
+            for strategy in [BONJSONDecoder.MappingStrategy.eager, .parallel] {
+                let decoder = BONJSONDecoder()
+                decoder.mappingStrategy = strategy
+                XCTAssertThrowsError(try decoder.decode([[String: String]].self, from: Data(bytes)), name) { error in
+                    errors.append(String(describing: error))
+                }
+            }
+            XCTAssertEqual(errors.count, 2, name)
+            XCTAssertEqual(errors.first, errors.last, name)
+        }
+    }
+
+    func testConcurrentArrayElementDecoding() throws {
+        struct Item: Codable, Equatable {
+            var id: Int
+            var name: String
+            var tags: [UInt8]
+        }
+        let items = (0..<1_000).map { Item(id: $0, name: "name \($0)", tags: [1, 2, UInt8($0 % 256)]) }
+        let data = try BONJSONEncoder().encode(items)
+
+        for strategy in [BONJSONDecoder.MappingStrategy.eager, .lazy, .parallel] {
+            let decoder = BONJSONDecoder()
+            decoder.mappingStrategy = strategy
+            decoder.decodesArrayElementsConcurrently = true
+            XCTAssertEqual(try decoder.decode([Item].self, from: data), items)
+        }
+    }
+
+    func testConcurrentArrayElementDecodingReportsErrors() throws {
+        struct Partial: Codable {
+            var id: Int
+            var extra: Int?
+        }
+        struct Required: Decodable {
+            var extra: Int
+        }
+        let items = (0..<500).map { Partial(id: $0, extra: $0 == 321 ? nil : $0) }
+        let data = try BONJSONEncoder().encode(items)
+
+        let decoder = BONJSONDecoder()
+        decoder.decodesArrayElementsConcurrently = true
+        XCTAssertThrowsError(try decoder.decode([Required].self, from: data)) { error in
+            guard case DecodingError.keyNotFound(_, let context)? = error as? DecodingError else {
+                return XCTFail("Unexpected error: \(error)")
+            }
+            XCTAssertEqual(context.codingPath.first?.intValue, 321)
+        }
+    }
+
+    // MARK: - Key Index
+
+    func testWideObjectRoundTripsThroughKeyIndex() throws {
+        let value = Dictionary(uniqueKeysWithValues: (0..<300).map { ("key\($0)", $0) })
+        let data = try BONJSONEncoder().encode(value)
+        XCTAssertEqual(try BONJSONDecoder().decode([String: Int].self, from: data), value)
+    }
+
+    func testWideObjectKeyLookup() throws {
+        struct Picked: Decodable, Equatable {
+            var key3: Int
+            var key42: Int
+            var missing: Int?
+        }
+        struct Required: Decodable {
+            var absent: Int
+        }
+        let value = Dictionary(uniqueKeysWithValues: (0..<50).map { ("key\($0)", $0) })
+        let data = try BONJSONEncoder().encode(value)
+
+        for strategy in [BONJSONDecoder.MappingStrategy.eager, .lazy] {
+            let decoder = BONJSONDecoder()
+            decoder.mappingStrategy = strategy
+            XCTAssertEqual(try decoder.decode(Picked.self, from: data), Picked(key3: 3, key42: 42, missing: nil))
+            XCTAssertThrowsError(try decoder.decode(Required.self, from: data)) { error in
+                guard case DecodingError.keyNotFound = error else {
+                    XCTFail("Expected keyNotFound, got \(error)")
+                    return
+                }
+            }
+        }
+    }
+
     // MARK: - Error Cases
 
     func testDecodeTypeMismatch() throws {
@@ -1020,6 +1267,45 @@ final class BONJSONNestedContainerTests: XCTestCase {
         let decoded = try decoder.decode(Mixed.self, from: data)
         XCTAssertEqual(decoded, value)
     }
+
+    func testNestedRecordInstancesCountTowardMaxDepth() throws {
+        struct Outer: Decodable, Equatable {
+            var a: Inner
+        }
+        struct Inner: Decodable, Equatable {
+            var a: Int
+        }
+
+        // Definition ["a"], then {"a": {"a": 1}} as two nested instances of it
+        let data = Data([0xB9, TestTypeCode.stringShort(length: 1), 0x61, TestTypeCode.containerEnd,
+                         0xBA, 0x00, 0xBA, 0x00, TestTypeCode.smallInt(1),
+                         TestTypeCode.containerEnd, TestTypeCode.containerEnd])
+
+        let decoder = BONJSONDecoder()
+        decoder.maxDepth = 2
+        XCTAssertEqual(try decoder.decode(Outer.self, from: data), Outer(a: Inner(a: 1)))
+
+        decoder.maxDepth = 1
+        XCTAssertThrowsError(try decoder.decode(Outer.self, from: data)) { error in
+            guard case BONJSONDecodingError.maxDepthExceeded = error else {
+                return XCTFail("Expected maxDepthExceeded, got \(error)")
+            }
+        }
+    }
+
+    func testMaxDepthAboveContainerLimitIsCapped() throws {
+        let depth = 600
+        let data = Data([UInt8](repeating: TestTypeCode.arrayStart, count: depth) +
+                        [UInt8](repeating: TestTypeCode.containerEnd, count: depth))
+
+        let decoder = BONJSONDecoder()
+        decoder.maxDepth = 1000
+        XCTAssertThrowsError(try decoder.decode([Int].self, from: data)) { error in
+            guard case BONJSONDecodingError.maxDepthExceeded = error else {
+                return XCTFail("Expected maxDepthExceeded, got \(error)")
+            }
+        }
+    }
 }
 
 // MARK: - Error Handling Tests
@@ -3048,6 +3334,49 @@ final class BONJSONBigNumberTests: XCTestCase {
         let decoded = try decoder.decode(Date.self, from: bonjsonData)
         XCTAssertEqual(decoded.timeIntervalSince1970, 1000000.0)
     }
+
+    // Big numbers are stored out of line, so the map entry must stay compact
+    func testMapEntryIsSixteenBytes() {
+        XCTAssertEqual(MemoryLayout<KSBONJSONMapEntry>.size, 16)
+    }
+
+    // Test several big numbers mixed with other values (batch [Double] path decodes payloads on demand)
+    func testBigNumbersInDoubleArray() throws {
+        let bonjsonData = Data([
+            0xb7,                           // Array start
+            0xb2, 0x03, 0x04, 0x39, 0x30,   // 123.45
+            0x05,                           // Small int 5
+            0xb2, 0x00, 0x03, 0x39, 0x30,   // -12345
+            0xb2, 0x00, 0x00,               // Zero (signed_length 0)
+            0xb6                            // Container end
+        ])
+
+        let decoder = BONJSONDecoder()
+        let decoded = try decoder.decode([Double].self, from: bonjsonData)
+        XCTAssertEqual(decoded.count, 4)
+        XCTAssertEqual(decoded[0], 123.45, accuracy: 0.001)
+        XCTAssertEqual(decoded[1], 5.0)
+        XCTAssertEqual(decoded[2], -12345.0)
+        XCTAssertEqual(decoded[3], 0.0)
+    }
+
+    // Test big number decoded as Decimal from a keyed container
+    func testBigNumberAsDecimalInKeyedContainer() throws {
+        let bonjsonData = Data([
+            0xb8,                               // Object start
+            0x6a, 0x76, 0x61, 0x6c, 0x75, 0x65, // Key "value"
+            0xb2, 0x03, 0x04, 0x39, 0x30,       // 123.45
+            0xb6                                // Container end
+        ])
+
+        struct DecimalHolder: Decodable {
+            var value: Decimal
+        }
+
+        let decoder = BONJSONDecoder()
+        let decoded = try decoder.decode(DecimalHolder.self, from: bonjsonData)
+        XCTAssertEqual(decoded.value, Decimal(string: "123.45"))
+    }
 }
 
 // MARK: - Security Tests
@@ -3280,23 +3609,55 @@ final class BONJSONSecurityTests: XCTestCase {
         XCTAssertEqual(decoded3, validString)
     }
 
-    // MARK: - Too Many Keys Tests
+    func testLongMultibyteStringsValidateAcrossBlocks() throws {
+        // Sequences of every width straddle the 16-byte SIMD block boundaries
+        let validString = String(repeating: "日本語テキスト🌍é!", count: 40)
+        let data = try BONJSONEncoder().encode(validString)
+        XCTAssertEqual(try BONJSONDecoder().decode(String.self, from: data), validString)
+
+        // Truncate the last character at each position near the end of the string
+        var utf8 = Array("aé世🌍".utf8)
+        while utf8.count < 64 { utf8.insert(0x61, at: 0) }
+        for dropCount in 1...3 {
+            var bytes = Array(utf8.dropLast(dropCount))
+            bytes.insert(0xFF, at: 0) // Long string
+            bytes.append(0xFF)
+            XCTAssertThrowsError(try BONJSONDecoder().decode(String.self, from: Data(bytes)))
+        }
+    }
 
-    func testDecoderRejectsTooManyKeysWhenDuplicateCheckEnabled() throws {
-        // Build an object with more than 256 keys using encoder, then test decoding
+    // MARK: - Many Keys Tests
+
+    func testDecoderAcceptsManyKeysWhenDuplicateCheckEnabled() throws {
+        // Duplicate detection is hash-based, so there is no per-object key limit
         var dict: [String: Int] = [:]
-        for i in 0..<257 {
+        for i in 0..<5000 {
             dict["key\(i)"] = i
         }
 
         let encoder = BONJSONEncoder()
         let bonjsonData = try encoder.encode(dict)
 
-        // Default duplicate detection should fail with too many keys
         let decoder = BONJSONDecoder()
-        XCTAssertThrowsError(try decoder.decode([String: Int].self, from: bonjsonData)) { error in
-            guard case BONJSONDecodingError.tooManyKeys = error else {
-                XCTFail("Expected tooManyKeys error, got \(error)")
+        let decoded = try decoder.decode([String: Int].self, from: bonjsonData)
+        XCTAssertEqual(decoded, dict)
+    }
+
+    func testDecoderRejectsDuplicateAmongManyKeys() throws {
+        // {"key0": 0, ..., "key299": 0, "key0": 0}
+        var bytes: [UInt8] = [TestTypeCode.objectStart]
+        for i in 0..<301 {
+            let key = Array("key\(i == 300 ? 0 : i)".utf8)
+            bytes.append(TestTypeCode.stringShort(length: key.count))
+            bytes.append(contentsOf: key)
+            bytes.append(TestTypeCode.smallInt(0))
+        }
+        bytes.append(TestTypeCode.containerEnd)
+
+        let decoder = BONJSONDecoder()
+        XCTAssertThrowsError(try decoder.decode([String: Int].self, from: Data(bytes))) { error in
+            guard case BONJSONDecodingError.duplicateObjectKey = error else {
+                XCTFail("Expected duplicateObjectKey error, got \(error)")
                 return
             }
         }
@@ -3448,6 +3809,104 @@ final class BONJSONTypedArrayEncoderTests: XCTestCase {
         let decoded = try BONJSONDecoder().decode([UInt8].self, from: data)
         XCTAssertEqual(decoded, values)
     }
+
+    // Typed arrays are mapped as a single span and converted on decode
+    func testTypedArrayWidensToWiderElementType() throws {
+        // float32 [1.5, -2.25]
+        let floats = Data([0xF6, 2, 0x00, 0x00, 0xC0, 0x3F, 0x00, 0x00, 0x10, 0xC0])
+        XCTAssertEqual(try BONJSONDecoder().decode([Double].self, from: floats), [1.5, -2.25])
+
+        // sint16 [-1, 300]
+        let shorts = Data([0xF9, 2, 0xFF, 0xFF, 0x2C, 0x01])
+        XCTAssertEqual(try BONJSONDecoder().decode([Int].self, from: shorts), [-1, 300])
+        XCTAssertEqual(try BONJSONDecoder().decode([Double].self, from: shorts), [-1.0, 300.0])
+    }
+
+    func testTypedArrayDecodesElementWise() throws {
+        struct Wrapper: Codable, Equatable {
+            var values: [Float]
+            var count: Int
+        }
+        let value = Wrapper(values: [1.5, -2.25, 3.0], count: 3)
+        let data = try BONJSONEncoder().encode(value)
+
+        XCTAssertEqual(try BONJSONDecoder().decode(Wrapper.self, from: data), value)
+
+        let decoder = BONJSONDecoder()
+        decoder.mappingStrategy = .lazy
+        XCTAssertEqual(try decoder.decode(Wrapper.self, from: data), value)
+    }
+
+    func testTypedArrayDoesNotDecodeAsStrings() throws {
+        let data = Data([0xFE, 2, 10, 20]) // uint8 [10, 20]
+        XCTAssertThrowsError(try BONJSONDecoder().decode([String].self, from: data))
+    }
+}
+
+// MARK: - Numeric Array Narrowing Tests
+
+final class BONJSONNumericNarrowingTests: XCTestCase {
+
+    private func makeEncoder() -> BONJSONEncoder {
+        let encoder = BONJSONEncoder()
+        encoder.narrowsNumericArrays = true
+        return encoder
+    }
+
+    func testIntArraysUseNarrowestElementType() throws {
+        let cases: [([Int], UInt8, Int)] = [
+            ([0, 1, 255], 0xFE, 1),                    // TYPE_TYPED_UINT8
+            ([-1, 127, -128], 0xFA, 1),                // TYPE_TYPED_SINT8
+            ([0, 65535], 0xFD, 2),                     // TYPE_TYPED_UINT16
+            ([-32768, 200], 0xF9, 2),                  // TYPE_TYPED_SINT16
+            ([1, 4_000_000_000], 0xFC, 4),             // TYPE_TYPED_UINT32
+            ([-1, Int(Int32.max)], 0xF8, 4),           // TYPE_TYPED_SINT32
+            ([0, 5_000_000_000], 0xF7, 8),             // TYPE_TYPED_SINT64
+            ([Int.min, Int.max], 0xF7, 8),
+        ]
+        for (values, typeCode, elementSize) in cases {
+            let data = try makeEncoder().encode(values)
+            XCTAssertEqual(data[0], typeCode, "\(values)")
+            XCTAssertEqual(data.count, 2 + values.count * elementSize, "\(values)")
+            XCTAssertEqual(try BONJSONDecoder().decode([Int].self, from: data), values)
+        }
+    }
+
+    func testLongArraysRoundTrip() throws {
+        // Long enough for the vector loops and their scalar tails
+        let unsigned = (0..<1001).map { $0 * 37 % 60_000 }
+        let signed = (0..<1001).map { Int64($0 % 256) - 128 }
+        XCTAssertEqual(try makeEncoder().encode(unsigned)[0], 0xFD)
+        XCTAssertEqual(try makeEncoder().encode(signed)[0], 0xFA)
+        XCTAssertEqual(try BONJSONDecoder().decode([Int].self, from: makeEncoder().encode(unsigned)), unsigned)
+        XCTAssertEqual(try BONJSONDecoder().decode([Int64].self, from: makeEncoder().encode(signed)), signed)
+    }
+
+    func testDoubleArraysNarrowOnlyWhenExact() throws {
+        let exact = (0..<103).map { Double($0) / 8 }
+        let data = try makeEncoder().encode(exact)
+        XCTAssertEqual(data[0], 0xF6) // TYPE_TYPED_FLOAT32
+        XCTAssertEqual(try BONJSONDecoder().decode([Double].self, from: data), exact)
+
+        for inexact in [exact + [0.1], exact + [1e300], [Double.leastNonzeroMagnitude] + exact] {
+            let data = try makeEncoder().encode(inexact)
+            XCTAssertEqual(data[0], 0xF5) // TYPE_TYPED_FLOAT64
+            XCTAssertEqual(try BONJSONDecoder().decode([Double].self, from: data), inexact)
+        }
+    }
+
+    func testNestedArraysAreNarrowed() throws {
+        let value = ["ids": [1, 2, 3], "big": [70_000]]
+        let data = try makeEncoder().encode(value)
+        XCTAssertTrue(data.contains(0xFE))
+        XCTAssertTrue(data.contains(0xFC))
+        XCTAssertEqual(try BONJSONDecoder().decode([String: [Int]].self, from: data), value)
+    }
+
+    func testOffByDefault() throws {
+        XCTAssertEqual(try BONJSONEncoder().encode([1, 2, 3])[0], 0xF7)
+        XCTAssertEqual(try BONJSONEncoder().encode([1.5])[0], 0xF5)
+    }
 }
 
 // MARK: - Nested Batch Encoding Tests
@@ -3693,4 +4152,1944 @@ final class BONJSONRecordEncoderTests: XCTestCase {
         let decoded = try BONJSONDecoder().decode([Item].self, from: data)
         XCTAssertEqual(decoded, items)
     }
+
+    func testRecordExpansionBeyondInputLength() throws {
+        // Each instance is ~7 bytes on the wire but expands to 11 map entries,
+        // so the entry buffer has to grow during the scan.
+        struct Flags: Codable, Equatable {
+            var a: Int
+            var b: Int
+            var c: Int
+            var d: Int
+            var e: Int
+        }
+        let items = (0..<5000).map { Flags(a: $0 % 7, b: 1, c: 2, d: 3, e: 4) }
+        let data = try BONJSONEncoder().encode(items)
+        XCTAssertEqual(Array(data)[0], 0xB9, "Expected record encoding")
+        XCTAssertLessThan(data.count, items.count * 11)
+
+        let decoded = try BONJSONDecoder().decode([Flags].self, from: data)
+        XCTAssertEqual(decoded, items)
+    }
+}
+
+// MARK: - Nested Record Encoding Tests
+
+final class BONJSONNestedRecordEncoderTests: XCTestCase {
+
+    struct Item: Codable, Equatable {
+        var id: Int
+        var name: String
+    }
+
+    struct Group: Codable, Equatable {
+        var title: String
+        var members: [Item]
+    }
+
+    struct Response: Codable, Equatable {
+        var status: String
+        var items: [Item]
+        var groups: [Group]
+    }
+
+    private func makeResponse() -> Response {
+        let items = (0..<20).map { Item(id: $0, name: "item\($0)") }
+        return Response(
+            status: "ok",
+            items: items,
+            groups: (0..<3).map { Group(title: "group\($0)", members: Array(items.prefix($0 + 2))) }
+        )
+    }
+
+    private func makeEncoder() -> BONJSONEncoder {
+        let encoder = BONJSONEncoder()
+        encoder.recordEncodingStrategy = .allArrays
+        return encoder
+    }
+
+    /// The key lists of the record definitions at the start of a document.
+    private func recordDefinitions(in data: Data) -> [[String]] {
+        let bytes = Array(data)
+        var definitions: [[String]] = []
+        var i = 0
+        while i < bytes.count && bytes[i] == 0xB9 {
+            i += 1
+            var keys: [String] = []
+            while bytes[i] != TestTypeCode.containerEnd {
+                let length: Int
+                if bytes[i] == TestTypeCode.stringLong {
+                    length = bytes[(i + 1)...].firstIndex(of: TestTypeCode.stringLong)! - i - 1
+                    keys.append(String(decoding: bytes[(i + 1)..<(i + 1 + length)], as: UTF8.self))
+                    i += length + 2
+                } else {
+                    length = Int(bytes[i] - TestTypeCode.stringShort(length: 0))
+                    keys.append(String(decoding: bytes[(i + 1)..<(i + 1 + length)], as: UTF8.self))
+                    i += length + 1
+                }
+            }
+            i += 1
+            definitions.append(keys)
+        }
+        return definitions
+    }
+
+    func testNestedArraysAreEncodedAsRecords() throws {
+        let response = makeResponse()
+        let data = try makeEncoder().encode(response)
+
+        XCTAssertEqual(recordDefinitions(in: data), [["id", "name"], ["title", "members"]])
+        XCTAssertLessThan(data.count, try BONJSONEncoder().encode(response).count)
+        XCTAssertEqual(try BONJSONDecoder().decode(Response.self, from: data), response)
+    }
+
+    func testDefaultStrategyOnlyUsesRecordsForRootArrays() throws {
+        let data = try BONJSONEncoder().encode(makeResponse())
+        XCTAssertEqual(recordDefinitions(in: data), [])
+    }
+
+    func testRootRecordArrayWithNestedRecordArrays() throws {
+        let groups = makeResponse().groups
+        let data = try makeEncoder().encode(groups)
+
+        // The root definition is written first; the nested one is inserted after it
+        XCTAssertEqual(recordDefinitions(in: data), [["title", "members"], ["id", "name"]])
+        XCTAssertEqual(try BONJSONDecoder().decode([Group].self, from: data), groups)
+    }
+
+    func testMismatchedNestedArrayFallsBackWithoutItsDefinition() throws {
+        struct Loose: Codable, Equatable {
+            var a: Int?
+            var b: Int?
+        }
+        struct Container: Codable, Equatable {
+            var loose: [Loose]
+            var items: [Item]
+        }
+        let value = Container(
+            loose: [Loose(a: 1, b: nil), Loose(a: nil, b: 2)],
+            items: [Item(id: 1, name: "x"), Item(id: 2, name: "y")]
+        )
+        let data = try makeEncoder().encode(value)
+
+        XCTAssertEqual(recordDefinitions(in: data), [["id", "name"]])
+        XCTAssertEqual(try BONJSONDecoder().decode(Container.self, from: data), value)
+    }
+
+    func testDefinitionLimitFallsBackToRegularObjects() throws {
+        // 300 differently keyed arrays: the first 256 get definitions, the rest don't
+        let value = (0..<300).map { i in
+            [["k\(i)": i], ["k\(i)": i + 1]]
+        }
+        let data = try makeEncoder().encode(["arrays": value])
+
+        XCTAssertEqual(recordDefinitions(in: data).count, Int(KSBONJSON_MAX_RECORD_DEFS))
+        XCTAssertEqual(try BONJSONDecoder().decode([String: [[[String: Int]]]].self, from: data), ["arrays": value])
+    }
+
+    func testStreamingOnlyUsesRecordsForRootArrays() throws {
+        let response = makeResponse()
+        let encoder = makeEncoder()
+        var streamed = Data()
+        try encoder.encode(response) { streamed.append(contentsOf: $0) }
+
+        XCTAssertEqual(recordDefinitions(in: streamed), [])
+        XCTAssertEqual(try BONJSONDecoder().decode(Response.self, from: streamed), response)
+    }
+}
+
+// MARK: - Compact Record Decoder Tests
+
+final class BONJSONCompactRecordDecoderTests: XCTestCase {
+
+    struct Point: Codable, Equatable {
+        var x: Int
+        var y: Int
+        var label: String?
+    }
+
+    /// Definition ["x", "y", "label"], then [{x:1, y:2, label:"a"}, {x:3, y:4}].
+    private let recordBytes: [UInt8] = [
+        0xB9,
+        TestTypeCode.stringShort(length: 1), 0x78,
+        TestTypeCode.stringShort(length: 1), 0x79,
+        TestTypeCode.stringShort(length: 5), 0x6C, 0x61, 0x62, 0x65, 0x6C,
+        TestTypeCode.containerEnd,
+        TestTypeCode.arrayStart,
+        0xBA, 0x00, TestTypeCode.smallInt(1), TestTypeCode.smallInt(2), TestTypeCode.stringShort(length: 1), 0x61, TestTypeCode.containerEnd,
+        0xBA, 0x00, TestTypeCode.smallInt(3), TestTypeCode.smallInt(4), TestTypeCode.containerEnd,
+        TestTypeCode.containerEnd,
+    ]
+
+    private func makeMap(compactRecords: Bool) throws -> _PositionMap {
+        return try _PositionMap(
+            data: Data(recordBytes),
+            flags: ksbonjson_defaultDecodeFlags(),
+            unicodeStrategy: .reject,
+            nulStrategy: .reject,
+            duplicateKeyStrategy: .reject,
+            compactRecords: compactRecords
+        )
+    }
+
+    func testCompactRecordsStoreValuesOnly() throws {
+        let compact = try makeMap(compactRecords: true)
+        let expanded = try makeMap(compactRecords: false)
+
+        // Both instances drop their three copied key entries
+        XCTAssertEqual(Int(expanded.count) - Int(compact.count), 6)
+
+        let first = try XCTUnwrap(compact.getEntry(at: compact.rootIndex + 1))
+        XCTAssertEqual(first.type, KSBONJSON_TYPE_RECORD)
+        XCTAssertEqual(first.data.record.definition, 0)
+        XCTAssertEqual(compact.recordKeyIndices(definition: 0).count, 3)
+    }
+
+    func testDecodeRecordsWithMissingTrailingValues() throws {
+        let points = try BONJSONDecoder().decode([Point].self, from: Data(recordBytes))
+        XCTAssertEqual(points, [Point(x: 1, y: 2, label: "a"), Point(x: 3, y: 4, label: nil)])
+    }
+
+    func testRecordAllKeysAndMissingKey() throws {
+        struct KeyList: Decodable {
+            var keys: [String]
+            init(from decoder: Decoder) throws {
+                keys = try decoder.container(keyedBy: _TestKey.self).allKeys.map { $0.stringValue }
+            }
+        }
+        let keyLists = try BONJSONDecoder().decode([KeyList].self, from: Data(recordBytes))
+        XCTAssertEqual(keyLists.map { $0.keys }, [["x", "y", "label"], ["x", "y", "label"]])
+
+        struct Missing: Decodable {
+            var z: Int
+        }
+        XCTAssertThrowsError(try BONJSONDecoder().decode([Missing].self, from: Data(recordBytes))) { error in
+            guard case DecodingError.keyNotFound(let key, _) = error else {
+                return XCTFail("Expected keyNotFound, got \(error)")
+            }
+            XCTAssertEqual(key.stringValue, "z")
+        }
+    }
+
+    func testRecordsWithNestedValuesRoundTrip() throws {
+        struct Shape: Codable, Equatable {
+            var name: String
+            var points: [Point]
+            var tags: [String]
+            var origin: Point?
+        }
+        let shapes = (0..<50).map { i in
+            Shape(
+                name: "shape\(i)",
+                points: (0..<3).map { Point(x: $0, y: i, label: $0 == 0 ? nil : "p\($0)") },
+                tags: i % 2 == 0 ? ["even"] : [],
+                origin: i % 3 == 0 ? Point(x: i, y: i, label: nil) : nil
+            )
+        }
+        let encoder = BONJSONEncoder()
+        encoder.recordEncodingStrategy = .allArrays
+        let data = try encoder.encode(shapes)
+        XCTAssertEqual(Array(data)[0], 0xB9, "Expected record encoding")
+
+        for strategy in [BONJSONDecoder.MappingStrategy.eager, .lazy, .parallel] {
+            let decoder = BONJSONDecoder()
+            decoder.mappingStrategy = strategy
+            XCTAssertEqual(try decoder.decode([Shape].self, from: data), shapes, "\(strategy)")
+        }
+    }
+
+    func testRecordKeysUseKeyDecodingStrategy() throws {
+        struct Row: Codable, Equatable {
+            var userId: Int
+            var displayName: String
+        }
+        struct SnakeRow: Codable {
+            var user_id: Int
+            var display_name: String
+        }
+        let data = try BONJSONEncoder().encode((0..<5).map { SnakeRow(user_id: $0, display_name: "n\($0)") })
+        let expected = (0..<5).map { Row(userId: $0, displayName: "n\($0)") }
+
+        let snakeDecoder = BONJSONDecoder()
+        snakeDecoder.keyDecodingStrategy = .convertFromSnakeCase
+        XCTAssertEqual(try snakeDecoder.decode([Row].self, from: data), expected)
+
+        // Custom conversion keeps the per-object lookup
+        let customDecoder = BONJSONDecoder()
+        customDecoder.keyDecodingStrategy = .custom { path in
+            _TestKey(stringValue: path.last!.stringValue.convertFromSnakeCase())
+        }
+        XCTAssertEqual(try customDecoder.decode([Row].self, from: data), expected)
+    }
+
+    func testDuplicateRecordKeysFollowStrategy() throws {
+        // Definition ["a", "a"], then [{a:1, a:2}, {a:3, a:4}]
+        let bytes: [UInt8] = [
+            0xB9, TestTypeCode.stringShort(length: 1), 0x61, TestTypeCode.stringShort(length: 1), 0x61, TestTypeCode.containerEnd,
+            TestTypeCode.arrayStart,
+            0xBA, 0x00, TestTypeCode.smallInt(1), TestTypeCode.smallInt(2), TestTypeCode.containerEnd,
+            0xBA, 0x00, TestTypeCode.smallInt(3), TestTypeCode.smallInt(4), TestTypeCode.containerEnd,
+            TestTypeCode.containerEnd,
+        ]
+        struct A: Decodable, Equatable {
+            var a: Int
+        }
+
+        XCTAssertThrowsError(try BONJSONDecoder().decode([A].self, from: Data(bytes)))
+
+        let first = BONJSONDecoder()
+        first.duplicateKeyDecodingStrategy = .keepFirst
+        XCTAssertEqual(try first.decode([A].self, from: Data(bytes)), [A(a: 1), A(a: 3)])
+
+        let last = BONJSONDecoder()
+        last.duplicateKeyDecodingStrategy = .keepLast
+        XCTAssertEqual(try last.decode([A].self, from: Data(bytes)), [A(a: 2), A(a: 4)])
+        XCTAssertEqual(try last.decode([[String: Int]].self, from: Data(bytes)), [["a": 2], ["a": 4]])
+    }
+}
+
+// MARK: - Streaming Encoder Tests
+
+final class BONJSONStreamingEncoderTests: XCTestCase {
+
+    struct Row: Codable, Equatable {
+        var id: Int
+        var name: String
+        var note: String?
+    }
+
+    private struct SinkFailure: Error {}
+
+    private func streamedChunks<T: Encodable>(_ value: T, using encoder: BONJSONEncoder) throws -> [Data] {
+        var chunks: [Data] = []
+        try encoder.encode(value) { chunks.append(Data($0)) }
+        return chunks
+    }
+
+    func testStreamedOutputMatchesBufferedOutput() throws {
+        let rows = (0..<2000).map { Row(id: $0, name: "row \($0)", note: "n") }
+        let encoder = BONJSONEncoder()
+        encoder.streamingChunkSize = 1024
+
+        let chunks = try streamedChunks(rows, using: encoder)
+        XCTAssertGreaterThan(chunks.count, 10)
+        XCTAssertTrue(chunks.allSatisfy { $0.count <= 1024 })
+        XCTAssertEqual(chunks.reduce(Data(), +), try encoder.encode(rows))
+    }
+
+    func testValueLargerThanChunkIsStreamedWhole() throws {
+        let value = ["big": String(repeating: "x", count: 5000), "small": "y"]
+        let encoder = BONJSONEncoder()
+        encoder.streamingChunkSize = 1024
+
+        let streamed = try streamedChunks(value, using: encoder).reduce(Data(), +)
+        XCTAssertEqual(try BONJSONDecoder().decode([String: String].self, from: streamed), value)
+    }
+
+    func testStreamedRecordArrayFallsBackPerElement() throws {
+        // Rows without a note don't match the record schema taken from the first row
+        let rows = (0..<500).map { Row(id: $0, name: "row \($0)", note: $0 % 3 == 0 ? nil : "n") }
+        let encoder = BONJSONEncoder()
+        encoder.streamingChunkSize = 512
+
+        let streamed = try streamedChunks(rows, using: encoder).reduce(Data(), +)
+        XCTAssertEqual(Array(streamed)[0], 0xB9, "Expected record encoding")
+        XCTAssertEqual(try BONJSONDecoder().decode([Row].self, from: streamed), rows)
+    }
+
+    func testSinkErrorStopsEncoding() throws {
+        let rows = (0..<2000).map { Row(id: $0, name: "row \($0)", note: nil) }
+        let encoder = BONJSONEncoder()
+        encoder.streamingChunkSize = 1024
+
+        var calls = 0
+        XCTAssertThrowsError(try encoder.encode(rows) { _ in
+            calls += 1
+            throw SinkFailure()
+        }) { error in
+            XCTAssertTrue(error is SinkFailure)
+        }
+        XCTAssertEqual(calls, 1)
+    }
+
+    func testMaxDocumentSizeCountsFlushedBytes() {
+        let encoder = BONJSONEncoder()
+        encoder.streamingChunkSize = 256
+        encoder.maxDocumentSize = 1000
+
+        let values = (0..<1000).map { "value \($0)" }
+        XCTAssertThrowsError(try encoder.encode(values) { _ in }) { error in
+            guard case BONJSONEncodingError.maxDocumentSizeExceeded = error else {
+                return XCTFail("Expected maxDocumentSizeExceeded, got \(error)")
+            }
+        }
+    }
+
+    func testEncodeToOutputStream() throws {
+        let rows = (0..<300).map { Row(id: $0, name: "row \($0)", note: nil) }
+        let encoder = BONJSONEncoder()
+        encoder.streamingChunkSize = 256
+
+        let stream = OutputStream(toMemory: ())
+        stream.open()
+        try encoder.encode(rows, to: stream)
+        stream.close()
+
+        let written = try XCTUnwrap(stream.property(forKey: .dataWrittenToMemoryStreamKey) as? Data)
+        XCTAssertEqual(written, try encoder.encode(rows))
+    }
+}
+
+// MARK: - Concurrent Encoding Tests
+
+final class BONJSONConcurrentEncodingTests: XCTestCase {
+
+    struct Row: Codable, Equatable {
+        var id: Int
+        var name: String
+        var note: String?
+    }
+
+    /// Throws when encoded if `fails` is set, reporting where it was.
+    struct Failing: Encodable {
+        var fails: Bool
+
+        func encode(to encoder: Encoder) throws {
+            if fails {
+                throw EncodingError.invalidValue(self, EncodingError.Context(codingPath: encoder.codingPath, debugDescription: "fails"))
+            }
+            var container = encoder.singleValueContainer()
+            try container.encode(1)
+        }
+    }
+
+    private func makeEncoder() -> BONJSONEncoder {
+        let encoder = BONJSONEncoder()
+        encoder.encodesArrayElementsConcurrently = true
+        return encoder
+    }
+
+    func testConcurrentOutputMatchesSerialOutput() throws {
+        let rows = (0..<5000).map { Row(id: $0, name: "row \($0)", note: "n") }
+        let nested = (0..<3000).map { [$0, $0 * 2] }
+        let serial = BONJSONEncoder()
+        let concurrent = makeEncoder()
+        XCTAssertEqual(try concurrent.encode(rows), try serial.encode(rows))
+        XCTAssertEqual(try concurrent.encode(nested), try serial.encode(nested))
+
+        serial.recordEncodingStrategy = .allArrays
+        concurrent.recordEncodingStrategy = .allArrays
+        XCTAssertEqual(try concurrent.encode(rows), try serial.encode(rows))
+    }
+
+    func testConcurrentStreamingMatchesSerialOutput() throws {
+        let rows = (0..<5000).map { Row(id: $0, name: "row \($0)", note: nil) }
+        let encoder = makeEncoder()
+        encoder.streamingChunkSize = 1024
+
+        var chunks: [Data] = []
+        try encoder.encode(rows) { chunks.append(Data($0)) }
+        XCTAssertTrue(chunks.allSatisfy { $0.count <= 1024 })
+        XCTAssertEqual(chunks.reduce(Data(), +), try BONJSONEncoder().encode(rows))
+    }
+
+    func testMismatchingElementsAreWrittenAsObjects() throws {
+        let rows = (0..<2000).map { Row(id: $0, name: "row \($0)", note: $0 % 7 == 3 ? nil : "n") }
+        let data = try makeEncoder().encode(rows)
+        XCTAssertEqual(Array(data)[0], 0xB9, "Expected record encoding")
+        XCTAssertEqual(try BONJSONDecoder().decode([Row].self, from: data), rows)
+    }
+
+    func testEarliestElementErrorIsReported() {
+        let values = (0..<4000).map { Failing(fails: $0 == 700 || $0 == 3500) }
+        XCTAssertThrowsError(try makeEncoder().encode(values)) { error in
+            guard case EncodingError.invalidValue(_, let context)? = error as? EncodingError else {
+                return XCTFail("Unexpected error: \(error)")
+            }
+            XCTAssertEqual(context.codingPath.first?.intValue, 700)
+        }
+    }
+
+    func testMaxDocumentSizeCoversAllChunks() {
+        let encoder = makeEncoder()
+        encoder.maxDocumentSize = 10_000
+        let rows = (0..<2000).map { Row(id: $0, name: "row \($0)", note: nil) }
+        XCTAssertThrowsError(try encoder.encode(rows)) { error in
+            guard case BONJSONEncodingError.maxDocumentSizeExceeded = error else {
+                return XCTFail("Expected maxDocumentSizeExceeded, got \(error)")
+            }
+        }
+    }
+}
+
+// MARK: - Session Tests
+
+final class BONJSONSessionTests: XCTestCase {
+
+    struct Message: Codable, Equatable {
+        var id: Int
+        var tags: [String]
+        var payload: [String: Double]
+    }
+
+    private func message(size: Int) -> Message {
+        return Message(
+            id: size,
+            tags: (0..<size).map { "tag\($0)" },
+            payload: Dictionary(uniqueKeysWithValues: (0..<size).map { ("k\($0)", Double($0) / 2) })
+        )
+    }
+
+    func testSessionEncodesMatchFreshEncodes() throws {
+        let encoder = BONJSONEncoder()
+        let session = BONJSONSession()
+        for size in [1, 200, 3, 0, 50] {
+            let value = message(size: size)
+            XCTAssertEqual(try encoder.encode(value, using: session), try encoder.encode(value))
+        }
+        XCTAssertNotNil(session.takeEncodeBuffer(), "Buffer should be kept between encodes")
+    }
+
+    func testSessionDecodesMatchFreshDecodes() throws {
+        let encoder = BONJSONEncoder()
+        let decoder = BONJSONDecoder()
+        let session = BONJSONSession()
+        // Shrinking documents reuse an input buffer larger than the input
+        for size in [200, 3, 0, 50, 1] {
+            let value = message(size: size)
+            let data = try encoder.encode(value)
+            XCTAssertEqual(try decoder.decode(Message.self, from: data, using: session), value)
+            try data.withUnsafeBytes { buffer in
+                XCTAssertEqual(try decoder.decode(Message.self, from: buffer, using: session), value)
+            }
+        }
+    }
+
+    func testSessionReuseKeepsTrailingBytesCheck() throws {
+        let decoder = BONJSONDecoder()
+        let session = BONJSONSession()
+        _ = try decoder.decode([String].self, from: try BONJSONEncoder().encode(["a", "b", "c", "d"]), using: session)
+
+        let shorter = try BONJSONEncoder().encode([1, 2])
+        XCTAssertEqual(try decoder.decode([Int].self, from: shorter, using: session), [1, 2])
+        XCTAssertThrowsError(try decoder.decode([Int].self, from: shorter + Data([0x01]), using: session))
+    }
+
+    func testSessionRecoversFromDecodeErrors() throws {
+        let decoder = BONJSONDecoder()
+        let session = BONJSONSession()
+        let invalid = Data([TestTypeCode.objectStart, TestTypeCode.smallInt(1)])
+        XCTAssertThrowsError(try decoder.decode([String: Int].self, from: invalid, using: session))
+
+        let valid = try BONJSONEncoder().encode(["a": 1])
+        XCTAssertEqual(try decoder.decode([String: Int].self, from: valid, using: session), ["a": 1])
+    }
+
+    func testSessionSwitchesBetweenMappingStrategies() throws {
+        let value = message(size: 40)
+        let data = try BONJSONEncoder().encode(value)
+        let session = BONJSONSession()
+        for strategy in [BONJSONDecoder.MappingStrategy.eager, .lazy, .eager, .parallel, .lazy] {
+            let decoder = BONJSONDecoder()
+            decoder.mappingStrategy = strategy
+            XCTAssertEqual(try decoder.decode(Message.self, from: data, using: session), value)
+        }
+    }
+
+    func testOversizedStorageIsNotRetained() throws {
+        let session = BONJSONSession(maxRetainedBytes: 64)
+        let value = message(size: 100)
+        let data = try BONJSONEncoder().encode(value, using: session)
+        XCTAssertNil(session.takeEncodeBuffer())
+        XCTAssertEqual(try BONJSONDecoder().decode(Message.self, from: data, using: session), value)
+        XCTAssertNil(session.takeMapStorage())
+    }
+}
+
+// MARK: - Small Document Tests
+
+final class BONJSONSmallDocumentTests: XCTestCase {
+
+    struct Reply: Codable, Equatable {
+        var status: [[Int]]
+        var headers: [String: String]
+        var body: String
+        var retry: Int?
+    }
+
+    private func reply(width: Int) -> Reply {
+        return Reply(
+            status: [[200, width], [], [1, 2, 3]],
+            headers: ["type": "text", "tag": String(repeating: "x", count: width)],
+            body: "ok",
+            retry: width
+        )
+    }
+
+    // Small documents have no sibling table, so skipping a nested container
+    // relies on its subtree size instead
+    func testSmallDocumentSkipsNestedContainers() throws {
+        let value = reply(width: 3)
+        let data = try BONJSONEncoder().encode(value)
+        XCTAssertLessThan(data.count, _PositionMap.smallDocumentSize)
+        for strategy in [BONJSONDecoder.MappingStrategy.eager, .lazy, .parallel] {
+            let decoder = BONJSONDecoder()
+            decoder.mappingStrategy = strategy
+            XCTAssertEqual(try decoder.decode(Reply.self, from: data), value)
+        }
+    }
+
+    func testDocumentsEitherSideOfThresholdDecodeAlike() throws {
+        let encoder = BONJSONEncoder()
+        let decoder = BONJSONDecoder()
+        let session = BONJSONSession()
+        var sawSmall = false
+        var sawLarge = false
+        for width in stride(from: 150, through: 350, by: 25) {
+            let value = reply(width: width)
+            let data = try encoder.encode(value)
+            sawSmall = sawSmall || data.count < _PositionMap.smallDocumentSize
+            sawLarge = sawLarge || data.count >= _PositionMap.smallDocumentSize
+            XCTAssertEqual(try decoder.decode(Reply.self, from: data), value)
+            XCTAssertEqual(try decoder.decode(Reply.self, from: data, using: session), value)
+        }
+        XCTAssertTrue(sawSmall && sawLarge)
+    }
+}
+
+// MARK: - Key Interning Tests
+
+final class BONJSONKeyInterningTests: XCTestCase {
+
+    struct Point: Codable, Equatable {
+        var x: Int
+        var y: Int
+        var label: String
+        var tags: [String: Int]
+    }
+
+    private func makePoints(_ count: Int) -> [Point] {
+        return (0..<count).map { i in
+            Point(x: i, y: -i, label: "p\(i % 7)", tags: ["a": i, "label": i % 3])
+        }
+    }
+
+    func testRepeatedKeysInternToOneIdEach() throws {
+        let bytes = Array(try BONJSONEncoder().encode(makePoints(500)))
+
+        var context = KSBONJSONMapContext()
+        ksbonjson_map_beginGrowable(&context, bytes, bytes.count, ksbonjson_defaultDecodeFlags())
+        defer { ksbonjson_map_freeEntries(&context) }
+        ksbonjson_map_setInternKeys(&context, true)
+        XCTAssertEqual(ksbonjson_map_scan(&context), KSBONJSON_DECODE_OK)
+
+        // x, y, label, tags and a, however many objects repeat them
+        XCTAssertEqual(context.internedKeyCount, 5)
+        let labelId = "label".withCString { ksbonjson_map_findKeyId(&context, $0, 5) }
+        XCTAssertLessThan(labelId, 5)
+        XCTAssertEqual("missing".withCString { ksbonjson_map_findKeyId(&context, $0, 7) }, UInt32.max)
+    }
+
+    func testInternedKeysDecodeAlikeAcrossStrategies() throws {
+        let points = makePoints(300)
+        let data = try BONJSONEncoder().encode(points)
+        XCTAssertGreaterThanOrEqual(data.count, _PositionMap.smallDocumentSize)
+        let session = BONJSONSession()
+        for strategy in [BONJSONDecoder.MappingStrategy.eager, .lazy, .parallel] {
+            let decoder = BONJSONDecoder()
+            decoder.mappingStrategy = strategy
+            XCTAssertEqual(try decoder.decode([Point].self, from: data), points)
+            XCTAssertEqual(try decoder.decode([Point].self, from: data, using: session), points)
+        }
+    }
+
+    func testInternedKeysInWideObjectsAndWithConversion() throws {
+        // Wide objects look keys up by id, and a key no object has is simply absent
+        struct Snake: Codable, Equatable {
+            var firstName: String
+            var lastName: String?
+        }
+        let wide = Dictionary(uniqueKeysWithValues: (0..<40).map { ("key_\($0)", $0) })
+        let data = try BONJSONEncoder().encode(Array(repeating: wide, count: 20))
+        let decoder = BONJSONDecoder()
+        XCTAssertEqual(try decoder.decode([[String: Int]].self, from: data), Array(repeating: wide, count: 20))
+
+        let snakes = try BONJSONEncoder().encode(Array(repeating: ["first_name": "Ada", "filler": String(repeating: "z", count: 20)], count: 20))
+        decoder.keyDecodingStrategy = .convertFromSnakeCase
+        XCTAssertEqual(try decoder.decode([Snake].self, from: snakes), Array(repeating: Snake(firstName: "Ada", lastName: nil), count: 20))
+    }
+}
+
+// MARK: - Decoder Pooling Tests
+
+final class BONJSONDecoderPoolingTests: XCTestCase {
+
+    struct Outer: Decodable {
+        struct Inner: Decodable {
+            var value: Int
+        }
+        var inner: Inner
+    }
+
+    /// Reads 14 keys through a keyed container: too many for a linear search and too
+    /// few for the scan's key index, so the object uses the key cache.
+    struct Wide: Decodable {
+        var values: [Int]
+
+        init(from decoder: Decoder) throws {
+            let container = try decoder.container(keyedBy: _StringKey.self)
+            values = try (0..<14).map { try container.decode(Int.self, forKey: _StringKey(stringValue: "k\($0)")) }
+        }
+    }
+
+    /// Keeps its decoder, which must then not be reused for another value.
+    final class Keeper: Decodable {
+        let decoder: Decoder
+
+        init(from decoder: Decoder) throws {
+            self.decoder = decoder
+        }
+    }
+
+    func testErrorPathsAreRightAfterDecodersAreReused() throws {
+        let values: [[String: [String: Int]]] = (0..<100).map { ["inner": [$0 == 73 ? "other" : "value": $0]] }
+        let data = try BONJSONEncoder().encode(values)
+        XCTAssertThrowsError(try BONJSONDecoder().decode([Outer].self, from: data)) { error in
+            guard case DecodingError.keyNotFound(_, let context)? = error as? DecodingError else {
+                return XCTFail("Unexpected error: \(error)")
+            }
+            XCTAssertEqual(context.codingPath.map { $0.intValue.map(String.init) ?? $0.stringValue }, ["73", "inner"])
+        }
+    }
+
+    func testReusedKeyCachesHoldEachObjectsKeys() throws {
+        let objects = (0..<50).map { i in
+            Dictionary(uniqueKeysWithValues: (0..<14).map { ("k\($0)", i * 100 + $0) })
+        }
+        // Below the root, so they aren't encoded as records
+        let data = try BONJSONEncoder().encode(["objects": objects])
+        let decoded = try XCTUnwrap(try BONJSONDecoder().decode([String: [Wide]].self, from: data)["objects"])
+        XCTAssertEqual(decoded.map(\.values), objects.map { object in (0..<14).map { object["k\($0)"]! } })
+    }
+
+    func testDecoderKeptByValueIsNotReused() throws {
+        let data = try BONJSONEncoder().encode([[1], [2], [3]])
+        let keepers = try BONJSONDecoder().decode([Keeper].self, from: data)
+        XCTAssertEqual(keepers.map { $0.decoder.codingPath.first?.intValue }, [0, 1, 2])
+    }
+}
+
+// MARK: - Incremental Decoder Tests
+
+/// Collects the callbacks of the C callback decoders as strings.
+private final class DecodeEventLog {
+    var events: [String] = []
+}
+
+private func recordDecodeEvent(_ userData: UnsafeMutableRawPointer?, _ event: String) -> ksbonjson_decodeStatus {
+    Unmanaged<DecodeEventLog>.fromOpaque(userData!).takeUnretainedValue().events.append(event)
+    return KSBONJSON_DECODE_OK
+}
+
+/// Lives for the whole test run, since incremental contexts keep a pointer to it.
+private let decodeEventCallbacks: UnsafePointer<KSBONJSONDecodeCallbacks> = {
+    let callbacks = UnsafeMutablePointer<KSBONJSONDecodeCallbacks>.allocate(capacity: 1)
+    callbacks.initialize(to: KSBONJSONDecodeCallbacks(
+        onBoolean: { value, userData in recordDecodeEvent(userData, "bool \(value)") },
+        onUnsignedInteger: { value, userData in recordDecodeEvent(userData, "uint \(value)") },
+        onSignedInteger: { value, userData in recordDecodeEvent(userData, "int \(value)") },
+        onFloat: { value, userData in recordDecodeEvent(userData, "float \(value)") },
+        onBigNumber: { value, userData in
+            recordDecodeEvent(userData, "bignum \(value.significandSign) \(value.significand) \(value.exponent)")
+        },
+        onNull: { userData in recordDecodeEvent(userData, "null") },
+        onString: { value, length, userData in
+            let bytes = UnsafeRawBufferPointer(start: value, count: length)
+            return recordDecodeEvent(userData, "string \(String(decoding: bytes, as: UTF8.self))")
+        },
+        onBeginObject: { userData in recordDecodeEvent(userData, "{") },
+        onBeginArray: { userData in recordDecodeEvent(userData, "[") },
+        onEndContainer: { userData in recordDecodeEvent(userData, "}") },
+        onEndData: { userData in recordDecodeEvent(userData, "end") }
+    ))
+    return UnsafePointer(callbacks)
+}()
+
+final class BONJSONIncrementalDecoderTests: XCTestCase {
+
+    private struct Document: Codable {
+        var title: String
+        var values: [Double]
+        var counts: [Int16]
+        var flags: [Bool]
+        var nested: [String: Int]
+        var empty: [UInt8]
+        var missing: String?
+    }
+
+    private func makeDocument() throws -> [UInt8] {
+        let document = Document(
+            title: String(repeating: "title ", count: 60),
+            values: [1.5, -2.25, 1e300],
+            counts: [1, -300, 32000],
+            flags: [true, false],
+            nested: ["answer": 42, "big": 100_000],
+            empty: [],
+            missing: nil
+        )
+        return Array(try BONJSONEncoder().encode(document))
+    }
+
+    private func decodeWhole(_ bytes: [UInt8]) -> (ksbonjson_decodeStatus, [String]) {
+        let log = DecodeEventLog()
+        var offset = 0
+        let status = ksbonjson_decode(bytes, bytes.count, decodeEventCallbacks,
+                                      Unmanaged.passUnretained(log).toOpaque(), &offset)
+        return (status, log.events)
+    }
+
+    private func decodeIncrementally(_ bytes: [UInt8], chunkSize: Int) -> (ksbonjson_decodeStatus, [String]) {
+        let log = DecodeEventLog()
+        var context = KSBONJSONIncrementalDecodeContext()
+        ksbonjson_decodeIncremental_begin(&context, decodeEventCallbacks, Unmanaged.passUnretained(log).toOpaque())
+        for start in stride(from: 0, to: bytes.count, by: chunkSize) {
+            let chunk = Array(bytes[start..<min(start + chunkSize, bytes.count)])
+            guard ksbonjson_decodeIncremental_feed(&context, chunk, chunk.count) == KSBONJSON_DECODE_OK else {
+                break
+            }
+        }
+        return (ksbonjson_decodeIncremental_end(&context), log.events)
+    }
+
+    func testChunkedDecodeMatchesWholeDecode() throws {
+        let bytes = try makeDocument()
+        let (wholeStatus, wholeEvents) = decodeWhole(bytes)
+        XCTAssertEqual(wholeStatus, KSBONJSON_DECODE_OK)
+        XCTAssertEqual(wholeEvents.last, "end")
+
+        for chunkSize in [1, 2, 3, 7, 64, bytes.count] {
+            let (status, events) = decodeIncrementally(bytes, chunkSize: chunkSize)
+            XCTAssertEqual(status, KSBONJSON_DECODE_OK, "chunk size \(chunkSize)")
+            XCTAssertEqual(events, wholeEvents, "chunk size \(chunkSize)")
+        }
+    }
+
+    func testValuesAreReportedBeforeTheDocumentEnds() {
+        // {"a": 1, "b": [2, ...
+        let bytes: [UInt8] = [
+            TestTypeCode.objectStart,
+            TestTypeCode.stringShort(length: 1), 0x61, TestTypeCode.smallInt(1),
+            TestTypeCode.stringShort(length: 1), 0x62, TestTypeCode.arrayStart, TestTypeCode.smallInt(2),
+        ]
+        let log = DecodeEventLog()
+        var context = KSBONJSONIncrementalDecodeContext()
+        ksbonjson_decodeIncremental_begin(&context, decodeEventCallbacks, Unmanaged.passUnretained(log).toOpaque())
+        XCTAssertEqual(ksbonjson_decodeIncremental_feed(&context, bytes, bytes.count), KSBONJSON_DECODE_OK)
+        XCTAssertEqual(log.events, ["{", "string a", "int 1", "string b", "[", "int 2"])
+        XCTAssertEqual(context.decodedOffset, bytes.count)
+        XCTAssertEqual(ksbonjson_decodeIncremental_end(&context), KSBONJSON_DECODE_UNCLOSED_CONTAINERS)
+    }
+
+    func testTruncatedDocumentIsIncomplete() throws {
+        let bytes = try makeDocument()
+        // Cut inside the long title string
+        let (status, events) = decodeIncrementally(Array(bytes.prefix(20)), chunkSize: 5)
+        XCTAssertEqual(status, KSBONJSON_DECODE_INCOMPLETE)
+        XCTAssertFalse(events.contains("end"))
+    }
+
+    func testInvalidDataFailsAndStaysFailed() {
+        // An object whose "name" is an integer
+        let bytes: [UInt8] = [TestTypeCode.objectStart, TestTypeCode.smallInt(5), TestTypeCode.containerEnd]
+        let log = DecodeEventLog()
+        var context = KSBONJSONIncrementalDecodeContext()
+        ksbonjson_decodeIncremental_begin(&context, decodeEventCallbacks, Unmanaged.passUnretained(log).toOpaque())
+        XCTAssertEqual(ksbonjson_decodeIncremental_feed(&context, bytes, bytes.count), KSBONJSON_DECODE_EXPECTED_OBJECT_NAME)
+        XCTAssertEqual(ksbonjson_decodeIncremental_feed(&context, bytes, bytes.count), KSBONJSON_DECODE_EXPECTED_OBJECT_NAME)
+        XCTAssertEqual(ksbonjson_decodeIncremental_end(&context), KSBONJSON_DECODE_EXPECTED_OBJECT_NAME)
+    }
+
+    func testRecordInstancesAreReportedAsObjects() {
+        // Definition ["a", "b"], then [{1, 2}, {3}]: the second instance leaves "b" out
+        let bytes: [UInt8] = [
+            0xB9, TestTypeCode.stringShort(length: 1), 0x61, TestTypeCode.stringShort(length: 1), 0x62,
+            TestTypeCode.containerEnd,
+            TestTypeCode.arrayStart,
+            0xBA, 0x00, TestTypeCode.smallInt(1), TestTypeCode.smallInt(2), TestTypeCode.containerEnd,
+            0xBA, 0x00, TestTypeCode.smallInt(3), TestTypeCode.containerEnd,
+            TestTypeCode.containerEnd,
+        ]
+        let expected = [
+            "[",
+            "{", "string a", "int 1", "string b", "int 2", "}",
+            "{", "string a", "int 3", "string b", "null", "}",
+            "}", "end",
+        ]
+        let (wholeStatus, wholeEvents) = decodeWhole(bytes)
+        XCTAssertEqual(wholeStatus, KSBONJSON_DECODE_OK)
+        XCTAssertEqual(wholeEvents, expected)
+        for chunkSize in [1, 2, 5] {
+            let (status, events) = decodeIncrementally(bytes, chunkSize: chunkSize)
+            XCTAssertEqual(status, KSBONJSON_DECODE_OK, "chunk size \(chunkSize)")
+            XCTAssertEqual(events, expected, "chunk size \(chunkSize)")
+        }
+    }
+}
+
+// MARK: - Document Sequence Tests
+
+final class BONJSONDocumentSequenceTests: XCTestCase {
+
+    struct Event: Codable, Equatable {
+        var id: Int
+        var kind: String
+    }
+
+    private func makeEvents() -> [Event] {
+        return (0..<10).map { Event(id: $0, kind: $0 % 2 == 0 ? "open" : "close") }
+    }
+
+    func testWriterAndReaderRoundTrip() throws {
+        var log = Data()
+        let writer = BONJSONDocumentWriter { log.append(contentsOf: $0) }
+        for event in makeEvents() {
+            try writer.write(event)
+        }
+        XCTAssertEqual(writer.documentCount, 10)
+        XCTAssertEqual(writer.bytesWritten, log.count)
+
+        let reader = BONJSONDocumentReader(data: log)
+        XCTAssertEqual(try reader.decodeAll(Event.self), makeEvents())
+        XCTAssertTrue(reader.isAtEnd)
+        XCTAssertNil(try reader.next(Event.self))
+    }
+
+    func testAppendingToDataMatchesSeparateEncodes() throws {
+        let encoder = BONJSONEncoder()
+        let session = BONJSONSession()
+        var log = Data()
+        var expected = Data()
+        for event in makeEvents() {
+            try encoder.encode(event, appendingTo: &log, using: session)
+            expected.append(try encoder.encode(event))
+        }
+        XCTAssertEqual(log, expected)
+    }
+
+    func testSkipReturnsDocumentRanges() throws {
+        let encoder = BONJSONEncoder()
+        let documents = try [encoder.encode([1, 2, 3]), encoder.encode("x"), encoder.encode(makeEvents())]
+        let log = documents.reduce(Data(), +)
+
+        let ranges = try BONJSONDocumentReader(data: log).remainingRanges()
+        XCTAssertEqual(ranges.map { log[$0] }, documents)
+
+        // Ranges are indices into the reader's data, even for a slice
+        let slice = (Data([0xEE]) + log).dropFirst()
+        let sliceRanges = try BONJSONDocumentReader(data: slice).remainingRanges()
+        XCTAssertEqual(sliceRanges.map { slice[$0] }, documents)
+    }
+
+    func testMixedDocumentTypes() throws {
+        var log = Data()
+        let encoder = BONJSONEncoder()
+        try encoder.encode(makeEvents(), appendingTo: &log)
+        try encoder.encode(42, appendingTo: &log)
+
+        let reader = BONJSONDocumentReader(data: log)
+        XCTAssertEqual(try reader.next([Event].self), makeEvents())
+        XCTAssertEqual(try reader.next(Int.self), 42)
+        XCTAssertNil(try reader.next(Int.self))
+    }
+
+    func testFailedDocumentCanBeSkipped() throws {
+        var log = Data()
+        let encoder = BONJSONEncoder()
+        try encoder.encode("not an event", appendingTo: &log)
+        try encoder.encode(Event(id: 1, kind: "open"), appendingTo: &log)
+
+        let reader = BONJSONDocumentReader(data: log)
+        XCTAssertThrowsError(try reader.next(Event.self))
+        XCTAssertEqual(reader.offset, 0)
+        XCTAssertNotNil(try reader.skip())
+        XCTAssertEqual(try reader.next(Event.self), Event(id: 1, kind: "open"))
+    }
+
+    func testTruncatedLastDocumentThrows() throws {
+        var log = Data()
+        try BONJSONEncoder().encode([1, 2], appendingTo: &log)
+        try BONJSONEncoder().encode([3, 4], appendingTo: &log)
+
+        let reader = BONJSONDocumentReader(data: log.dropLast())
+        XCTAssertEqual(try reader.next([Int].self), [1, 2])
+        XCTAssertThrowsError(try reader.next([Int].self))
+    }
+
+    func testDocumentSizeLimitAppliesPerDocument() throws {
+        var log = Data()
+        for event in makeEvents() {
+            try BONJSONEncoder().encode(event, appendingTo: &log)
+        }
+        let decoder = BONJSONDecoder()
+        decoder.maxDocumentSize = 64
+        XCTAssertGreaterThan(log.count, 64)
+        XCTAssertEqual(try BONJSONDocumentReader(data: log, decoder: decoder).decodeAll(Event.self), makeEvents())
+
+        decoder.maxDocumentSize = 4
+        XCTAssertThrowsError(try BONJSONDocumentReader(data: log, decoder: decoder).next(Event.self))
+    }
+
+    func testCMapScansConsecutiveDocuments() throws {
+        var log = Data()
+        try BONJSONEncoder().encode([1, 2, 3], appendingTo: &log)
+        try BONJSONEncoder().encode(makeEvents(), appendingTo: &log)
+        let bytes = Array(log)
+
+        var context = KSBONJSONMapContext()
+        ksbonjson_map_beginGrowable(&context, bytes, bytes.count, ksbonjson_defaultDecodeFlags())
+        defer { ksbonjson_map_freeEntries(&context) }
+        ksbonjson_map_setLazy(&context, true)
+
+        var offset = 0
+        var rootTypes: [KSBONJSONValueType] = []
+        while offset < bytes.count {
+            XCTAssertEqual(ksbonjson_map_scanNextDocument(&context, bytes, bytes.count, &offset), KSBONJSON_DECODE_OK)
+            XCTAssertTrue(context.isLazy)
+            rootTypes.append(ksbonjson_map_get(&context, ksbonjson_map_root(&context)).pointee.type)
+        }
+        XCTAssertEqual(offset, bytes.count)
+        XCTAssertEqual(rootTypes.count, 2)
+        XCTAssertEqual(ksbonjson_map_scanNextDocument(&context, bytes, bytes.count, &offset), KSBONJSON_DECODE_INCOMPLETE)
+    }
+}
+
+// MARK: - Path Query Tests
+
+final class BONJSONPathQueryTests: XCTestCase {
+
+    struct Item: Codable, Equatable {
+        var name: String
+        var price: Double
+    }
+
+    struct Order: Codable {
+        var id: Int
+        var customer: [String: String]
+        var items: [Item]
+        var samples: [Double]
+        var flags: [String: Bool]
+    }
+
+    func makeDocument(_ decoder: BONJSONDecoder = BONJSONDecoder()) throws -> BONJSONDocument {
+        let order = Order(
+            id: 42,
+            customer: ["name": "Ada", "email": "ada@example.com"],
+            items: [Item(name: "pen", price: 1.5), Item(name: "ink", price: 4), Item(name: "pad", price: 2.25)],
+            samples: [0.5, 1.5, 2.5, 3.5],
+            flags: ["gift": true]
+        )
+        return try BONJSONDocument(data: BONJSONEncoder().encode(order), decoder: decoder)
+    }
+
+    func testSingleValues() throws {
+        let document = try makeDocument()
+        XCTAssertEqual(try document.int64(at: BONJSONPath("$.id")), 42)
+        XCTAssertEqual(try document.uint64(at: BONJSONPath("id")), 42)
+        XCTAssertEqual(try document.double(at: BONJSONPath("$.items[1].price")), 4)
+        XCTAssertEqual(try document.string(at: BONJSONPath("$.customer.name")), "Ada")
+        XCTAssertEqual(try document.string(at: BONJSONPath("$['customer'][\"email\"]")), "ada@example.com")
+        XCTAssertEqual(try document.bool(at: BONJSONPath("$.flags.gift")), true)
+        XCTAssertEqual(try document.double(at: BONJSONPath("$.samples[2]")), 2.5)
+    }
+
+    func testMissingOrMismatchedValuesAreNil() throws {
+        let document = try makeDocument()
+        XCTAssertNil(try document.int64(at: BONJSONPath("$.missing")))
+        XCTAssertNil(try document.int64(at: BONJSONPath("$.items[3].price")))
+        XCTAssertNil(try document.string(at: BONJSONPath("$.items.name")))
+        XCTAssertNil(try document.int64(at: BONJSONPath("$.customer.name")))
+        XCTAssertNil(try document.bool(at: BONJSONPath("$.id")))
+        XCTAssertFalse(try document.contains(BONJSONPath("$.id[0]")))
+        XCTAssertTrue(try document.contains(BONJSONPath("$")))
+    }
+
+    func testWildcards() throws {
+        let document = try makeDocument()
+        XCTAssertEqual(try document.doubles(at: BONJSONPath("$.items[*].price")), [1.5, 4, 2.25])
+        XCTAssertEqual(try document.strings(at: BONJSONPath("$.items[*].name")), ["pen", "ink", "pad"])
+        XCTAssertEqual(try document.int64s(at: BONJSONPath("$.samples.*")), [0, 1, 2, 3])
+        XCTAssertEqual(try document.doubles(at: BONJSONPath("$.samples[*]")), [0.5, 1.5, 2.5, 3.5])
+        XCTAssertEqual(Set(try document.strings(at: BONJSONPath("$.customer.*"))), ["Ada", "ada@example.com"])
+        XCTAssertEqual(try document.count(of: BONJSONPath("$.*")), 5)
+        XCTAssertEqual(try document.bools(at: BONJSONPath("$.flags[*]")), [true])
+        XCTAssertEqual(try document.int64s(at: BONJSONPath("$.missing[*]")), [])
+    }
+
+    func testDecodeAtPath() throws {
+        let document = try makeDocument()
+        XCTAssertEqual(try document.decode(Item.self, at: BONJSONPath("$.items[2]")), Item(name: "pad", price: 2.25))
+        XCTAssertEqual(try document.decodeAll(Item.self, at: BONJSONPath("$.items[*]")).map(\.name), ["pen", "ink", "pad"])
+        XCTAssertEqual(try document.decode([Double].self, at: BONJSONPath("$.samples")), [0.5, 1.5, 2.5, 3.5])
+        XCTAssertNil(try document.decode(Item.self, at: BONJSONPath("$.items[9]")))
+    }
+
+    func testKeyStrategyDoesNotApplyToPaths() throws {
+        let data = try BONJSONEncoder().encode(["user_id": 7])
+        let decoder = BONJSONDecoder()
+        decoder.keyDecodingStrategy = .convertFromSnakeCase
+        let document = try BONJSONDocument(data: data, decoder: decoder)
+        XCTAssertEqual(try document.int64(at: BONJSONPath("$.user_id")), 7)
+        XCTAssertNil(try document.int64(at: BONJSONPath("$.userId")))
+    }
+
+    func testRecordFields() throws {
+        // Root arrays of keyed objects are encoded as records by default
+        let items = [Item(name: "a", price: 1), Item(name: "b", price: 2)]
+        let document = try BONJSONDocument(data: BONJSONEncoder().encode(items))
+        XCTAssertEqual(try document.doubles(at: BONJSONPath("$[*].price")), [1, 2])
+        XCTAssertEqual(try document.string(at: BONJSONPath("$[1].name")), "b")
+    }
+
+    func testMalformedPathsThrow() {
+        for expression in ["$.", "$[", "$[x]", "$..a", "$[\"a]", "$[1", "$.a b[0]x", "$.a b", "$.a\"", "$.a*", "a b"] {
+            XCTAssertThrowsError(try BONJSONPath(expression), expression)
+        }
+        let tooDeep = "$" + String(repeating: ".a", count: Int(KSBONJSON_MAX_PATH_STEPS) + 1)
+        XCTAssertThrowsError(try BONJSONPath(tooDeep))
+    }
+
+    func testMalformedContainerThrowsWhenQueried() throws {
+        // The lazy scan only checks structure; the non-string key inside "a" is found by the query
+        let data = Data([
+            TestTypeCode.objectStart,
+            TestTypeCode.stringShort(length: 1), 0x61,
+            TestTypeCode.objectStart, TestTypeCode.smallInt(5), TestTypeCode.smallInt(5), TestTypeCode.containerEnd,
+            TestTypeCode.stringShort(length: 1), 0x7A, TestTypeCode.smallInt(1),
+            TestTypeCode.containerEnd,
+        ])
+        let document = try BONJSONDocument(data: data)
+        XCTAssertEqual(try document.int64(at: BONJSONPath("$.z")), 1)
+        XCTAssertThrowsError(try document.int64(at: BONJSONPath("$.a.b")))
+    }
+
+    func testCPathQueriesOnLazyMap() throws {
+        let bytes = Array(try BONJSONEncoder().encode(["a": [["b": 1], ["b": 2]], "c": [["b": 3]]]))
+        var context = KSBONJSONMapContext()
+        ksbonjson_map_beginGrowable(&context, bytes, bytes.count, ksbonjson_defaultDecodeFlags())
+        defer { ksbonjson_map_freeEntries(&context) }
+        ksbonjson_map_setLazy(&context, true)
+        XCTAssertEqual(ksbonjson_map_scan(&context), KSBONJSON_DECODE_OK)
+        let scannedCount = context.entriesCount
+
+        let expression = Array("$.a[*].b".utf8CString)
+        var path = KSBONJSONPath()
+        XCTAssertTrue(ksbonjson_path_compile(&path, expression, expression.count - 1))
+        var values = [Int64](repeating: 0, count: 1)
+        var status = KSBONJSON_DECODE_INVALID_DATA
+        XCTAssertEqual(ksbonjson_path_decodeInt64s(&context, &path, ksbonjson_map_root(&context), &values, 1, &status), 2)
+        XCTAssertEqual(status, KSBONJSON_DECODE_OK)
+        XCTAssertEqual(values, [1])
+
+        // Only "a" and its elements were expanded, not "c"
+        XCTAssertGreaterThan(context.entriesCount, scannedCount)
+        let cIndex = ksbonjson_map_findKey(&context, ksbonjson_map_root(&context), "c", 1)
+        XCTAssertEqual(ksbonjson_map_get(&context, cIndex).pointee.data.container.count, UInt32.max)
+    }
+}
+
+// MARK: - Fragment Tests
+
+final class BONJSONFragmentTests: XCTestCase {
+
+    struct Profile: Codable, Equatable {
+        var name: String
+        var tags: [String]
+    }
+
+    struct Response<Body: Encodable>: Encodable {
+        var requestID: Int
+        var profile: Body
+    }
+
+    struct DecodedResponse: Decodable, Equatable {
+        var requestID: Int
+        var profile: Profile
+    }
+
+    let profile = Profile(name: "Ada", tags: ["admin", "ops"])
+
+    func testSplicedFragmentMatchesEncodingInPlace() throws {
+        let encoder = BONJSONEncoder()
+        let fragment = try BONJSONFragment(encoding: profile)
+        let spliced = try encoder.encode(Response(requestID: 7, profile: fragment))
+        let direct = try encoder.encode(Response(requestID: 7, profile: profile))
+        XCTAssertEqual(spliced, direct)
+        XCTAssertEqual(try BONJSONDecoder().decode(DecodedResponse.self, from: spliced),
+                       DecodedResponse(requestID: 7, profile: profile))
+    }
+
+    func testFragmentsInArraysAndAtRoot() throws {
+        let fragment = try BONJSONFragment(encoding: profile)
+        let encoder = BONJSONEncoder()
+        XCTAssertEqual(try encoder.encode(fragment), fragment.bytes)
+
+        // An array of fragments is never mistaken for a record array
+        let data = try encoder.encode([fragment, fragment, fragment])
+        XCTAssertEqual(try BONJSONDecoder().decode([Profile].self, from: data), [profile, profile, profile])
+    }
+
+    func testFragmentNeverUsesRecords() throws {
+        let profiles = [profile, Profile(name: "Bob", tags: [])]
+        XCTAssertEqual(try BONJSONEncoder().encode(profiles).first, 0xB9)
+        let fragment = try BONJSONFragment(encoding: profiles)
+        XCTAssertEqual(fragment.bytes.first, TestTypeCode.arrayStart)
+        let data = try BONJSONEncoder().encode(["people": fragment])
+        XCTAssertEqual(try BONJSONDecoder().decode([String: [Profile]].self, from: data), ["people": profiles])
+    }
+
+    func testStreamedFragment() throws {
+        let fragment = try BONJSONFragment(encoding: String(repeating: "x", count: 1000))
+        let encoder = BONJSONEncoder()
+        encoder.streamingChunkSize = 256
+        var streamed = Data()
+        try encoder.encode([fragment, fragment]) { streamed.append(contentsOf: $0) }
+        XCTAssertEqual(try BONJSONDecoder().decode([String].self, from: streamed).map(\.count), [1000, 1000])
+    }
+
+    func testInvalidFragmentBytesThrow() throws {
+        XCTAssertThrowsError(try BONJSONFragment(bytes: Data()))
+        XCTAssertThrowsError(try BONJSONFragment(bytes: Data([TestTypeCode.arrayStart])))
+        XCTAssertThrowsError(try BONJSONFragment(bytes: Data([TestTypeCode.smallInt(1), TestTypeCode.smallInt(2)])))
+        XCTAssertThrowsError(try BONJSONFragment(bytes: BONJSONEncoder().encode([profile, profile])))
+        XCTAssertEqual(try BONJSONFragment(bytes: Data([TestTypeCode.true])).bytes, Data([TestTypeCode.true]))
+    }
+
+    func testFragmentDepthCountsTowardsMaxDepth() throws {
+        let nested = [[["x"]]]
+        let fragments = [
+            try BONJSONFragment(encoding: nested),
+            try BONJSONFragment(bytes: BONJSONEncoder().encode(nested)),
+        ]
+        for fragment in fragments {
+            let encoder = BONJSONEncoder()
+            encoder.maxDepth = 3
+            XCTAssertEqual(try encoder.encode(fragment), fragment.bytes)
+            XCTAssertThrowsError(try encoder.encode(["a": fragment])) { error in
+                guard case BONJSONEncodingError.maxDepthExceeded = error else {
+                    return XCTFail("Expected maxDepthExceeded, got \(error)")
+                }
+            }
+            encoder.maxDepth = 4
+            XCTAssertEqual(try BONJSONDecoder().decode([String: [[[String]]]].self, from: encoder.encode(["a": fragment])),
+                           ["a": nested])
+        }
+    }
+
+    func testOtherEncodersRejectFragments() throws {
+        let fragment = try BONJSONFragment(bytes: Data([TestTypeCode.null]))
+        XCTAssertThrowsError(try JSONEncoder().encode([fragment]))
+    }
+
+    func testCFragmentBookkeeping() throws {
+        var buffer = [UInt8](repeating: 0, count: 64)
+        var flags = ksbonjson_defaultEncodeFlags()
+        flags.maxDepth = Int.max
+        flags.maxStringLength = Int.max
+        flags.maxContainerSize = Int.max
+        flags.maxDocumentSize = Int.max
+        var context = KSBONJSONBufferEncodeContext()
+        let fragment: [UInt8] = [TestTypeCode.objectStart, TestTypeCode.stringShort(length: 1), 0x61,
+                                 TestTypeCode.smallInt(1), TestTypeCode.containerEnd]
+        buffer.withUnsafeMutableBufferPointer { bytes in
+            ksbonjson_encodeToBuffer_beginWithFlags(&context, bytes.baseAddress, bytes.count, flags)
+            XCTAssertEqual(ksbonjson_encodeToBuffer_beginObject(&context), 1)
+            XCTAssertEqual(ksbonjson_encodeToBuffer_fragment(&context, fragment, fragment.count, 1),
+                           -Int(KSBONJSON_ENCODE_EXPECTED_OBJECT_NAME.rawValue))
+            XCTAssertEqual(ksbonjson_encodeToBuffer_string(&context, "k", 1), 2)
+            XCTAssertEqual(ksbonjson_encodeToBuffer_fragment(&context, fragment, fragment.count, Int.max),
+                           -Int(KSBONJSON_ENCODE_MAX_DEPTH_EXCEEDED.rawValue))
+            XCTAssertEqual(ksbonjson_encodeToBuffer_fragment(&context, fragment, fragment.count, 1), fragment.count)
+            XCTAssertEqual(ksbonjson_encodeToBuffer_fragment(&context, [TestTypeCode.containerEnd], 1, 0),
+                           -Int(KSBONJSON_ENCODE_INVALID_DATA.rawValue))
+            XCTAssertGreaterThan(ksbonjson_encodeToBuffer_endAllContainers(&context), 0)
+        }
+        let length = ksbonjson_encodeToBuffer_end(&context)
+        XCTAssertEqual(try BONJSONDecoder().decode([String: [String: Int]].self, from: Data(buffer[..<length])),
+                       ["k": ["a": 1]])
+    }
+}
+
+// MARK: - Column Encoding Tests
+
+final class BONJSONColumnEncodingTests: XCTestCase {
+
+    struct AnyKey: CodingKey {
+        var stringValue: String
+        var intValue: Int? { nil }
+        init(stringValue: String) { self.stringValue = stringValue }
+        init?(intValue: Int) { nil }
+    }
+
+    /// Encodes a dictionary entry by entry through a keyed container, as Dictionary itself would.
+    struct KeyedDictionary<Value: Encodable>: Encodable {
+        var dictionary: [String: Value]
+        func encode(to encoder: Encoder) throws {
+            var container = encoder.container(keyedBy: AnyKey.self)
+            for (key, value) in dictionary {
+                try container.encode(value, forKey: AnyKey(stringValue: key))
+            }
+        }
+    }
+
+    func assertMatchesKeyedEncoding<Value: Encodable & Decodable & Equatable>(
+        _ dictionary: [String: Value], file: StaticString = #filePath, line: UInt = #line
+    ) throws {
+        let encoder = BONJSONEncoder()
+        let fast = try encoder.encode(dictionary)
+        XCTAssertEqual(fast, try encoder.encode(KeyedDictionary(dictionary: dictionary)), file: file, line: line)
+        XCTAssertEqual(try BONJSONDecoder().decode([String: Value].self, from: fast), dictionary, file: file, line: line)
+    }
+
+    func testDictionariesMatchKeyedEncoding() throws {
+        try assertMatchesKeyedEncoding(["a": 1, "b": -300, "c": Int.max, "d": Int.min, "e": 0])
+        try assertMatchesKeyedEncoding(["name": "Ada", "empty": "", "long": String(repeating: "é", count: 100)])
+        try assertMatchesKeyedEncoding(["on": true, "off": false])
+        try assertMatchesKeyedEncoding([String: Int]())
+        try assertMatchesKeyedEncoding([String(repeating: "k", count: 80): "v"])
+    }
+
+    func testNestedDictionaries() throws {
+        struct Config: Codable, Equatable {
+            var counts: [String: Int]
+            var labels: [[String: String]]
+        }
+        let config = Config(counts: ["x": 1, "y": 2], labels: [["a": "b"], [:], ["c": "d", "e": "f"]])
+        let data = try BONJSONEncoder().encode(config)
+        XCTAssertEqual(try BONJSONDecoder().decode(Config.self, from: data), config)
+    }
+
+    func testDictionaryArraysStillUseRecords() throws {
+        let rows: [[String: Int]] = [["a": 1], ["a": 2], ["a": 3]]
+        let data = try BONJSONEncoder().encode(rows)
+        XCTAssertEqual(data.first, 0xB9)
+        XCTAssertEqual(try BONJSONDecoder().decode([[String: Int]].self, from: data), rows)
+    }
+
+    func testDictionaryLimitsAndNUL() throws {
+        XCTAssertThrowsError(try BONJSONEncoder().encode(["k": "a\u{0}b"])) { error in
+            guard case BONJSONEncodingError.nulCharacterInString = error else {
+                return XCTFail("Expected nulCharacterInString, got \(error)")
+            }
+        }
+        XCTAssertThrowsError(try BONJSONEncoder().encode(["a\u{0}b": 1])) { error in
+            guard case BONJSONEncodingError.nulCharacterInString = error else {
+                return XCTFail("Expected nulCharacterInString, got \(error)")
+            }
+        }
+        let encoder = BONJSONEncoder()
+        encoder.maxStringLength = 3
+        XCTAssertThrowsError(try encoder.encode(["key": "long"])) { error in
+            guard case BONJSONEncodingError.maxStringLengthExceeded = error else {
+                return XCTFail("Expected maxStringLengthExceeded, got \(error)")
+            }
+        }
+        encoder.maxStringLength = 10
+        encoder.maxDepth = 1
+        XCTAssertThrowsError(try encoder.encode([["k": 1]])) { error in
+            guard case BONJSONEncodingError.maxDepthExceeded = error else {
+                return XCTFail("Expected maxDepthExceeded, got \(error)")
+            }
+        }
+    }
+
+    func testConvertedKeysTakeTheKeyedPath() throws {
+        let encoder = BONJSONEncoder()
+        encoder.keyEncodingStrategy = .convertToSnakeCase
+        let data = try encoder.encode(["someKey": 1])
+        XCTAssertEqual(try BONJSONDecoder().decode([String: Int].self, from: data), ["some_key": 1])
+    }
+
+    /// A C string that stays valid, for columns built outside a call.
+    func cString(_ string: StaticString) -> UnsafePointer<CChar> {
+        return UnsafeRawPointer(string.utf8Start).assumingMemoryBound(to: CChar.self)
+    }
+
+    struct Row {
+        var id: Int64
+        var score: Double
+        var active: Bool
+        var name: KSBONJSONColumnString
+    }
+
+    struct DecodedRow: Decodable, Equatable {
+        var id: Int64
+        var score: Double
+        var active: Bool
+        var name: String
+    }
+
+    func encodeRows(asRecords: Bool) throws -> Data {
+        let rows = [
+            Row(id: 1, score: 1.5, active: true, name: KSBONJSONColumnString(bytes: cString("a"), length: 1)),
+            Row(id: -300, score: 0.1, active: false, name: KSBONJSONColumnString(bytes: cString("bb"), length: 2)),
+        ]
+        var buffer = [UInt8](repeating: 0, count: 256)
+        var flags = ksbonjson_defaultEncodeFlags()
+        flags.maxDepth = Int.max
+        flags.maxStringLength = Int.max
+        flags.maxContainerSize = Int.max
+        flags.maxDocumentSize = Int.max
+        var context = KSBONJSONBufferEncodeContext()
+        let stride = MemoryLayout<Row>.stride
+        buffer.withUnsafeMutableBufferPointer { bytes in
+            ksbonjson_encodeToBuffer_beginWithFlags(&context, bytes.baseAddress, bytes.count, flags)
+            if asRecords {
+                var definition: [UInt8] = [0xB9] // TYPE_RECORD_DEF
+                for key in ["id", "score", "active", "name"] {
+                    definition.append(TestTypeCode.stringShort(length: key.utf8.count))
+                    definition.append(contentsOf: key.utf8)
+                }
+                definition.append(TestTypeCode.containerEnd)
+                bytes.baseAddress!.update(from: definition, count: definition.count)
+                context.position = definition.count
+            }
+            XCTAssertEqual(ksbonjson_encodeToBuffer_beginArray(&context), 1)
+            rows.withUnsafeBytes { raw in
+                let base = raw.baseAddress!
+                let columns = [
+                    KSBONJSONColumn(key: cString("id"), keyLength: 2, type: KSBONJSON_COLUMN_INT64,
+                                    values: base + MemoryLayout<Row>.offset(of: \.id)!, stride: stride),
+                    KSBONJSONColumn(key: cString("score"), keyLength: 5, type: KSBONJSON_COLUMN_DOUBLE,
+                                    values: base + MemoryLayout<Row>.offset(of: \.score)!, stride: stride),
+                    KSBONJSONColumn(key: cString("active"), keyLength: 6, type: KSBONJSON_COLUMN_BOOL,
+                                    values: base + MemoryLayout<Row>.offset(of: \.active)!, stride: stride),
+                    KSBONJSONColumn(key: cString("name"), keyLength: 4, type: KSBONJSON_COLUMN_STRING,
+                                    values: base + MemoryLayout<Row>.offset(of: \.name)!, stride: stride),
+                ]
+                let maxSize = ksbonjson_maxEncodedSize_columns(columns, columns.count, rows.count, asRecords)
+                let start = context.position
+                let written = asRecords
+                    ? ksbonjson_encodeToBuffer_recordRows(&context, 0, columns, columns.count, rows.count)
+                    : ksbonjson_encodeToBuffer_objectRows(&context, columns, columns.count, rows.count)
+                XCTAssertEqual(written, context.position - start)
+                XCTAssertLessThanOrEqual(written, maxSize)
+                XCTAssertEqual(context.containerElementCounts.1, rows.count)
+            }
+            XCTAssertEqual(ksbonjson_encodeToBuffer_endContainer(&context), 1)
+        }
+        return Data(buffer[..<ksbonjson_encodeToBuffer_end(&context)])
+    }
+
+    func testCObjectAndRecordRows() throws {
+        let expected = [DecodedRow(id: 1, score: 1.5, active: true, name: "a"),
+                        DecodedRow(id: -300, score: 0.1, active: false, name: "bb")]
+        let objects = try encodeRows(asRecords: false)
+        XCTAssertEqual(try BONJSONDecoder().decode([DecodedRow].self, from: objects), expected)
+        let records = try encodeRows(asRecords: true)
+        XCTAssertEqual(try BONJSONDecoder().decode([DecodedRow].self, from: records), expected)
+        XCTAssertLessThan(records.count, objects.count)
+    }
+
+    func testCRowsValidateBeforeWriting() throws {
+        var buffer = [UInt8](repeating: 0, count: 64)
+        var flags = ksbonjson_defaultEncodeFlags()
+        flags.maxDepth = Int.max
+        flags.maxStringLength = Int.max
+        flags.maxContainerSize = Int.max
+        flags.maxDocumentSize = Int.max
+        var context = KSBONJSONBufferEncodeContext()
+        let values: [Double] = [1, .nan]
+        buffer.withUnsafeMutableBufferPointer { bytes in
+            ksbonjson_encodeToBuffer_beginWithFlags(&context, bytes.baseAddress, bytes.count, flags)
+            XCTAssertEqual(ksbonjson_encodeToBuffer_beginArray(&context), 1)
+            values.withUnsafeBytes { raw in
+                var columns = [KSBONJSONColumn(key: cString("x"), keyLength: 1, type: KSBONJSON_COLUMN_DOUBLE,
+                                               values: raw.baseAddress, stride: 0)]
+                XCTAssertEqual(ksbonjson_encodeToBuffer_objectRows(&context, columns, 1, 2),
+                               -Int(KSBONJSON_ENCODE_INVALID_DATA.rawValue))
+                XCTAssertEqual(context.position, 1)
+                columns[0].key = cString("a\u{0}")
+                columns[0].keyLength = 2
+                XCTAssertEqual(ksbonjson_encodeToBuffer_objectRows(&context, columns, 1, 1),
+                               -Int(KSBONJSON_ENCODE_NUL_CHARACTER.rawValue))
+                XCTAssertEqual(context.position, 1)
+                // Only the first row, which is finite
+                columns[0].keyLength = 1
+                XCTAssertEqual(ksbonjson_encodeToBuffer_objectRows(&context, columns, 1, 1), 5)
+            }
+        }
+    }
+}
+
+// MARK: - Field Coding Tests
+
+final class BONJSONFieldCodingTests: XCTestCase {
+
+    struct Address: Codable, Equatable {
+        var city: String
+    }
+
+    struct Person: Codable, Equatable, BONJSONFieldCodable {
+        var name: String
+        var age: Int
+        var score: Double
+        var active: Bool
+        var email: String?
+        var address: Address
+
+        static let bonjsonFields = BONJSONFieldTable(["name", "age", "score", "active", "email", "address"])
+
+        init(name: String, age: Int, score: Double, active: Bool, email: String?, address: Address) {
+            self.name = name
+            self.age = age
+            self.score = score
+            self.active = active
+            self.email = email
+            self.address = address
+        }
+
+        func encodeFields(to writer: inout BONJSONFieldWriter) throws {
+            try writer.encode(name, at: 0)
+            try writer.encode(age, at: 1)
+            try writer.encode(score, at: 2)
+            try writer.encode(active, at: 3)
+            try writer.encodeIfPresent(email, at: 4)
+            try writer.encode(address, at: 5)
+        }
+
+        init(fields reader: inout BONJSONFieldReader) throws {
+            name = try reader.decode(String.self, at: 0)
+            age = try reader.decode(Int.self, at: 1)
+            score = try reader.decode(Double.self, at: 2)
+            active = try reader.decode(Bool.self, at: 3)
+            email = try reader.decodeIfPresent(String.self, at: 4)
+            address = try reader.decode(Address.self, at: 5)
+        }
+    }
+
+    /// The same shape without a field conformance, so it goes through the Codable containers.
+    struct PlainPerson: Codable, Equatable {
+        var name: String
+        var age: Int
+        var score: Double
+        var active: Bool
+        var email: String?
+        var address: Address
+    }
+
+    let people = [
+        Person(name: "Ada", age: 36, score: 9.5, active: true, email: "ada@example.com", address: Address(city: "London")),
+        Person(name: "Bob", age: -2, score: 0.1, active: false, email: nil, address: Address(city: "")),
+    ]
+
+    func plain(_ person: Person) -> PlainPerson {
+        return PlainPerson(name: person.name, age: person.age, score: person.score, active: person.active,
+                           email: person.email, address: person.address)
+    }
+
+    func testFieldEncodingMatchesCodable() throws {
+        let encoder = BONJSONEncoder()
+        for person in people {
+            XCTAssertEqual(try encoder.encode(person), try encoder.encode(plain(person)))
+            XCTAssertEqual(try encoder.encode(["p": person]), try encoder.encode(["p": plain(person)]))
+        }
+        // Root arrays are records, whose elements go through the Codable path
+        XCTAssertEqual(try encoder.encode(people), try encoder.encode(people.map(plain)))
+    }
+
+    func testFieldDecodingRoundTrips() throws {
+        let decoder = BONJSONDecoder()
+        let encoder = BONJSONEncoder()
+        for person in people {
+            XCTAssertEqual(try decoder.decode(Person.self, from: encoder.encode(person)), person)
+        }
+        // Compact records and nested objects
+        XCTAssertEqual(try decoder.decode([Person].self, from: encoder.encode(people)), people)
+        XCTAssertEqual(try decoder.decode([String: Person].self, from: encoder.encode(["x": people[0]])), ["x": people[0]])
+        decoder.mappingStrategy = .lazy
+        XCTAssertEqual(try decoder.decode([Person].self, from: encoder.encode(people)), people)
+    }
+
+    func testFieldsOutOfOrderAndMissing() throws {
+        struct Reordered: Encodable {
+            var address: Address
+            var active: Bool
+            var score: Double
+            var age: Int
+            var name: String
+            var extra: [Int]
+        }
+        let data = try BONJSONEncoder().encode(Reordered(address: Address(city: "Oslo"), active: true,
+                                                         score: 2, age: 7, name: "Eve", extra: [1, 2]))
+        XCTAssertEqual(try BONJSONDecoder().decode(Person.self, from: data),
+                       Person(name: "Eve", age: 7, score: 2, active: true, email: nil, address: Address(city: "Oslo")))
+
+        let missing = try BONJSONEncoder().encode(["name": "Eve"])
+        XCTAssertThrowsError(try BONJSONDecoder().decode(Person.self, from: missing)) { error in
+            guard case DecodingError.keyNotFound(let key, _) = error else {
+                return XCTFail("Expected keyNotFound, got \(error)")
+            }
+            XCTAssertEqual(key.stringValue, "age")
+        }
+    }
+
+    func testFieldTypeMismatchThrows() throws {
+        let data = try BONJSONEncoder().encode(["name": 1])
+        XCTAssertThrowsError(try BONJSONDecoder().decode(Person.self, from: data))
+        XCTAssertThrowsError(try BONJSONDecoder().decode(Person.self, from: BONJSONEncoder().encode([1, 2])))
+    }
+
+    func testConvertedKeysUseCodable() throws {
+        struct Snake: Codable, Equatable, BONJSONFieldCodable {
+            var userID: Int
+            static let bonjsonFields = BONJSONFieldTable(["userID"])
+            init(userID: Int) { self.userID = userID }
+            func encodeFields(to writer: inout BONJSONFieldWriter) throws {
+                try writer.encode(userID, at: 0)
+            }
+            init(fields reader: inout BONJSONFieldReader) throws {
+                userID = try reader.decode(Int.self, at: 0)
+            }
+        }
+        let encoder = BONJSONEncoder()
+        encoder.keyEncodingStrategy = .convertToSnakeCase
+        let data = try encoder.encode(Snake(userID: 3))
+        XCTAssertEqual(try BONJSONDecoder().decode([String: Int].self, from: data), ["user_id": 3])
+        let decoder = BONJSONDecoder()
+        decoder.keyDecodingStrategy = .convertFromSnakeCase
+        XCTAssertEqual(try decoder.decode(Snake.self, from: data), Snake(userID: 3))
+    }
+
+    func testFieldEncodingLimits() throws {
+        let encoder = BONJSONEncoder()
+        encoder.maxDepth = 1
+        XCTAssertThrowsError(try encoder.encode(people[0])) { error in
+            guard case BONJSONEncodingError.maxDepthExceeded = error else {
+                return XCTFail("Expected maxDepthExceeded, got \(error)")
+            }
+        }
+        XCTAssertThrowsError(try BONJSONEncoder().encode(
+            Person(name: "a\u{0}", age: 0, score: 0, active: false, email: nil, address: Address(city: "")))) { error in
+            guard case BONJSONEncodingError.nulCharacterInString = error else {
+                return XCTFail("Expected nulCharacterInString, got \(error)")
+            }
+        }
+        XCTAssertThrowsError(try BONJSONEncoder().encode(
+            Person(name: "", age: 0, score: .nan, active: false, email: nil, address: Address(city: ""))))
+    }
+}
+
+// MARK: - Statistics Tests
+
+final class BONJSONStatisticsTests: XCTestCase {
+
+    struct Item: Codable, Equatable {
+        var name: String
+        var tags: [String]
+        var score: Double
+    }
+
+    let items = [
+        Item(name: "first", tags: ["a", String(repeating: "long ", count: 20)], score: 1.5),
+        Item(name: "second", tags: [], score: 2),
+    ]
+
+    func testHandlersAreOnlyCalledInStatisticsBuilds() throws {
+        var encodeStatistics: BONJSONEncoder.Statistics?
+        let encoder = BONJSONEncoder()
+        encoder.statisticsHandler = { encodeStatistics = $0 }
+        let data = try encoder.encode(items)
+
+        var decodeStatistics: BONJSONDecoder.Statistics?
+        let decoder = BONJSONDecoder()
+        decoder.statisticsHandler = { decodeStatistics = $0 }
+        XCTAssertEqual(try decoder.decode([Item].self, from: data), items)
+
+        #if BONJSON_STATS
+        XCTAssertNotNil(encodeStatistics)
+        XCTAssertNotNil(decodeStatistics)
+        #else
+        XCTAssertNil(encodeStatistics)
+        XCTAssertNil(decodeStatistics)
+        #endif
+    }
+
+    #if BONJSON_STATS
+    func testEncodingCounts() throws {
+        var statistics = BONJSONEncoder.Statistics?.none
+        let encoder = BONJSONEncoder()
+        encoder.statisticsHandler = { statistics = $0 }
+        _ = try encoder.encode(items)
+
+        let stats = try XCTUnwrap(statistics)
+        XCTAssertEqual(stats.recordInstanceCount, 2)
+        XCTAssertEqual(stats.objectCount, 0)
+        XCTAssertEqual(stats.longStringCount, 1)
+        XCTAssertEqual(stats.longStringBytes, 100)
+        XCTAssertEqual(stats.integerCount + stats.floatCount, 2)
+        XCTAssertEqual(stats.encodeNanoseconds, 0)
+    }
+
+    func testDecodingCounts() throws {
+        let data = try BONJSONEncoder().encode(items)
+        var statistics = BONJSONDecoder.Statistics?.none
+        let decoder = BONJSONDecoder()
+        decoder.statisticsIncludeTimings = true
+        decoder.statisticsHandler = { statistics = $0 }
+        _ = try decoder.decode([Item].self, from: data)
+
+        let stats = try XCTUnwrap(statistics)
+        XCTAssertEqual(stats.longStringCount, 1)
+        XCTAssertEqual(stats.longStringBytes, 100)
+        XCTAssertEqual(stats.fastValidationCount + stats.slowValidationCount,
+                       stats.shortStringCount + stats.longStringCount)
+        XCTAssertGreaterThan(stats.scanNanoseconds, 0)
+    }
+
+    func testLazyExpansionsAreCounted() throws {
+        let data = try BONJSONEncoder().encode(["a": ["x": 1], "b": ["y": 2]])
+        var statistics = BONJSONDecoder.Statistics?.none
+        let decoder = BONJSONDecoder()
+        decoder.mappingStrategy = .lazy
+        decoder.statisticsHandler = { statistics = $0 }
+        _ = try decoder.decode([String: [String: Int]].self, from: data)
+
+        let stats = try XCTUnwrap(statistics)
+        XCTAssertGreaterThan(stats.expansionCount, 0)
+    }
+    #endif
+}
+
+// MARK: - Transcoder Tests
+
+final class BONJSONTranscoderTests: XCTestCase {
+
+    struct Item: Codable, Equatable {
+        var id: Int
+        var name: String
+        var scores: [Double]
+    }
+
+    private let itemsJSON = """
+        [
+            {"id": 1, "name": "first", "scores": [1.5, 2]},
+            {"id": 2, "name": "second\\n", "scores": [0.25]},
+            {"id": 3, "name": "\\u00e9t\\u00e9", "scores": []}
+        ]
+        """
+
+    private let items = [
+        Item(id: 1, name: "first", scores: [1.5, 2]),
+        Item(id: 2, name: "second\n", scores: [0.25]),
+        Item(id: 3, name: "été", scores: []),
+    ]
+
+    func testJSONToBONJSONDecodes() throws {
+        let bonjson = try BONJSONTranscoder().bonjson(fromJSON: Data(itemsJSON.utf8))
+        XCTAssertEqual(try BONJSONDecoder().decode([Item].self, from: bonjson), items)
+    }
+
+    func testRootArrayOfSameShapedObjectsUsesRecords() throws {
+        let transcoder = BONJSONTranscoder()
+        XCTAssertEqual(try transcoder.bonjson(fromJSON: Data(itemsJSON.utf8)).first, 0xB9)
+
+        transcoder.usesRecords = false
+        let plain = try transcoder.bonjson(fromJSON: Data(itemsJSON.utf8))
+        XCTAssertEqual(plain.first, TestTypeCode.arrayStart)
+        XCTAssertEqual(try BONJSONDecoder().decode([Item].self, from: plain), items)
+    }
+
+    func testNumbersKeepTheirKind() throws {
+        struct Numbers: Codable, Equatable {
+            var small: Int
+            var large: UInt64
+            var negative: Int64
+            var fraction: Double
+            var bytes: [UInt8]
+            var mixed: [Double]
+        }
+        let json = """
+            {"small": 5, "large": 18446744073709551615, "negative": -9223372036854775808,
+             "fraction": 0.1, "bytes": [0, 128, 255], "mixed": [1, 2.5, -3e-2]}
+            """
+        let transcoder = BONJSONTranscoder()
+        let bonjson = try transcoder.bonjson(fromJSON: Data(json.utf8))
+        XCTAssertTrue(bonjson.contains(0xFE), "Expected a uint8 typed array")
+        XCTAssertEqual(try BONJSONDecoder().decode(Numbers.self, from: bonjson), Numbers(
+            small: 5, large: .max, negative: .min, fraction: 0.1, bytes: [0, 128, 255], mixed: [1, 2.5, -0.03]))
+
+        transcoder.usesTypedArrays = false
+        let untyped = try transcoder.bonjson(fromJSON: Data(json.utf8))
+        XCTAssertFalse(untyped.contains(0xFE))
+        XCTAssertEqual(try BONJSONDecoder().decode(Numbers.self, from: untyped),
+                       try BONJSONDecoder().decode(Numbers.self, from: bonjson))
+    }
+
+    func testBONJSONToJSONIsCompact() throws {
+        let transcoder = BONJSONTranscoder()
+        let bonjson = try transcoder.bonjson(fromJSON: Data(#"{ "a": [1, 2.5, "x\n"], "b": null, "c": {} }"#.utf8))
+        let json = try transcoder.json(fromBONJSON: bonjson)
+        XCTAssertEqual(String(decoding: json, as: UTF8.self), #"{"a":[1,2.5,"x\n"],"b":null,"c":{}}"#)
+    }
+
+    func testFloatsUseShortestForm() throws {
+        let bonjson = try BONJSONEncoder().encode([0.1, 1.0 / 3.0, 5e-324, 1e-310])
+        let json = try BONJSONTranscoder().json(fromBONJSON: bonjson)
+        XCTAssertEqual(String(decoding: json, as: UTF8.self), "[0.1,0.3333333333333333,5e-324,1e-310]")
+    }
+
+    func testEncodedValuesConvertToJSON() throws {
+        let json = try BONJSONTranscoder().json(fromBONJSON: try BONJSONEncoder().encode(items))
+        XCTAssertEqual(try JSONDecoder().decode([Item].self, from: json), items)
+    }
+
+    func testStreamsMatchWholeConversion() throws {
+        let transcoder = BONJSONTranscoder()
+        transcoder.readChunkSize = 7
+        let expected = try transcoder.bonjson(fromJSON: Data(itemsJSON.utf8))
+
+        let input = InputStream(data: Data(itemsJSON.utf8))
+        let output = OutputStream(toMemory: ())
+        input.open()
+        output.open()
+        try transcoder.convertJSON(from: input, to: output)
+        input.close()
+        output.close()
+        XCTAssertEqual(output.property(forKey: .dataWrittenToMemoryStreamKey) as? Data, expected)
+    }
+
+    func testMalformedJSONThrows() {
+        let transcoder = BONJSONTranscoder()
+        for json in ["", "[1, 2", "{\"a\" 1}", "[1,]", "tru", "\"unterminated", "1 2"] {
+            XCTAssertThrowsError(try transcoder.bonjson(fromJSON: Data(json.utf8)), "\(json)")
+        }
+    }
+
+    func testLimitsApply() {
+        let transcoder = BONJSONTranscoder()
+        transcoder.maxDepth = 2
+        XCTAssertNoThrow(try transcoder.bonjson(fromJSON: Data("[[1]]".utf8)))
+        XCTAssertThrowsError(try transcoder.bonjson(fromJSON: Data("[[[1]]]".utf8))) { error in
+            guard case BONJSONDecodingError.maxDepthExceeded = error else {
+                return XCTFail("Expected maxDepthExceeded, got \(error)")
+            }
+        }
+    }
+
+    func testSinkErrorIsRethrown() {
+        struct SinkFailure: Error {}
+        XCTAssertThrowsError(try BONJSONTranscoder().convertJSON(Data(itemsJSON.utf8)) { _ in throw SinkFailure() }) { error in
+            XCTAssertTrue(error is SinkFailure, "Got \(error)")
+        }
+    }
+}
+
+// MARK: - Map Index Tests
+
+final class BONJSONMapIndexTests: XCTestCase {
+
+    struct Reading: Codable, Equatable {
+        var sensor: String
+        var values: [Int]
+        var note: String?
+    }
+
+    var directory: URL!
+
+    override func setUpWithError() throws {
+        directory = FileManager.default.temporaryDirectory
+            .appendingPathComponent("bonjson-index-\(UUID().uuidString)")
+        try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+    }
+
+    override func tearDownWithError() throws {
+        try? FileManager.default.removeItem(at: directory)
+    }
+
+    func makeReadings() -> [Reading] {
+        return (0..<2000).map { Reading(sensor: "sensor \($0 % 7)", values: [$0, $0 * 3, -$0], note: $0 % 5 == 0 ? "check" : nil) }
+    }
+
+    func writeDocument(_ readings: [Reading]) throws -> (document: URL, index: URL) {
+        let document = directory.appendingPathComponent("readings.bonjson")
+        let index = directory.appendingPathComponent("readings.bonjson.index")
+        try BONJSONEncoder().encode(readings).write(to: document)
+        try BONJSONDecoder().writeIndex(forContentsOf: document, to: index)
+        return (document, index)
+    }
+
+    func assertIndexMismatch(_ expression: @autoclosure () throws -> Any, file: StaticString = #file, line: UInt = #line) {
+        XCTAssertThrowsError(try expression(), file: file, line: line) { error in
+            guard case BONJSONDecodingError.indexMismatch = error else {
+                return XCTFail("Expected indexMismatch, got \(error)", file: file, line: line)
+            }
+        }
+    }
+
+    func testDecodeFromIndexMatchesScan() throws {
+        let readings = makeReadings()
+        let (document, index) = try writeDocument(readings)
+        let decoded = try BONJSONDecoder().decode([Reading].self, contentsOf: document, index: index)
+        XCTAssertEqual(decoded, readings)
+
+        // The index is reusable, and typed arrays expanded by one decode don't touch the file
+        XCTAssertEqual(try BONJSONDecoder().decode([Reading].self, contentsOf: document, index: index), readings)
+    }
+
+    func testRewritingIndexReplacesIt() throws {
+        let (document, index) = try writeDocument(makeReadings())
+        let changed = Array(makeReadings().reversed())
+        try BONJSONEncoder().encode(changed).write(to: document)
+        try BONJSONDecoder().writeIndex(forContentsOf: document, to: index)
+        XCTAssertEqual(try BONJSONDecoder().decode([Reading].self, contentsOf: document, index: index), changed)
+    }
+
+    func testPathQueriesFromIndex() throws {
+        let readings = makeReadings()
+        let (document, index) = try writeDocument(readings)
+        let indexed = try BONJSONDocument(contentsOf: document, index: index)
+        XCTAssertEqual(try indexed.string(at: BONJSONPath("$[1234].sensor")), readings[1234].sensor)
+        XCTAssertEqual(try indexed.int64(at: BONJSONPath("$[1999].values[1]")), 5997)
+        XCTAssertEqual(try indexed.count(of: BONJSONPath("$[*].note")), readings.filter { $0.note != nil }.count)
+    }
+
+    func testChangedDocumentIsRejected() throws {
+        let (document, index) = try writeDocument(makeReadings())
+        var readings = makeReadings()
+        readings[0].sensor = "sensor X"
+        try BONJSONEncoder().encode(readings).write(to: document)
+        assertIndexMismatch(try BONJSONDecoder().decode([Reading].self, contentsOf: document, index: index))
+        assertIndexMismatch(try BONJSONDocument(contentsOf: document, index: index))
+    }
+
+    func testOtherDecoderSettingsAreRejected() throws {
+        let (document, index) = try writeDocument(makeReadings())
+
+        let limited = BONJSONDecoder()
+        limited.maxContainerSize = 100_000
+        assertIndexMismatch(try limited.decode([Reading].self, contentsOf: document, index: index))
+
+        let allowsDuplicates = BONJSONDecoder()
+        allowsDuplicates.duplicateKeyDecodingStrategy = .keepLast
+        assertIndexMismatch(try allowsDuplicates.decode([Reading].self, contentsOf: document, index: index))
+
+        // Custom key conversion maps record instances as objects
+        let custom = BONJSONDecoder()
+        custom.keyDecodingStrategy = .custom { $0.last! }
+        assertIndexMismatch(try custom.decode([Reading].self, contentsOf: document, index: index))
+
+        // Settings that only apply while decoding values don't matter
+        let dates = BONJSONDecoder()
+        dates.dateDecodingStrategy = .secondsSince1970
+        XCTAssertEqual(try dates.decode([Reading].self, contentsOf: document, index: index), makeReadings())
+    }
+
+    func testInvalidIndexThrows() throws {
+        let (document, index) = try writeDocument(makeReadings())
+        let bytes = try Data(contentsOf: index)
+        try bytes.prefix(bytes.count - 8).write(to: index)
+        XCTAssertThrowsError(try BONJSONDecoder().decode([Reading].self, contentsOf: document, index: index))
+        try Data(repeating: 0, count: 256).write(to: index)
+        XCTAssertThrowsError(try BONJSONDecoder().decode([Reading].self, contentsOf: document, index: index))
+    }
 }
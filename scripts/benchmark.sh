@@ -1,12 +1,90 @@
 #!/bin/bash
-# ABOUTME: Runs the BONJSON vs JSON benchmark comparison with release optimizations.
+# ABOUTME: Runs the Swift BONJSON vs JSON comparison, or the C microbenchmarks with baseline gating.
+# ABOUTME: Usage: benchmark.sh [c [--save FILE] [--compare FILE] [--threshold PCT] [benchmark args...]]
 
-set -e
+set -eo pipefail
 
-cd "$(dirname "$0")"
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+cd "$PROJECT_DIR"
 
-echo "Building benchmark in release mode..."
-swift build -c release --product bonjson-benchmark 2>&1 | grep -v "^Build complete" || true
+if [ "$1" != "c" ]; then
+    echo "Building benchmark in release mode..."
+    swift build -c release --product bonjson-benchmark 2>&1 | grep -v "^Build complete" || true
 
+    echo ""
+    swift run -c release bonjson-benchmark
+    exit 0
+fi
+shift
+
+SAVE_FILE=""
+COMPARE_FILE=""
+THRESHOLD=10
+BENCH_ARGS=()
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --save) SAVE_FILE="$2"; shift 2 ;;
+        --compare) COMPARE_FILE="$2"; shift 2 ;;
+        --threshold) THRESHOLD="$2"; shift 2 ;;
+        *) BENCH_ARGS+=("$1"); shift ;;
+    esac
+done
+
+# The C benchmark is a few translation units, so build it directly rather than
+# through SwiftPM; this also works where no Swift toolchain is installed.
+BENCH_BINARY=".build/bonjson-c-benchmark"
+mkdir -p .build
+echo "Building C benchmark..." >&2
+${CC:-cc} -std=gnu11 ${CFLAGS:--O2} -DNDEBUG -o "$BENCH_BINARY" Sources/CKSBonjsonBenchmark/*.c -lm
+
+RESULTS="$(mktemp)"
+trap 'rm -f "$RESULTS"' EXIT
+"$BENCH_BINARY" "${BENCH_ARGS[@]}" | tee "$RESULTS"
+
+if [ -n "$SAVE_FILE" ]; then
+    cp "$RESULTS" "$SAVE_FILE"
+    echo "" >&2
+    echo "Saved baseline to $SAVE_FILE" >&2
+fi
+
+if [ -z "$COMPARE_FILE" ]; then
+    exit 0
+fi
+
+if [ "$(head -1 "$COMPARE_FILE" | cut -f1)" != "$(head -1 "$RESULTS" | cut -f1)" ]; then
+    echo "" >&2
+    echo "ERROR: $COMPARE_FILE was recorded with a different corpus version" >&2
+    exit 1
+fi
+
+# Rows are keyed by benchmark and corpus. A benchmark regresses when its
+# ns_per_value (column 8) grows by more than THRESHOLD percent.
 echo ""
-swift run -c release bonjson-benchmark
+echo "=== COMPARISON WITH $COMPARE_FILE (threshold ${THRESHOLD}%) ==="
+printf "%-20s %-14s %12s %12s %8s\n" "benchmark" "corpus" "baseline" "current" "change"
+awk -F'\t' -v threshold="$THRESHOLD" '
+    /^#/ || $1 == "benchmark" { next }
+    FNR == NR { baseline[$1 "\t" $2] = $8; next }
+    {
+        key = $1 "\t" $2
+        if (!(key in baseline)) {
+            printf "%-20s %-14s %12s %12.3f %8s\n", $1, $2, "-", $8, "new"
+            next
+        }
+        change = (baseline[key] > 0) ? ($8 - baseline[key]) * 100 / baseline[key] : 0
+        status = ""
+        if (change > threshold) {
+            status = "REGRESSION"
+            regressions++
+        }
+        printf "%-20s %-14s %12.3f %12.3f %+7.1f%% %s\n", $1, $2, baseline[key], $8, change, status
+    }
+    END {
+        if (regressions > 0) {
+            printf "\n%d benchmark(s) regressed by more than %s%%\n", regressions, threshold
+            exit 1
+        }
+        print "\nNo regressions"
+    }
+' "$COMPARE_FILE" "$RESULTS"